@@ -1,16 +1,16 @@
 #include "AlbumArt.hpp"
 
-#include <map>
 #include <algorithm>
-#include <thread>
+#include <cstring>
 
 #include "MathCPP/Duration.hpp"
 
+#include "AnalysisCache.hpp"
 #include "Bicubic.hpp"
 #include "Buffer.hpp"
+#include "Canvas.hpp"
 #include "CConsole.h"
 #include "Gaussian.hpp"
-#include "Hash.hpp"
 #include "Settings.hpp"
 #include "Utils.hpp"
 
@@ -40,6 +40,8 @@ void AlbumArt::OnInit(int windowWidth, int windowHeight, float scale) {
 
 	albumTexCoords[361 * 2] = albumTexCoords[2];
 	albumTexCoords[361 * 2 + 1] = albumTexCoords[3];
+
+	worker = std::thread(&AlbumArt::Work, this);
 }
 
 void AlbumArt::OnResize(int windowWidth, int windowHeight, float scale) {
@@ -91,50 +93,48 @@ void AlbumArt::UpdateTextureCoords() {
 void AlbumArt::OnLoop(GLfloat x, GLfloat y, float frameCount) {
 	// try_lock so we don't miss a frame or two
 	if (mutex.try_lock()) {
-		if (surfaceToLoad) {
-			LoadFromSurface(surfaceToLoad, true);
-			surfaceToLoad = nullptr;
-
-			// We only want to keep lastSurface
-			// around for as long as we need
-			// to scale it down.
-			// 
-			// [16Jul2025] We now want to keep the un-scaled surface
-			//             around as it might need rescaling when the
-			//             DPI changes
-			// 
-//			SDL_FreeSurface(lastSurface);
-//			lastSurface = nullptr;
+		while (!results.empty()) {
+			pending.emplace_back(std::move(results.front()));
+			results.pop_front();
 		}
 		mutex.unlock();
 	}
 
+	// One at a time, so everything lands in
+	// the same order it was asked for
+	while (!pending.empty()) {
+		auto &result = pending.front();
+
+		// Not worth uploading. Anything that's already
+		// started has to finish first, though, as our
+		// worker might still be filling its buffer.
+		if (result.stage == Result::Stage::Staging && IsSuperseded(result)) {
+			Discard(result);
+		} else if (Upload(result)) {
+			if (IsSuperseded(result))
+				Discard(result);
+			else
+				Apply(result);
+		} else {
+			break;
+		}
+
+		pending.pop_front();
+	}
+
 	if (albumLoaded) {
-		glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-		glEnable(GL_TEXTURE_2D);
-		glTranslatef(
-			x,
-			y,
-			0.0f
-		);
-		glRotatef(
+		auto &canvas = Canvas::Get();
+
+		canvas.SetColor(1.0f, 1.0f, 1.0f, 1.0f);
+		canvas.Translate(x, y);
+		canvas.Rotate(
 			360.0f + frameCount,
 			0.0f,
 			0.0f,
 			1.0f
 		);
-		glBindTexture(GL_TEXTURE_2D, album);
-		glVertexPointer(2, GL_FLOAT, 0, albumVertexBuffer);
-		glTexCoordPointer(2, GL_FLOAT, 0, albumTexCoords);
-
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-		glDrawArrays(GL_TRIANGLE_FAN, 0, 362);
-		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-		glDisableClientState(GL_VERTEX_ARRAY);
-
-		glDisable(GL_TEXTURE_2D);
-		glLoadIdentity();
+		canvas.DrawTextured(GL_TRIANGLE_FAN, 362, album, albumVertexBuffer, albumTexCoords);
+		canvas.LoadIdentity();
 	}
 }
 
@@ -149,25 +149,22 @@ int AlbumArt::DrawSquare(int x, int y, int height, GLfloat alpha) {
 			squareVertexBuffer[6] = height * aspectRatio;
 		}
 
-		glColor4f(1.0f, 1.0f, 1.0f, alpha);
-		glEnable(GL_TEXTURE_2D);
-		glTranslatef(
-			static_cast<GLfloat>(x),
-			static_cast<GLfloat>(y),
-			0.0f
-		);
-		glBindTexture(GL_TEXTURE_2D, album);
-		glVertexPointer(2, GL_FLOAT, 0, squareVertexBuffer);
-		glTexCoordPointer(2, GL_FLOAT, 0, Buffer::TexCoordBuffer.data());
+		auto &canvas = Canvas::Get();
 
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, Buffer::SquareBuffer.data());
-		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-		glDisableClientState(GL_VERTEX_ARRAY);
-
-		glDisable(GL_TEXTURE_2D);
-		glLoadIdentity();
+		canvas.SetColor(1.0f, 1.0f, 1.0f, alpha);
+		canvas.Translate(
+			static_cast<float>(x),
+			static_cast<float>(y)
+		);
+		canvas.DrawTextured(
+			GL_TRIANGLES,
+			6,
+			album,
+			squareVertexBuffer,
+			Buffer::TexCoordBuffer.data(),
+			Buffer::SquareBuffer.data()
+		);
+		canvas.LoadIdentity();
 
 		// Return our width
 		return static_cast<int>(squareVertexBuffer[4]);
@@ -177,447 +174,582 @@ int AlbumArt::DrawSquare(int x, int y, int height, GLfloat alpha) {
 }
 
 void AlbumArt::OnDestroy() {
-	if (lastSurface)
-		SDL_FreeSurface(lastSurface);
+	{
+		std::unique_lock lock(mutex);
+		stopping = true;
+		jobs.clear();
+	}
+
+	// No need to wait for any scaling to finish
+	if (scaling)
+		*scaling = true;
+	if (prefetching)
+		*prefetching = true;
+
+	condition.notify_all();
+
+	// Our worker could still be filling one of our buffers
+	if (worker.joinable())
+		worker.join();
+
+	for (auto &result : results)
+		Discard(result);
+	for (auto &result : pending)
+		Discard(result);
+
+	results.clear();
+	pending.clear();
+
+	source.reset();
+	scaled.reset();
+	prefetched.clear();
+
+	Canvas::Get().Flush();
 
 	glDeleteTextures(1, &album);
 	album = 0;
 }
 
 std::filesystem::path AlbumArt::FindArt(const std::filesystem::path &folder) const {
-	std::filesystem::path found;
-	bool foundPreferred = false;
-
-	auto find = [&](const std::filesystem::directory_entry &entry, bool breakOnFind = false) {
-		auto extension = entry.path().extension().u8string();
-		std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
-		if (IsSupported(extension)) {
-			if (found.empty())
-				found = entry.path();
-
-			auto filename = entry.path().filename().u8string();
-			std::transform(filename.begin(), filename.end(), filename.begin(), tolower);
-
-			if ((filename.find("cover") == 0 ||
-				filename.find("front") == 0 ||
-				filename.find("folder") == 0) &&
-				!foundPreferred) {
-				found = entry.path();
-				foundPreferred = true;
-
-				// Optionally break when we find a preferred file
-				//
-				// This can be used with recursive_directory_iterator
-				// to avoid scanning _every_ subfolder.
-				//
-				// My music folder has a number of unsorted tracks
-				// in the root, and I don't want it scannning through
-				// 1TB of data when trying to load album art for those
-				//
-				// In those cases, this will just pick the first (preferred)
-				// album art file found in any of the subfolders. It should
-				// really just pick _nothing_, but I'm not sure what a good
-				// litmus test for this specific case would look like.
-				if (breakOnFind)
-					return true;
-			}
+	// Only scan subfolders if we don't already have embedded art
+	return Palette::FindArt(folder, !embeddedArt);
+}
+
+void AlbumArt::Queue(Job job) {
+	{
+		std::unique_lock lock(mutex);
+		jobs.emplace_back(std::move(job));
+	}
+
+	condition.notify_one();
+}
+
+void AlbumArt::Work() {
+	while (true) {
+		Job job;
+
+		{
+			std::unique_lock lock(mutex);
+			condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			if (stopping)
+				return;
+
+			job = std::move(jobs.front());
+			jobs.pop_front();
 		}
 
-		return false;
-	};
+		// Filling's never skipped, since the
+		// render thread is waiting on it
+		if (job.type == Job::Type::Fill) {
+			Fill(job);
+			continue;
+		}
+
+		// Prefetching's for whichever song's next, so it
+		// doesn't care which one's loaded. Whatever the
+		// last one got ready is no good to this one.
+		if (job.type == Job::Type::Prefetch) {
+			prefetched.clear();
+
+			if (!*job.canceled)
+				Prepare(job);
+
+			continue;
+		}
+
+		// Nobody wants this anymore
+		if (job.generation != generation || (job.canceled && *job.canceled))
+			continue;
 
-	// Try to find in our current folder first
-	for (const auto &iter : std::filesystem::directory_iterator(folder))
-		find(iter);
+		// Art from a new song is only ever
+		// measured up against its own
+		if (job.generation != workerGeneration) {
+			workerGeneration = job.generation;
+			acceptedWidth = acceptedHeight = 0;
+			embeddedArt = false;
+		}
 
-	// Then try any subfolders
-	// FIXME: we don't need to re-check files in the current folder
-	if (found.empty() && (albumWidth == 0 || albumHeight == 0) /* only scan subfolders if we don't already have embedded art */) {
-		for (const auto &iter : std::filesystem::recursive_directory_iterator(folder))
-			if (find(iter, true)) break;
+		if (job.type == Job::Type::Decode)
+			Decode(job);
+		else
+			ScaleSource(job);
 	}
+}
 
-	return found;
+void AlbumArt::Post(Result result) {
+	std::unique_lock lock(mutex);
+	results.emplace_back(std::move(result));
 }
 
-void AlbumArt::LoadFromSurface(SDL_Surface *surface, bool scaled) {
-	glEnable(GL_TEXTURE_2D);
-	glDeleteTextures(1, &album);
-	glGenTextures(1, &album);
-	glBindTexture(GL_TEXTURE_2D, album);
+void AlbumArt::Decode(Job &job) {
+	const auto embedded = job.path.empty() && job.folder.empty();
+
+	if (embedded) {
+		embeddedArt = true;
+	} else if (!job.folder.empty()) {
+		job.path = FindArt(job.folder);
+
+		if (job.path.empty()) {
+			CConsole::Console.Print(L"Could not load external album art for " + job.song.wstring(), MSG_ALERT);
+			return;
+		}
+	}
+
+	if (!embedded)
+		job.data = Fetcko::Utils::GetStringFromFile(job.path);
+
+	const auto &contents = job.data;
+	auto hash = Palette::Hash(contents.c_str(), contents.size());
+
+	auto &last = embedded ? lastEmbeddedHash : lastHash;
+	if (hash == last) {
+		CConsole::Console.Print(std::string(embedded ? "Embedded" : "External") + " art has already been loaded for this album", MSG_DIAG);
+
+		acceptedWidth = source ? source->w : 0;
+		acceptedHeight = source ? source->h : 0;
+
+		Result result;
+		result.generation = job.generation;
+		result.width = acceptedWidth;
+		result.height = acceptedHeight;
+		Post(std::move(result));
+
+		return;
+	}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_FALSE);
+	last = hash;
+
+	// If it was prefetched, it's already been
+	// decoded and had its colors picked out
+	std::optional<Prefetched> ready;
+	if (auto found = std::find_if(
+			prefetched.begin(),
+			prefetched.end(),
+			[hash](const Prefetched &art) { return art.hash == hash; }
+		); found != prefetched.end()) {
+		ready = std::move(*found);
+		prefetched.erase(found);
+	}
+
+	auto surface = ready ? ready->decoded.surface : DecodeImage(contents, job.mimeType);
+
+	if (!surface) {
+		if (embedded)
+			CConsole::Console.Print("Could not load embedded album art!", MSG_ERROR);
+		else
+			CConsole::Console.Print("Could not load external album art from file " + job.path.u8string(), MSG_ERROR);
+
+		return;
+	} else if (!job.force && surface->w < acceptedWidth && surface->h < acceptedHeight) {
+		CConsole::Console.Print(std::string(embedded ? "Embedded" : "External") + " album art is smaller than what's already loaded", MSG_ALERT);
+		return;
+	} else if (!embedded && acceptedWidth != 0 && acceptedHeight != 0) {
+		CConsole::Console.Print("External album art is larger than embedded. Using it instead.", MSG_DIAG);
+	}
+
+	source = surface;
+	scaled.reset();
+
+	// and maybe scaled, too
+	if (ready && ready->scaled) {
+		scaled = ready->scaled;
+		scaledRadius = ready->scaledRadius;
+	}
+
+	acceptedWidth = surface->w;
+	acceptedHeight = surface->h;
+
+	Result result = ready ? std::move(ready->decoded) : Result();
+	result.generation = job.generation;
+	result.surface = source;
+	result.width = surface->w;
+	result.height = surface->h;
+
+	if (!ready)
+		PickColors(result, hash);
+
+	Post(std::move(result));
+}
+
+void AlbumArt::Prepare(Job &job) {
+	std::vector<Prefetched> ready;
+
+	// Anything smaller than what's already been
+	// got ready would only be turned down
+	int width = 0, height = 0;
+
+	const auto prepare = [&](const std::string &contents, const std::string &mimeType, std::uint32_t last) {
+		auto hash = Palette::Hash(contents.c_str(), contents.size());
+
+		// Decode() won't even look at it
+		if (hash == last)
+			return;
+
+		// Decode() can say why when it gets to it
+		auto surface = DecodeImage(contents, mimeType);
+		if (!surface || (surface->w < width && surface->h < height))
+			return;
+
+		width = surface->w;
+		height = surface->h;
+
+		Prefetched art;
+		art.hash = hash;
+		art.decoded.surface = surface;
+		art.decoded.width = width;
+		art.decoded.height = height;
+		PickColors(art.decoded, hash);
+
+		ready.emplace_back(std::move(art));
+	};
+
+	// In the same order they'd be loaded in
+	const auto embedded = !job.data.empty();
+	if (embedded)
+		prepare(job.data, job.mimeType, lastEmbeddedHash);
+
+	if (*job.canceled)
+		return;
+
+	// Only scan subfolders if there's no embedded art
+	if (auto path = Palette::FindArt(job.folder, !embedded); !path.empty())
+		prepare(Fetcko::Utils::GetStringFromFile(path), "", lastHash);
+
+	if (ready.empty() || *job.canceled)
+		return;
+
+	// Whichever came last is what'll get scaled
+	auto &winner = ready.back();
+	winner.scaled = Resize(winner.decoded.surface, job.radius, *job.canceled);
+
+	if (!winner.scaled)
+		return;
 
-	albumWidth = surface->w;
-	albumHeight = surface->h;
+	winner.scaledRadius = job.radius;
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surface->w, surface->h, 0, surface->format->BitsPerPixel == 32 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, surface->pixels);
+	prefetched = std::move(ready);
 
+	CConsole::Console.Print(L"Prefetched album art for " + job.song.filename().wstring(), MSG_DIAG);
+}
+
+AlbumArt::Surface AlbumArt::DecodeImage(const std::string &contents, const std::string &mimeType) const {
+	// We already have the whole file, so
+	// there's no need to read it again
+	auto file = SDL_RWFromConstMem(contents.data(), static_cast<int>(contents.size()));
+
+	SDL_Surface *surface = nullptr;
+	if (!mimeType.empty()) {
+		auto type = mimeType.substr(mimeType.find('/') + 1);
+		surface = IMG_LoadTyped_RW(file, 1, type.c_str());
+	} else {
+		surface = IMG_Load_RW(file, 1);
+	}
+
+	if (!surface)
+		return nullptr;
+
+	return Surface(surface, SDL_FreeSurface);
+}
+
+void AlbumArt::PickColors(Result &result, std::uint32_t hash) const {
+	const auto surface = result.surface.get();
 	auto pixels = reinterpret_cast<uint8_t *>(surface->pixels);
 
-	if (!scaled) {
-		// lastSurface is the last surface
-		// _before_ scaling, so only update
-		// it when we aren't scaling
-		if (lastSurface)
-			SDL_FreeSurface(lastSurface);
-
-		lastSurface = surface;
-		lastSurfaceUpdated = true;
-
-		if (colorMethod == ColorMethod::Average) {
-			// Go through every pixel to find an "average" color
-			uint64_t averageR = 0;
-			uint64_t averageG = 0;
-			uint64_t averageB = 0;
-			for (auto x = 0; x < surface->w; ++x) {
-				for (auto y = 0; y < surface->h; ++y) {
-					auto pos = y * surface->format->BytesPerPixel * surface->w + x * surface->format->BytesPerPixel;
-
-					averageR += pixels[pos];
-					averageG += pixels[pos + 1];
-					averageB += pixels[pos + 2];
-				}
+	if (colorMethod == ColorMethod::Average) {
+		// Go through every pixel to find an "average" color
+		uint64_t averageR = 0;
+		uint64_t averageG = 0;
+		uint64_t averageB = 0;
+		for (auto x = 0; x < surface->w; ++x) {
+			for (auto y = 0; y < surface->h; ++y) {
+				auto pos = y * surface->format->BytesPerPixel * surface->w + x * surface->format->BytesPerPixel;
+
+				averageR += pixels[pos];
+				averageG += pixels[pos + 1];
+				averageB += pixels[pos + 2];
 			}
+		}
 
-			Colour color(
-				(averageR / surface->w * surface->h) / 255.0f,
-				(averageG / surface->w * surface->h) / 255.0f,
-				(averageB / surface->w * surface->h) / 255.0f
-			);
-
-			auto hsv = color.ToHsv();
-			hsv.s = 0.9f;
-			hsv.v = 0.9f;
+		Colour color(
+			(averageR / surface->w * surface->h) / 255.0f,
+			(averageG / surface->w * surface->h) / 255.0f,
+			(averageB / surface->w * surface->h) / 255.0f
+		);
 
-			averageColor = Colour<float>::FromHsv(hsv.h, hsv.s, hsv.v);
+		auto hsv = color.ToHsv();
+		hsv.s = 0.9f;
+		hsv.v = 0.9f;
 
-			for (const auto &listener : colorChangeListeners)
-				listener->OnColorChanged(averageColor);
+		result.averageColor = Colour<float>::FromHsv(hsv.h, hsv.s, hsv.v);
+	} else {
+		// A palette popRocksAnalyse (or an earlier visit
+		// to this album) already worked out saves us a
+		// pass over every pixel
+		const auto &selection = Settings::settings.GetColorSelection();
+		if (auto cached = AnalysisCache::LoadPalette(hash, selection)) {
+			result.histogram = std::move(*cached);
 		} else {
-			std::map<float, Bin> histogram;
-
-			Colour<float> color;
-
-			// Still using nearest neighbor for this...
-			// should we wait until Scale() is done before
-			// loading the colors?
-			//
-			// n = 1, but "VA-11 HALL-A - Second Round"'s
-			// album art sets a precedent for still
-			// using nearest neighbor. Bicubic ultimately
-			// makes the dominant color darker.
-			//
-			// Until proven otherwise, color selection is
-			// wrapped in "if (!scaled)"
-			auto hstep = std::max(1, static_cast<int>(surface->w / (radius * 2)));
-			auto vstep = std::max(1, static_cast<int>(surface->h / (radius * 2)));
-
-			double minSaturation = Settings::settings.GetColorSelection().minSaturation;
-			double minValue = Settings::settings.GetColorSelection().minValue;
-
-			while (histogram.empty()) {
-				for (auto x = 0; x < surface->w; x += hstep) {
-					for (auto y = 0; y < surface->h; y += vstep) {
-						auto index = y * surface->pitch + x * surface->format->BytesPerPixel;
-
-						color.r = pixels[index] / 255.0f;
-						color.g = pixels[index + 1] / 255.0f;
-						color.b = pixels[index + 2] / 255.0f;
-
-						auto hsv = color.ToHsv();
-
-						// Round to the nearest 0.5
-						// That gives us 720 possible hues
-						//hsv.h = (std::round(hsv.h * 2)) / 2;
-
-						// Round to the nearest _even_ number
-						// This only gives us 180 possible hues,
-						// but allows for fewer low-count bins
-						hsv.h = std::round(std::round(hsv.h) / 2) * 2;
-
-						// Exclude dark / low contrast colors
-						if (hsv.s >= minSaturation && hsv.v >= minValue) {
-							if (auto iter = histogram.find(hsv.h); iter != histogram.end()) {
-								++iter->second.count;
-								iter->second.s += hsv.s;
-								
-								/*
-								if (hsv.s > iter->second.s)
-									iter->second.s = hsv.s;
-								*/
-
-								iter->second.v += hsv.v;
-							} else
-								histogram.emplace(std::make_pair(hsv.h, Bin(1, hsv.h, hsv.s, hsv.v)));
-						}
-					}
-				}
+			result.histogram = Palette::Extract(surface, selection);
+			AnalysisCache::SavePalette(hash, *result.histogram, selection);
+		}
+	}
+}
 
-				// If we found nothing above the minimums,
-				// disable them
-				if (histogram.empty() && minSaturation > DBL_EPSILON) {
-					minSaturation = 0.0;
-					minValue = 0.0;
-				} else
-					break;
-			}
+void AlbumArt::Fill(const Job &job) {
+	const auto surface = job.surface.get();
+	const auto rowLength = static_cast<std::size_t>(surface->w) * surface->format->BytesPerPixel;
 
-			this->histogram.clear();
+	auto destination = reinterpret_cast<std::uint8_t *>(job.destination);
+	auto row = reinterpret_cast<const std::uint8_t *>(surface->pixels);
 
-			std::size_t maxCount = std::numeric_limits<std::size_t>::min();
-			for (const auto &[hue, bin] : histogram) {
-				if (bin.count > maxCount)
-					maxCount = bin.count;
-			}
+	for (auto y = 0; y < surface->h; ++y) {
+		std::memcpy(destination, row, rowLength);
 
-			const auto minPercentage = static_cast<std::size_t>(
-				maxCount * Settings::settings.GetColorSelection().minPercentage
-			);
-
-			for (auto &[hue, bin] : histogram) {
-				// Filter out anything < a percentage of our max
-				if (bin.count >= minPercentage) {
-					this->histogram.emplace(
-						Bin(
-							bin.count,
-							bin.h,
-							bin.s / bin.count,
-							bin.v / bin.count
-						)
-					);
-				}
-			}
+		destination += rowLength;
+		row += surface->pitch;
+	}
 
-			// This compares each bin to _every_ other bin in the histogram
-			/*
-			for (auto iter = this->histogram.begin(); iter != this->histogram.end();) {
-				bool erased = false;
-				for (auto compare = this->histogram.begin(); compare != this->histogram.end(); ++compare) {
-					// When hues are separated by less than a
-					// certain number of degrees, choose the
-					// one with the highest count and discard
-					// the other.
-					if (compare != iter &&
-						std::abs(iter->second.h - compare->second.h) < minSeparation &&
-						iter->first < compare->first
-					) {
-						iter = this->histogram.erase(iter);
-						erased = true;
-						break;
-					}
-				}
-				if (!erased)
-					++iter;
-			}
-			*/
-
-			// This compares each bin to the last bin inserted into the histogram
-			/*
-			auto tempHistogram = this->histogram;
-			this->histogram.clear();
-			for (auto iter = tempHistogram.rbegin(); iter != tempHistogram.rend(); ++iter) {
-				if (this->histogram.empty()) {
-					this->histogram.emplace(*iter);
-				} else if (std::abs(this->histogram.begin()->h - iter->h) > 25.0) {
-					CConsole::Console.Print(
-						"Placing in histogram because hue is " +
-							std::to_string(iter->h) +
-							" vs last bin's hue of " +
-							std::to_string(this->histogram.begin()->h),
-						MSG_DIAG
-					);
-					this->histogram.emplace(*iter);
-				}
-			}
-			*/
-
-			// This compares each bin to the other, already-selected bins
-			//
-			// This also doesn't just take hue into account.
-			// If we had to remove the minimum saturation / value filters,
-			// we also check for value separation.
-			auto tempHistogram = this->histogram;
-			this->histogram.clear();
-			for (auto iter = tempHistogram.rbegin(); iter != tempHistogram.rend(); ++iter) {
-				if (this->histogram.empty()) {
-					this->histogram.emplace(*iter);
-				} else {
-					bool found = true;
-					for (auto compare = this->histogram.begin(); compare != this->histogram.end(); ++compare) {
-						auto rgb = Colour<float>::FromHsv(iter->h, iter->s, iter->v);
-						auto rgbComp = Colour<float>::FromHsv(compare->h, compare->s, compare->v);
-
-						auto distance =
-							std::sqrt(
-								std::pow(rgbComp.r - rgb.r, 2) +
-								std::pow(rgbComp.g - rgb.g, 2) +
-								std::pow(rgbComp.b - rgb.b, 2)
-							);
-
-						// https://gamedev.stackexchange.com/a/4472
-						// 360 - 0 (in degrees) needs to be 0, not 360
-						if ((180 - abs(abs(iter->h - compare->h) - 180) < Settings::settings.GetColorSelection().minHueSeparation &&
-							distance < Settings::settings.GetColorSelection().minRgbSeparation) ||
-							(minSaturation <= DBL_EPSILON && std::abs(compare->v - iter->v) < Settings::settings.GetColorSelection().minValueSeparation))
-							found = false;
-
-						/*
-						if (180 - abs(abs(iter->h - compare->h) - 180) < Settings::settings.GetColorSelection().minHueSeparation ||
-							(minSaturation <= DBL_EPSILON && std::abs(compare->v - iter->v) < Settings::settings.GetColorSelection().minValueSeparation))
-							found = false;
-						*/
-					}
-					if (found)
-						this->histogram.emplace(*iter);
-				}
+	*job.filled = true;
+}
+
+bool AlbumArt::Upload(Result &result) {
+	if (!result.surface)
+		return true;
+
+	const auto surface = result.surface.get();
+	const auto format = surface->format->BitsPerPixel == 32 ? GL_RGBA : GL_RGB;
+	const auto size = static_cast<GLsizeiptr>(surface->w) * surface->h * surface->format->BytesPerPixel;
+
+	switch (result.stage) {
+		case Result::Stage::Staging: {
+			glGenBuffers(1, &result.buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, result.buffer);
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+
+			auto destination = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			if (!destination) {
+				CConsole::Console.Print("Could not map a buffer for album art", MSG_ERROR);
+				Discard(result);
+				return true;
 			}
 
-			// FIXME: In This Moment's "Blood"'s red
-			//        is more pink right now, but
-			//        selecting the max saturation
-			//        instead of the average blows out
-			//        colors on other albums like 
-			//        "talking / Nana Hitsuji"
+			result.filled = std::make_shared<std::atomic<bool>>(false);
 
-			// If our histogram contains only a single color,
-			// add a darker / lighter variant of that color 
-			// for beat detection to toggle through
-			if (this->histogram.size() == 1) {
-				auto deeperColor = *this->histogram.begin();
+			Job job;
+			job.type = Job::Type::Fill;
+			job.surface = result.surface;
+			job.destination = destination;
+			job.filled = result.filled;
+			Queue(std::move(job));
 
-				if (deeperColor.v >= 0.5)
-					deeperColor.v = std::clamp(deeperColor.v / 1.75f, 0.0f, 1.0f);
-				else
-					deeperColor.v = std::clamp(deeperColor.v * 1.75f, 0.0f, 1.0f);
+			result.stage = Result::Stage::Filling;
 
-				deeperColor.count -= 1;
+			return false;
+		}
+		case Result::Stage::Filling: {
+			if (!*result.filled)
+				return false;
+
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, result.buffer);
 
-				this->histogram.emplace(std::move(deeperColor));
+			if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				CConsole::Console.Print("Album art's buffer was lost before it could be uploaded", MSG_ERROR);
+				Discard(result);
+				return true;
 			}
 
-			ResetBin();
+			glGenTextures(1, &result.texture);
+			glBindTexture(GL_TEXTURE_2D, result.texture);
+
+			// Unscaled art's drawn a lot smaller than it is
+			// (until it's scaled down), so it needs mipmaps
+			// to not shimmer. Scaled art's drawn 1:1.
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, result.scaled ? GL_LINEAR : GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+
+			// Rows were packed tightly by Fill()
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+			// Sourced from the bound buffer, so this returns
+			// straight away and the copy happens on the GPU's time
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surface->w, surface->h, 0, format, GL_UNSIGNED_BYTE, nullptr);
+
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+			if (!result.scaled)
+				glGenerateMipmap(GL_TEXTURE_2D);
+
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			// The driver holds onto it until the copy's done
+			glDeleteBuffers(1, &result.buffer);
+			result.buffer = 0;
+
+			result.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			result.stage = Result::Stage::Transferring;
+
+			// Make sure the GPU actually gets started on it
+			glFlush();
+
+			return false;
+		}
+		case Result::Stage::Transferring: {
+			if (glClientWaitSync(result.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+				return false;
+
+			glDeleteSync(result.fence);
+			result.fence = nullptr;
+			result.stage = Result::Stage::Done;
+
+			return true;
 		}
+		default:
+			return true;
+	}
+}
+
+void AlbumArt::Apply(Result &result) {
+	const auto current = result.generation == generation;
+
+	if (result.texture) {
+		// Don't pull the old art out from under
+		// anything that's already been drawn with it
+		Canvas::Get().Flush();
+
+		glDeleteTextures(1, &album);
+		album = result.texture;
+		result.texture = 0;
+
+		albumWidth = result.surface->w;
+		albumHeight = result.surface->h;
+		aspectRatio = static_cast<float>(albumWidth) / albumHeight;
+
+		UpdateTextureCoords();
 	}
 
-	scaledAlbumWidth = surface->w;
-	scaledAlbumHeight = surface->h;
-	aspectRatio = static_cast<float>(surface->w) / surface->h;
+	result.surface.reset();
 
-	UpdateTextureCoords();
+	// Scaling doesn't change anything else
+	if (result.scaled) {
+		if (current)
+			albumLoaded = true;
 
-	// [16Jul2025] We now want to keep the un-scaled surface
-	//             around as it might need rescaling when the
-	//             DPI changes
-	// 
-//	if (lastSurface)
-//		SDL_FreeSurface(lastSurface);
+		return;
+	}
+
+	// Kept even if it's too late to show,
+	// so this art's colors are right if we
+	// come back to it
+	if (result.histogram) {
+		histogram = std::move(*result.histogram);
+
+		// Anything pointing into the old one is gone
+		previousBins.clear();
+		binIter = histogram.rbegin();
+	}
 
-	glDisable(GL_TEXTURE_2D);
+	if (!current)
+		return;
 
 	albumLoaded = true;
+
+	if (result.averageColor) {
+		averageColor = *result.averageColor;
+
+		for (const auto &listener : colorChangeListeners)
+			listener->OnColorChanged(averageColor);
+	} else if (result.histogram) {
+		ResetBin();
+	} else if (!histogram.empty()) {
+		// Same art as before
+		UpdateBin(true);
+	}
 }
 
-bool AlbumArt::Load(const std::filesystem::path &fileName, const std::filesystem::path &parentPath, bool force) {
-	auto extension = fileName.extension().u8string();
-	std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
+void AlbumArt::Discard(Result &result) {
+	if (result.buffer) {
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, result.buffer);
+		if (result.stage == Result::Stage::Filling)
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-	std::filesystem::path found;
+		glDeleteBuffers(1, &result.buffer);
+	}
 
-	// Do we have cover art?
-	if (IsSupported(extension))
-		found = fileName;
-	else if (!parentPath.empty())
-		found = FindArt(parentPath);
-	else
-		found = FindArt(fileName.parent_path());
-
-	if (!found.empty()) {
-		auto contents = Fetcko::Utils::GetStringFromFile(found);
-		auto hash = hash_32_fnv1a_const(contents.c_str(), contents.size());
-		if (hash == lastHash) {
-			CConsole::Console.Print("External art has already been loaded for this album", MSG_DIAG);
-			albumLoaded = true;
-			albumWidth = lastWidth;
-			albumHeight = lastHeight;
-			UpdateBin(true);
-			return true;
-		}
+	if (result.fence)
+		glDeleteSync(result.fence);
 
-		lastHash = hash;
+	glDeleteTextures(1, &result.texture);
 
-		auto utf8 = found.u8string();
-		auto surface = IMG_Load(utf8.c_str());
+	result.buffer = result.texture = 0;
+	result.fence = nullptr;
+	result.surface.reset();
+	result.stage = Result::Stage::Done;
+}
 
-		if (!surface) {
-			CConsole::Console.Print("Could not load external album art from file " + utf8, MSG_ERROR);
-			return false;
-		} else if (!force && surface->w < albumWidth && surface->h < albumHeight) {
-			CConsole::Console.Print("External album art is smaller than what's already loaded", MSG_ALERT);
-			SDL_FreeSurface(surface);
-			return false;
-		} else if (albumWidth != 0 && albumHeight != 0) {
-			CConsole::Console.Print("External album art is larger than embedded. Using it instead.", MSG_DIAG);
-		}
+bool AlbumArt::Load(const std::filesystem::path &fileName, const std::filesystem::path &parentPath, bool force) {
+	auto extension = fileName.extension().u8string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
 
-		LoadFromSurface(surface);
+	Job job;
+	job.type = Job::Type::Decode;
+	job.generation = generation;
+	job.force = force;
+
+	// Do we have cover art?
+	if (IsSupported(extension)) {
+		job.path = fileName;
 	} else {
-		CConsole::Console.Print(L"Could not load external album art for " + fileName.wstring(), MSG_ALERT);
-		return false;
+		job.folder = parentPath.empty() ? fileName.parent_path() : parentPath;
+		job.song = fileName;
 	}
 
+	Queue(std::move(job));
+
 	return true;
 }
 
 bool AlbumArt::Load(const std::string &mimeType, const void *data, std::size_t length) {
-	auto hash = hash_32_fnv1a_const(reinterpret_cast<const char *>(data), length);
-	if (hash == lastEmbeddedHash) {
-		CConsole::Console.Print("Embedded art has already been loaded for this album", MSG_DIAG);
-		albumLoaded = true;
-		albumWidth = lastWidth;
-		albumHeight = lastHeight;
-		UpdateBin(true);
-		return true;
-	}
-
-	lastEmbeddedHash = hash;
+	if (!data || length == 0)
+		return false;
 
-	auto file = SDL_RWFromMem(
-		const_cast<void*>(data),
-		static_cast<int>(length)
-	);
-	auto type = mimeType.substr(mimeType.find('/') + 1);
+	// Whatever data points to is only ours for now
+	return Load(mimeType, std::string(reinterpret_cast<const char *>(data), length));
+}
 
-	auto surface = IMG_LoadTyped_RW(file, 1, type.c_str());
-	if (!surface) {
-		CConsole::Console.Print("Could not load embedded album art!", MSG_ERROR);
-		return false;
-	} else if (surface->w < albumWidth && surface->h < albumHeight) {
-		CConsole::Console.Print("Embedded album art is smaller than what's already loaded", MSG_ALERT);
-		SDL_FreeSurface(surface);
+bool AlbumArt::Load(const std::string &mimeType, std::string &&data) {
+	if (data.empty())
 		return false;
-	}
 
-	LoadFromSurface(surface);
+	Job job;
+	job.type = Job::Type::Decode;
+	job.generation = generation;
+	job.data = std::move(data);
+	job.mimeType = mimeType;
+	Queue(std::move(job));
 
 	return true;
 }
 
 void AlbumArt::Reset(const Colour<float> &color) {
 	albumLoaded = false;
-	/*
-	glDeleteTextures(1, &album);
-	album = 0;
-	*/
-	lastWidth = albumWidth;
-	lastHeight = albumHeight;
 
-	albumWidth = 0;
-	albumHeight = 0;
+	// Anything still on its way is for the last song
+	++generation;
+
+	// and there's no point finishing the last song's
+	// scaling before we get started on this one's art
+	if (scaling)
+		*scaling = true;
+
 	averageColor = color;
 }
 
@@ -721,53 +853,138 @@ void AlbumArt::SetRadius(float radius) {
 }
 
 void AlbumArt::Scale(bool force) {
-	if ((!lastSurface || !lastSurfaceUpdated) && !force) return;
-
-	lastSurfaceUpdated = false;
-
-	std::thread([&] {
-		// Wrap pixels in a new surface. This way, we can
-		// free the surface without losing the original
-		// pixel data.
-		SDL_Surface *resized = SDL_CreateRGBSurfaceWithFormatFrom(
-			lastSurface->pixels,
-			lastSurface->w,
-			lastSurface->h,
-			lastSurface->format->BytesPerPixel,
-			lastSurface->pitch,
-			lastSurface->format->format
-		);
+	// Whatever's scaling now is for an older radius
+	// (or older art), so it can stop where it is
+	if (scaling)
+		*scaling = true;
+
+	scaling = std::make_shared<std::atomic<bool>>(false);
+
+	Job job;
+	job.type = Job::Type::Scale;
+	job.generation = generation;
+	job.scaleGeneration = ++scaleGeneration;
+	job.force = force;
+	job.radius = radius;
+	job.canceled = scaling;
+	Queue(std::move(job));
+}
 
-		auto start = std::chrono::system_clock::now();
+void AlbumArt::Prefetch(
+	const std::filesystem::path &song,
+	const std::filesystem::path &parentPath,
+	const std::string &mimeType,
+	std::string data
+) {
+	// Whatever was coming up before isn't now
+	if (prefetching)
+		*prefetching = true;
+
+	prefetching = std::make_shared<std::atomic<bool>>(false);
+
+	Job job;
+	job.type = Job::Type::Prefetch;
+	job.folder = parentPath.empty() ? song.parent_path() : parentPath;
+	job.song = song;
+	job.data = std::move(data);
+	job.mimeType = mimeType;
+	job.radius = radius;
+	job.canceled = prefetching;
+	Queue(std::move(job));
+}
 
-		// TODO: RGBA support
-		if (lastSurface->format->BitsPerPixel == 24) {
-			Gaussian gaussian;
+void AlbumArt::CancelPrefetch() {
+	if (!prefetching)
+		return;
 
-			auto w = lastSurface->w / 2;
-			SDL_Surface *next = nullptr;
-			while (w > radius * 2) {
-				auto blurred = gaussian.Blur(resized);
+	*prefetching = true;
 
-				resized = Bicubic::ResizeImage(blurred, static_cast<float>(w) / blurred->w);
+	// Still queued, so our worker
+	// lets go of what it got ready
+	Job job;
+	job.type = Job::Type::Prefetch;
+	job.canceled = prefetching;
+	Queue(std::move(job));
 
-				w /= 2;
-			}
+	prefetching.reset();
+}
+
+bool AlbumArt::IsSuperseded(const Result &result) const {
+	return result.scaled && result.scaleGeneration != scaleGeneration;
+}
+
+void AlbumArt::ScaleSource(const Job &job) {
+	if (!source)
+		return;
 
-			resized = Bicubic::ResizeImage(resized, (radius * 2) / resized->w);
+	// A forced Scale() that got canceled will have
+	// left its radius behind for the next one
+	if (job.force || job.radius != scaledRadius)
+		scaled.reset();
 
-			// [16Jul2025] We now want to keep the un-scaled surface
-			//             around as it might need rescaling when the
-			//             DPI changes
-//			if (resized)
-//				lastSurface = nullptr;
+	if (!scaled) {
+		scaled = Resize(source, job.radius, *job.canceled);
+
+		// Canceled part way through
+		if (!scaled)
+			return;
+
+		scaledRadius = job.radius;
+	}
+
+	Result result;
+	result.generation = job.generation;
+	result.scaled = true;
+	result.scaleGeneration = job.scaleGeneration;
+	result.width = source->w;
+	result.height = source->h;
+	result.surface = scaled;
+
+	Post(std::move(result));
+}
+
+AlbumArt::Surface AlbumArt::Resize(const Surface &surface, float radius, const std::atomic<bool> &canceled) const {
+	// Wrap pixels in a new surface. This way, we can
+	// free the surface without losing the original
+	// pixel data.
+	SDL_Surface *resized = SDL_CreateRGBSurfaceWithFormatFrom(
+		surface->pixels,
+		surface->w,
+		surface->h,
+		surface->format->BytesPerPixel,
+		surface->pitch,
+		surface->format->format
+	);
+
+	auto start = std::chrono::system_clock::now();
+
+	// TODO: RGBA support
+	if (surface->format->BitsPerPixel == 24) {
+		Gaussian gaussian;
+
+		auto w = surface->w / 2;
+		while (resized && w > radius * 2) {
+			auto blurred = gaussian.Blur(resized, canceled);
+
+			resized = blurred ? Bicubic::ResizeImage(blurred, static_cast<float>(w) / blurred->w, canceled) : nullptr;
+
+			w /= 2;
 		}
 
-		auto end = std::chrono::system_clock::now();
+		if (resized)
+			resized = Bicubic::ResizeImage(resized, (radius * 2) / resized->w, canceled);
+	}
 
-		std::unique_lock lock(mutex);
-		surfaceToLoad = resized;
+	auto end = std::chrono::system_clock::now();
+
+	if (!resized) {
+		CConsole::Console.Print("Image resizing was canceled after " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
+		return nullptr;
+	}
+
+	CConsole::Console.Print("Image resizing took " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
 
-		CConsole::Console.Print("Image resizing took " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
-	}).detach();
-}
\ No newline at end of file
+	// If we didn't resize, this still points
+	// at surface's pixels, so keep them around
+	return Surface(resized, [surface](SDL_Surface *resized) { SDL_FreeSurface(resized); });
+}
@@ -2,10 +2,16 @@
 
 #include <filesystem>
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <glad/glad.h>
@@ -13,18 +19,38 @@
 
 #include "MathCPP/Colour.hpp"
 
+#include "ArtLoader.hpp"
 #include "ColorChangeListener.hpp"
+#include "Palette.hpp"
 
 using namespace MathsCPP;
 
-class AlbumArt {
+// Art gets found, decoded, has its colors picked out and
+// is scaled down on a worker thread of our own, one job at
+// a time (so embedded art, then external art, then scaling
+// the winner happen in the order they were asked for).
+//
+// Decoded pixels are copied by the worker straight into a
+// pixel buffer the render thread mapped for it, then uploaded
+// from there without the render thread ever touching them.
+// The old art stays on screen until the new texture's ready.
+//
+// Anything asked for before the last Reset() still lands (so
+// we know what's in our texture), but won't show itself or
+// change any colors.
+//
+// Scaling's the exception: every Scale() cancels the one
+// before it (which stops at the next tile of rows it gets to),
+// and anything an older one still manages to post is thrown
+// away without being uploaded.
+//
+// The next song's art can be got ready ahead of time with
+// Prefetch(), which does everything but the upload. Loading
+// that same art afterwards skips straight to uploading it.
+class AlbumArt : public ArtLoader {
 public:
 	static constexpr bool IsSupported(const std::string_view &lowercaseExtension) {
-		for (const auto &extension : SupportedExtensions)
-			if (lowercaseExtension == extension)
-				return true;
-
-		return false;
+		return Palette::IsSupported(lowercaseExtension);
 	}
 
 	enum class ColorMethod { Average, Dominant };
@@ -34,10 +60,15 @@ public:
 	void OnLoop(GLfloat x, GLfloat y, float frameCount);
 	void OnDestroy();
 
+	// All of the Load()s only queue the art to be decoded, and
+	// return whether there was any to queue.
+	//
 	// fileName is the path to the _song_
 	//
 	// This function finds the album art
-	// relative to that path. If the original
+	// relative to that path (on our worker,
+	// since it can mean going through every
+	// subfolder). If the original
 	// path is multiple folders up from the
 	// song, we can pass that in the parentPath
 	// argument. This allows for loading folders
@@ -57,7 +88,10 @@ public:
 	//     ...
 	bool Load(const std::filesystem::path &fileName, const std::filesystem::path &parentPath = "", bool force = false);
 
-	bool Load(const std::string &mimeType, const void *data, std::size_t length);
+	bool Load(const std::string &mimeType, const void *data, std::size_t length) override;
+
+	// Same again, for art that's already ours to keep
+	bool Load(const std::string &mimeType, std::string &&data);
 
 	void Reset(const Colour<float> &color);
 
@@ -81,13 +115,121 @@ public:
 
 	void Scale(bool force = false);
 
+	// Decodes, picks the colors out of and scales whatever art
+	// Load()ing song's embedded art (if it has any) and then song
+	// itself would end up with, without showing any of it.
+	//
+	// Only the last song prefetched is kept, and prefetching
+	// another cancels it.
+	void Prefetch(
+		const std::filesystem::path &song,
+		const std::filesystem::path &parentPath,
+		const std::string &mimeType,
+		std::string data
+	);
+
+	// Stops prefetching, and lets go of anything prefetched
+	void CancelPrefetch();
+
 private:
-	constexpr inline static std::array<std::string_view, 3> SupportedExtensions = { ".jpg", ".png", ".webp" };
+	using Bin = Palette::Bin;
+	using Histogram = Palette::Histogram;
+	using Surface = std::shared_ptr<SDL_Surface>;
+
+	// Something for our worker to do
+	struct Job {
+		enum class Type { Decode, Scale, Fill, Prefetch };
+
+		Type type = Type::Decode;
+		std::uint64_t generation = 0;
+
+		// Decode: a file to read, a folder to find one
+		// in (for song), or art we already have in memory
+		// (with its mime type)
+		//
+		// Prefetch: the same, but embedded art (if any)
+		// and then a folder
+		std::filesystem::path path;
+		std::filesystem::path folder;
+		std::filesystem::path song;
+		std::string data;
+		std::string mimeType;
+		bool force = false;
+
+		// Scale (Prefetch only needs the last two)
+		std::uint64_t scaleGeneration = 0;
+		float radius = 0.0f;
+		std::shared_ptr<std::atomic<bool>> canceled;
+
+		// Fill: copy surface's rows (tightly packed) into
+		// destination, then set filled
+		Surface surface;
+		void *destination = nullptr;
+		std::shared_ptr<std::atomic<bool>> filled;
+	};
 
-	std::filesystem::path FindArt(const std::filesystem::path &folder) const;
+	// Something for the render thread to pick up
+	struct Result {
+		enum class Stage { Staging, Filling, Transferring, Done };
+
+		std::uint64_t generation = 0;
+
+		// Empty when the art's the same as what we already have
+		Surface surface;
+		bool scaled = false;
+		std::uint64_t scaleGeneration = 0;
+
+		// Size of the art, before any scaling
+		int width = 0, height = 0;
+
+		// Only one of these, if any
+		std::optional<Histogram> histogram;
+		std::optional<Colour<float>> averageColor;
+
+		// The upload, as it gets along
+		Stage stage = Stage::Staging;
+		GLuint buffer = 0;
+		GLuint texture = 0;
+		GLsync fence = nullptr;
+		std::shared_ptr<std::atomic<bool>> filled;
+	};
+
+	void Queue(Job job);
+	void Work();
+
+	// Art that was got ready by a Prefetch()
+	struct Prefetched {
+		std::uint32_t hash = 0;
+
+		// As Decode() would have posted it
+		Result decoded;
+
+		// Only the art that won out gets scaled
+		Surface scaled;
+		float scaledRadius = 0.0f;
+	};
 
-	// This frees the surface once it's done
-	void LoadFromSurface(SDL_Surface *surface, bool scaled = false);
+	// Only ever called from our worker
+	std::filesystem::path FindArt(const std::filesystem::path &folder) const;
+	void Decode(Job &job);
+	void ScaleSource(const Job &job);
+	void Prepare(Job &job);
+
+	// mimeType's only needed for embedded art
+	Surface DecodeImage(const std::string &contents, const std::string &mimeType) const;
+	void PickColors(Result &result, std::uint32_t hash) const;
+	Surface Resize(const Surface &surface, float radius, const std::atomic<bool> &canceled) const;
+	void Fill(const Job &job);
+	void Post(Result result);
+
+	// Moves result's upload along. True once it's done
+	// (or there was nothing to upload).
+	bool Upload(Result &result);
+	void Apply(Result &result);
+	void Discard(Result &result);
+
+	// Whether a newer Scale() has come along since
+	bool IsSuperseded(const Result &result) const;
 
 	void UpdateVertexCoords();
 	void UpdateTextureCoords();
@@ -99,7 +241,6 @@ private:
 
 	GLuint album = 0;
 	int albumWidth = 0, albumHeight = 0;
-	int scaledAlbumWidth = 0, scaledAlbumHeight = 0;
 	float albumVertexBuffer[362 * 2] = { 0.0f };
 	float squareVertexBuffer[8] = { 0 };
 	float albumTexCoords[362 * 2] = { 0.0f };
@@ -109,28 +250,6 @@ private:
 
 	ColorMethod colorMethod = ColorMethod::Dominant;
 	Colour<float> averageColor{ 1.0f, 1.0f, 1.0f };
-	struct Bin {
-		Bin(std::size_t count, float h, float s, float v) : count(count), h(h), s(s), v(v) {}
-
-		std::size_t count;
-		float h = 0.0f;
-		float s = 0.0;
-		float v = 0.0f;
-	};
-
-	struct CompareBins {
-		bool operator()(const Bin &lhs, const Bin &rhs) const {
-			return 
-				lhs.count < rhs.count ||
-				(lhs.count == rhs.count && lhs.h < rhs.h);
-
-			// The original container is sorted by hue,
-			// so we'll never have two bins with the same
-			// hue.
-		}
-	};
-
-	using Histogram = std::multiset<Bin, CompareBins>;
 
 	Histogram histogram;
 	Histogram::reverse_iterator binIter;
@@ -139,15 +258,55 @@ private:
 
 	std::set<ColorChangeListener *> colorChangeListeners;
 
+	// Bumped by every Reset()
+	std::atomic<std::uint64_t> generation = 0;
+
+	// Owned by the render thread, oldest first
+	std::deque<Result> pending;
+
+	// Bumped by every Scale()
+	std::uint64_t scaleGeneration = 0;
+
+	// Set when whatever's scaling doesn't need to anymore
+	std::shared_ptr<std::atomic<bool>> scaling;
+
+	// Same again, for prefetching
+	std::shared_ptr<std::atomic<bool>> prefetching;
+
+	// Owned by our worker
+
+	// The last art we decoded (before scaling), kept
+	// around as it might need rescaling when the DPI
+	// changes
+	Surface source;
+
+	// source, once it's been scaled. Kept so a Scale()
+	// that finds it already done can post it again (in
+	// case we posted it for one that got superseded).
+	Surface scaled;
+	float scaledRadius = 0.0f;
+
+	std::uint64_t workerGeneration = 0;
+	int acceptedWidth = 0, acceptedHeight = 0;
+
+	// Whether this song's embedded art has come through,
+	// so we know not to go looking through subfolders
+	bool embeddedArt = false;
+
 	std::uint32_t lastHash = 0;
 	std::uint32_t lastEmbeddedHash = 0;
-	int lastWidth = 0, lastHeight = 0;
 
-	SDL_Surface *lastSurface = nullptr;
-	std::atomic<bool> lastSurfaceUpdated = false;
-	SDL_Surface *surfaceToLoad = nullptr;
+	// From the last Prefetch(), until they're loaded
+	std::vector<Prefetched> prefetched;
 
+	// Shared between the two, under mutex
+	std::thread worker;
 	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+
+	std::deque<Job> jobs;
+	std::deque<Result> results;
 
 	float scale = 1.0f;
 };
\ No newline at end of file
@@ -0,0 +1,561 @@
+// popRocksAnalyse
+//
+// Works out beats, palettes, loudness and waveforms for a whole
+// library ahead of time, using every core, and drops them into
+// the same AnalysisCache the player reads from. No window, no GL.
+//
+//	popRocksAnalyse <library folder> [--threads N] [--force]
+//		[--no-beats] [--no-loudness] [--no-waveforms]
+//		[--no-palettes]
+//
+// It also prints how long everything took, which makes it a
+// handy benchmark for the analysis code.
+
+#define SDL_MAIN_HANDLED
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <bass.h>
+#include <bassape.h>
+#include <bassflac.h>
+#include <basswv.h>
+#include <SDL.h>
+#include <SDL_image.h>
+
+#include "MathCPP/Duration.hpp"
+
+#include "AnalysisCache.hpp"
+#include "AnalysisGraph.hpp"
+#include "BeatDetect.hpp"
+#include "CConsole.h"
+#include "Cue.hpp"
+#include "Palette.hpp"
+#include "Track.hpp"
+#include "TrackFeatures.hpp"
+#include "Utils.hpp"
+#include "WorkStealingPool.hpp"
+
+using namespace MathsCPP;
+
+namespace {
+struct Options {
+	std::filesystem::path library;
+	std::size_t threads = 0;
+	bool force = false;
+	bool beats = true;
+	bool loudness = true;
+	bool waveforms = true;
+	bool palettes = true;
+
+	// We don't read the player's settings, so palettes only
+	// get picked up by a player that's left these alone
+	Palette::ColorSelection colorSelection;
+};
+
+// Everything here gets updated from every worker
+struct Stats {
+	std::atomic<std::size_t> tracks = 0;
+	std::atomic<std::size_t> analysed = 0;
+	std::atomic<std::size_t> cached = 0;
+	std::atomic<std::size_t> failed = 0;
+	std::atomic<std::size_t> palettes = 0;
+
+	std::mutex mutex;
+	double seconds = 0.0;
+
+	void AddSeconds(double seconds) {
+		std::unique_lock lock(mutex);
+		this->seconds += seconds;
+	}
+};
+
+// Nothing we start ever gets canceled
+const std::atomic<bool> NotCanceled = false;
+
+std::string Lowercase(std::string string) {
+	std::transform(string.begin(), string.end(), string.begin(), tolower);
+	return string;
+}
+
+// BASS's plugins are named like any other shared library
+std::string PluginName(const std::string &name) {
+#if defined(_WIN32)
+	return name + ".dll";
+#elif defined(__APPLE__)
+	return "lib" + name + ".dylib";
+#else
+	return "lib" + name + ".so";
+#endif
+}
+
+// Same as CApp::OpenWithFlags(). path.c_str() is UTF-16
+// on Windows (which bass.h handles for us) and UTF-8 elsewhere.
+HSTREAM Open(const std::filesystem::path &path, const std::string &extension) {
+	constexpr DWORD flags = BASS_STREAM_PRESCAN | BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT;
+
+	auto ret = BASS_StreamCreateFile(FALSE, path.c_str(), 0, 0, flags);
+	if (!ret) {
+		// In case our plugins didn't properly load
+		if (extension == ".flac")
+			ret = BASS_FLAC_StreamCreateFile(FALSE, path.c_str(), 0, 0, flags);
+		else if (extension == ".ape")
+			ret = BASS_APE_StreamCreateFile(FALSE, path.c_str(), 0, 0, flags);
+		else if (extension == ".wv")
+			ret = BASS_WV_StreamCreateFile(FALSE, path.c_str(), 0, 0, flags);
+	}
+
+	return ret;
+}
+
+class Analyser {
+public:
+	explicit Analyser(const Options &options) : options(options), pool(options.threads) {}
+
+	void Run() {
+		std::vector<std::filesystem::path> cues;
+		std::map<std::filesystem::path, std::vector<std::filesystem::path>> folders;
+
+		// Folder by folder rather than with a recursive_directory_iterator,
+		// since one bad folder (or a symlink loop) deep in the library
+		// would end that, and we'd lose everything found so far
+		std::vector<std::filesystem::path> directories = { options.library };
+		while (!directories.empty()) {
+			auto directory = std::move(directories.back());
+			directories.pop_back();
+
+			std::error_code error;
+			for (auto iter = std::filesystem::directory_iterator(directory, std::filesystem::directory_options::skip_permission_denied, error);
+				iter != std::filesystem::directory_iterator();
+				iter.increment(error)) {
+				std::error_code entryError;
+
+				// Symlinked folders aren't followed, same as
+				// recursive_directory_iterator, so they can't loop
+				if (iter->is_directory(entryError) && !iter->is_symlink(entryError)) {
+					directories.emplace_back(iter->path());
+					continue;
+				}
+
+				if (!iter->is_regular_file(entryError))
+					continue;
+
+				auto extension = Lowercase(iter->path().extension().u8string());
+				if (extension == ".cue")
+					cues.emplace_back(iter->path());
+				else if (Track::IsSupported(extension))
+					folders[iter->path().parent_path()].emplace_back(iter->path());
+			}
+
+			if (error) {
+				// Nothing at all to go on
+				if (directory == options.library) {
+					CConsole::Console.Print("Could not read " + options.library.u8string() + ": " + error.message(), MSG_ERROR);
+					return;
+				}
+
+				CConsole::Console.Print("Skipping the rest of " + directory.u8string() + ": " + error.message(), MSG_ALERT);
+			}
+		}
+
+		// A cue sheet's image gets analysed track by track,
+		// so it doesn't get analysed as one big song as well
+		std::vector<std::pair<std::filesystem::path, std::vector<Track>>> albums;
+		for (const auto &path : cues) {
+			Cue cue;
+			auto file = cue.OnLoad(path);
+			if (!file || cue.GetTracks().empty())
+				continue;
+
+			const auto &tracks = cue.GetTracks();
+
+			std::vector<Track> album;
+			album.reserve(tracks.size());
+			for (std::size_t i = 0; i < tracks.size(); ++i) {
+				album.emplace_back(Track{
+					*file,
+					tracks[i].startTime,
+					i + 1 < tracks.size() ?
+						std::optional<double>(tracks[i + 1].startTime - tracks[i].startTime) :
+						std::nullopt
+				});
+			}
+
+			auto &files = folders[file->parent_path()];
+			files.erase(std::remove(files.begin(), files.end(), *file), files.end());
+
+			albums.emplace_back(*file, std::move(album));
+		}
+
+		for (const auto &album : albums)
+			stats.tracks += album.second.size();
+		for (const auto &folder : folders)
+			stats.tracks += folder.second.size();
+
+		CConsole::Console.Print(
+			"Analysing " + std::to_string(stats.tracks) + " tracks on " + std::to_string(pool.GetWorkerCount()) + " threads",
+			MSG_NORMAL
+		);
+
+		auto start = std::chrono::system_clock::now();
+
+		for (auto &folder : folders) {
+			if (options.palettes)
+				pool.Submit([this, folder = folder.first] { AnalyseFolderArt(folder); });
+
+			for (auto &path : folder.second)
+				pool.Submit([this, path = std::move(path)] { AnalyseTrack(path); });
+		}
+
+		// Workers start from the back of their queues, so
+		// these go last to get the longest jobs going first.
+		// Nobody's then left waiting on one huge album image
+		// at the very end.
+		for (auto &album : albums)
+			pool.Submit([this, album = std::move(album)] { AnalyseAlbum(album.first, album.second); });
+
+		pool.Wait();
+
+		auto elapsed = Duration<Microseconds>(std::chrono::system_clock::now() - start).AsSeconds();
+
+		std::ostringstream summary;
+		summary.precision(2);
+		summary << std::fixed
+			<< "Done in " << elapsed << " seconds: "
+			<< stats.analysed << " tracks analysed, "
+			<< stats.cached << " already cached, "
+			<< stats.failed << " failed, "
+			<< stats.palettes << " palettes";
+		CConsole::Console.Print(summary.str(), MSG_NORMAL);
+
+		if (elapsed > 0.0) {
+			std::ostringstream rate;
+			rate.precision(2);
+			rate << std::fixed
+				<< stats.analysed / elapsed << " tracks/s, "
+				<< stats.seconds / elapsed << "x realtime";
+			CConsole::Console.Print(rate.str(), MSG_NORMAL);
+		}
+	}
+
+private:
+	void Progress(const std::filesystem::path &path, double startTime, const std::string &what) {
+		auto done = stats.analysed + stats.cached + stats.failed;
+
+		std::string name = path.filename().u8string();
+		if (startTime > DBL_EPSILON)
+			name += " @ " + std::to_string(startTime);
+
+		CConsole::Console.Print(
+			"[" + std::to_string(done) + "/" + std::to_string(stats.tracks) + "] " + what + " " + name,
+			MSG_NORMAL
+		);
+	}
+
+	void AnalyseTrack(const std::filesystem::path &path) {
+		bool beats = options.beats && (options.force || !AnalysisCache::LoadBeats(path));
+		TrackFeatures features(path, 0.0, std::nullopt, options.loudness, options.waveforms, options.force);
+
+		// Embedded art lives in the tags, so palettes still
+		// need the file opened even when everything else is done
+		if (!beats && features.IsEmpty() && !options.palettes) {
+			++stats.cached;
+			Progress(path, 0.0, "Cached");
+			return;
+		}
+
+		auto extension = Lowercase(path.extension().u8string());
+
+		auto streamHandle = Open(path, extension);
+		if (!streamHandle) {
+			++stats.failed;
+			CConsole::Console.Print("Could not open " + path.u8string() + "! Error code " + std::to_string(BASS_ErrorGetCode()), MSG_ERROR);
+			return;
+		}
+
+		if (options.palettes)
+			AnalyseEmbeddedArt(path, extension, streamHandle);
+
+		if (beats || !features.IsEmpty()) {
+			BASS_CHANNELINFO channelInfo;
+			BASS_ChannelGetInfo(streamHandle, &channelInfo);
+
+			// Everything comes out of the one decode
+			if (beats) {
+				auto timeline = BeatDetect::Analyse(
+					streamHandle,
+					channelInfo.freq,
+					channelInfo.chans,
+					NotCanceled,
+					std::nullopt,
+					std::nullopt,
+					[&features](AnalysisGraph &graph) { features.AddTo(graph); }
+				);
+
+				if (timeline)
+					AnalysisCache::SaveBeats(path, 0.0, *timeline);
+			} else {
+				AnalysisGraph graph(channelInfo.freq, channelInfo.chans);
+				features.AddTo(graph);
+				graph.Run(streamHandle, NotCanceled);
+			}
+
+			features.Save();
+
+			stats.AddSeconds(BASS_ChannelBytes2Seconds(streamHandle, BASS_ChannelGetLength(streamHandle, BASS_POS_BYTE)));
+
+			++stats.analysed;
+			Progress(path, 0.0, "Analysed");
+		} else {
+			++stats.cached;
+			Progress(path, 0.0, "Cached");
+		}
+
+		BASS_StreamFree(streamHandle);
+	}
+
+	void AnalyseAlbum(const std::filesystem::path &path, const std::vector<Track> &album) {
+		// Only the tracks that need beats get BeatRoot's attention,
+		// but every track's features come out of the same decode
+		std::vector<Track> beats;
+		std::vector<std::unique_ptr<TrackFeatures>> features;
+		std::vector<bool> needed;
+
+		for (const auto &track : album) {
+			bool needsBeats = options.beats && (options.force || !AnalysisCache::LoadBeats(track.path, track.startTime));
+			if (needsBeats)
+				beats.emplace_back(track);
+
+			features.emplace_back(std::make_unique<TrackFeatures>(
+				track.path,
+				track.startTime,
+				track.length,
+				options.loudness,
+				options.waveforms,
+				options.force
+			));
+
+			needed.emplace_back(needsBeats || !features.back()->IsEmpty());
+		}
+
+		bool anything = std::find(needed.begin(), needed.end(), true) != needed.end();
+
+		if (!anything && !options.palettes) {
+			for (const auto &track : album) {
+				++stats.cached;
+				Progress(track.path, track.startTime, "Cached");
+			}
+
+			return;
+		}
+
+		auto extension = Lowercase(path.extension().u8string());
+
+		auto streamHandle = Open(path, extension);
+		if (!streamHandle) {
+			stats.failed += album.size();
+			CConsole::Console.Print("Could not open " + path.u8string() + "! Error code " + std::to_string(BASS_ErrorGetCode()), MSG_ERROR);
+			return;
+		}
+
+		if (options.palettes)
+			AnalyseEmbeddedArt(path, extension, streamHandle);
+
+		if (anything) {
+			BASS_CHANNELINFO channelInfo;
+			BASS_ChannelGetInfo(streamHandle, &channelInfo);
+
+			auto addFeatures = [&features](AnalysisGraph &graph) {
+				for (auto &track : features)
+					track->AddTo(graph);
+			};
+
+			if (!beats.empty()) {
+				std::vector<BeatDetect::Range> ranges;
+				ranges.reserve(beats.size());
+				for (const auto &track : beats)
+					ranges.emplace_back(track.startTime, track.length);
+
+				BeatDetect::AnalyseAlbum(
+					streamHandle,
+					channelInfo.freq,
+					channelInfo.chans,
+					NotCanceled,
+					ranges,
+					[&beats](std::size_t index, std::shared_ptr<const BeatTimeline> timeline) {
+						if (timeline)
+							AnalysisCache::SaveBeats(beats[index].path, beats[index].startTime, *timeline);
+					},
+					addFeatures
+				);
+			} else {
+				AnalysisGraph graph(channelInfo.freq, channelInfo.chans);
+				addFeatures(graph);
+				graph.Run(streamHandle, NotCanceled);
+			}
+
+			for (const auto &track : features)
+				track->Save();
+
+			stats.AddSeconds(BASS_ChannelBytes2Seconds(streamHandle, BASS_ChannelGetLength(streamHandle, BASS_POS_BYTE)));
+		}
+
+		for (std::size_t i = 0; i < album.size(); ++i) {
+			if (needed[i]) {
+				++stats.analysed;
+				Progress(album[i].path, album[i].startTime, "Analysed");
+			} else {
+				++stats.cached;
+				Progress(album[i].path, album[i].startTime, "Cached");
+			}
+		}
+
+		BASS_StreamFree(streamHandle);
+	}
+
+	void AnalyseEmbeddedArt(const std::filesystem::path &path, const std::string &extension, HSTREAM streamHandle) {
+		Palette::ReadEmbeddedArt(path, extension, streamHandle, [this](const std::string &mimeType, const void *data, std::size_t length) {
+			auto hash = Palette::Hash(data, length);
+			if (!Claim(hash))
+				return;
+
+			auto file = SDL_RWFromConstMem(data, static_cast<int>(length));
+			auto type = mimeType.substr(mimeType.find('/') + 1);
+
+			if (auto surface = IMG_LoadTyped_RW(file, 1, type.c_str())) {
+				AnalysisCache::SavePalette(hash, Palette::Extract(surface, options.colorSelection), options.colorSelection);
+				SDL_FreeSurface(surface);
+				++stats.palettes;
+			}
+		});
+	}
+
+	void AnalyseFolderArt(const std::filesystem::path &folder) {
+		auto found = Palette::FindArt(folder);
+		if (found.empty())
+			return;
+
+		auto contents = Fetcko::Utils::GetStringFromFile(found);
+		auto hash = Palette::Hash(contents.c_str(), contents.size());
+		if (!Claim(hash))
+			return;
+
+		auto file = SDL_RWFromConstMem(contents.c_str(), static_cast<int>(contents.size()));
+		if (auto surface = IMG_Load_RW(file, 1)) {
+			AnalysisCache::SavePalette(hash, Palette::Extract(surface, options.colorSelection), options.colorSelection);
+			SDL_FreeSurface(surface);
+			++stats.palettes;
+		} else {
+			CConsole::Console.Print("Could not load album art from " + found.u8string(), MSG_ALERT);
+		}
+	}
+
+	// Whole albums tend to share the same art, so only the
+	// first track to get to it works out its palette
+	bool Claim(std::uint32_t hash) {
+		{
+			std::unique_lock lock(mutex);
+			if (!claimed.insert(hash).second)
+				return false;
+		}
+
+		return options.force || !AnalysisCache::LoadPalette(hash, options.colorSelection);
+	}
+
+	const Options &options;
+	WorkStealingPool pool;
+	Stats stats;
+
+	std::mutex mutex;
+	std::set<std::uint32_t> claimed;
+};
+
+int Run(const std::vector<std::string> &arguments) {
+	Options options;
+
+	for (std::size_t i = 0; i < arguments.size(); ++i) {
+		const auto &argument = arguments[i];
+
+		if (argument == "--threads" && i + 1 < arguments.size())
+			options.threads = static_cast<std::size_t>(std::max(0, std::atoi(arguments[++i].c_str())));
+		else if (argument == "--force")
+			options.force = true;
+		else if (argument == "--no-beats")
+			options.beats = false;
+		else if (argument == "--no-loudness")
+			options.loudness = false;
+		else if (argument == "--no-waveforms")
+			options.waveforms = false;
+		else if (argument == "--no-palettes")
+			options.palettes = false;
+		else if (options.library.empty())
+			options.library = std::filesystem::u8path(argument);
+		else {
+			CConsole::Console.Print("Unknown argument " + argument, MSG_ERROR);
+			return 1;
+		}
+	}
+
+	if (options.library.empty()) {
+		CConsole::Console.Print("Usage: popRocksAnalyse <library folder> [--threads N] [--force] [--no-beats] [--no-loudness] [--no-waveforms] [--no-palettes]", MSG_NORMAL);
+		return 1;
+	}
+
+	if (AnalysisCache::GetFolder().empty()) {
+		CConsole::Console.Print("Could not find anywhere to keep the cache!", MSG_ERROR);
+		return 1;
+	}
+
+	// Keys in the cache are absolute, so make sure we
+	// see the same paths the player does
+	std::error_code error;
+	options.library = std::filesystem::absolute(options.library, error).lexically_normal();
+
+	IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_WEBP);
+
+	if (!BASS_PluginLoad(PluginName("bassflac").c_str(), 0))
+		CConsole::Console.Print("Could not load FLAC plugin! Error code " + std::to_string(BASS_ErrorGetCode()), MSG_ERROR);
+	if (!BASS_PluginLoad(PluginName("bassape").c_str(), 0))
+		CConsole::Console.Print("Could not load APE plugin! Error code " + std::to_string(BASS_ErrorGetCode()), MSG_ERROR);
+	if (!BASS_PluginLoad(PluginName("basswv").c_str(), 0))
+		CConsole::Console.Print("Could not load WavPack plugin! Error code " + std::to_string(BASS_ErrorGetCode()), MSG_ERROR);
+
+	// We only ever decode, so there's no need for a real device
+	if (BASS_Init(0, 44100, 0, 0, nullptr) != TRUE) {
+		CConsole::Console.Print("Could not initialize BASS! Error code " + std::to_string(BASS_ErrorGetCode()), MSG_ERROR);
+		return 1;
+	}
+
+	Analyser(options).Run();
+
+	BASS_Free();
+	IMG_Quit();
+
+	return 0;
+}
+}
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t *argv[]) {
+#else
+int main(int argc, char *argv[]) {
+#endif
+	CConsole::Console.OnInit();
+
+	std::vector<std::string> arguments;
+	for (int i = 1; i < argc; ++i)
+		arguments.emplace_back(std::filesystem::path(argv[i]).u8string());
+
+	return Run(arguments);
+}
@@ -0,0 +1,287 @@
+#include "AnalysisCache.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "Hash.hpp"
+#include "Utils.hpp"
+
+namespace {
+constexpr char Magic[4] = { 'P', 'R', 'A', 'C' };
+
+class Writer {
+public:
+	Writer(const std::filesystem::path &path, std::uint32_t version) : path(path) {
+		if (path.empty())
+			return;
+
+		// Write somewhere nobody else will be, then move it into
+		// place, so a reader never sees half a file
+		std::ostringstream suffix;
+		suffix << ".tmp" << std::hash<std::thread::id>{}(std::this_thread::get_id())
+			<< '-' << std::chrono::steady_clock::now().time_since_epoch().count();
+
+		temporary = path;
+		temporary += suffix.str();
+
+		file.open(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+
+		file.write(Magic, sizeof(Magic));
+		Write(version);
+	}
+
+	~Writer() {
+		if (path.empty())
+			return;
+
+		file.close();
+
+		std::error_code error;
+		if (file)
+			std::filesystem::rename(temporary, path, error);
+
+		if (!file || error)
+			std::filesystem::remove(temporary, error);
+	}
+
+	template<typename T>
+	void Write(const T &value) {
+		file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	void Write(const std::vector<T> &values) {
+		Write(static_cast<std::uint64_t>(values.size()));
+		file.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+	}
+
+private:
+	std::filesystem::path path;
+	std::filesystem::path temporary;
+	std::ofstream file;
+};
+
+class Reader {
+public:
+	Reader(const std::filesystem::path &path, std::uint32_t version) {
+		if (path.empty())
+			return;
+
+		file.open(path, std::ios::in | std::ios::binary);
+
+		char magic[sizeof(Magic)] = { 0 };
+		file.read(magic, sizeof(magic));
+
+		std::uint32_t fileVersion = 0;
+		file.read(reinterpret_cast<char *>(&fileVersion), sizeof(fileVersion));
+
+		valid = file && std::equal(std::begin(magic), std::end(magic), std::begin(Magic)) && fileVersion == version;
+	}
+
+	template<typename T>
+	bool Read(T &value) {
+		file.read(reinterpret_cast<char *>(&value), sizeof(T));
+		return valid = valid && static_cast<bool>(file);
+	}
+
+	template<typename T>
+	bool Read(std::vector<T> &values) {
+		std::uint64_t size = 0;
+		if (!Read(size))
+			return false;
+
+		// Anything this big is a corrupt file, not a real song
+		if (size > (1 << 24))
+			return valid = false;
+
+		values.resize(static_cast<std::size_t>(size));
+		file.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(T));
+		return valid = valid && static_cast<bool>(file);
+	}
+
+	bool IsValid() const { return valid; }
+
+private:
+	std::ifstream file;
+	bool valid = false;
+};
+}
+
+std::shared_ptr<const BeatTimeline> AnalysisCache::LoadBeats(const std::filesystem::path &path, double startTime) {
+	Reader reader(GetTrackFile(path, startTime, ".beats"), BeatsVersion);
+
+	std::vector<double> times;
+	std::vector<uint8_t> barPositions;
+	if (!reader.IsValid() || !reader.Read(times) || !reader.Read(barPositions))
+		return nullptr;
+
+	return std::make_shared<const BeatTimeline>(std::move(times), std::move(barPositions));
+}
+
+void AnalysisCache::SaveBeats(const std::filesystem::path &path, double startTime, const BeatTimeline &beats) {
+	Writer writer(GetTrackFile(path, startTime, ".beats"), BeatsVersion);
+
+	writer.Write(beats.GetTimes());
+	writer.Write(beats.GetBarPositions());
+}
+
+std::optional<Loudness::Result> AnalysisCache::LoadLoudness(const std::filesystem::path &path, double startTime) {
+	Reader reader(GetTrackFile(path, startTime, ".loudness"), LoudnessVersion);
+
+	Loudness::Result ret;
+	if (!reader.IsValid() ||
+		!reader.Read(ret.integrated) ||
+		!reader.Read(ret.range) ||
+		!reader.Read(ret.samplePeak) ||
+		!reader.Read(ret.truePeak))
+		return std::nullopt;
+
+	return ret;
+}
+
+void AnalysisCache::SaveLoudness(const std::filesystem::path &path, double startTime, const Loudness::Result &loudness) {
+	Writer writer(GetTrackFile(path, startTime, ".loudness"), LoudnessVersion);
+
+	writer.Write(loudness.integrated);
+	writer.Write(loudness.range);
+	writer.Write(loudness.samplePeak);
+	writer.Write(loudness.truePeak);
+}
+
+std::shared_ptr<const PeakPyramid> AnalysisCache::LoadWaveform(const std::filesystem::path &path, double startTime) {
+	Reader reader(GetTrackFile(path, startTime, ".peaks"), WaveformVersion);
+
+	double blockTime = 0.0;
+	std::vector<PeakPyramid::Peak> peaks;
+	if (!reader.IsValid() || !reader.Read(blockTime) || !reader.Read(peaks) || !(blockTime > 0.0))
+		return nullptr;
+
+	return std::make_shared<const PeakPyramid>(std::move(peaks), blockTime);
+}
+
+void AnalysisCache::SaveWaveform(const std::filesystem::path &path, double startTime, const PeakPyramid &waveform) {
+	Writer writer(GetTrackFile(path, startTime, ".peaks"), WaveformVersion);
+
+	writer.Write(waveform.GetBlockTime());
+	writer.Write(waveform.GetLevel(0));
+}
+
+std::optional<Palette::Histogram> AnalysisCache::LoadPalette(std::uint32_t artHash, const Palette::ColorSelection &selection) {
+	Reader reader(GetArtFile(artHash, ".palette"), PaletteVersion);
+
+	Palette::ColorSelection saved;
+	if (!reader.IsValid() ||
+		!reader.Read(saved.minPercentage) ||
+		!reader.Read(saved.minSaturation) ||
+		!reader.Read(saved.minValue) ||
+		!reader.Read(saved.minHueSeparation) ||
+		!reader.Read(saved.minValueSeparation) ||
+		!reader.Read(saved.minRgbSeparation))
+		return std::nullopt;
+
+	if (saved.minPercentage != selection.minPercentage ||
+		saved.minSaturation != selection.minSaturation ||
+		saved.minValue != selection.minValue ||
+		saved.minHueSeparation != selection.minHueSeparation ||
+		saved.minValueSeparation != selection.minValueSeparation ||
+		saved.minRgbSeparation != selection.minRgbSeparation)
+		return std::nullopt;
+
+	std::uint64_t count = 0;
+	if (!reader.Read(count))
+		return std::nullopt;
+
+	Palette::Histogram ret;
+	for (std::uint64_t i = 0; i < count; ++i) {
+		std::uint64_t binCount = 0;
+		float h = 0.0f, s = 0.0f, v = 0.0f;
+		if (!reader.Read(binCount) || !reader.Read(h) || !reader.Read(s) || !reader.Read(v))
+			return std::nullopt;
+
+		ret.emplace(static_cast<std::size_t>(binCount), h, s, v);
+	}
+
+	return ret;
+}
+
+void AnalysisCache::SavePalette(std::uint32_t artHash, const Palette::Histogram &palette, const Palette::ColorSelection &selection) {
+	Writer writer(GetArtFile(artHash, ".palette"), PaletteVersion);
+
+	writer.Write(selection.minPercentage);
+	writer.Write(selection.minSaturation);
+	writer.Write(selection.minValue);
+	writer.Write(selection.minHueSeparation);
+	writer.Write(selection.minValueSeparation);
+	writer.Write(selection.minRgbSeparation);
+
+	writer.Write(static_cast<std::uint64_t>(palette.size()));
+	for (const auto &bin : palette) {
+		writer.Write(static_cast<std::uint64_t>(bin.count));
+		writer.Write(bin.h);
+		writer.Write(bin.s);
+		writer.Write(bin.v);
+	}
+}
+
+const std::filesystem::path &AnalysisCache::GetFolder() {
+	static const std::filesystem::path folder = [] {
+		auto ret = Fetcko::Utils::GetUserFolder();
+		if (ret.empty())
+			return ret;
+
+		ret /= "Cache";
+
+		std::error_code error;
+		std::filesystem::create_directories(ret, error);
+
+		return error ? std::filesystem::path() : ret;
+	}();
+
+	return folder;
+}
+
+std::filesystem::path AnalysisCache::GetTrackFile(const std::filesystem::path &path, double startTime, const char *extension) {
+	const auto &folder = GetFolder();
+	if (folder.empty())
+		return {};
+
+	std::error_code error;
+	auto size = std::filesystem::file_size(path, error);
+	if (error)
+		return {};
+
+	auto modified = std::filesystem::last_write_time(path, error);
+	if (error)
+		return {};
+
+	// The player and popRocksAnalyse can come at the same
+	// file from different directions
+	auto absolute = std::filesystem::absolute(path, error).lexically_normal();
+	if (error)
+		return {};
+
+	std::ostringstream key;
+	key << absolute.u8string() << '|' << startTime << '|' << size << '|' << modified.time_since_epoch().count();
+
+	auto string = key.str();
+
+	char name[17];
+	std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash_64_fnv1a_const(string.c_str(), string.size())));
+
+	return folder / (std::string(name) + extension);
+}
+
+std::filesystem::path AnalysisCache::GetArtFile(std::uint32_t artHash, const char *extension) {
+	const auto &folder = GetFolder();
+	if (folder.empty())
+		return {};
+
+	char name[9];
+	std::snprintf(name, sizeof(name), "%08x", artHash);
+
+	return folder / (std::string(name) + extension);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+#include "BeatTimeline.hpp"
+#include "Loudness.hpp"
+#include "Palette.hpp"
+#include "PeakPyramid.hpp"
+
+// Analysis results kept on disk between runs, under a
+// Cache folder next to our settings. popRocksAnalyse fills
+// this in ahead of time, and the player reads from (and
+// adds to) it as it goes.
+//
+// Every feature of every track is its own small file, named
+// after the track's path, start time, size and modification
+// time. Changing a file just means it gets analysed again,
+// and two processes never fight over the same file.
+//
+// Everything here is safe to call from any thread.
+class AnalysisCache {
+public:
+	static std::shared_ptr<const BeatTimeline> LoadBeats(const std::filesystem::path &path, double startTime = 0.0);
+	static void SaveBeats(const std::filesystem::path &path, double startTime, const BeatTimeline &beats);
+
+	static std::optional<Loudness::Result> LoadLoudness(const std::filesystem::path &path, double startTime = 0.0);
+	static void SaveLoudness(const std::filesystem::path &path, double startTime, const Loudness::Result &loudness);
+
+	// Only level 0 goes on disk, the rest gets rebuilt on load
+	static std::shared_ptr<const PeakPyramid> LoadWaveform(const std::filesystem::path &path, double startTime = 0.0);
+	static void SaveWaveform(const std::filesystem::path &path, double startTime, const PeakPyramid &waveform);
+
+	// Palettes belong to album art rather than tracks, so
+	// they're looked up by the art's Palette::Hash(). A
+	// palette worked out with a different selection
+	// doesn't count.
+	static std::optional<Palette::Histogram> LoadPalette(std::uint32_t artHash, const Palette::ColorSelection &selection);
+	static void SavePalette(std::uint32_t artHash, const Palette::Histogram &palette, const Palette::ColorSelection &selection);
+
+	// Empty if there's nowhere to keep a cache
+	static const std::filesystem::path &GetFolder();
+
+private:
+	// Bump these whenever a feature's file layout
+	// (or the analysis behind it) changes
+	static constexpr std::uint32_t BeatsVersion = 1;
+	static constexpr std::uint32_t LoudnessVersion = 2;
+	static constexpr std::uint32_t PaletteVersion = 1;
+	static constexpr std::uint32_t WaveformVersion = 1;
+
+	static std::filesystem::path GetTrackFile(const std::filesystem::path &path, double startTime, const char *extension);
+	static std::filesystem::path GetArtFile(std::uint32_t artHash, const char *extension);
+};
@@ -0,0 +1,184 @@
+#include "AnalysisGraph.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <fftw3.h>
+
+#include "MathCPP/Maths.hpp"
+
+#include "BeatDetect.hpp"
+
+using namespace MathsCPP;
+
+namespace {
+// Same as BeatRootProcessor's defaults
+constexpr double FftTime = 0.04644;
+constexpr double HopTime = FftTime / 2.0;
+
+// How many hops' worth of samples we decode at a time
+constexpr std::size_t HopsPerChunk = 16;
+}
+
+AnalysisGraph::AnalysisGraph(DWORD freq, DWORD chans) {
+	format.freq = freq;
+	format.chans = chans;
+	format.fftSize = static_cast<std::size_t>(std::lrint(std::pow(2.0, std::lrint(std::log2(FftTime * freq)))));
+	format.hopSize = static_cast<std::size_t>(std::lrint(freq * HopTime));
+}
+
+void AnalysisGraph::Add(Consumer &consumer, double startTime, std::optional<double> length) {
+	Entry entry;
+	entry.consumer = &consumer;
+	entry.first = static_cast<std::size_t>(std::llround(std::max(startTime, 0.0) * format.freq));
+	entry.last = length ?
+		entry.first + static_cast<std::size_t>(std::llround(std::max(*length, 0.0) * format.freq)) :
+		std::numeric_limits<std::size_t>::max();
+
+	entries.emplace_back(entry);
+}
+
+bool AnalysisGraph::Run(
+	HSTREAM streamHandle,
+	const std::atomic<bool> &canceled,
+	std::optional<double> startTime,
+	std::optional<double> length
+) {
+	if (entries.empty() || format.chans == 0 || format.hopSize == 0)
+		return !canceled;
+
+	const auto bytesPerFrame = format.chans * sizeof(float);
+
+	auto position = static_cast<std::size_t>(
+		BASS_ChannelSeconds2Bytes(streamHandle, startTime ? std::max(*startTime, 0.0) : 0.0) / bytesPerFrame
+	);
+	BASS_ChannelSetPosition(streamHandle, position * bytesPerFrame, BASS_POS_BYTE);
+
+	auto end = std::numeric_limits<std::size_t>::max();
+	if (length)
+		end = position + static_cast<std::size_t>(BASS_ChannelSeconds2Bytes(streamHandle, *length) / bytesPerFrame);
+
+	// Nobody past the end of what we're decoding can get anything
+	for (auto &entry : entries)
+		entry.last = std::min(entry.last, end);
+
+	for (auto &entry : entries)
+		entry.consumer->OnStart(format);
+
+	const bool wantsFrames = std::any_of(entries.begin(), entries.end(), [](const Entry &entry) {
+		return entry.consumer->WantsFrames();
+	});
+
+	const auto fftSize = format.fftSize;
+
+	double *in = nullptr;
+	fftw_complex *out = nullptr;
+	fftw_plan plan = nullptr;
+	std::vector<double> window;
+	std::vector<float> spectrum;
+
+	if (wantsFrames) {
+		in = fftw_alloc_real(fftSize);
+		out = fftw_alloc_complex(fftSize / 2 + 1);
+		{
+			std::scoped_lock lock(BeatDetect::planMutex);
+			plan = fftw_plan_dft_r2c_1d(static_cast<int>(fftSize), in, out, FFTW_ESTIMATE);
+		}
+
+		// Same window BASS uses for its own FFTs
+		window.resize(fftSize);
+		for (std::size_t i = 0; i < fftSize; ++i)
+			window[i] = 0.5 - 0.5 * std::cos(2.0 * Maths::PI<double> * i / (fftSize - 1));
+
+		spectrum.resize((fftSize / 2 + 1) * 2);
+	}
+
+	// Mixed down to mono as we go, for the STFT
+	std::vector<float> mono;
+	std::size_t consumed = 0;
+
+	// Where in the stream the next STFT frame starts
+	auto nextFrame = position;
+
+	std::vector<float> chunk(format.hopSize * HopsPerChunk * format.chans);
+
+	while (!canceled && position < end) {
+		auto bytes = static_cast<DWORD>(std::min<QWORD>(
+			chunk.size() * sizeof(float),
+			end == std::numeric_limits<std::size_t>::max() ?
+				std::numeric_limits<QWORD>::max() :
+				static_cast<QWORD>(end - position) * bytesPerFrame
+		));
+
+		auto read = static_cast<int>(BASS_ChannelGetData(streamHandle, chunk.data(), BASS_DATA_FLOAT | bytes));
+		if (read <= 0)
+			break;
+
+		const auto count = static_cast<std::size_t>(read) / bytesPerFrame;
+
+		for (const auto &entry : entries) {
+			auto first = std::max(entry.first, position);
+			auto last = std::min(entry.last, position + count);
+
+			if (first < last)
+				entry.consumer->OnSamples(chunk.data() + (first - position) * format.chans, last - first);
+		}
+
+		position += count;
+
+		if (!wantsFrames)
+			continue;
+
+		for (std::size_t i = 0; i < count; ++i) {
+			float sum = 0.0f;
+			for (DWORD c = 0; c < format.chans; ++c)
+				sum += chunk[i * format.chans + c];
+
+			mono.emplace_back(sum / format.chans);
+		}
+
+		while (mono.size() - consumed >= fftSize) {
+			for (std::size_t i = 0; i < fftSize; ++i)
+				in[i] = mono[consumed + i] * window[i];
+
+			fftw_execute(plan);
+
+			for (std::size_t i = 0; i <= fftSize / 2; ++i) {
+				spectrum[i * 2] = static_cast<float>(out[i][0]);
+				spectrum[i * 2 + 1] = static_cast<float>(out[i][1]);
+			}
+
+			// A frame belongs to whoever's range it starts in
+			for (const auto &entry : entries) {
+				if (nextFrame >= entry.first && nextFrame < entry.last && entry.consumer->WantsFrames())
+					entry.consumer->OnFrame(spectrum.data());
+			}
+
+			consumed += format.hopSize;
+			nextFrame += format.hopSize;
+		}
+
+		// Don't let the already consumed samples pile up
+		if (consumed > mono.size() / 2) {
+			mono.erase(mono.begin(), mono.begin() + consumed);
+			consumed = 0;
+		}
+	}
+
+	if (plan) {
+		std::scoped_lock lock(BeatDetect::planMutex);
+		fftw_destroy_plan(plan);
+	}
+
+	if (in) fftw_free(in);
+	if (out) fftw_free(out);
+
+	if (canceled)
+		return false;
+
+	for (auto &entry : entries)
+		entry.consumer->OnFinish();
+
+	return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include <bass.h>
+
+// Decodes a stream once and fans what comes out to any
+// number of consumers: the interleaved samples for those
+// that want them, and mono, Hann windowed STFT frames for
+// those that want those.
+//
+// Every feature we work out for a track (beats, loudness,
+// waveforms, ...) is a consumer, so adding another one only
+// costs its own kernel instead of another full decode.
+class AnalysisGraph {
+public:
+	struct Format {
+		DWORD freq = 0;
+		DWORD chans = 0;
+		std::size_t fftSize = 0;
+		std::size_t hopSize = 0;
+	};
+
+	class Consumer {
+	public:
+		virtual ~Consumer() = default;
+
+		// Nobody wanting frames means we can skip the FFT
+		virtual bool WantsFrames() const { return false; }
+
+		virtual void OnStart(const Format &format) {}
+
+		// Interleaved, straight from the decoder
+		virtual void OnSamples(const float *samples, std::size_t frames) {}
+
+		// fftSize / 2 + 1 bins, as interleaved real and imaginary parts
+		virtual void OnFrame(const float *spectrum) {}
+
+		// Not called if we were canceled
+		virtual void OnFinish() {}
+	};
+
+	using Setup = std::function<void(AnalysisGraph &)>;
+
+	// Frames are sized the same as BeatRoot's defaults
+	// (46ms, hopping by half that) so its onsets can
+	// share them with everything else
+	AnalysisGraph(DWORD freq, DWORD chans);
+
+	// The consumer only gets what falls between startTime and
+	// startTime + length, in seconds from the start of the
+	// stream (not from wherever Run() starts decoding).
+	//
+	// The consumer needs to outlive Run().
+	void Add(Consumer &consumer, double startTime = 0.0, std::optional<double> length = std::nullopt);
+
+	// Decodes the given stream (or just part of it) on the
+	// calling thread. The stream needs to have been opened with
+	// BASS_SAMPLE_FLOAT, and is left open for the caller to free.
+	//
+	// Returns false if we were canceled part way through.
+	bool Run(
+		HSTREAM streamHandle,
+		const std::atomic<bool> &canceled,
+		std::optional<double> startTime = std::nullopt,
+		std::optional<double> length = std::nullopt
+	);
+
+	const Format &GetFormat() const { return format; }
+
+private:
+	struct Entry {
+		Consumer *consumer = nullptr;
+
+		// In sample frames from the start of the stream
+		std::size_t first = 0;
+		std::size_t last = 0;
+	};
+
+	Format format;
+	std::vector<Entry> entries;
+};
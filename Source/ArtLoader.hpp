@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+class ArtLoader {
+public:
+	virtual ~ArtLoader() = default;
+
+	// Whatever data points to is only ours for the
+	// length of the call. Returns whether it was taken.
+	virtual bool Load(const std::string &mimeType, const void *data, std::size_t length) = 0;
+
+protected:
+};
@@ -1,300 +1,368 @@
 #include "BeatDetect.hpp"
 
-void BeatDetect::OnLoad(
-	HSTREAM streamHandle,
-	const DWORD freq,
-	const DWORD chans,
-	std::function<void()> onLoaded,
-	std::optional<double> startTime,
-	std::optional<double> endTime
-) {
-	canceled = false;
+#include <cmath>
+
+#include <fftw3.h>
 
-	thread = std::thread([this, streamHandle, freq, chans, onLoaded, startTime, endTime] {
-		_OnLoad(streamHandle, freq, chans, onLoaded, startTime, endTime);
-	});
+#include "MathCPP/Maths.hpp"
+
+BeatDetect::~BeatDetect() {
+	delete published.exchange(nullptr);
 }
 
 bool BeatDetect::OnLoop(double elapsed) {
-	if (mutex.try_lock()) {
-		if (detectBpm && eventListIter != eventList.end() && elapsed >= eventListIter->time) {
-			++eventListIter;
-			mutex.unlock();
-			return true;
-		}
+	// Pick up a newly finished timeline, if there is one.
+	// This is the only place the render thread's timeline
+	// ever changes, so there's nothing to lock.
+	if (auto fresh = published.exchange(nullptr)) {
+		timeline = std::move(*fresh);
+		delete fresh;
+
+		nextBeat = timeline ? timeline->Seek(elapsed) : 0;
+	}
 
-		mutex.unlock();
+	if (detectBpm && timeline && nextBeat < timeline->size() && elapsed >= timeline->GetTime(nextBeat)) {
+		++nextBeat;
+		return true;
 	}
 
 	return false;
 }
 
 void BeatDetect::SeekTo(double time) {
-	for (eventListIter = eventList.begin(); eventListIter != eventList.end(); ++eventListIter) {
-		if (eventListIter->time > time)
-			return;
-	}
+	if (timeline)
+		nextBeat = timeline->Seek(time);
 }
 
 void BeatDetect::ToggleDetection() {
-	std::unique_lock lock(mutex);
 	detectBpm = !detectBpm;
 }
 
 bool BeatDetect::IsDetecting() const { return detectBpm; }
 
-void BeatDetect::Cancel() {
-	if (!canceled && thread.joinable()) {
-		CConsole::Console.Print("Canceling beat detection thread", MSG_DIAG);
-
-		// Only set our state to idle
-		// if we actually canceled
-		state = State::Idle;
-	}
+void BeatDetect::Reset() {
+	delete published.exchange(nullptr);
+	timeline.reset();
+	nextBeat = 0;
+}
 
-	canceled = true;
-	if (thread.joinable())
-		thread.join();
+void BeatDetect::Publish(std::shared_ptr<const BeatTimeline> timeline) {
+	// If the render thread never picked up
+	// the previous timeline, it's stale anyway
+	delete published.exchange(
+		new std::shared_ptr<const BeatTimeline>(std::move(timeline))
+	);
 }
 
-void BeatDetect::Reset() {
-	Cancel();
+void BeatDetect::Onsets::OnStart(const AnalysisGraph::Format &format) {
+	matches =
+		format.fftSize == static_cast<std::size_t>(processor.getFFTSize()) &&
+		format.hopSize == static_cast<std::size_t>(processor.getHopSize());
 
-	state = State::Idle;
-	eventList.clear();
-	eventListIter = eventList.end();
+	if (!matches)
+		CConsole::Console.Print("BeatRoot's frames don't match the analysis graph's! Skipping onsets.", MSG_ERROR);
 }
 
-const BeatDetect::State BeatDetect::GetState() const { return state; }
+void BeatDetect::Onsets::OnFrame(const float *spectrum) {
+	if (matches)
+		processor.processFrame(&spectrum);
+}
 
-inline void BeatDetect::_OnLoad(
+std::shared_ptr<const BeatTimeline> BeatDetect::Analyse(
 	HSTREAM streamHandle,
 	DWORD freq,
 	DWORD chans,
-	std::function<void()> onLoaded,
+	const std::atomic<bool> &canceled,
 	std::optional<double> startTime,
-	std::optional<double> endTime,
-	std::optional<double> hopTime,
-	std::optional<AgentParameters> parameters
+	std::optional<double> length,
+	const AnalysisGraph::Setup &setup
 ) {
-	if (detectBpm) {
-		std::unique_lock lock(mutex);
+	// Decoding straight through the graph reads every sample
+	// once, where BASS_DATA_FFT_COMPLEX would have us seeking
+	// back (and decoding again) for every hop
+	AnalysisGraph graph(freq, chans);
 
-		state = State::Loading;
+	Onsets onsets(freq);
+	graph.Add(onsets);
 
-		BeatRootProcessor beatRootProcessor(
-			static_cast<float>(freq),
-			parameters ? *parameters : AgentParameters()
-		);
+	if (setup)
+		setup(graph);
+
+	auto start = std::chrono::system_clock::now();
+
+	if (!graph.Run(streamHandle, canceled, startTime, length))
+		return nullptr;
 
-		if (hopTime)
-			beatRootProcessor.setHopTime(*hopTime);
+	auto end = std::chrono::system_clock::now();
 
-		const auto hopBytes = BASS_ChannelSeconds2Bytes(
+	CConsole::Console.Print("Populating BeatRoot took " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
+
+	return TrackBeats(
+		[&onsets] { return onsets.GetProcessor().beatTrack(); },
+		streamHandle,
+		freq,
+		chans,
+		canceled,
+		startTime ? *startTime : 0.0,
+		length
+	);
+}
+
+std::shared_ptr<const BeatTimeline> BeatDetect::_Analyse(
+	HSTREAM streamHandle,
+	DWORD freq,
+	DWORD chans,
+	const std::atomic<bool> &canceled,
+	std::optional<double> startTime,
+	std::optional<double> length,
+	std::optional<double> hopTime,
+	std::optional<AgentParameters> parameters
+) {
+	BeatRootProcessor beatRootProcessor(
+		static_cast<float>(freq),
+		parameters ? *parameters : AgentParameters()
+	);
+
+	if (hopTime)
+		beatRootProcessor.setHopTime(*hopTime);
+
+	const auto hopBytes = BASS_ChannelSeconds2Bytes(
+		streamHandle,
+		beatRootProcessor.getHopTime()
+	);
+
+	const auto fftBytes = BASS_ChannelSeconds2Bytes(
+		streamHandle,
+		beatRootProcessor.getFFTTime()
+	);
+
+	QWORD offset = 0;
+	if (startTime) {
+		offset = BASS_ChannelSeconds2Bytes(
 			streamHandle,
-			beatRootProcessor.getHopTime()
+			*startTime
 		);
 
-		const auto fftBytes = BASS_ChannelSeconds2Bytes(
+		BASS_ChannelSetPosition(
 			streamHandle,
-			beatRootProcessor.getFFTTime()
+			offset,
+			BASS_POS_BYTE
 		);
+	}
 
-		QWORD offset = 0;
-		if (startTime) {
-			offset = BASS_ChannelSeconds2Bytes(
-				streamHandle,
-				*startTime
-			);
-
-			BASS_ChannelSetPosition(
-				streamHandle,
-				offset,
-				BASS_POS_BYTE
-			);
+	DWORD flags = BASS_DATA_FFT_COMPLEX;
+
+	if (beatRootProcessor.getFFTSize() >= 16384)
+		flags |= BASS_DATA_FFT16384;
+	else if (beatRootProcessor.getFFTSize() >= 8192)
+		flags |= BASS_DATA_FFT8192;
+	else if (beatRootProcessor.getFFTSize() >= 4096)
+		flags |= BASS_DATA_FFT4096;
+	else if (beatRootProcessor.getFFTSize() >= 2048)
+		flags |= BASS_DATA_FFT2048;
+	else if (beatRootProcessor.getFFTSize() >= 1024)
+		flags |= BASS_DATA_FFT1024;
+	else if (beatRootProcessor.getFFTSize() >= 512)
+		flags |= BASS_DATA_FFT512;
+	else if (beatRootProcessor.getFFTSize() >= 256)
+		flags |= BASS_DATA_FFT256;
+	else
+		CConsole::Console.Print("Beatroot is asking for an FFT size of " + std::to_string(beatRootProcessor.getFFTSize()) + ", which isn't supported", MSG_ERROR);
+
+	float **bufferWrapper = new float *[1];
+	bufferWrapper[0] = new float[beatRootProcessor.getFFTSize() * 2 /* real and imaginary parts */ * chans];
+
+	auto start = std::chrono::system_clock::now();
+
+	int bytes = BASS_ChannelGetData(streamHandle, bufferWrapper[0], flags);
+
+	QWORD totalBytes = 0;
+	while (bytes > 0 &&
+		!canceled &&
+		(!length || (length && BASS_ChannelBytes2Seconds(streamHandle, totalBytes) < *length))
+		) {
+		beatRootProcessor.processFrame(bufferWrapper);
+
+		totalBytes += hopBytes;
+		BASS_ChannelSetPosition(streamHandle, offset + totalBytes, BASS_POS_BYTE);
+
+		bytes = BASS_ChannelGetData(streamHandle, bufferWrapper[0], flags);
+	}
+
+	//auto in = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * beatRootProcessor.getFFTSize());
+	/*
+	auto in = (double *)fftw_malloc(sizeof(double) * beatRootProcessor.getFFTSize());
+	auto out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * beatRootProcessor.getFFTSize());
+	auto plan = fftw_plan_dft_r2c_1d(beatRootProcessor.getFFTSize(), in, out, FFTW_ESTIMATE);
+
+	int bytes = BASS_ChannelGetData(streamHandle, sbuffer.floatBuffer, BASS_DATA_FLOAT | fftBytes);
+	totalBytes = 0;
+
+	while (bytes > 0) {
+		for (auto i = 0; i < beatRootProcessor.getFFTSize(); ++i) {
+			in[i] = buffer.floatBuffer[i * info.chans]; // only read a single channel for now
 		}
 
-		DWORD flags = BASS_DATA_FFT_COMPLEX;
-
-		if (beatRootProcessor.getFFTSize() >= 16384)
-			flags |= BASS_DATA_FFT16384;
-		else if (beatRootProcessor.getFFTSize() >= 8192)
-			flags |= BASS_DATA_FFT8192;
-		else if (beatRootProcessor.getFFTSize() >= 4096)
-			flags |= BASS_DATA_FFT4096;
-		else if (beatRootProcessor.getFFTSize() >= 2048)
-			flags |= BASS_DATA_FFT2048;
-		else if (beatRootProcessor.getFFTSize() >= 1024)
-			flags |= BASS_DATA_FFT1024;
-		else if (beatRootProcessor.getFFTSize() >= 512)
-			flags |= BASS_DATA_FFT512;
-		else if (beatRootProcessor.getFFTSize() >= 256)
-			flags |= BASS_DATA_FFT256;
-		else
-			CConsole::Console.Print("Beatroot is asking for an FFT size of " + std::to_string(beatRootProcessor.getFFTSize()) + ", which isn't supported", MSG_ERROR);
-
-		float **bufferWrapper = new float *[1];
-		bufferWrapper[0] = new float[beatRootProcessor.getFFTSize() * 2 /* real and imaginary parts */ * chans];
-
-		auto start = std::chrono::system_clock::now();
-
-		int bytes = BASS_ChannelGetData(streamHandle, bufferWrapper[0], flags);
-
-		QWORD totalBytes = 0;
-		while (bytes > 0 &&
-			!canceled &&
-			(!endTime || (endTime && BASS_ChannelBytes2Seconds(streamHandle, totalBytes) < *endTime))
-			) {
-			beatRootProcessor.processFrame(bufferWrapper);
-
-			totalBytes += hopBytes;
-			BASS_ChannelSetPosition(streamHandle, offset + totalBytes, BASS_POS_BYTE);
-
-			bytes = BASS_ChannelGetData(streamHandle, bufferWrapper[0], flags);
+		fftw_execute(plan);
+
+		for (auto i = 0; i < beatRootProcessor.getFFTSize(); ++i) {
+			buffer.floatBuffer[i * 2] = out[i][0];
+			buffer.floatBuffer[i * 2 + 1] = out[i][1];
 		}
 
-		//auto in = (fftw_complex*) fftw_malloc(sizeof(fftw_complex) * beatRootProcessor.getFFTSize());
-		/*
-		auto in = (double *)fftw_malloc(sizeof(double) * beatRootProcessor.getFFTSize());
-		auto out = (fftw_complex *)fftw_malloc(sizeof(fftw_complex) * beatRootProcessor.getFFTSize());
-		auto plan = fftw_plan_dft_r2c_1d(beatRootProcessor.getFFTSize(), in, out, FFTW_ESTIMATE);
+		beatRootProcessor.processFrame(bufferWrapper);
 
-		int bytes = BASS_ChannelGetData(streamHandle, sbuffer.floatBuffer, BASS_DATA_FLOAT | fftBytes);
-		totalBytes = 0;
+		totalBytes += hopBytes;
+		BASS_ChannelSetPosition(streamHandle, totalBytes, BASS_POS_BYTE);
 
-		while (bytes > 0) {
-			for (auto i = 0; i < beatRootProcessor.getFFTSize(); ++i) {
-				in[i] = buffer.floatBuffer[i * info.chans]; // only read a single channel for now
-			}
 
-			fftw_execute(plan);
+		bytes = BASS_ChannelGetData(streamHandle, buffer.floatBuffer, BASS_DATA_FLOAT | fftBytes);
+	}
 
-			for (auto i = 0; i < beatRootProcessor.getFFTSize(); ++i) {
-				buffer.floatBuffer[i * 2] = out[i][0];
-				buffer.floatBuffer[i * 2 + 1] = out[i][1];
-			}
+	fftw_free(in);
+	fftw_free(out);
+	fftw_destroy_plan(plan);
+	*/
 
-			beatRootProcessor.processFrame(bufferWrapper);
+	delete[] bufferWrapper[0];
+	delete[] bufferWrapper;
 
-			totalBytes += hopBytes;
-			BASS_ChannelSetPosition(streamHandle, totalBytes, BASS_POS_BYTE);
+	if (!canceled) {
+		auto end = std::chrono::system_clock::now();
 
+		CConsole::Console.Print("Populating BeatRoot took " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
 
-			bytes = BASS_ChannelGetData(streamHandle, buffer.floatBuffer, BASS_DATA_FLOAT | fftBytes);
-		}
+		start = end;
 
-		fftw_free(in);
-		fftw_free(out);
-		fftw_destroy_plan(plan);
-		*/
+		auto beats = std::make_shared<const BeatTimeline>(beatRootProcessor.beatTrack());
 
-		delete[] bufferWrapper[0];
-		delete[] bufferWrapper;
+		end = std::chrono::system_clock::now();
 
-		if (!canceled) {
-			auto end = std::chrono::system_clock::now();
+		CConsole::Console.Print("BeatRoot processing took " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
 
-			CConsole::Console.Print("Populating BeatRoot took " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
+		if (!beats->empty()) {
+			LogBpm(*beats);
 
-			start = end;
+			return beats;
+		} else if (!parameters) {
+			CConsole::Console.Print("No beats detected even with a smaller hop size! Increasing expiry time next...", MSG_ALERT);
 
-			eventList = beatRootProcessor.beatTrack();
+			AgentParameters newParameters;
+			newParameters.expiryTime = 100.0;
+			return _Analyse(streamHandle, freq, chans, canceled, startTime ? startTime : 0.0, length, 0.010, newParameters);
+		} else {
+			CConsole::Console.Print("No beats detected with a smaller hop size and larger expiry time!", MSG_ERROR);
+		}
 
-			end = std::chrono::system_clock::now();
+		// Hang on to the (empty) result,
+		// so we don't try this song again
+		return beats;
+	}
 
-			CConsole::Console.Print("BeatRoot processing took " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
+	return nullptr;
+}
+void BeatDetect::AnalyseAlbum(
+	HSTREAM streamHandle,
+	DWORD freq,
+	DWORD chans,
+	const std::atomic<bool> &canceled,
+	const std::vector<Range> &ranges,
+	const std::function<void(std::size_t, std::shared_ptr<const BeatTimeline>)> &onAnalysed,
+	const AnalysisGraph::Setup &setup
+) {
+	if (ranges.empty() || chans == 0)
+		return;
 
-			// Calculate BPM
-			if (!eventList.empty()) {
-				auto [min, average, max] = GetTimeBetweenBeats();
+	AnalysisGraph graph(freq, chans);
 
-				CConsole::Console.Print(
-					"Song's estimated BPM is " +
-					std::to_string(static_cast<int>(1.0 / average * 60.0)) +
-					" based on " +
-					std::to_string(eventList.size()) +
-					" beats",
-					MSG_DIAG
-				);
+	Onsets onsets(freq);
+	graph.Add(onsets);
 
-				eventListIter = eventList.begin();
-			} else if (!hopTime) {
-				// I've only encountered one song (Halestorm's "Scream") that can't be processed
-				// with a hopTime of fftTime/2, so this is hopefully just an edge case.
-				//
-				// Curse of Jinxing strikes again: we can't find beats in Nico Vega's "Beast" even
-				// after the retry. Testing with BeatRoot in Audacity showed that setting the expiry
-				// time to 100 was required. 95 was tested, but produced spurious beats in the silence
-				// between the song and the outro.
-				//
-				// 3Oh!3's "Photofinnish" also requires a higher expiry time, but 50 is adequate here.
-				// Should we try 50 before 100? We'd probably waste too much time at that point. The goal
-				// here is to detect beats as quickly as possible.
-				CConsole::Console.Print("No beats detected. Trying again with a hop time of 10ms...", MSG_ALERT);
+	if (setup)
+		setup(graph);
 
-				lock.unlock();
+	auto start = std::chrono::system_clock::now();
 
-				_OnLoad(streamHandle, freq, chans, onLoaded, startTime ? startTime : 0.0, endTime, 0.010);
+	if (!graph.Run(streamHandle, canceled))
+		return;
 
-				// Return so we don't try to free the stream twice
-				return;
-			} else if (!parameters) {
-				CConsole::Console.Print("No beats detected even with a smaller hop size! Increasing expiry time next...", MSG_ALERT);
+	auto end = std::chrono::system_clock::now();
 
-				lock.unlock();
+	CConsole::Console.Print("Populating BeatRoot for the whole album took " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
 
-				AgentParameters newParameters;
-				newParameters.expiryTime = 100.0;
-				_OnLoad(streamHandle, freq, chans, onLoaded, startTime ? startTime : 0.0, endTime, 0.010, newParameters);
+	for (std::size_t i = 0; i < ranges.size() && !canceled; ++i) {
+		const auto &[startTime, length] = ranges[i];
 
-				// Return so we don't try to free the stream twice
-				return;
-			} else {
-				CConsole::Console.Print("No beats detected with a smaller hop size and larger expiry time!", MSG_ERROR);
-			}
+		auto beats = TrackBeats(
+			[&onsets, startTime = startTime, length = length] {
+				return onsets.GetProcessor().beatTrack(startTime, length ? startTime + *length : -1.0);
+			},
+			streamHandle,
+			freq,
+			chans,
+			canceled,
+			startTime,
+			length
+		);
 
-			state = State::Loaded;
-		} else {
-			state = State::Idle;
-		}
+		// Only this track's lost, the rest can still be tracked
+		if (!beats)
+			continue;
+
+		onAnalysed(i, std::move(beats));
 	}
+}
 
-	BASS_StreamFree(streamHandle);
+std::shared_ptr<const BeatTimeline> BeatDetect::TrackBeats(
+	const std::function<EventList()> &track,
+	HSTREAM streamHandle,
+	DWORD freq,
+	DWORD chans,
+	const std::atomic<bool> &canceled,
+	double startTime,
+	std::optional<double> length
+) {
+	auto start = std::chrono::system_clock::now();
 
-	// Only call the callback if we're
-	// actually detecting and weren't
-	// canceled
-	if (detectBpm && !canceled)
-		onLoaded();
+	auto beats = std::make_shared<const BeatTimeline>(track());
 
-	canceled = true;
-}
+	auto end = std::chrono::system_clock::now();
 
-inline std::tuple<double, double, double> BeatDetect::GetTimeBetweenBeats() const {
-	//double averageTimeBetweenBeats = 0.0;
-	std::tuple<double, double, double> ret = {
-		std::numeric_limits<double>::max(),
-		0.0,
-		std::numeric_limits<double>::lowest()
-	};
-
-	EventList::const_iterator lastEvent = eventList.end();
-	for (auto iter = eventList.begin(); iter != eventList.end(); ++iter) {
-		if (lastEvent != eventList.end()) {
-			auto delta = iter->time - lastEvent->time;
-
-			if (delta < std::get<0>(ret))
-				std::get<0>(ret) = delta;
-			if (delta > std::get<2>(ret))
-				std::get<2>(ret) = delta;
-
-			std::get<1>(ret) += delta;
-		}
+	CConsole::Console.Print("BeatRoot processing took " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
 
-		lastEvent = iter;
+	if (!beats->empty()) {
+		LogBpm(*beats);
+		return beats;
 	}
 
-	std::get<1>(ret) = std::get<1>(ret) / (eventList.size() - 1);
+	// I've only encountered one song (Halestorm's "Scream") that can't be processed
+	// with a hopTime of fftTime/2, so this is hopefully just an edge case.
+	//
+	// Curse of Jinxing strikes again: we can't find beats in Nico Vega's "Beast" even
+	// after the retry. Testing with BeatRoot in Audacity showed that setting the expiry
+	// time to 100 was required. 95 was tested, but produced spurious beats in the silence
+	// between the song and the outro.
+	//
+	// 3Oh!3's "Photofinnish" also requires a higher expiry time, but 50 is adequate here.
+	// Should we try 50 before 100? We'd probably waste too much time at that point. The goal
+	// here is to detect beats as quickly as possible.
+	//
+	// Retrying means going back to the stream for just this track, but it's rare enough
+	// that it isn't worth keeping the samples around for.
+	CConsole::Console.Print("No beats detected. Trying again with a hop time of 10ms...", MSG_ALERT);
+
+	return _Analyse(streamHandle, freq, chans, canceled, startTime, length, 0.010, std::nullopt);
+}
 
-	return ret;
-}
\ No newline at end of file
+void BeatDetect::LogBpm(const BeatTimeline &beats) {
+	auto [min, average, max] = beats.GetTimeBetweenBeats();
+
+	CConsole::Console.Print(
+		"Song's estimated BPM is " +
+		std::to_string(static_cast<int>(1.0 / average * 60.0)) +
+		" based on " +
+		std::to_string(beats.size()) +
+		" beats",
+		MSG_DIAG
+	);
+}
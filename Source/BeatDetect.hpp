@@ -1,13 +1,20 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <mutex>
-#include <thread>
+#include <optional>
+#include <utility>
+#include <vector>
 
 #include <bass.h>
 
 #include "MathCPP/Duration.hpp"
 
+#include "AnalysisGraph.hpp"
 #include "BeatRootProcessor.h"
+#include "BeatTimeline.hpp"
 #include "CConsole.h"
 
 using namespace MathsCPP;
@@ -15,57 +22,125 @@ using namespace MathsCPP;
 // In a prior life, these 2 words caused much anxiety
 class BeatDetect {
 public:
-	enum class State {
-		Idle,
-		Loading,
-		Loaded
+	~BeatDetect();
+
+	// Feeds BeatRoot its onsets out of an AnalysisGraph
+	class Onsets : public AnalysisGraph::Consumer {
+	public:
+		explicit Onsets(DWORD freq) : processor(static_cast<float>(freq), AgentParameters()) {}
+
+		bool WantsFrames() const override { return true; }
+		void OnStart(const AnalysisGraph::Format &format) override;
+		void OnFrame(const float *spectrum) override;
+
+		BeatRootProcessor &GetProcessor() { return processor; }
+
+	private:
+		BeatRootProcessor processor;
+		bool matches = true;
 	};
 
-	void OnLoad(
+	// Runs beat detection over the given decode stream on the
+	// calling thread. The stream is left open for the caller
+	// to free.
+	//
+	// setup can add whatever else wants to come along for
+	// the same decode.
+	//
+	// Returns nullptr if we were canceled part way through,
+	// or an empty timeline if no beats could be found.
+	static std::shared_ptr<const BeatTimeline> Analyse(
 		HSTREAM streamHandle,
-		const DWORD freq,
-		const DWORD chans,
-		std::function<void()> onLoaded,
+		DWORD freq,
+		DWORD chans,
+		const std::atomic<bool> &canceled,
 		std::optional<double> startTime = std::nullopt,
-		std::optional<double> endTime = std::nullopt
+		std::optional<double> length = std::nullopt,
+		const AnalysisGraph::Setup &setup = nullptr
 	);
 
+	// A start time and (optional) length within the stream
+	using Range = std::pair<double, std::optional<double>>;
+
+	// Decodes the whole stream once (e.g. a cue sheet's album
+	// image) and tracks beats for every range out of that single
+	// pass, instead of seeking and re-decoding for each track.
+	//
+	// onAnalysed is called on the calling thread with each
+	// range's index as it finishes, in the order given, so put
+	// whatever's most urgent first. Beat times are relative to
+	// the start of their range. Stops early if canceled.
+	static void AnalyseAlbum(
+		HSTREAM streamHandle,
+		DWORD freq,
+		DWORD chans,
+		const std::atomic<bool> &canceled,
+		const std::vector<Range> &ranges,
+		const std::function<void(std::size_t, std::shared_ptr<const BeatTimeline>)> &onAnalysed,
+		const AnalysisGraph::Setup &setup = nullptr
+	);
+
+	// Only ever call this from the render thread.
+	//
+	// Returns true if we passed a beat
+	// since the last call.
 	bool OnLoop(double elapsed);
 
+	// Only ever call this from the render thread
 	void SeekTo(double time);
 
+	// The timeline currently being played back (if any)
+	const std::shared_ptr<const BeatTimeline> &GetTimeline() const { return timeline; }
+
+	// Hands a finished timeline over to the render thread,
+	// which picks it up on its next OnLoop(). Safe to call
+	// from any thread.
+	void Publish(std::shared_ptr<const BeatTimeline> timeline);
+
 	void ToggleDetection();
 
 	bool IsDetecting() const;
 
-	void Cancel();
-
+	// Only ever call this from the render thread
 	void Reset();
 
-	const State GetState() const;
+	// FFTW's planner isn't thread safe, so take
+	// this when making plans off the render thread
+	static inline std::mutex planMutex;
 
 private:
-	inline void _OnLoad(
+	static std::shared_ptr<const BeatTimeline> _Analyse(
 		HSTREAM streamHandle,
 		DWORD freq,
 		DWORD chans,
-		std::function<void()> onLoaded,
-		std::optional<double> startTime = std::nullopt,
-		std::optional<double> endTime = std::nullopt,
-		std::optional<double> hopTime = std::nullopt,
-		std::optional<AgentParameters> parameters = std::nullopt
+		const std::atomic<bool> &canceled,
+		std::optional<double> startTime,
+		std::optional<double> length,
+		std::optional<double> hopTime,
+		std::optional<AgentParameters> parameters
 	);
 
-	inline std::tuple<double, double, double> GetTimeBetweenBeats() const;
+	// Turns what track() gets out of BeatRoot into a timeline, going
+	// back to the stream to retry if it couldn't find any beats
+	static std::shared_ptr<const BeatTimeline> TrackBeats(
+		const std::function<EventList()> &track,
+		HSTREAM streamHandle,
+		DWORD freq,
+		DWORD chans,
+		const std::atomic<bool> &canceled,
+		double startTime,
+		std::optional<double> length
+	);
 
-	bool detectBpm = false;
+	static void LogBpm(const BeatTimeline &beats);
 
-	EventList eventList;
-	EventList::iterator eventListIter = eventList.end();
+	std::atomic<bool> detectBpm = false;
 
-	std::thread thread;
-	std::atomic<bool> canceled = false;
-	std::mutex mutex;
+	// Owned by the render thread
+	std::shared_ptr<const BeatTimeline> timeline;
+	std::size_t nextBeat = 0;
 
-	State state = State::Idle;
+	// Written by the analysis thread and exchanged out by
+	// the render thread, so neither side ever waits on the other.
+	std::atomic<std::shared_ptr<const BeatTimeline> *> published = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,478 @@
+#include "BeatScheduler.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+#include "AnalysisCache.hpp"
+#include "TrackFeatures.hpp"
+
+void BeatScheduler::OnInit(
+	BeatDetect *detector,
+	OpenFunction openWithFlags,
+	FeaturesFunction publishFeatures,
+	std::size_t workers
+) {
+	this->detector = detector;
+	this->openWithFlags = std::move(openWithFlags);
+	this->publishFeatures = std::move(publishFeatures);
+
+	for (std::size_t i = 0; i < std::max<std::size_t>(workers, 1); ++i)
+		this->workers.emplace_back(&BeatScheduler::Work, this);
+}
+
+void BeatScheduler::OnDestroy() {
+	{
+		std::unique_lock lock(mutex);
+		stopping = true;
+
+		queue.clear();
+		for (auto &job : running)
+			*job.canceled = true;
+	}
+
+	condition.notify_all();
+
+	for (auto &worker : workers) {
+		if (worker.joinable())
+			worker.join();
+	}
+
+	workers.clear();
+}
+
+void BeatScheduler::Schedule(
+	const Playlist::Track &current,
+	const std::vector<Playlist::Track> &surrounding,
+	const std::vector<Playlist::Track> &album
+) {
+	std::vector<Playlist::Track> wanted;
+	wanted.reserve(surrounding.size() + 1);
+	wanted.emplace_back(current);
+	for (const auto &track : surrounding) {
+		if (wanted.size() > ahead + behind)
+			break;
+
+		wanted.emplace_back(track);
+	}
+
+	// The whole album comes out of one decode, so order it
+	// the same way as our window: nearest first, upcoming
+	// tracks before previous ones.
+	std::vector<Playlist::Track> ordered;
+	if (!album.empty()) {
+		auto currentIndex = static_cast<std::size_t>(
+			std::find_if(album.begin(), album.end(), [&current](const Playlist::Track &track) { return Key(track) == Key(current); }) - album.begin()
+		);
+		if (currentIndex == album.size())
+			currentIndex = 0;
+
+		ordered.reserve(album.size());
+		ordered.emplace_back(album[currentIndex]);
+		for (std::size_t distance = 1; distance < album.size(); ++distance) {
+			if (currentIndex + distance < album.size())
+				ordered.emplace_back(album[currentIndex + distance]);
+			if (distance <= currentIndex)
+				ordered.emplace_back(album[currentIndex - distance]);
+		}
+	}
+
+	{
+		std::unique_lock lock(mutex);
+
+		// Clear out the old song's beats while we hold the
+		// lock, so a worker finishing the old song can't
+		// sneak its beats in after us
+		this->current = Key(current);
+		detector->Reset();
+		publishFeatures(nullptr, std::nullopt);
+
+		if (auto analysis = Find(this->current)) {
+			if (analysis->timeline) {
+				CConsole::Console.Print("Using cached beats for " + current.path.stem().u8string(), MSG_DIAG);
+				detector->Publish(analysis->timeline);
+			}
+
+			publishFeatures(analysis->waveform, analysis->loudness);
+		}
+
+		// The waveform and loudness are always wanted,
+		// beats only if anyone's going to see them
+		const auto beats = detector->IsDetecting();
+
+		// Cancel anything running that fell out of our window.
+		// An album job covers every track in its image, so
+		// that stays for as long as we're in the same image.
+		// Anything not tracking beats that now should be gets
+		// started over, since the features come along anyway.
+		for (auto &job : running) {
+			if ((beats && !job.beats) || (!job.album.empty() ?
+				job.track.path != current.path :
+				std::none_of(wanted.begin(), wanted.end(), [&job](const Playlist::Track &track) { return Key(track) == Key(job.track); }))) {
+				CConsole::Console.Print("Canceling analysis of " + job.track.path.stem().u8string(), MSG_DIAG);
+				*job.canceled = true;
+			}
+		}
+
+		queue.clear();
+
+		if (!ordered.empty()) {
+			Job job{ ordered.front(), std::make_shared<std::atomic<bool>>(false), beats };
+			for (const auto &track : ordered) {
+				Key key(track);
+				if (!IsDone(key, beats) && !IsRunning(key, beats))
+					job.album.emplace_back(track);
+			}
+
+			if (!job.album.empty()) {
+				job.track = job.album.front();
+				queue.emplace_back(std::move(job));
+			}
+		} else {
+			for (const auto &track : wanted) {
+				Key key(track);
+				if (!IsDone(key, beats) && !IsRunning(key, beats))
+					queue.emplace_back(Job{ track, std::make_shared<std::atomic<bool>>(false), beats });
+			}
+		}
+	}
+
+	condition.notify_all();
+}
+
+std::optional<Loudness::Result> BeatScheduler::FindLoudness(const Playlist::Track &track) {
+	std::unique_lock lock(mutex);
+
+	if (auto analysis = Find(Key(track)))
+		return analysis->loudness;
+
+	return std::nullopt;
+}
+
+void BeatScheduler::Cancel() {
+	std::unique_lock lock(mutex);
+
+	queue.clear();
+	for (auto &job : running)
+		*job.canceled = true;
+}
+
+void BeatScheduler::Clear() {
+	std::unique_lock lock(mutex);
+
+	cache.clear();
+	cacheIndex.clear();
+}
+
+void BeatScheduler::SetWindow(std::size_t behind, std::size_t ahead) {
+	std::unique_lock lock(mutex);
+
+	this->behind = behind;
+	this->ahead = ahead;
+}
+
+void BeatScheduler::Work() {
+	std::unique_lock lock(mutex);
+
+	while (true) {
+		condition.wait(lock, [this] { return stopping || !queue.empty(); });
+
+		if (stopping)
+			return;
+
+		// The queue is already in priority order
+		auto job = std::move(queue.front());
+		queue.erase(queue.begin());
+
+		running.emplace_back(job);
+
+		lock.unlock();
+
+		if (!LoadFromDisk(job)) {
+			lock.lock();
+
+			running.erase(
+				std::find_if(running.begin(), running.end(), [&job](const Job &other) { return other.canceled == job.canceled; })
+			);
+
+			continue;
+		}
+
+		auto extension = job.track.path.extension().u8string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
+
+		if (auto streamHandle = openWithFlags(job.track.path, extension, BASS_STREAM_PRESCAN | BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT)) {
+			if (job.album.empty())
+				AnalyseTrack(streamHandle, job);
+			else
+				AnalyseAlbum(streamHandle, job);
+
+			BASS_StreamFree(streamHandle);
+		} else {
+			CConsole::Console.Print("Could not open " + job.track.path.u8string() + " for beat detection! Error code " + std::to_string(BASS_ErrorGetCode()), MSG_ERROR);
+		}
+
+		lock.lock();
+
+		running.erase(
+			std::find_if(running.begin(), running.end(), [&job](const Job &other) { return other.canceled == job.canceled; })
+		);
+	}
+}
+
+void BeatScheduler::AnalyseTrack(HSTREAM streamHandle, const Job &job) {
+	BASS_CHANNELINFO channelInfo;
+	BASS_ChannelGetInfo(streamHandle, &channelInfo);
+
+	// Beats we already had only need the features to go with them
+	auto loaded = job.loaded.find(Key(job.track));
+	const auto tracking = job.beats && loaded == job.loaded.end();
+
+	CConsole::Console.Print((tracking ? "Detecting beats for " : "Analysing ") + job.track.path.stem().u8string(), MSG_DIAG);
+
+	// We're decoding the whole thing anyway
+	TrackFeatures features(job.track.path, job.track.startTime, job.track.length);
+
+	const auto startTime = job.track.startTime > DBL_EPSILON ? job.track.startTime : static_cast<std::optional<double>>(std::nullopt);
+
+	std::shared_ptr<const BeatTimeline> timeline;
+	if (tracking) {
+		timeline = BeatDetect::Analyse(
+			streamHandle,
+			channelInfo.freq,
+			channelInfo.chans,
+			*job.canceled,
+			startTime,
+			job.track.length,
+			[&features](AnalysisGraph &graph) { features.AddTo(graph); }
+		);
+
+		if (!timeline)
+			return;
+	} else {
+		AnalysisGraph graph(channelInfo.freq, channelInfo.chans);
+		features.AddTo(graph);
+
+		if (!graph.Run(streamHandle, *job.canceled, startTime, job.track.length))
+			return;
+	}
+
+	if (*job.canceled)
+		return;
+
+	if (timeline)
+		AnalysisCache::SaveBeats(job.track.path, job.track.startTime, *timeline);
+	else if (loaded != job.loaded.end())
+		timeline = loaded->second;
+
+	features.Save();
+
+	std::unique_lock lock(mutex);
+	Finish(job, job.track, { std::move(timeline), features.GetWaveform(), features.GetLoudness() });
+}
+
+void BeatScheduler::AnalyseAlbum(HSTREAM streamHandle, const Job &job) {
+	BASS_CHANNELINFO channelInfo;
+	BASS_ChannelGetInfo(streamHandle, &channelInfo);
+
+	// Indices into job.album of the tracks that
+	// still need beats, and of those that don't
+	std::vector<std::size_t> tracked, untracked;
+	for (std::size_t i = 0; i < job.album.size(); ++i) {
+		if (job.beats && job.loaded.count(Key(job.album[i])) == 0)
+			tracked.emplace_back(i);
+		else
+			untracked.emplace_back(i);
+	}
+
+	CConsole::Console.Print((!tracked.empty() ? "Detecting beats for " : "Analysing ") + std::to_string(job.album.size()) + " tracks of " + job.track.path.stem().u8string(), MSG_DIAG);
+
+	std::vector<BeatDetect::Range> ranges;
+	std::vector<std::unique_ptr<TrackFeatures>> features;
+	ranges.reserve(tracked.size());
+	features.reserve(job.album.size());
+	for (const auto &track : job.album)
+		features.emplace_back(std::make_unique<TrackFeatures>(track.path, track.startTime, track.length));
+	for (auto index : tracked)
+		ranges.emplace_back(job.album[index].startTime, job.album[index].length);
+
+	auto onAnalysed = [this, &job, &features](std::size_t index, std::shared_ptr<const BeatTimeline> timeline) {
+		if (*job.canceled)
+			return;
+
+		const auto &track = job.album[index];
+
+		if (timeline)
+			AnalysisCache::SaveBeats(track.path, track.startTime, *timeline);
+		else if (auto loaded = job.loaded.find(Key(track)); loaded != job.loaded.end())
+			timeline = loaded->second;
+
+		features[index]->Save();
+
+		std::unique_lock lock(mutex);
+		Finish(job, track, { std::move(timeline), features[index]->GetWaveform(), features[index]->GetLoudness() });
+	};
+
+	auto setup = [&features](AnalysisGraph &graph) {
+		for (auto &track : features)
+			track->AddTo(graph);
+	};
+
+	if (!tracked.empty()) {
+		// Tracks that only wanted features are done as soon as
+		// the decode is, so get them out of the way before
+		// waiting on BeatRoot for the rest
+		bool flushed = false;
+
+		BeatDetect::AnalyseAlbum(
+			streamHandle,
+			channelInfo.freq,
+			channelInfo.chans,
+			*job.canceled,
+			ranges,
+			[&](std::size_t index, std::shared_ptr<const BeatTimeline> timeline) {
+				if (!flushed) {
+					for (auto other : untracked)
+						onAnalysed(other, nullptr);
+
+					flushed = true;
+				}
+
+				onAnalysed(tracked[index], std::move(timeline));
+			},
+			setup
+		);
+
+		return;
+	}
+
+	AnalysisGraph graph(channelInfo.freq, channelInfo.chans);
+	setup(graph);
+
+	if (!graph.Run(streamHandle, *job.canceled))
+		return;
+
+	for (auto index : untracked)
+		onAnalysed(index, nullptr);
+}
+
+bool BeatScheduler::LoadFromDisk(Job &job) {
+	auto load = [this, &job](const Playlist::Track &track) {
+		Analysis analysis;
+		if (job.beats) {
+			analysis.timeline = AnalysisCache::LoadBeats(track.path, track.startTime);
+			if (!analysis.timeline)
+				return false;
+		}
+
+		analysis.waveform = AnalysisCache::LoadWaveform(track.path, track.startTime);
+		analysis.loudness = AnalysisCache::LoadLoudness(track.path, track.startTime);
+		if (!analysis.waveform || !analysis.loudness) {
+			// Beats cached by an older version won't have a waveform
+			// or loudness to go with them. The beats are still good,
+			// so they get used straight away and only the rest is redone.
+			if (analysis.timeline) {
+				CConsole::Console.Print("Loaded beats for " + track.path.stem().u8string() + " from disk", MSG_DIAG);
+
+				{
+					std::unique_lock lock(mutex);
+					if (!*job.canceled && Key(track) == current)
+						detector->Publish(analysis.timeline);
+				}
+
+				job.loaded.emplace(track, std::move(analysis.timeline));
+			}
+
+			return false;
+		}
+
+		CConsole::Console.Print("Loaded " + std::string(job.beats ? "beats" : "analysis") + " for " + track.path.stem().u8string() + " from disk", MSG_DIAG);
+
+		std::unique_lock lock(mutex);
+		Finish(job, track, std::move(analysis));
+
+		return true;
+	};
+
+	if (job.album.empty())
+		return !load(job.track);
+
+	job.album.erase(
+		std::remove_if(job.album.begin(), job.album.end(), load),
+		job.album.end()
+	);
+
+	if (job.album.empty())
+		return false;
+
+	job.track = job.album.front();
+
+	return true;
+}
+
+void BeatScheduler::Finish(const Job &job, const Playlist::Track &track, Analysis analysis) {
+	if (*job.canceled)
+		return;
+
+	Key key(track);
+	Store(key, analysis);
+
+	// We're still holding the lock, so the current
+	// song can't change out from under us here
+	if (key == current) {
+		CConsole::Console.Print("Analysis finished for the current song (" + track.path.stem().u8string() + ")!", MSG_DIAG);
+
+		if (analysis.timeline)
+			detector->Publish(std::move(analysis.timeline));
+
+		publishFeatures(std::move(analysis.waveform), std::move(analysis.loudness));
+	} else {
+		CConsole::Console.Print("Analysis finished for " + track.path.stem().u8string(), MSG_DIAG);
+	}
+}
+
+const BeatScheduler::Analysis *BeatScheduler::Find(const Key &key) {
+	auto iter = cacheIndex.find(key);
+	if (iter == cacheIndex.end())
+		return nullptr;
+
+	// Most recently used goes to the front
+	cache.splice(cache.begin(), cache, iter->second);
+
+	return &iter->second->second;
+}
+
+void BeatScheduler::Store(const Key &key, Analysis analysis) {
+	if (auto iter = cacheIndex.find(key); iter != cacheIndex.end()) {
+		// Working out just the features again
+		// doesn't mean forgetting its beats
+		if (!analysis.timeline)
+			analysis.timeline = std::move(iter->second->second.timeline);
+
+		iter->second->second = std::move(analysis);
+		cache.splice(cache.begin(), cache, iter->second);
+		return;
+	}
+
+	cache.emplace_front(key, std::move(analysis));
+	cacheIndex.emplace(key, cache.begin());
+
+	while (cache.size() > cacheSize) {
+		cacheIndex.erase(cache.back().first);
+		cache.pop_back();
+	}
+}
+
+bool BeatScheduler::IsDone(const Key &key, bool beats) const {
+	auto iter = cacheIndex.find(key);
+
+	return iter != cacheIndex.end() && (!beats || iter->second->second.timeline);
+}
+
+bool BeatScheduler::IsRunning(const Key &key, bool beats) const {
+	return std::any_of(running.begin(), running.end(), [&key, beats](const Job &job) {
+		return !*job.canceled && (job.beats || !beats) && (
+			Key(job.track) == key ||
+			std::any_of(job.album.begin(), job.album.end(), [&key](const Playlist::Track &track) { return Key(track) == key; })
+		);
+	});
+}
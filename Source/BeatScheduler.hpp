@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <bass.h>
+
+#include "BeatDetect.hpp"
+#include "BeatTimeline.hpp"
+#include "Loudness.hpp"
+#include "PeakPyramid.hpp"
+#include "Playlist.hpp"
+
+// Runs beat detection for the current track and a
+// window of tracks around it on a small pool of worker
+// threads, nearest to the playhead first.
+//
+// Finished timelines are kept in an LRU cache, so
+// skipping back and forth through an album reuses
+// work instead of throwing it away. They're also saved
+// to (and looked for in) the AnalysisCache on disk.
+//
+// Each track's waveform overview and loudness come along
+// for the ride, since they're worked out from the same decode.
+// They're wanted whether or not beats are being detected, so
+// with detection off, that's all that gets worked out.
+class BeatScheduler {
+public:
+	using OpenFunction = std::function<HSTREAM(const std::filesystem::path &, const std::string &, DWORD)>;
+	using FeaturesFunction = std::function<void(std::shared_ptr<const PeakPyramid>, std::optional<Loudness::Result>)>;
+
+	static constexpr std::size_t DefaultAhead = 3;
+	static constexpr std::size_t DefaultBehind = 1;
+	static constexpr std::size_t DefaultWorkers = 2;
+	static constexpr std::size_t DefaultCacheSize = 32;
+
+	// Timelines for the current track are published to detector
+	// (while it's detecting), and its waveform and loudness to
+	// publishFeatures (empty when it changes). publishFeatures
+	// gets called from any of our threads.
+	void OnInit(
+		BeatDetect *detector,
+		OpenFunction openWithFlags,
+		FeaturesFunction publishFeatures,
+		std::size_t workers = DefaultWorkers
+	);
+	void OnDestroy();
+
+	// Replaces everything we want analysed. The current track
+	// gets the highest priority, followed by surrounding (which
+	// should already be ordered nearest first).
+	//
+	// Anything queued or running that's no longer wanted is
+	// dropped. Only ever call this from the render thread.
+	//
+	// When playing a cue sheet, pass every one of its tracks
+	// as album. The image then gets decoded once for all of
+	// them (still current track first) instead of once per track.
+	void Schedule(
+		const Playlist::Track &current,
+		const std::vector<Playlist::Track> &surrounding,
+		const std::vector<Playlist::Track> &album = {}
+	);
+
+	// The loudness we've already worked out for track, if
+	// we have. This never goes to the disk, so it's fine to
+	// call from the render thread.
+	std::optional<Loudness::Result> FindLoudness(const Playlist::Track &track);
+
+	// Cancels everything, but keeps what's already cached
+	void Cancel();
+
+	// Drops every cached timeline
+	void Clear();
+
+	void SetWindow(std::size_t behind, std::size_t ahead);
+	std::size_t GetBehind() const { return behind; }
+	std::size_t GetAhead() const { return ahead; }
+
+private:
+	struct Key {
+		std::filesystem::path path;
+		double startTime = 0.0;
+
+		Key() = default;
+		Key(const Playlist::Track &track) : path(track.path), startTime(track.startTime) {}
+
+		bool operator==(const Key &other) const {
+			return startTime == other.startTime && path == other.path;
+		}
+
+		bool operator<(const Key &other) const {
+			if (path != other.path)
+				return path < other.path;
+
+			return startTime < other.startTime;
+		}
+	};
+
+	struct Analysis {
+		// Null if beats weren't being detected
+		std::shared_ptr<const BeatTimeline> timeline;
+		std::shared_ptr<const PeakPyramid> waveform;
+		std::optional<Loudness::Result> loudness;
+	};
+
+	struct Job {
+		Playlist::Track track;
+		std::shared_ptr<std::atomic<bool>> canceled;
+
+		// Whether to track beats, or only work out features
+		bool beats = false;
+
+		// Every track still to do from one album image,
+		// most urgent first. Empty for a single track.
+		std::vector<Playlist::Track> album;
+
+		// Beats we found on disk for tracks whose waveform or
+		// loudness weren't there. Those only need the features.
+		std::map<Key, std::shared_ptr<const BeatTimeline>> loaded;
+	};
+
+	void Work();
+
+	// Finishes whatever of job we already have on disk (from
+	// popRocksAnalyse or an earlier run), leaving the rest.
+	// Returns whether there's anything left to analyse.
+	bool LoadFromDisk(Job &job);
+
+	void AnalyseTrack(HSTREAM streamHandle, const Job &job);
+	void AnalyseAlbum(HSTREAM streamHandle, const Job &job);
+
+	// All of these expect mutex to be held
+	const Analysis *Find(const Key &key);
+	void Store(const Key &key, Analysis analysis);
+	bool IsDone(const Key &key, bool beats) const;
+	bool IsRunning(const Key &key, bool beats) const;
+	void Finish(const Job &job, const Playlist::Track &track, Analysis analysis);
+
+	BeatDetect *detector = nullptr;
+	OpenFunction openWithFlags;
+	FeaturesFunction publishFeatures;
+
+	std::size_t behind = DefaultBehind;
+	std::size_t ahead = DefaultAhead;
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+
+	Key current;
+
+	// Highest priority first
+	std::vector<Job> queue;
+	std::vector<Job> running;
+
+	// Most recently used first
+	std::list<std::pair<Key, Analysis>> cache;
+	std::map<Key, decltype(cache)::iterator> cacheIndex;
+	std::size_t cacheSize = DefaultCacheSize;
+};
@@ -0,0 +1,121 @@
+#include "BeatTimeline.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <utility>
+
+namespace {
+bool IsEarlier(const Event &left, const Event &right) {
+	return left.time < right.time;
+}
+}
+
+BeatTimeline::BeatTimeline(const EventList &events) {
+	// BeatRoot should always give us
+	// these in order, but binary searching
+	// (and counting off bars) relies on it,
+	// so make sure
+	const EventList *sorted = &events;
+
+	EventList copy;
+	if (!std::is_sorted(events.begin(), events.end(), IsEarlier)) {
+		copy = events;
+		std::stable_sort(copy.begin(), copy.end(), IsEarlier);
+		sorted = &copy;
+	}
+
+	times.reserve(sorted->size());
+	for (const auto &event : *sorted)
+		times.emplace_back(event.time);
+
+	CalculateTempos();
+	CalculateBarPositions(*sorted);
+}
+
+BeatTimeline::BeatTimeline(std::vector<double> times, std::vector<uint8_t> barPositions) :
+	times(std::move(times)),
+	barPositions(std::move(barPositions)) {
+	if (!std::is_sorted(this->times.begin(), this->times.end()))
+		std::sort(this->times.begin(), this->times.end());
+
+	this->barPositions.resize(this->times.size(), 0);
+
+	CalculateTempos();
+}
+
+std::size_t BeatTimeline::Seek(double time) const {
+	return std::upper_bound(times.begin(), times.end(), time) - times.begin();
+}
+
+std::tuple<double, double, double> BeatTimeline::GetTimeBetweenBeats() const {
+	std::tuple<double, double, double> ret = {
+		std::numeric_limits<double>::max(),
+		0.0,
+		std::numeric_limits<double>::lowest()
+	};
+
+	for (std::size_t i = 1; i < times.size(); ++i) {
+		auto delta = times[i] - times[i - 1];
+
+		if (delta < std::get<0>(ret))
+			std::get<0>(ret) = delta;
+		if (delta > std::get<2>(ret))
+			std::get<2>(ret) = delta;
+
+		std::get<1>(ret) += delta;
+	}
+
+	if (times.size() > 1)
+		std::get<1>(ret) = std::get<1>(ret) / (times.size() - 1);
+
+	return ret;
+}
+
+void BeatTimeline::CalculateTempos() {
+	tempos.resize(times.size(), 0.0f);
+
+	if (times.size() < 2)
+		return;
+
+	// The local tempo of a beat is the average of
+	// the intervals within 2 beats either side of it,
+	// which smooths out any jitter in the beat times
+	// while still following tempo changes.
+	constexpr std::size_t Window = 2;
+
+	for (std::size_t i = 0; i < times.size(); ++i) {
+		auto first = i > Window ? i - Window : 0;
+		auto last = std::min(i + Window, times.size() - 1);
+
+		if (last == first)
+			continue;
+
+		auto interval = (times[last] - times[first]) / (last - first);
+		if (interval > 0.0)
+			tempos[i] = static_cast<float>(60.0 / interval);
+	}
+}
+
+void BeatTimeline::CalculateBarPositions(const EventList &events) {
+	barPositions.resize(times.size(), 0);
+
+	if (times.size() != events.size())
+		return;
+
+	// BeatRoot doesn't know anything about bars, but
+	// interpolated beats have no salience, and downbeats
+	// tend to be the strongest onsets. So whichever of
+	// the 4 possible phases has the most salience is
+	// our best guess for where the downbeats are.
+	std::array<double, BeatsPerBar> salience{};
+	for (std::size_t i = 0; i < events.size(); ++i)
+		salience[i % BeatsPerBar] += events[i].salience;
+
+	auto phase = static_cast<std::size_t>(
+		std::max_element(salience.begin(), salience.end()) - salience.begin()
+	);
+
+	for (std::size_t i = 0; i < barPositions.size(); ++i)
+		barPositions[i] = static_cast<uint8_t>((i + BeatsPerBar - phase) % BeatsPerBar);
+}
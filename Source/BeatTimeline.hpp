@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include "Event.h"
+
+// An immutable, sorted list of beat times for a
+// single song, along with a local tempo and bar
+// position for each beat.
+//
+// Once built, a timeline is never modified, so
+// it can be handed from the analysis thread to
+// the render thread without any locking.
+class BeatTimeline {
+public:
+	// We assume 4/4, since that's what
+	// the vast majority of songs are in
+	static constexpr uint8_t BeatsPerBar = 4;
+
+	BeatTimeline(const EventList &events);
+
+	// Restores a timeline we saved earlier
+	BeatTimeline(std::vector<double> times, std::vector<uint8_t> barPositions);
+
+	// Returns the index of the first beat
+	// strictly after the given time
+	std::size_t Seek(double time) const;
+
+	std::size_t size() const { return times.size(); }
+	bool empty() const { return times.empty(); }
+
+	double GetTime(std::size_t index) const { return times[index]; }
+
+	// In beats per minute
+	float GetTempo(std::size_t index) const { return tempos[index]; }
+
+	// 0 is the downbeat
+	uint8_t GetBarPosition(std::size_t index) const { return barPositions[index]; }
+	bool IsDownbeat(std::size_t index) const { return barPositions[index] == 0; }
+
+	// Minimum, average, and maximum
+	// time between beats (in seconds)
+	std::tuple<double, double, double> GetTimeBetweenBeats() const;
+
+	const std::vector<double> &GetTimes() const { return times; }
+	const std::vector<uint8_t> &GetBarPositions() const { return barPositions; }
+
+private:
+	void CalculateTempos();
+	// events have to be in the same order as times
+	void CalculateBarPositions(const EventList &events);
+
+	// Kept separate from the annotations so
+	// binary searches stay cache friendly
+	std::vector<double> times;
+
+	std::vector<float> tempos;
+	std::vector<uint8_t> barPositions;
+};
@@ -2,7 +2,11 @@
 
 #define MULTITHREADED 1
 
-SDL_Surface *Bicubic::ResizeImage(SDL_Surface *surface, float scale) {
+namespace {
+constexpr int TileRows = 16;
+}
+
+SDL_Surface *Bicubic::ResizeImage(SDL_Surface *surface, float scale, const std::atomic<bool> &canceled) {
 	SDL_Surface *ret = SDL_CreateRGBSurfaceWithFormat(
 		surface->flags,
 		static_cast<int>(std::ceil(surface->w * scale)),
@@ -15,18 +19,14 @@ SDL_Surface *Bicubic::ResizeImage(SDL_Surface *surface, float scale) {
 
 	uint8_t *pixels = reinterpret_cast<uint8_t *>(ret->pixels);
 
-#if MULTITHREADED
-	const auto numThreads = std::max(1u, std::thread::hardware_concurrency() - 1);
-	std::vector<std::thread> threads(numThreads);
+	// Rows are handed out a tile at a time, so
+	// we can stop part way through if we have to
+	const auto tiles = (ret->h + TileRows - 1) / TileRows;
+	std::atomic<int> nextTile = 0;
 
-	for (unsigned int t = 0; t < numThreads; ++t) {
-		threads[t] = std::thread([t, numThreads, ret, pixels, surface] {
-			for (int y = static_cast<int>(t * std::ceil(static_cast<float>(ret->h) / numThreads));
-				y < (t + 1) * std::ceil(static_cast<float>(ret->h) / numThreads) && y < ret->h;
-				++y) {
-#else
-			for (int y = 0; y < ret->h; ++y) {
-#endif
+	auto work = [&] {
+		for (auto tile = nextTile++; tile < tiles && !canceled; tile = nextTile++) {
+			for (int y = tile * TileRows; y < std::min((tile + 1) * TileRows, ret->h); ++y) {
 				uint8_t *destPixel = pixels + y * ret->pitch;
 				float v = float(y) / float(ret->h - 1);
 				for (int x = 0; x < ret->w; ++x) {
@@ -40,19 +40,32 @@ SDL_Surface *Bicubic::ResizeImage(SDL_Surface *surface, float scale) {
 					destPixel += 3;
 				}
 			}
+		}
+	};
+
 #if MULTITHREADED
-		});
-	}
+	const auto numThreads = std::max(1u, std::thread::hardware_concurrency() - 1);
+	std::vector<std::thread> threads(numThreads);
+
+	for (unsigned int t = 0; t < numThreads; ++t)
+		threads[t] = std::thread(work);
 
 	for (unsigned int t = 0; t < numThreads; ++t) {
 		if (threads[t].joinable()) {
 			threads[t].join();
 		}
 	}
+#else
+	work();
 #endif
 
 	SDL_FreeSurface(surface);
 
+	if (canceled) {
+		SDL_FreeSurface(ret);
+		return nullptr;
+	}
+
 	return ret;
 }
 
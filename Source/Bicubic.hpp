@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 
 #include <SDL_image.h>
 
@@ -10,7 +11,11 @@
 // Derived from https://blog.demofox.org/2015/08/15/resizing-images-with-bicubic-interpolation/
 class Bicubic {
 public:
-	static SDL_Surface *ResizeImage(SDL_Surface *surface, float scale);
+	// This frees the surface once it's done.
+	//
+	// Returns nullptr if we were canceled part way through
+	// (which we check for between every few rows).
+	static SDL_Surface *ResizeImage(SDL_Surface *surface, float scale, const std::atomic<bool> &canceled);
 
 private:
 	// t is a value that goes from 0 to 1 to interpolate in a C1 continuous way across uniformly sampled data points.
@@ -1,6 +1,7 @@
 #include "CApp.h"
 
 #include <atlstr.h>
+#include <cstdint>
 #include <filesystem>
 #include <map>
 #include <math.h>
@@ -21,12 +22,14 @@
 
 #include "CConsole.h"
 #include "Buffer.hpp"
+#include "Canvas.hpp"
 #include "FFTLineRenderer.hpp"
 #include "FFTRenderer.hpp"
 #include "ID3V2.hpp"
 #include "MP4.hpp"
 #include "OscilloscopeRenderer.hpp"
 #include "RecordAudioStream.h"
+#include "Settings.hpp"
 
 using namespace MathsCPP;
 
@@ -73,37 +76,100 @@ DWORD CALLBACK InWasapiProc(void *buffer, DWORD length, void *user) {
 	return 1; // continue recording
 }
 
+// Fills buffer from the current song, carrying straight on
+// into the next one at the very sample the current one ends
+// on (if it's been got ready), for gapless playback.
+//
+// handoff is where in buffer the next song starts, or
+// how much we filled if it doesn't.
+DWORD PullSongs(CApp *app, void *buffer, DWORD length, DWORD &handoff) {
+	const auto handle = app->GetStreamHandle();
+
+	// Also fails if the render thread swapped
+	// the stream out from under us
+	int c = BASS_ChannelGetData(handle, buffer, length);
+	if (c < 0)
+		c = 0;
+
+	handoff = static_cast<DWORD>(c);
+
+	// At the end of the current stream, but not the _buffer_
+	if (static_cast<DWORD>(c) < length && BASS_ChannelIsActive(handle) == BASS_ACTIVE_STOPPED) {
+		// Otherwise, the render thread gets it going (or
+		// stops us) on its next loop, and it's silence
+		// until then
+		if (app->AdvanceToPrefetched(handle)) {
+			auto next = BASS_ChannelGetData(app->GetStreamHandle(), reinterpret_cast<std::uint8_t *>(buffer) + c, length - c);
+			if (next > 0)
+				c += next;
+		}
+	}
+
+	return static_cast<DWORD>(c);
+}
+
+void Scale(float *samples, std::size_t count, float gain) {
+	if (gain == 1.0f)
+		return;
+
+	for (std::size_t i = 0; i < count; ++i)
+		samples[i] *= gain;
+}
+
+void Scale(short *samples, std::size_t count, float gain) {
+	if (gain == 1.0f)
+		return;
+
+	// Anything turned up past full scale just clips
+	for (std::size_t i = 0; i < count; ++i) {
+		samples[i] = static_cast<short>(std::clamp(
+			samples[i] * gain,
+			static_cast<float>(std::numeric_limits<short>::min()),
+			static_cast<float>(std::numeric_limits<short>::max())
+		));
+	}
+}
+
 DWORD CALLBACK OutputWasapiProc(void *buffer, DWORD length, void *user) {
 	const auto app = reinterpret_cast<CApp *>(user);
 
-	int c = BASS_ChannelGetData(app->GetStreamHandle(), buffer, length);
-	if (c < 0) { // at the end of the current stream, but not the _buffer_
-		auto code = BASS_ErrorGetCode();
-		if (auto next = app->GetControls().GetPlaylist().Next()) {
-			auto extension = next->path.extension().u8string();
-			std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
-			app->Open(next->path, extension, true);
+	// Swapping the next song in switches
+	// to its gain right where it starts
+	const auto gain = app->GetOutputGain();
 
-			// Immediately start adding new samples to the buffer
-			// for gapless playback
-			c = BASS_ChannelGetData(app->GetStreamHandle(), buffer, length);
+	DWORD handoff = 0;
+	auto c = PullSongs(app, buffer, length, handoff);
 
-			// Update the UI on the next loop
-			app->AdvanceToNextTrack();
-		} else {
-			// Can't kill WASAPI from inside WASAPI,
-			// so we also have to do this on the next loop
-			app->StopExclusive();
+	// Normalize first, then the user's volume on top
+	auto volume = 1.0f;
+	if (app->GetControls().GetVolume().GetVolumeControl())
+		volume = app->GetControls().GetVolume().GetScaledVolume();
 
-			return 0;
-		}
-	}
+	auto floatBuffer = reinterpret_cast<float *>(buffer);
+	Scale(floatBuffer, handoff / sizeof(float), gain * volume);
+	Scale(floatBuffer + handoff / sizeof(float), (c - handoff) / sizeof(float), app->GetOutputGain() * volume);
 
-	if (app->GetControls().GetVolume().GetVolumeControl()) {
-		auto floatBuffer = reinterpret_cast<float *>(buffer);
-		for (auto i = 0; i < c / sizeof(float); ++i)
-			floatBuffer[i] *= app->GetControls().GetVolume().GetScaledVolume();
-	}
+	return c;
+}
+
+// Outside of exclusive mode, everything plays through the one
+// stream, so BASS never has to stop and start between songs.
+// We normalize it ourselves, same as OutputWasapiProc.
+DWORD CALLBACK OutputStreamProc(HSTREAM handle, void *buffer, DWORD length, void *user) {
+	const auto app = reinterpret_cast<CApp *>(user);
+
+	const auto gain = app->GetOutputGain();
+
+	// Coming up short just stalls it until there's more,
+	// so it's never ended and there's always somewhere
+	// for the next song to go
+	DWORD handoff = 0;
+	auto c = PullSongs(app, buffer, length, handoff);
+
+	// 16-bit, same as what it's pulling from
+	auto shortBuffer = reinterpret_cast<short *>(buffer);
+	Scale(shortBuffer, handoff / sizeof(short), gain);
+	Scale(shortBuffer + handoff / sizeof(short), (c - handoff) / sizeof(short), app->GetOutputGain());
 
 	return c;
 }
@@ -259,9 +325,19 @@ void CApp::OnInit() {
 	// OpenGL implementations (namely VBoxSVGA's)
 	SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
 
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY);
+	const auto useCompatibilityProfile = []() {
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_COMPATIBILITY);
+	};
+
+	if (Settings::settings.GetCoreProfile()) {
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	} else {
+		useCompatibilityProfile();
+	}
 
 	sdlWindow = SDL_CreateWindow(
 		"popRocks",
@@ -272,12 +348,22 @@ void CApp::OnInit() {
 		SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI
 	);
 	SDL_GLContext context = SDL_GL_CreateContext(sdlWindow);
+	if (!context && Settings::settings.GetCoreProfile()) {
+		CConsole::Console.Print(std::string("Could not create a core profile OpenGL context: ") + SDL_GetError(), MSG_ALERT);
+
+		useCompatibilityProfile();
+		context = SDL_GL_CreateContext(sdlWindow);
+	}
+
 	if (!context)
 		CConsole::Console.Print(std::string("Could not create OpenGL context: ") + SDL_GetError(), MSG_ERROR);
 
 	CConsole::Console.Print("gladLoadGL() returned " + std::to_string(gladLoadGL()), MSG_DIAG);
 	CConsole::Console.Print(std::string("OpenGL Version: ") + reinterpret_cast<const char*>(glGetString(GL_VERSION)), MSG_DIAG);
 
+	if (!Canvas::Get().OnInit())
+		CConsole::Console.Print("Could not set up the canvas, so there'll be nothing to see", MSG_ERROR);
+
 	// Prefer adaptive sync over regular vsync
 	if (SDL_GL_SetSwapInterval(-1) == -1)
 		SDL_GL_SetSwapInterval(1);
@@ -299,6 +385,22 @@ void CApp::OnInit() {
 	if (BASS_Init(device, freq, 0, 0, nullptr) != TRUE)
 		CConsole::Console.Print("Could not initialize audio device!", MSG_ERROR);
 
+	beatScheduler.OnInit(
+		&beatDetect,
+		[this](const std::filesystem::path &path, const std::string &extension, DWORD flags) {
+			return OpenWithFlags(path, extension, flags);
+		},
+		[this](std::shared_ptr<const PeakPyramid> waveform, std::optional<Loudness::Result> loudness) {
+			controls.PublishWaveform(std::move(waveform));
+
+			// If the render thread never picked up
+			// the previous loudness, it's stale anyway
+			delete publishedLoudness.exchange(
+				new std::optional<Loudness::Result>(std::move(loudness))
+			);
+		}
+	);
+
 	lightPack.OnInit();
 	albumArt.OnInit(windowWidth, windowHeight, scale);
 	renderer->OnInit(windowWidth, windowHeight);
@@ -339,7 +441,11 @@ void CApp::Listen() {
 
 	in = reinterpret_cast<double*>(fftw_malloc(sizeof(double) * bufferLength * 2));
     out = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * bufferLength * 2));
-	plan = fftw_plan_dft_r2c_1d(static_cast<int>(bufferLength * 2), in, out, FFTW_ESTIMATE);
+	{
+		// Beat detection might be planning on another thread
+		std::scoped_lock lock(BeatDetect::planMutex);
+		plan = fftw_plan_dft_r2c_1d(static_cast<int>(bufferLength * 2), in, out, FFTW_ESTIMATE);
+	}
 
 	//streamHandle = BASS_StreamCreate(48000, 2, BASS_SAMPLE_FLOAT, STREAMPROC_PUSH, NULL);
 	//listening = true;
@@ -367,16 +473,10 @@ void CApp::OnResize(int width, int height, float scale) {
 	windowHeight = height;
 	hStep = static_cast<float>(windowWidth) / bufferLength;
 
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	glOrtho(0, windowWidth, windowHeight, 0, -100.0f, 100.0f);
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
+	Canvas::Get().OnResize(windowWidth, windowHeight);
 	glViewport(0, 0, windowWidth, windowHeight);
 
-	glClearAccum(0.0, 0.0, 0.0, 1.0);
-	glClear(GL_ACCUM_BUFFER_BIT);
+	motionBlur.OnResize(windowWidth, windowHeight);
 
 	renderer->OnResize(windowWidth, windowHeight);
 	controls.OnResize(windowWidth, windowHeight, scale);
@@ -392,43 +492,99 @@ const Colour<float> &CApp::GetColor() const {
 void CApp::SetColor(float alpha) const {
 	const auto &color = GetColor();
 
-	glColor4f(color.r, color.g, color.b, alpha);
+	Canvas::Get().SetColor(color.r, color.g, color.b, alpha);
 }
 
-inline void CApp::AdvanceToNextTrack() {
+bool CApp::AdvanceToPrefetched(HSTREAM finished) {
+	auto next = prefetchedStream.exchange(0);
+	if (!next)
+		return false;
+
+	// The render thread's opened something else since we
+	// looked, and that's what the user's waiting to hear.
+	// It gave up on next when it started opening it, so
+	// it's left to us to free.
+	if (!streamHandle.compare_exchange_strong(finished, next)) {
+		BASS_StreamFree(next);
+		return false;
+	}
+
+	// Its gain starts with its first sample, too
+	outputGain = prefetchedGain.load();
+
+	// Freeing it closes its file, which
+	// the render thread can do for us
+	finishedStream = finished;
+
+	// Update the UI on the next loop
 	advanceOnNextLoop = true;
+
+	return true;
 }
 
 void CApp::OnLoop(const Delta &time) {
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 
+	UpdateLoading();
+
 	if (!fileLoaded && !listening) {
 		SwapBuffers();
 		return;
 	}
 
+	// Once we've read the tags of a folder's songs, they'll
+	// probably be in a different order. If we've barely
+	// started the song we guessed at, start over from the
+	// first one in that order. Otherwise, look again at
+	// which are around the current one.
+	constexpr static double BarelyStarted = 2.0;
+
+	auto &playlist = controls.GetPlaylist();
+	if (playlist.Update(!fileLoaded || controls.GetCurrentPosition() >= BarelyStarted)) {
+		if (auto first = playlist.Current(); first && fileLoaded && first->path != loadedFile)
+			LoadFile(first->path, true);
+		else if (fileLoaded)
+			LoadBeats(loadedFile);
+	}
+
+	if (auto fresh = publishedLoudness.exchange(nullptr)) {
+		OnLoudness(std::move(*fresh));
+		delete fresh;
+	}
+
 	if(fileLoaded) {
 		if (renderer->IsFloatingPoint()) {
 			if (controls.GetExclusiveIndicator().IsExclusive()) {
 				BASS_WASAPI_GetData(buffer, fftFlag);
 
-				// Scale back up to 100% volume
-				auto inverseVolume = controls.GetVolume().GetInverseVolume();
+				// Scale back up to 100% volume (and undo
+				// any normalization, we do our own)
+				auto inverseVolume = controls.GetVolume().GetInverseVolume() / outputGain;
 				for (auto i = 0; i < bufferLength; ++i)
 					floatBuffer[i] *= inverseVolume;
 
-			} else BASS_ChannelGetData(streamHandle, buffer, fftFlag);
+			} else {
+				BASS_ChannelGetData(outputStream, buffer, fftFlag);
+
+				// Undo any normalization, we do our own
+				Scale(floatBuffer, fftLength, 1.0f / outputGain);
+			}
 		} else {
 			if (controls.GetExclusiveIndicator().IsExclusive()) {
 				BASS_WASAPI_GetData(buffer, static_cast<DWORD>(bufferLength * sizeof(float) * channelInfo.chans));
 
 				// Scale back up to 100% volume
-				auto inverseVolume = controls.GetVolume().GetInverseVolume();
+				auto inverseVolume = controls.GetVolume().GetInverseVolume() / outputGain;
 				for (auto i = 0; i < bufferLength * channelInfo.chans; ++i)
 					shortBuffer[i] = static_cast<short>(floatBuffer[i] * inverseVolume * std::numeric_limits<short>::max());
 			}
-			else BASS_ChannelGetData(streamHandle, buffer, static_cast<DWORD>(bufferLength * sizeof(short) * channelInfo.chans));
+			else {
+				BASS_ChannelGetData(outputStream, buffer, static_cast<DWORD>(bufferLength * sizeof(short) * channelInfo.chans));
+
+				// Undo any normalization, we do our own
+				Scale(shortBuffer, bufferLength * channelInfo.chans, 1.0f / outputGain);
+			}
 		}
 	} else {
 		std::unique_lock lock(audioSink->mutex);
@@ -493,7 +649,12 @@ void CApp::OnLoop(const Delta &time) {
 	}
 	*/
 
-	if (resetGain) resetGain = false;
+	if (resetGain) {
+		resetGain = false;
+
+		// The renderer just learned its gain from this song
+		calibratedLoudness = loudness ? std::optional<double>(loudness->integrated) : std::nullopt;
+	}
 
 	//++frameCount;
 	if (rotating) {
@@ -511,20 +672,17 @@ void CApp::OnLoop(const Delta &time) {
 		}
 	}
 			
+	const auto blurring = blur && motionBlur.Begin();
+
 	renderer->Draw(time, frameCount, GetColor());
 
 	if (!shuttingDown)
 		lightPack.OnLoop((albumArt.Loaded() && !overrideColor) ? albumArt.GetColor() : visColor);
 
-	if (blur) {
-		glDisable(GL_BLEND);
-		glAccum(GL_MULT, blurIntensity);
-		glAccum(GL_ACCUM, 1 - blurIntensity);
-		glAccum(GL_RETURN, 1.0);
-		glEnable(GL_BLEND);
-	}
+	if (blurring)
+		motionBlur.End(blurIntensity);
 
-	// Draw album art OVER the accumulation buffer
+	// Draw album art OVER the blur
 	// since we don't want it getting blurry
 	albumArt.OnLoop(
 		windowWidth / 2.0f,
@@ -532,16 +690,30 @@ void CApp::OnLoop(const Delta &time) {
 		frameCount
 	);
 
-	// Render the controls over the accumulation buffer, too
-	auto elapsed = controls.OnLoop(time, streamHandle, [this](float alpha) { SetColor(alpha); });
+	// Render the controls over the blur, too. They go by
+	// what's being heard, not what's been decoded.
+	auto elapsed = controls.OnLoop(time, streamHandle, GetOutputLatency(), [this](float alpha) { SetColor(alpha); });
 
 	// If we reached the end of the song, try loading the next
 	// song in the playlist
 	if (advanceOnNextLoop) {
-		LoadFile(controls.GetPlaylist().Current()->path, true);
 		advanceOnNextLoop = false;
+
+		// The output proc's done with it
+		BASS_StreamFree(finishedStream.exchange(0));
+
+		// Unless something else has been loaded since
+		if (prefetch && prefetch->published) {
+			if (auto next = controls.GetPlaylist().Next())
+				LoadFile(next->path, true);
+		}
 	} else if (auto &cue = controls.GetPlaylist().GetCue();
-		(!controls.GetExclusiveIndicator().IsExclusive() || cue) && elapsed >= controls.GetCurrentSongLength()) {
+		// The next song's already on its way
+		!IsOpening() && (
+			(cue && elapsed >= controls.GetCurrentSongLength()) ||
+			// The output ran out with nothing to go on to
+			HasRunOut()
+		)) {
 		if (auto next = controls.GetPlaylist().Next()) {
 			CConsole::Console.Print("Reached the end of the current song and loading the next", MSG_DIAG);
 
@@ -557,18 +729,24 @@ void CApp::OnLoop(const Delta &time) {
 		}
 	}
 
-	if (stopWasapiOnNextLoop) {
-		StopExclusive(FALSE);
-		stopWasapiOnNextLoop = false;
-	}
+	UpdatePrefetch(elapsed);
+
+	if(beatDetect.OnLoop(elapsed))
+		albumArt.NextBin(true);
 
-	if(beatDetect->OnLoop(elapsed - (controls.GetExclusiveIndicator().IsExclusive() ? exclusiveBufferSize : 0)))
+	// There's nothing to prescan in listen mode, so beats
+	// come from the capture thread as they're heard.
+	// Always check, so turning detection on doesn't
+	// fire off a stale beat.
+	if (listening && !fileLoaded && audioSink->beats.OnLoop() && beatDetect.IsDetecting())
 		albumArt.NextBin(true);
 
 	SwapBuffers();
 }
 
 inline void CApp::SwapBuffers() {
+	Canvas::Get().Flush();
+
 	controls.GetFpsCounter().OnFrame();
 	SDL_GL_SwapWindow(sdlWindow);
 }
@@ -581,8 +759,18 @@ void CApp::OnDestroy() {
 		keyboardHook = nullptr;
 	}
 
-	for (auto &detector : beatDetectors)
-		detector.Cancel();
+	beatScheduler.OnDestroy();
+
+	// Anything still loading has to be done
+	// with BASS before it goes
+	CancelPrefetch();
+	loading.reset();
+	abandonedLoaders.clear();
+
+	if (outputStream) {
+		BASS_StreamFree(outputStream);
+		outputStream = 0;
+	}
 
 	if (listening) {
 		audioSink->done = true;
@@ -600,6 +788,10 @@ void CApp::OnDestroy() {
 
 	controls.OnDestroy();
 
+	motionBlur.OnDestroy();
+	Polyline::OnDestroy();
+	Canvas::Get().OnDestroy();
+
 	BASS_WASAPI_Free();
 	BASS_Free();
 	IMG_Quit();
@@ -622,14 +814,28 @@ HSTREAM CApp::OpenWithFlags(const std::filesystem::path &path, const std::string
 	return ret;
 }
 
+DWORD CApp::GetOpenFlags(bool exclusive) {
+	if (exclusive)
+		return BASS_STREAM_PRESCAN | BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT;
+
+	// We play it through outputStream ourselves
+	return BASS_STREAM_PRESCAN | BASS_STREAM_DECODE;
+}
+
 void CApp::Open(const std::filesystem::path &path, const std::string &extension, bool exclusive) {
+	Open(path, extension, OpenWithFlags(path, extension, GetOpenFlags(exclusive)), exclusive);
+}
+
+void CApp::Open(const std::filesystem::path &path, const std::string &extension, HSTREAM stream, bool exclusive) {
+	bool fellBack = false;
+
 	if (exclusive) {
 		if (wasapiInfo.freq != channelInfo.freq) {
 			if (wasapiInfo.freq != 0) StopExclusive(TRUE);
 
 			// Only swap out the handle _after_ we've stopped
 			// as StopExclusive(TRUE) frees the handle
-			streamHandle = OpenWithFlags(path, extension, BASS_STREAM_PRESCAN | BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT);
+			BASS_StreamFree(streamHandle.exchange(stream));
 
 			if (BASS_WASAPI_Init(device, channelInfo.freq, channelInfo.chans, BASS_WASAPI_BUFFER | BASS_WASAPI_EXCLUSIVE, exclusiveBufferSize, 0, OutputWasapiProc, reinterpret_cast<void *>(this)) == TRUE) {
 				BASS_WASAPI_GetInfo(&wasapiInfo);
@@ -646,8 +852,15 @@ void CApp::Open(const std::filesystem::path &path, const std::string &extension,
 				CConsole::Console.Print("Could not initialize exclusive mode! Error code " + std::to_string(BASS_ErrorGetCode()), MSG_ERROR);
 				exclusive = false;
 			}
+
+			fellBack = true;
 		} else {
-			streamHandle = OpenWithFlags(path, extension, BASS_STREAM_PRESCAN | BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT);
+			// Only ever free what we took out, since
+			// OutputWasapiProc might be swapping in
+			// the next song as we speak
+			if (auto previous = streamHandle.exchange(stream); previous != stream)
+				BASS_StreamFree(previous);
+
 			return;
 		}
 	}
@@ -655,20 +868,99 @@ void CApp::Open(const std::filesystem::path &path, const std::string &extension,
 	if (!exclusive) {
 		BASS_WASAPI_Free();
 		controls.GetExclusiveIndicator().SetExclusive(false);
-		BASS_StreamFree(streamHandle);
-		streamHandle = OpenWithFlags(path, extension, BASS_STREAM_PRESCAN);
+
+		// A stream opened for exclusive mode
+		// is floating point, so that has to
+		// be opened all over again
+		if (fellBack) {
+			BASS_StreamFree(streamHandle.exchange(0));
+			stream = OpenWithFlags(path, extension, GetOpenFlags(false));
+		}
+
+		if (auto previous = streamHandle.exchange(stream); previous != stream)
+			BASS_StreamFree(previous);
+
+		OpenOutputStream();
 	}
 }
 
-void CApp::Stop(BOOL reset) {
-	BASS_ChannelStop(streamHandle);
+void CApp::OpenOutputStream() {
+	// Songs in the same format as the last
+	// just carry on through the same stream
+	if (outputStream) {
+		BASS_CHANNELINFO info = { 0 };
+		BASS_ChannelGetInfo(outputStream, &info);
+
+		if (info.freq == channelInfo.freq && info.chans == channelInfo.chans)
+			return;
+
+		BASS_StreamFree(outputStream);
+	}
+
+	// 16-bit, same as what it's pulling from
+	outputStream = BASS_StreamCreate(channelInfo.freq, channelInfo.chans, 0, OutputStreamProc, reinterpret_cast<void *>(this));
+	if (!outputStream) {
+		CConsole::Console.Print("Could not create output stream! Error code " + std::to_string(BASS_ErrorGetCode()), MSG_ERROR);
+		return;
+	}
+}
+
+void CApp::FlushOutput() {
+	if (controls.GetExclusiveIndicator().IsExclusive() || !outputStream)
+		return;
+
+	switch (BASS_ChannelIsActive(outputStream)) {
+	case BASS_ACTIVE_PLAYING:
+	case BASS_ACTIVE_STALLED:
+		// Restarting a user stream clears its buffer
+		BASS_ChannelPlay(outputStream, TRUE);
+		break;
+	case BASS_ACTIVE_PAUSED:
+		// As does stopping it, and it'll pick
+		// up again from there when it's played
+		BASS_ChannelStop(outputStream);
+		break;
+	default:
+		break;
+	}
+}
+
+double CApp::GetOutputLatency() const {
+	if (controls.GetExclusiveIndicator().IsExclusive())
+		return exclusiveBufferSize;
+
+	if (!outputStream)
+		return 0.0;
+
+	auto buffered = BASS_ChannelGetData(outputStream, nullptr, BASS_DATA_AVAILABLE);
+	if (buffered == static_cast<DWORD>(-1))
+		return 0.0;
+
+	return BASS_ChannelBytes2Seconds(outputStream, buffered);
+}
+
+bool CApp::HasRunOut() const {
+	if (BASS_ChannelIsActive(streamHandle) != BASS_ACTIVE_STOPPED)
+		return false;
+
+	if (controls.GetExclusiveIndicator().IsExclusive())
+		return true;
 
-	if (reset == TRUE)
-		BASS_StreamFree(streamHandle);
+	// Not until we've heard the last of it
+	// (but it can wait while we're paused)
+	auto output = BASS_ChannelIsActive(outputStream);
+	return output == BASS_ACTIVE_STALLED || output == BASS_ACTIVE_STOPPED;
 }
 
-void CApp::StopExclusive() {
-	stopWasapiOnNextLoop = true;
+void CApp::Stop(BOOL reset) {
+	BASS_ChannelStop(outputStream);
+
+	if (reset == TRUE) {
+		BASS_StreamFree(outputStream);
+		outputStream = 0;
+
+		BASS_StreamFree(streamHandle.exchange(0));
+	}
 }
 
 void CApp::StopExclusive(BOOL reset) {
@@ -681,7 +973,7 @@ void CApp::StopExclusive(BOOL reset) {
 
 	if (reset == TRUE) {
 		BASS_WASAPI_Free();
-		BASS_StreamFree(streamHandle);
+		BASS_StreamFree(streamHandle.exchange(0));
 		wasapiInfo = { 0 };
 	}
 }
@@ -694,67 +986,65 @@ void CApp::Unmute() {
 	}
 }
 
-void CApp::LoadBeats(
-	HSTREAM streamHandle,
-	std::filesystem::path path // not a reference because we pass this to the callback lambda
-) {
+void CApp::LoadBeats(const std::filesystem::path &path) {
+	Playlist::Track current{ path };
+
 	// When we have a FLAC + .cue, we only
 	// want to analyze the current _song_,
 	// not the whole file
-	const auto &cue = controls.GetPlaylist().GetCue();
+	if (const auto &cue = controls.GetPlaylist().GetCue()) {
+		current.startTime = cue->GetCurrentTrack()->startTime;
+		current.length = controls.GetCurrentSongLength();
+	}
 
-	// No matter what, we're done with our _current_ detector
-	beatDetect->Reset();
+	beatScheduler.Schedule(
+		current,
+		controls.GetPlaylist().Surrounding(beatScheduler.GetBehind(), beatScheduler.GetAhead()),
+		controls.GetPlaylist().Album()
+	);
+}
 
-	auto nextDetector = (beatDetect == &beatDetectors[0] ? &beatDetectors[1] : &beatDetectors[0]);
+void CApp::OnLoudness(std::optional<Loudness::Result> loudness) {
+	// Silence doesn't tell us anything
+	if (loudness && loudness->integrated <= Loudness::Result().integrated)
+		loudness.reset();
 
-	if (nextDetector->GetState() > BeatDetect::State::Idle) {
-		auto temp = nextDetector;
+	this->loudness = std::move(loudness);
 
-		CConsole::Console.Print("Ping-ponging beat detectors", MSG_DIAG);
-		nextDetector = beatDetect;
-		beatDetect = temp;
-	} else {
-		beatDetect->OnLoad(
-			streamHandle,
-			channelInfo.freq,
-			channelInfo.chans,
-			[this, path] {
-				CConsole::Console.Print("Beat detection finished for the current song in the playlist (" + path.stem().u8string() + ")!", MSG_DIAG);
-				beatDetect->SeekTo(controls.GetCurrentPosition());
-			},
-			cue ? cue->GetCurrentTrack()->startTime : static_cast<std::optional<double>>(std::nullopt),
-			cue ? controls.GetCurrentSongLength() : static_cast<std::optional<double>>(std::nullopt)
-		);
+	if (this->loudness) {
+		// Rather than the renderer starting over (and
+		// visibly jumping), scale what it's learned by how
+		// much louder this song is than where it learned it
+		if (calibratedLoudness)
+			renderer->ScaleGain(static_cast<float>(std::pow(10.0, (this->loudness->integrated - *calibratedLoudness) / 20.0)));
+
+		calibratedLoudness = this->loudness->integrated;
 	}
 
-	if (const auto &next = const_cast<const Playlist &>(controls.GetPlaylist()).Next()) {
-		auto nextExtension = next->path.extension().u8string();
-		std::transform(nextExtension.begin(), nextExtension.end(), nextExtension.begin(), tolower);
-		auto nextHandle = OpenWithFlags(next->path, nextExtension, BASS_STREAM_PRESCAN | BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT);
-
-		BASS_CHANNELINFO nextChannelInfo;
-		BASS_ChannelGetInfo(nextHandle, &nextChannelInfo);
-
-		nextDetector->OnLoad(
-			nextHandle,
-			nextChannelInfo.freq,
-			nextChannelInfo.chans,
-			[this, next, nextDetector] {
-				if (nextDetector->IsDetecting())
-					CConsole::Console.Print("Beat detection finished for the next song in the playlist (" + next->path.stem().u8string() + ")!", MSG_DIAG);
-			},
-			next->startTime > DBL_EPSILON ? next->startTime : static_cast<std::optional<double>>(std::nullopt),
-			controls.GetNextSongLength()
-		);
+	// If the analysis only just finished, we're too far in
+	// to normalize, and this song plays as it is
+	constexpr static double LateLoudness = 2.0;
+
+	if (this->loudness && controls.GetCurrentPosition() < LateLoudness) {
+		normalizedTo = this->loudness;
+		UpdateOutputGain();
 	}
 }
 
-void CApp::ResetBeatDetection() {
-	CConsole::Console.Print("Resetting beat detectors", MSG_DIAG);
-	for (auto &detector : beatDetectors) {
-		detector.Reset();
-	}
+void CApp::UpdateOutputGain() {
+	outputGain = GetGain(normalizedTo);
+
+	// Turning normalization on or off goes
+	// for what's up next, too
+	if (prefetch)
+		prefetchedGain = GetGain(prefetch->loudness);
+}
+
+float CApp::GetGain(const std::optional<Loudness::Result> &loudness) const {
+	if (Settings::settings.GetNormalize() && loudness)
+		return static_cast<float>(loudness->GetGain(Settings::settings.GetTargetLoudness()));
+
+	return 1.0f;
 }
 
 void CApp::LoadFile(std::filesystem::path path, bool fromPlaylist) {
@@ -768,25 +1058,30 @@ void CApp::LoadFile(std::filesystem::path path, bool fromPlaylist) {
 	// the cue sheet and run beat detection
 	// on the new song
 	if (path == loadedFile) {
+		// Whatever else we were on our way to
+		// isn't happening now
+		if (loading && loading->loader->GetPath() != path)
+			AbandonLoading();
+
 		controls.LoadFromCue();
 
-		for (auto &detector : beatDetectors)
-			detector.Cancel();
+		// A new song, so full volume until we know how loud it is
+		normalizedTo.reset();
+		UpdateOutputGain();
 
-		LoadBeats(
-			OpenWithFlags(path, extension, BASS_STREAM_PRESCAN | BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT),
-			path
-		);
+		LoadBeats(path);
 
 		return;
 	}
 
-	if (!fromPlaylist) {
-		// If we're not in a playlist, _reset_
-		// any current beat detectors.
-		for (auto &detector : beatDetectors)
-			detector.Reset();
+	// Same again, but we've not opened it yet. Anywhere
+	// we were going to seek to is for a different song.
+	if (IsOpening() && path == loading->loader->GetPath()) {
+		loading->seek.reset();
+		return;
+	}
 
+	if (!fromPlaylist) {
 		if (std::filesystem::is_directory(path) || controls.GetPlaylist().IsCue(extension)) {
 			path = controls.GetPlaylist().OnLoad(
 				path,
@@ -806,103 +1101,363 @@ void CApp::LoadFile(std::filesystem::path path, bool fromPlaylist) {
 		// folder that was originally scanned
 		// for songs
 		originalPath = controls.GetPlaylist().GetPath();
-
-		// If we're in a playlist, cancel any
-		// current beat detectors
-		for (auto &detector : beatDetectors)
-			detector.Cancel();
 	}
 
-	albumArt.Reset(visColor);
-
-	overrideColor = false;
-
 	// If we try to load an image directly,
 	// use that as the album art
 	if (AlbumArt::IsSupported(extension)) {
+		// Rather than have the song we're
+		// loading replace it
+		if (IsOpening())
+			AbandonLoading();
+		else if (loading)
+			loading->loadArt = false;
+
+		albumArt.Reset(visColor);
+
+		overrideColor = false;
+
 		albumArt.Load(path, originalPath, true);
 		return;
 	}
 
-	if (fileLoaded && !controls.GetExclusiveIndicator().IsExclusive()) {
-		Stop();
-		
-		Open(path, extension, controls.GetExclusiveIndicator().IsExclusive());
+	AbandonLoading();
 
-		// Don't reset gain if we're changing songs
-		// in a playlist.
-		if (!fromPlaylist) {
-			resetGain = true;
+	loading.emplace();
+	loading->originalPath = originalPath;
+	loading->fromPlaylist = fromPlaylist;
+	loading->exclusive = controls.GetExclusiveIndicator().IsExclusive();
 
-			renderer->Reset();
-			resetGain = dynamicGain.reset;
+	if (prefetch && prefetch->loader->GetPath() == path && prefetch->exclusive == loading->exclusive) {
+		// We already got started on it, and
+		// may well have got all the way
+		loading->loader = std::move(prefetch->loader);
+
+		// Auto-advancing swaps it in from the
+		// WASAPI proc, so it's already playing
+		if (prefetch->published && !prefetchedStream.exchange(0)) {
+			loading->advanced = true;
+			loading->normalizedTo = std::move(prefetch->loudness);
 		}
+
+		auto stream = std::move(prefetch->stream);
+		auto tags = std::move(prefetch->tags);
+		prefetch.reset();
+
+		if (stream) {
+			// It's already told us why
+			if (!stream->handle) {
+				loading.reset();
+				return;
+			}
+
+			if (OnOpened(*stream) && tags) {
+				OnTagsRead(std::move(*tags));
+				loading.reset();
+			}
+		}
+	} else {
+		CancelPrefetch();
+
+		loading->loader = std::make_unique<TrackLoader>(
+			path,
+			extension,
+			GetOpenFlags(loading->exclusive),
+			[this](const std::filesystem::path &path, const std::string &extension, DWORD flags) {
+				return OpenWithFlags(path, extension, flags);
+			}
+		);
 	}
+}
 
-	// We want this as a local variable, as it's handed off to BeatDetect
-	auto streamHandle = OpenWithFlags(path, extension, BASS_STREAM_PRESCAN | BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT);
+void CApp::AbandonLoading() {
+	if (loading) {
+		loading->loader->Cancel();
+		abandonedLoaders.emplace_back(std::move(loading->loader));
+		loading.reset();
+	}
+}
 
-	if (streamHandle) {
-		BASS_ChannelGetInfo(streamHandle, &channelInfo);
+void CApp::UpdatePrefetch(double elapsed) {
+	// The output proc's just swapped it in, and
+	// we've not caught up with it yet
+	if (advanceOnNextLoop)
+		return;
+
+	const auto exclusive = controls.GetExclusiveIndicator().IsExclusive();
 
-		renderer->SetNumberOfChannels(
-			// chans is a DWORD, but I can't imagine
-			// many cases where we have > 255 channels
-			static_cast<uint8_t>(channelInfo.chans)
+	std::optional<Playlist::Track> upcoming;
+	if (fileLoaded && !listening)
+		upcoming = controls.GetPlaylist().Upcoming();
+
+	// A cue sheet's songs all come from the one
+	// file, so there's nothing to get ready
+	if (upcoming && upcoming->path == loadedFile)
+		upcoming.reset();
+
+	// What we got ready isn't what's next anymore (or
+	// it was opened for the wrong kind of playback)
+	if (prefetch && (!upcoming || upcoming->path != prefetch->loader->GetPath() || prefetch->exclusive != exclusive))
+		CancelPrefetch();
+
+	if (!prefetch) {
+		// Not until the current song's done
+		// loading, and nearly done playing
+		if (!upcoming || loading || controls.GetCurrentSongLength() - elapsed > prefetchTime)
+			return;
+
+		auto extension = upcoming->path.extension().u8string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
+
+		CConsole::Console.Print("Getting " + upcoming->path.filename().u8string() + " ready to play next", MSG_DIAG);
+
+		prefetch.emplace();
+		prefetch->exclusive = exclusive;
+		prefetch->loader = std::make_unique<TrackLoader>(
+			upcoming->path,
+			extension,
+			GetOpenFlags(exclusive),
+			[this](const std::filesystem::path &path, const std::string &extension, DWORD flags) {
+				return OpenWithFlags(path, extension, flags);
+			},
+			true
 		);
+	}
+
+	if (!prefetch->stream) {
+		prefetch->stream = prefetch->loader->TakeStream();
+		if (!prefetch->stream)
+			return;
+	}
+
+	// The output proc can carry straight on with it,
+	// so long as what it's playing through doesn't
+	// need setting up all over again to play it
+	BASS_CHANNELINFO output = { 0 };
+	if (exclusive) {
+		output.freq = wasapiInfo.freq;
+		output.chans = wasapiInfo.chans;
+	} else if (outputStream) {
+		BASS_ChannelGetInfo(outputStream, &output);
+	}
+
+	// The output proc switches to its gain right on its
+	// first sample, so keep looking for how loud it is
+	// until then
+	if (!prefetch->loudness && prefetch->stream->handle) {
+		prefetch->loudness = beatScheduler.FindLoudness(Playlist::Track{ prefetch->loader->GetPath() });
+
+		// Same as OnLoudness(), silence doesn't tell us anything
+		if (prefetch->loudness && prefetch->loudness->integrated <= Loudness::Result().integrated)
+			prefetch->loudness.reset();
+
+		prefetchedGain = GetGain(prefetch->loudness);
+	}
+
+	if (!prefetch->published &&
+		prefetch->stream->handle &&
+		prefetch->stream->info.freq == output.freq &&
+		prefetch->stream->info.chans == output.chans) {
+		prefetch->published = true;
+		prefetchedStream = prefetch->stream->handle;
+	}
+
+	if (!prefetch->tags) {
+		prefetch->tags = prefetch->loader->TakeTags();
+
+		// Same art OnTagsRead() will load
+		if (prefetch->tags) {
+			const auto &art = prefetch->tags->art;
+
+			albumArt.Prefetch(
+				prefetch->loader->GetPath(),
+				controls.GetPlaylist().GetPath(),
+				art ? art->mimeType : "",
+				art ? art->data : ""
+			);
+		}
+	}
+}
 
-		controls.OnLoad(streamHandle);
+void CApp::CancelPrefetch() {
+	if (!prefetch)
+		return;
 
-		LoadBeats(streamHandle, path);
+	// Unless the output proc's already playing
+	// it, its stream's ours to free
+	if (!prefetch->published || prefetchedStream.exchange(0)) {
+		if (prefetch->stream && prefetch->stream->handle)
+			BASS_StreamFree(prefetch->stream->handle);
+	}
 
-		// If we're loading our first file
-		// or we didn't auto-advance, explicitly
-		// open the file. Auto-advancing handles
-		// opening the file in the WASAPI proc.
-		if (!fileLoaded || !advanceOnNextLoop)
-			Open(path, extension, controls.GetExclusiveIndicator().IsExclusive());
+	albumArt.CancelPrefetch();
+
+	prefetch->loader->Cancel();
+	abandonedLoaders.emplace_back(std::move(prefetch->loader));
+	prefetch.reset();
+}
+
+void CApp::UpdateLoading() {
+	// Anything we gave up on can go once
+	// it's not going to keep us waiting
+	abandonedLoaders.erase(
+		std::remove_if(
+			abandonedLoaders.begin(),
+			abandonedLoaders.end(),
+			[](const std::unique_ptr<TrackLoader> &loader) { return loader->Done(); }
+		),
+		abandonedLoaders.end()
+	);
 
-		metadata.OnLoad(
+	if (!loading)
+		return;
+
+	if (!loading->opened) {
+		auto stream = loading->loader->TakeStream();
+		if (!stream)
+			return;
+
+		// It's already told us why
+		if (!stream->handle) {
+			loading.reset();
+			return;
+		}
+
+		if (!OnOpened(*stream))
+			return;
+	}
+
+	if (auto tags = loading->loader->TakeTags()) {
+		OnTagsRead(std::move(*tags));
+		loading.reset();
+	}
+}
+
+bool CApp::OnOpened(const TrackLoader::Stream &stream) {
+	const auto &path = loading->loader->GetPath();
+	const auto &extension = loading->loader->GetExtension();
+
+	const auto exclusive = controls.GetExclusiveIndicator().IsExclusive();
+
+	// Exclusive mode got toggled while we were opening, so
+	// we opened it the wrong way. Start over, off this thread
+	// again, and carry on with the old song until it's done.
+	if (!loading->advanced && exclusive != loading->exclusive) {
+		BASS_StreamFree(stream.handle);
+
+		auto loader = std::make_unique<TrackLoader>(
 			path,
 			extension,
-			this->streamHandle,
-			&controls,
-			&albumArt
+			GetOpenFlags(exclusive),
+			[this](const std::filesystem::path &path, const std::string &extension, DWORD flags) {
+				return OpenWithFlags(path, extension, flags);
+			}
 		);
 
+		loading->loader->Cancel();
+		abandonedLoaders.emplace_back(std::move(loading->loader));
+
+		loading->loader = std::move(loader);
+		loading->exclusive = exclusive;
+
+		return false;
+	}
+
+	loading->opened = true;
+
+	albumArt.Reset(visColor);
+
+	overrideColor = false;
+
+	auto handle = stream.handle;
+	channelInfo = stream.info;
+
+	if (!loading->advanced) {
+		// Don't reset gain if we're changing songs
+		// in a playlist. Nor if we know how loud the
+		// renderer's gain was learned at, since we
+		// can just rescale it once we know how loud
+		// this song is (see OnLoudness()).
+		if (fileLoaded && !exclusive && !loading->fromPlaylist && !calibratedLoudness) {
+			resetGain = true;
+
+			renderer->Reset();
+			resetGain = dynamicGain.reset;
+		}
+
+		Open(path, extension, handle, exclusive);
+	}
+
+	if (loading->advanced) {
+		// The output proc's already switched to its gain
+		normalizedTo = std::move(loading->normalizedTo);
+	} else {
+		// Full volume until we know how loud it is
+		normalizedTo.reset();
+		UpdateOutputGain();
+	}
+
+	renderer->SetNumberOfChannels(
+		// chans is a DWORD, but I can't imagine
+		// many cases where we have > 255 channels
+		static_cast<uint8_t>(channelInfo.chans)
+	);
+
+	// If the output proc's only just swapped it in,
+	// it might not quite have got to streamHandle yet
+	controls.OnLoad(loading->advanced ? handle : streamHandle.load());
+
+	fileLoaded = true;
+	loadedFile = path;
+	loadedFileExtension = extension;
+
+	LoadBeats(path);
+
+	// Until we have the file's own tags
+	controls.LoadFromCue();
+
+	if (controls.GetExclusiveIndicator().IsExclusive()) {
+		// Only unmute if this is the first / only song
+		if (!loading->fromPlaylist)
+			Unmute();
+
+		// Auto-advancing never _stops_ playback
+		if (!loading->advanced)
+			BASS_WASAPI_Start();
+	} else {
+		// Whatever's still buffered from the last song
+		// has to go, unless we've gone straight on to
+		// this one from it
+		BASS_ChannelPlay(outputStream, loading->advanced ? FALSE : TRUE);
+	}
+
+	if (loading->seek)
+		SeekTo(*loading->seek);
+
+	return true;
+}
+
+void CApp::OnTagsRead(TrackLoader::Tags tags) {
+	tags.LoadInto(controls);
+
+	if (loading->loadArt) {
+		if (tags.art)
+			albumArt.Load(tags.art->mimeType, std::move(tags.art->data));
+
 		// Always look for external art,
 		// in case it's higher resolution
 		// than the embedded
-		albumArt.Load(path.wstring(), originalPath);
+		albumArt.Load(loading->loader->GetPath(), loading->originalPath);
 
 		// Once we have our final art,
 		// scale it down
 		albumArt.Scale();
-
-		// If we have any tags from the cue
-		// sheet, load them _after_ everything
-		// else
-		controls.LoadFromCue();
-
-		if (controls.GetExclusiveIndicator().IsExclusive()) {
-			// Only unmute if this is the first / only song
-			if (!fromPlaylist)
-				Unmute();
-
-			// If we're loading our first file
-			// or we didn't auto-advance, explicitly
-			// start playback. Auto-advancing never
-			// _stops_ playback.
-			if (!fileLoaded || !advanceOnNextLoop)
-				BASS_WASAPI_Start();
-		} else {
-			BASS_ChannelPlay(this->streamHandle, false);
-		}
-
-		fileLoaded = true;
-		loadedFile = path;
-		loadedFileExtension = extension;
 	}
+
+	// If we have any tags from the cue
+	// sheet, load them _after_ everything
+	// else
+	controls.LoadFromCue();
 }
 
 void CApp::PlayPreparedFile() {
@@ -940,12 +1495,21 @@ void CApp::SetStrobeFrequency(Duration<Microseconds> freq) {
 
 void CApp::ToggleBlur() {
 	blur = !blur;
+
+	// Start from nothing, rather than
+	// from whenever we last blurred
+	if (blur)
+		motionBlur.Reset();
 }
 
 void CApp::SetBlurIntensity(float intensity) {
 	blurIntensity = intensity;
 }
 
+void CApp::SetHalfResolutionBlur(bool halfResolution) {
+	motionBlur.SetHalfResolution(halfResolution);
+}
+
 void CApp::Seek(double seconds) {
 	auto bytes = BASS_ChannelSeconds2Bytes(
 		streamHandle,
@@ -970,14 +1534,22 @@ void CApp::Seek(double seconds) {
 		auto code = BASS_ErrorGetCode();
 		CConsole::Console.Print("Seek failed! Error code " + std::to_string(code), MSG_ERROR);
 	} else {
+		FlushOutput();
+
 		// Refresh our times
 		controls.SetElapsedSeconds(-1);
 
-		beatDetect->SeekTo(absolute);
+		beatDetect.SeekTo(absolute);
 	}
 }
 
 void CApp::SeekTo(double seconds) {
+	// We'll get there once it's open
+	if (IsOpening()) {
+		loading->seek = seconds;
+		return;
+	}
+
 	if (BASS_ChannelSetPosition(
 			streamHandle,
 			BASS_ChannelSeconds2Bytes(
@@ -989,13 +1561,15 @@ void CApp::SeekTo(double seconds) {
 		auto code = BASS_ErrorGetCode();
 		CConsole::Console.Print("Seek failed! Error code " + std::to_string(code), MSG_ERROR);
 	} else {
+		FlushOutput();
+
 		// Refresh our times
 		controls.SetElapsedSeconds(-1);
 
 		if (auto &cue = controls.GetPlaylist().GetCue())
-			beatDetect->SeekTo(seconds - cue->GetCurrentTrack()->startTime);
+			beatDetect.SeekTo(seconds - cue->GetCurrentTrack()->startTime);
 		else
-			beatDetect->SeekTo(seconds);
+			beatDetect.SeekTo(seconds);
 	}
 }
 
@@ -1016,10 +1590,13 @@ void CApp::TogglePlaying() {
 			else
 				BASS_WASAPI_Start();
 		} else {
-			if (BASS_ChannelIsActive(streamHandle) != BASS_ACTIVE_PLAYING)
-				BASS_ChannelPlay(streamHandle, FALSE);
+			// Stalled's still playing, just waiting on
+			// the next song
+			if (auto active = BASS_ChannelIsActive(outputStream);
+				active != BASS_ACTIVE_PLAYING && active != BASS_ACTIVE_STALLED)
+				BASS_ChannelPlay(outputStream, FALSE);
 			else
-				BASS_ChannelPause(streamHandle);
+				BASS_ChannelPause(outputStream);
 		}
 	}
 }
@@ -1042,10 +1619,6 @@ void CApp::NextTrack() {
 
 void CApp::PreviousTrack() {
 	if (auto prev = controls.GetPlaylist().Previous()) {
-		// Since we have the _next_ track preloaded
-		// for beat detection, we need to reset
-		ResetBeatDetection();
-
 		LoadFile(prev->path, true);
 
 		if (prev->startTime > DBL_EPSILON)
@@ -1054,12 +1627,6 @@ void CApp::PreviousTrack() {
 }
 
 void CApp::OnMouseClicked(const Vector2i &mousePos) {
-	// Playlist::OnMouseClicked automatically advances
-	// our playlist to the clicked position, so we have
-	// to figure out what our next track is _before_
-	// that happens.
-	const auto next = const_cast<const Playlist &>(controls.GetPlaylist()).Next();
-
 	if (mousePos.y >= windowHeight - Controls::SeekbarSize * scale) {
 		double time = (static_cast<double>(mousePos.x) / windowWidth) * controls.GetCurrentSongLength();
 
@@ -1068,11 +1635,6 @@ void CApp::OnMouseClicked(const Vector2i &mousePos) {
 
 		SeekTo(time);
 	} else if (auto file = controls.GetPlaylist().OnMouseClicked(mousePos)) {
-		// If we didn't select the _next_ song in the playlist,
-		// we need to reset beat detection.
-		if (!next || file->path != next->path)
-			ResetBeatDetection();
-
 		LoadFile(file->path, true);
 
 		SeekTo(file->startTime);
@@ -1114,7 +1676,7 @@ void CApp::OnMouseClicked(const Vector2i &mousePos) {
 			BASS_WASAPI_Start();
 		} else {
 			BASS_Start();
-			BASS_ChannelPlay(streamHandle, false);
+			BASS_ChannelPlay(outputStream, false);
 		}
 	}
 }
@@ -2,7 +2,9 @@
 
 #include <iostream>
 #include <array>
+#include <atomic>
 #include <map>
+#include <memory>
 #include <vector>
 #include <optional>
 #include <thread>
@@ -20,25 +22,28 @@
 
 #include <SDL.h>
 
-#include "FFtw3.h"
+#include <fftw3.h>
 
 #include "MathCPP/Duration.hpp"
 
 #include "AlbumArt.hpp"
 #include "BeatDetect.hpp"
+#include "BeatScheduler.hpp"
 #include "CConsole.h"
 #include "ColorChangeListener.hpp"
 #include "Controls.hpp"
 #include "DynamicGain.hpp"
 #include "FPSCounter.hpp"
 #include "LightPack.hpp"
+#include "Loudness.hpp"
 #include "Mappings.h"
-#include "Metadata.hpp"
+#include "MotionBlur.hpp"
 #include "Playlist.hpp"
 #include "Polyline.hpp"
 #include "Preset.hpp"
 #include "Renderer.hpp"
 #include "Text.hpp"
+#include "TrackLoader.hpp"
 #include "Volume.hpp"
 
 using namespace MathsCPP;
@@ -93,6 +98,9 @@ public:
 	void ToggleBlur();
 	void SetBlurIntensity(float intensity);
 
+	// Keeps the blur's history at half our resolution
+	void SetHalfResolutionBlur(bool halfResolution);
+
 	void Seek(double seconds);
 
 	std::pair<int, int> GetWindowSize() { return { windowWidth, windowHeight }; }
@@ -112,11 +120,22 @@ public:
 
 	void LoadPreset(std::size_t index);
 
-	void AdvanceToNextTrack();
+	// Swaps in the next song's stream, if it's been got ready
+	// (and the output can carry on playing it as it is). Only
+	// ever call this from OutputWasapiProc or OutputStreamProc.
+	//
+	// finished is the stream the proc's been playing. If
+	// that's not current anymore, nothing's swapped in.
+	bool AdvanceToPrefetched(HSTREAM finished);
 
 	void Open(const std::filesystem::path &path, const std::string &extension, bool exclusive);
 
-	void StopExclusive();
+	// What the output procs scale by to normalize
+	// the current song (1.0 if we're not)
+	float GetOutputGain() const { return outputGain; }
+
+	// Only ever call this from the render thread
+	void UpdateOutputGain();
 
 private:
 	void AddCommands();
@@ -133,14 +152,56 @@ private:
 	inline void SwapBuffers();
 
 	HSTREAM OpenWithFlags(const std::filesystem::path &path, const std::string &extension, DWORD flags);
+
+	// What a song gets opened with to play it (exclusively or not)
+	static DWORD GetOpenFlags(bool exclusive);
+
+	// Plays stream, which should have been opened with
+	// GetOpenFlags(exclusive)
+	void Open(const std::filesystem::path &path, const std::string &extension, HSTREAM stream, bool exclusive);
+
+	// Sets up outputStream for channelInfo, unless
+	// it's already set up for the same format
+	void OpenOutputStream();
+
+	// Drops whatever outputStream has buffered,
+	// so a seek's heard straight away
+	void FlushOutput();
+
+	// How far behind streamHandle what's being heard is, in seconds
+	double GetOutputLatency() const;
+
+	// Whether we've heard the last of the current
+	// song, with nothing to go on to after it
+	bool HasRunOut() const;
+
+	// Commits whatever's come in for the song we're loading
+	void UpdateLoading();
+	// False if it has to be opened again (and we're
+	// still waiting on it)
+	bool OnOpened(const TrackLoader::Stream &stream);
+	void OnTagsRead(TrackLoader::Tags tags);
+
+	// Whether we're still waiting to play the song we're loading
+	bool IsOpening() const { return loading && !loading->opened; }
+	void AbandonLoading();
+
+	// Gets the next song ready once we're near the end of this one
+	void UpdatePrefetch(double elapsed);
+	void CancelPrefetch();
 	
 	void Stop(BOOL reset = TRUE);
 	void StopExclusive(BOOL reset);
 	
 	inline void Unmute();
 
-	inline void LoadBeats(HSTREAM streamHandle, std::filesystem::path path);
-	void ResetBeatDetection();
+	inline void LoadBeats(const std::filesystem::path &path);
+
+	// The current song's loudness, fresh from the BeatScheduler
+	void OnLoudness(std::optional<Loudness::Result> loudness);
+
+	// What to scale a song by to normalize it (1.0 if we're not)
+	float GetGain(const std::optional<Loudness::Result> &loudness) const;
 
 	int windowWidth = 1920;
 	int windowHeight = 1080;
@@ -150,9 +211,82 @@ private:
 	bool fileLoaded = false;
 	std::filesystem::path loadedFile;
 	std::string loadedFileExtension;
+
+	// The song we're loading, until its tags come in
+	struct Loading {
+		std::unique_ptr<TrackLoader> loader;
+		std::filesystem::path originalPath;
+		bool fromPlaylist = false;
+		bool exclusive = false;
+
+		// Whether the output proc already swapped
+		// it in (and it's playing) before we even
+		// started
+		bool advanced = false;
+
+		// Whether we've started playing it yet
+		bool opened = false;
+
+		// Where to start playing from, once we do
+		std::optional<double> seek;
+
+		// What the output proc normalized it to when
+		// it swapped it in, if it was advanced
+		std::optional<Loudness::Result> normalizedTo;
+
+		// False if an image got loaded over the top of it
+		bool loadArt = true;
+	};
+
+	std::optional<Loading> loading;
+
+	// The song after this one, got ready ahead of time.
+	// LoadFile() takes over whatever it's got so far.
+	struct Prefetch {
+		std::unique_ptr<TrackLoader> loader;
+		bool exclusive = false;
+
+		std::optional<TrackLoader::Stream> stream;
+		std::optional<TrackLoader::Tags> tags;
+
+		// Whether the output proc's been told about stream
+		bool published = false;
+
+		// How loud it is, if we know yet
+		std::optional<Loudness::Result> loudness;
+	};
+
+	std::optional<Prefetch> prefetch;
+
+	// How long before the end of a song we
+	// get the next one ready, in seconds
+	double prefetchTime = 10.0;
+
+	// Handed over to the output proc...
+	std::atomic<HSTREAM> prefetchedStream = 0;
+
+	// ...along with the gain to switch to
+	// on its very first sample...
+	std::atomic<float> prefetchedGain = 1.0f;
+
+	// ...and what it was playing before, for
+	// us to free once it's swapped it out
+	std::atomic<HSTREAM> finishedStream = 0;
+
+	// Loaders we gave up on, kept until their threads are
+	// done, so giving up never has to wait on them
+	std::vector<std::unique_ptr<TrackLoader>> abandonedLoaders;
+
 	int device = -1; // Default Sounddevice
 	int freq = 48000; // Sample rate (Hz)
-	HSTREAM streamHandle = NULL; // Handle for open stream
+	// Handle for open stream. The output procs swap the
+	// next song in, so only ever exchange it for another.
+	std::atomic<HSTREAM> streamHandle = 0;
+
+	// What we play streamHandle through outside of
+	// exclusive mode (see OutputStreamProc)
+	HSTREAM outputStream = 0;
+
 	BASS_CHANNELINFO channelInfo = { 0 };
 
 	uint8_t *buffer = nullptr;
@@ -200,9 +334,29 @@ private:
 	bool blur = false;
 
 	float blurIntensity = 0.88f;
+
+	MotionBlur motionBlur;
 	
 	bool resetGain = false;
 
+	// Written by the analysis threads and exchanged out by the
+	// render thread, same as BeatDetect's timelines
+	std::atomic<std::optional<Loudness::Result> *> publishedLoudness = nullptr;
+
+	// The current song's, if we know it
+	std::optional<Loudness::Result> loudness;
+
+	// What outputGain was worked out from. This only ever
+	// changes as a song starts, since a jump in volume
+	// partway through one is worse than leaving it be.
+	std::optional<Loudness::Result> normalizedTo;
+
+	// How loud the song the renderer learned its gain from
+	// was, if we know it
+	std::optional<double> calibratedLoudness;
+
+	std::atomic<float> outputGain = 1.0f;
+
 	// This config has much more aggressive normalization
 //	DynamicGain<float> dynamicGain{ 
 //		0.001f, 0.000001f, std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest(), true, true, true
@@ -224,10 +378,8 @@ private:
 
 	Controls controls;
 
-	std::array<BeatDetect, 2> beatDetectors;
-	BeatDetect *beatDetect = &beatDetectors[0];
-
-	Metadata metadata;
+	BeatDetect beatDetect;
+	BeatScheduler beatScheduler;
 
 	Polyline circleLine;
 
@@ -236,7 +388,6 @@ private:
 	std::size_t presetIndex = 0;
 
 	std::atomic<bool> advanceOnNextLoop = false;
-	std::atomic<bool> stopWasapiOnNextLoop = false;
 
 	BASS_WASAPI_INFO wasapiInfo{ 0 };
 
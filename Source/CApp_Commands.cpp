@@ -3,6 +3,7 @@
 #include "FFTLineRenderer.hpp"
 #include "OscilloscopeRenderer.hpp"
 #include "FFTRenderer.hpp"
+#include "Settings.hpp"
 
 void CApp::AddCommands() {
 	// Command template:
@@ -386,10 +387,16 @@ void CApp::AddCommands() {
 		{
 			L"blur", [&](const std::vector<std::wstring> &args) {
 				if (args.size() > 1) {
-					try {
-						SetBlurIntensity(std::stof(args[1]));
-					} catch (std::exception &e) {
-						CConsole::Console.Print(std::string("Could not set blur factor: ") + e.what(), MSG_ERROR);
+					if (args[1] == L"half") {
+						SetHalfResolutionBlur(true);
+					} else if (args[1] == L"full") {
+						SetHalfResolutionBlur(false);
+					} else {
+						try {
+							SetBlurIntensity(std::stof(args[1]));
+						} catch (std::exception &e) {
+							CConsole::Console.Print(std::string("Could not set blur factor: ") + e.what(), MSG_ERROR);
+						}
 					}
 				} else {
 					ToggleBlur();
@@ -413,20 +420,91 @@ void CApp::AddCommands() {
 		},
 		{
 			L"bpm", [&](const std::vector<std::wstring> &args) {
-				for (auto &detector : beatDetectors)
-					detector.ToggleDetection();
+				beatDetect.ToggleDetection();
+
+				// Either way, the waveform and loudness
+				// are still wanted, so just reschedule
+				if (!loadedFile.empty())
+					LoadBeats(loadedFile);
+			}
+		},
+		{
+			L"lookahead", [&](const std::vector<std::wstring> &args) {
+				if (args.size() > 1) {
+					try {
+						auto ahead = std::stoull(args[1]);
+						auto behind = args.size() > 2 ? std::stoull(args[2]) : beatScheduler.GetBehind();
 
-				if (beatDetect->IsDetecting() && !loadedFile.empty()) {
-					for (auto &detector : beatDetectors)
-						detector.Cancel();
+						beatScheduler.SetWindow(behind, ahead);
+
+						if (!loadedFile.empty())
+							LoadBeats(loadedFile);
+					} catch (std::exception &e) {
+						CConsole::Console.Print(std::string("Could not set lookahead: ") + e.what(), MSG_ERROR);
+					}
+				}
+
+				CConsole::Console.Print(
+					"Detecting beats for " +
+						std::to_string(beatScheduler.GetAhead()) +
+						" upcoming and " +
+						std::to_string(beatScheduler.GetBehind()) +
+						" previous songs",
+					MSG_DIAG
+				);
+			}
+		},
+		{
+			L"normalize", [&](const std::vector<std::wstring> &args) {
+				// No arguments toggles, a number sets
+				// the target loudness (and turns it on)
+				if (args.size() > 1) {
+					if (args[1] == L"off") {
+						Settings::settings.SetNormalize(false);
+					} else if (args[1] == L"on") {
+						Settings::settings.SetNormalize(true);
+					} else {
+						try {
+							Settings::settings.SetTargetLoudness(std::stod(args[1]));
+							Settings::settings.SetNormalize(true);
+						} catch (std::exception &e) {
+							CConsole::Console.Print(std::string("Could not set target loudness: ") + e.what(), MSG_ERROR);
+						}
+					}
+				} else {
+					Settings::settings.SetNormalize(!Settings::settings.GetNormalize());
+				}
 
-					LoadBeats(
-						OpenWithFlags(loadedFile, loadedFileExtension, BASS_STREAM_PRESCAN | BASS_STREAM_DECODE | BASS_SAMPLE_FLOAT),
-						loadedFile
+				UpdateOutputGain();
+
+				if (Settings::settings.GetNormalize()) {
+					CConsole::Console.Print(
+						"Normalizing songs to " + std::to_string(Settings::settings.GetTargetLoudness()) + " LUFS",
+						MSG_DIAG
 					);
+				} else {
+					CConsole::Console.Print("Not normalizing songs", MSG_DIAG);
 				}
 			}
 		},
+		{
+			L"prefetch", [&](const std::vector<std::wstring> &args) {
+				if (args.size() > 1) {
+					try {
+						prefetchTime = std::max(0.0, std::stod(args[1]));
+					} catch (std::exception &e) {
+						CConsole::Console.Print(std::string("Could not set prefetch time: ") + e.what(), MSG_ERROR);
+					}
+				}
+
+				CConsole::Console.Print(
+					"Getting the next song ready " +
+						std::to_string(prefetchTime) +
+						" seconds before the end of the current one",
+					MSG_DIAG
+				);
+			}
+		},
 		{
 			L"width", [&](const std::vector<std::wstring> &args) {
 				if (args.size() > 1) {
@@ -440,6 +518,27 @@ void CApp::AddCommands() {
 				}
 			}
 		},
+		{
+			L"extrude", [&](const std::vector<std::wstring> &args) {
+				if (args.size() > 1) {
+					if (args[1] == L"gpu") {
+						Polyline::SetGpuExtrusion(true);
+					} else if (args[1] == L"cpu") {
+						Polyline::SetGpuExtrusion(false);
+					} else {
+						CConsole::Console.Print("Lines can only be extruded on the gpu or the cpu", MSG_ERROR);
+						return;
+					}
+				} else {
+					Polyline::SetGpuExtrusion(!Polyline::GetGpuExtrusion());
+				}
+
+				CConsole::Console.Print(
+					std::string("Extruding lines on the ") + (Polyline::GetGpuExtrusion() ? "GPU" : "CPU"),
+					MSG_DIAG
+				);
+			}
+		},
 		{
 			L"rgb", [&](const std::vector<std::wstring> &args) {
 				lightPack.SetMethod(LightPack::Method::RGB);
@@ -8,14 +8,18 @@
 
 #include "CConsole.h"
 
+#include <codecvt>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <locale>
 
 #include "SDL.h"
 #include "Utils.hpp"
 
 CConsole CConsole::Console;
 
+#ifdef _WIN32
 // https://discourse.libsdl.org/t/detect-console-window-close-windows/20557/4
 BOOL WINAPI ConsoleHandlerRoutine(DWORD dwCtrlType) {
 	if (dwCtrlType == CTRL_CLOSE_EVENT) {
@@ -25,6 +29,7 @@ BOOL WINAPI ConsoleHandlerRoutine(DWORD dwCtrlType) {
 	}
 	return false;
 }
+#endif
 
 ///////////////////////////////////////////////////////////////
 //
@@ -43,6 +48,7 @@ CConsole::CConsole() {
 //
 ///////////////////////////////////////////////////////////////
 void CConsole::OnInit() {
+#ifdef _WIN32
 	AllocConsole();
 	AttachConsole(ATTACH_PARENT_PROCESS);
 
@@ -50,10 +56,13 @@ void CConsole::OnInit() {
 
 	in = GetStdHandle(STD_INPUT_HANDLE);
 	out = GetStdHandle(STD_OUTPUT_HANDLE);
+#endif
 
 	bufferPos = 0;
 
+#ifdef _WIN32
 	SetConsoleCtrlHandler(ConsoleHandlerRoutine, true);
+#endif
 
 	Print("CConsole::OnInit(): Console initialized", MSG_DIAG);
 }
@@ -65,7 +74,9 @@ void CConsole::OnInit() {
 //
 ///////////////////////////////////////////////////////////////
 void CConsole::OnCleanup() {
+#ifdef _WIN32
 	FreeConsole();
+#endif
 }
 
 ///////////////////////////////////////////////////////////////
@@ -76,7 +87,34 @@ void CConsole::OnCleanup() {
 //
 ///////////////////////////////////////////////////////////////
 void CConsole::Print(std::string message, unsigned messageType) {
+#ifdef _WIN32
 	Print(std::wstring(message.begin(), message.end()), messageType);
+#else
+	std::unique_lock lock(mutex, std::defer_lock);
+
+	if (!processingCommands)
+		lock.lock();
+
+	// Everywhere else, it's a plain old terminal
+	const char *color;
+	switch (messageType) {
+		case MSG_DIAG:
+			color = "\x1b[36m";
+			break;
+		case MSG_ALERT:
+			color = "\x1b[33m";
+			break;
+		case MSG_ERROR:
+			color = "\x1b[31m";
+			break;
+		case MSG_NORMAL:
+		default:
+			color = "\x1b[37m";
+			break;
+	}
+
+	std::cout << color << std::setw(2) << std::setfill('0') << SDL_GetTicks() / 1000 / 60 << ':' << std::setw(2) << std::setfill('0') << (SDL_GetTicks() / 1000)%60 << " - " << message << "\x1b[0m" << std::endl;
+#endif
 }
 
 ///////////////////////////////////////////////////////////////
@@ -87,6 +125,10 @@ void CConsole::Print(std::string message, unsigned messageType) {
 //
 ///////////////////////////////////////////////////////////////
 void CConsole::Print(std::wstring message, unsigned messageType) {
+#ifndef _WIN32
+	std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+	Print(converter.to_bytes(message), messageType);
+#else
 	std::unique_lock lock(mutex, std::defer_lock);
 
 	if (!processingCommands)
@@ -120,6 +162,7 @@ void CConsole::Print(std::wstring message, unsigned messageType) {
 	SetConsoleTextAttribute(out, WHITE);
 	WriteConsoleW(out, &writeChars[RETURN], 4, &numWritten, NULL);
 	WriteConsoleW(out, buffer, bufferPos, &numWritten, NULL);
+#endif
 }
 
 ///////////////////////////////////////////////////////////////
@@ -130,6 +173,7 @@ void CConsole::Print(std::wstring message, unsigned messageType) {
 //
 ///////////////////////////////////////////////////////////////
 void CConsole::Read(bool initial) {
+#ifdef _WIN32
 	std::unique_lock lock(mutex);
 
 	/*
@@ -210,6 +254,7 @@ void CConsole::Read(bool initial) {
 	}
 
 	delete[] records;
+#endif
 }
 
 void CConsole::AddCommands(std::map<std::wstring, Command> &&commands) {
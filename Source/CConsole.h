@@ -10,14 +10,18 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <map>
 #include <string>
 #include <sstream>
 #include <mutex>
 #include <optional>
+#include <vector>
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 
 #define BUFFERSIZE 256 /* Size of input buffer */
 
@@ -66,16 +70,20 @@ private:
 	void ProcessBuffer();
 	void ClearBuffer();
 
+#ifdef _WIN32
 	HANDLE in = nullptr;
 	HANDLE out = nullptr;
+#endif
 
 	wchar_t buffer[BUFFERSIZE] = { 0 };
 	unsigned bufferPos = 0;
 	const wchar_t *writeChars = L"\b \b\n > \r";
 
+#ifdef _WIN32
 	DWORD numEvents = 0;
 	DWORD numRead = 0;
 	DWORD numWritten = 0;
+#endif
 
 	std::map<std::wstring, Command> commands;
 
@@ -0,0 +1,473 @@
+#include "Canvas.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "MathCPP/Maths.hpp"
+
+#include "CConsole.h"
+
+using namespace MathsCPP;
+
+namespace {
+// GLSL 1.50 is as old as the 3.2 contexts we still ask for,
+// and is just as happy in a core profile
+constexpr const char *VertexShader = R"(#version 150
+
+layout(std140) uniform Frame {
+	mat4 projection;
+};
+
+in vec2 position;
+in vec2 texCoord;
+in vec4 color;
+
+out vec2 fragmentTexCoord;
+out vec4 fragmentColor;
+
+void main() {
+	fragmentTexCoord = texCoord;
+	fragmentColor = color;
+
+	gl_Position = projection * vec4(position, 0.0, 1.0);
+}
+)";
+
+constexpr const char *FragmentShader = R"(#version 150
+
+uniform sampler2D image;
+
+in vec2 fragmentTexCoord;
+in vec4 fragmentColor;
+
+out vec4 outputColor;
+
+void main() {
+	outputColor = fragmentColor * texture(image, fragmentTexCoord);
+}
+)";
+
+enum Attribute : GLuint { Position, TexCoord, Color };
+
+GLuint Compile(GLenum type, const char *source) {
+	auto shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+
+	GLint compiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+	if (!compiled) {
+		GLint length = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+
+		std::string log(std::max(length, 1), '\0');
+		glGetShaderInfoLog(shader, length, nullptr, log.data());
+
+		CConsole::Console.Print("Could not compile shader: " + log, MSG_ERROR);
+
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+const float *At(const float *data, std::size_t index, GLsizei stride) {
+	return reinterpret_cast<const float *>(reinterpret_cast<const char *>(data) + index * stride);
+}
+}
+
+GLuint Canvas::CreateProgram(
+	const char *vertexSource,
+	const char *fragmentSource,
+	std::initializer_list<std::pair<GLuint, const char *>> attributes
+) {
+	auto vertexShader = Compile(GL_VERTEX_SHADER, vertexSource);
+	auto fragmentShader = Compile(GL_FRAGMENT_SHADER, fragmentSource);
+
+	if (!vertexShader || !fragmentShader) {
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return 0;
+	}
+
+	auto ret = glCreateProgram();
+	glAttachShader(ret, vertexShader);
+	glAttachShader(ret, fragmentShader);
+
+	for (const auto &[location, name] : attributes)
+		glBindAttribLocation(ret, location, name);
+
+	glLinkProgram(ret);
+
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(ret, GL_LINK_STATUS, &linked);
+
+	if (!linked) {
+		GLint length = 0;
+		glGetProgramiv(ret, GL_INFO_LOG_LENGTH, &length);
+
+		std::string log(std::max(length, 1), '\0');
+		glGetProgramInfoLog(ret, length, nullptr, log.data());
+
+		CConsole::Console.Print("Could not link shaders: " + log, MSG_ERROR);
+
+		glDeleteProgram(ret);
+		return 0;
+	}
+
+	return ret;
+}
+
+Canvas &Canvas::Get() {
+	static Canvas canvas;
+	return canvas;
+}
+
+bool Canvas::OnInit() {
+	if (initialized)
+		return true;
+
+	GLint profile = 0;
+	glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profile);
+	core = (profile & GL_CONTEXT_CORE_PROFILE_BIT) != 0;
+
+	program = CreateProgram(
+		VertexShader,
+		FragmentShader,
+		{ { Position, "position" }, { TexCoord, "texCoord" }, { Color, "color" } }
+	);
+
+	if (!program)
+		return false;
+
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "image"), 0);
+	glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Frame"), FrameBinding);
+	glUseProgram(0);
+
+	glGenBuffers(1, &frameBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(Frame), &frame, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glGenVertexArrays(1, &vertexArray);
+	glGenBuffers(1, &vertexBuffer);
+
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+	capacity = InitialCapacity;
+	offset = 0;
+	glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+
+	glEnableVertexAttribArray(Position);
+	glVertexAttribPointer(Position, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const void *>(offsetof(Vertex, x)));
+	glEnableVertexAttribArray(TexCoord);
+	glVertexAttribPointer(TexCoord, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const void *>(offsetof(Vertex, u)));
+	glEnableVertexAttribArray(Color);
+	glVertexAttribPointer(Color, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<const void *>(offsetof(Vertex, r)));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	const std::uint8_t white[4] = { 255, 255, 255, 255 };
+
+	glGenTextures(1, &whiteTexture);
+	glBindTexture(GL_TEXTURE_2D, whiteTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	initialized = true;
+
+	CConsole::Console.Print(std::string("Drawing with a ") + (core ? "core" : "compatibility") + " profile context", MSG_DIAG);
+
+	return true;
+}
+
+void Canvas::OnDestroy() {
+	if (!initialized)
+		return;
+
+	glDeleteTextures(1, &whiteTexture);
+	glDeleteBuffers(1, &vertexBuffer);
+	glDeleteBuffers(1, &frameBuffer);
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteProgram(program);
+
+	whiteTexture = vertexBuffer = frameBuffer = vertexArray = program = 0;
+
+	vertices.clear();
+	batches.clear();
+
+	initialized = false;
+}
+
+void Canvas::OnResize(int width, int height) {
+	constexpr float zNear = -100.0f, zFar = 100.0f;
+
+	std::memset(frame.projection, 0, sizeof(frame.projection));
+
+	frame.projection[0] = 2.0f / width;
+	frame.projection[5] = -2.0f / height;
+	frame.projection[10] = -2.0f / (zFar - zNear);
+	frame.projection[12] = -1.0f;
+	frame.projection[13] = 1.0f;
+	frame.projection[14] = -(zFar + zNear) / (zFar - zNear);
+	frame.projection[15] = 1.0f;
+
+	frameChanged = true;
+}
+
+void Canvas::SetColor(float r, float g, float b, float a) {
+	color = { r, g, b, a };
+}
+
+void Canvas::Translate(float x, float y, float z) {
+	for (int row = 0; row < 4; ++row)
+		modelView[12 + row] += modelView[row] * x + modelView[4 + row] * y + modelView[8 + row] * z;
+}
+
+void Canvas::Rotate(float degrees, float x, float y, float z) {
+	// Same as glRotatef, which ignores an axis
+	// that's too short to normalise
+	auto length = std::sqrt(x * x + y * y + z * z);
+	if (length < 1e-4f)
+		return;
+
+	x /= length;
+	y /= length;
+	z /= length;
+
+	auto radians = degrees * Maths::DEG2RAD<float>;
+	auto c = std::cos(radians);
+	auto s = std::sin(radians);
+	auto t = 1.0f - c;
+
+	const float rotation[16] = {
+		t * x * x + c,		t * x * y + s * z,	t * x * z - s * y,	0.0f,
+		t * x * y - s * z,	t * y * y + c,		t * y * z + s * x,	0.0f,
+		t * x * z + s * y,	t * y * z - s * x,	t * z * z + c,		0.0f,
+		0.0f,				0.0f,				0.0f,				1.0f
+	};
+
+	auto previous = modelView;
+	for (int column = 0; column < 4; ++column) {
+		for (int row = 0; row < 4; ++row) {
+			modelView[column * 4 + row] =
+				previous[row] * rotation[column * 4] +
+				previous[4 + row] * rotation[column * 4 + 1] +
+				previous[8 + row] * rotation[column * 4 + 2] +
+				previous[12 + row] * rotation[column * 4 + 3];
+		}
+	}
+}
+
+void Canvas::LoadIdentity() {
+	modelView = {
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	};
+}
+
+void Canvas::Draw(
+	GLenum mode,
+	GLsizei count,
+	const float *positions,
+	const unsigned short *indices,
+	const float *colors
+) {
+	Append(mode, count, 0, positions, nullptr, indices, colors, 0);
+}
+
+void Canvas::DrawTextured(
+	GLenum mode,
+	GLsizei count,
+	GLuint texture,
+	const float *positions,
+	const float *texCoords,
+	const unsigned short *indices,
+	GLsizei stride
+) {
+	Append(mode, count, texture, positions, texCoords, indices, nullptr, stride);
+}
+
+void Canvas::Append(
+	GLenum mode,
+	GLsizei count,
+	GLuint texture,
+	const float *positions,
+	const float *texCoords,
+	const unsigned short *indices,
+	const float *colors,
+	GLsizei stride
+) {
+	if (!positions || count <= 0)
+		return;
+
+	if (stride == 0)
+		stride = 2 * sizeof(float);
+
+	// Strips and fans get turned into plain triangles,
+	// so they can go in the same draw as everything else
+	std::size_t triangles = 0;
+	switch (mode) {
+		case GL_TRIANGLES:
+			triangles = count / 3;
+			break;
+		case GL_TRIANGLE_STRIP:
+		case GL_TRIANGLE_FAN:
+			triangles = count >= 3 ? count - 2 : 0;
+			break;
+		default:
+			CConsole::Console.Print("Can't draw primitive mode " + std::to_string(mode), MSG_ALERT);
+			return;
+	}
+
+	if (triangles == 0)
+		return;
+
+	if (batches.empty() || batches.back().texture != texture)
+		batches.emplace_back(Batch{ texture, static_cast<GLint>(vertices.size()), 0 });
+
+	vertices.reserve(vertices.size() + triangles * 3);
+
+	const auto &m = modelView;
+
+	auto emit = [&](std::size_t i) {
+		std::size_t index = indices ? indices[i] : i;
+
+		auto position = At(positions, index, stride);
+
+		Vertex vertex;
+		vertex.x = m[0] * position[0] + m[4] * position[1] + m[12];
+		vertex.y = m[1] * position[0] + m[5] * position[1] + m[13];
+
+		if (texCoords) {
+			auto texCoord = At(texCoords, index, stride);
+			vertex.u = texCoord[0];
+			vertex.v = texCoord[1];
+		} else {
+			vertex.u = vertex.v = 0.0f;
+		}
+
+		const auto *rgba = colors ? &colors[index * 4] : color.data();
+		vertex.r = rgba[0];
+		vertex.g = rgba[1];
+		vertex.b = rgba[2];
+		vertex.a = rgba[3];
+
+		vertices.emplace_back(vertex);
+	};
+
+	for (std::size_t i = 0; i < triangles; ++i) {
+		switch (mode) {
+			case GL_TRIANGLES:
+				emit(i * 3);
+				emit(i * 3 + 1);
+				emit(i * 3 + 2);
+				break;
+			case GL_TRIANGLE_STRIP:
+				emit(i);
+				emit(i + 1);
+				emit(i + 2);
+				break;
+			case GL_TRIANGLE_FAN:
+				emit(0);
+				emit(i + 1);
+				emit(i + 2);
+				break;
+		}
+	}
+
+	batches.back().count += static_cast<GLsizei>(triangles * 3);
+}
+
+void Canvas::Flush() {
+	if (!initialized || vertices.empty()) {
+		vertices.clear();
+		batches.clear();
+		return;
+	}
+
+	const auto size = static_cast<GLsizeiptr>(vertices.size() * sizeof(Vertex));
+
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+	// Once we run out of room, hand the old storage back
+	// to the driver (it'll hang onto it for as long as the
+	// GPU's still reading it) and start over in a new one.
+	// Until then, nothing we write overlaps anything the
+	// GPU could still be drawing, so there's nothing to
+	// wait for.
+	if (offset + size > capacity) {
+		while (capacity < size)
+			capacity *= 2;
+
+		glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+		offset = 0;
+	}
+
+	auto data = glMapBufferRange(
+		GL_ARRAY_BUFFER,
+		offset,
+		size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
+	);
+
+	if (data) {
+		std::memcpy(data, vertices.data(), size);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+
+		glUseProgram(program);
+		BindFrame();
+		glActiveTexture(GL_TEXTURE0);
+
+		const auto first = static_cast<GLint>(offset / sizeof(Vertex));
+
+		for (const auto &batch : batches) {
+			glBindTexture(GL_TEXTURE_2D, batch.texture ? batch.texture : whiteTexture);
+			glDrawArrays(GL_TRIANGLES, first + batch.first, batch.count);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glUseProgram(0);
+
+		offset += size;
+	} else {
+		CConsole::Console.Print("Could not map the vertex buffer", MSG_ERROR);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+
+	vertices.clear();
+	batches.clear();
+}
+
+void Canvas::BindFrame() {
+	if (!initialized)
+		return;
+
+	if (frameChanged) {
+		glBindBuffer(GL_UNIFORM_BUFFER, frameBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Frame), &frame);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		frameChanged = false;
+	}
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FrameBinding, frameBuffer);
+}
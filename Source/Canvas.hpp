@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Everything we draw goes through here instead of the fixed-function
+// pipeline, so we run on core profile contexts (and Mesa's llvmpipe,
+// for testing without a GPU) just as well as compatibility ones.
+//
+// It keeps the same state the fixed-function pipeline did (a current
+// color and a modelview matrix) but only on our side. Every draw gets
+// transformed into one big run of triangles for the frame, which all
+// goes up in one go (into a streaming VBO that gets orphaned when it
+// fills up) and is drawn with one call per texture change.
+//
+// Anything that reads back what's been drawn (or changes a texture
+// that's already been drawn with) needs to Flush() first.
+//
+// Only ever use this from the render thread.
+class Canvas {
+public:
+	static Canvas &Get();
+
+	// Compiles and links a pair of shaders, binding any attributes
+	// to the given locations first. 0 (and the reason why in the
+	// console) if they don't compile or link.
+	static GLuint CreateProgram(
+		const char *vertexSource,
+		const char *fragmentSource,
+		std::initializer_list<std::pair<GLuint, const char *>> attributes = {}
+	);
+
+	// Call these once the context's current (and before it goes away)
+	bool OnInit();
+	void OnDestroy();
+
+	// Sets up the same projection we used to give glOrtho:
+	// (0, 0) in the top left, one unit per pixel
+	void OnResize(int width, int height);
+
+	bool IsCore() const { return core; }
+
+	// Same as their fixed-function namesakes
+	void SetColor(float r, float g, float b, float a);
+	const std::array<float, 4> &GetColor() const { return color; }
+
+	void Translate(float x, float y, float z = 0.0f);
+	void Rotate(float degrees, float x, float y, float z);
+	void LoadIdentity();
+
+	// Column-major, for anything with shaders of its own
+	const std::array<float, 16> &GetModelView() const { return modelView; }
+
+	// mode is one of GL_TRIANGLES, GL_TRIANGLE_STRIP or GL_TRIANGLE_FAN,
+	// and count is how many vertices (or indices, if there are any) to
+	// draw. colors (RGBA) is per vertex, in place of the current color.
+	void Draw(
+		GLenum mode,
+		GLsizei count,
+		const float *positions,
+		const unsigned short *indices = nullptr,
+		const float *colors = nullptr
+	);
+
+	// Tinted with the current color. stride (in bytes, like GL's) is
+	// for both positions and texCoords, so they can be interleaved.
+	void DrawTextured(
+		GLenum mode,
+		GLsizei count,
+		GLuint texture,
+		const float *positions,
+		const float *texCoords,
+		const unsigned short *indices = nullptr,
+		GLsizei stride = 0
+	);
+
+	// Actually draws everything we've been given since last time
+	void Flush();
+
+	// Binds our projection to FrameBinding, for anything with shaders
+	// of its own (that declare the same Frame block) to draw with
+	void BindFrame();
+
+	static constexpr GLuint FrameBinding = 0;
+
+private:
+	struct Vertex {
+		float x, y;
+		float u, v;
+		float r, g, b, a;
+	};
+
+	// A run of vertices that all use the same texture
+	struct Batch {
+		GLuint texture = 0;
+		GLint first = 0;
+		GLsizei count = 0;
+	};
+
+	// Laid out the same as the shaders' (std140) Frame block
+	struct Frame {
+		float projection[16];
+	};
+
+	static constexpr GLsizeiptr InitialCapacity = 1 << 20;
+
+	Canvas() = default;
+
+	void Append(
+		GLenum mode,
+		GLsizei count,
+		GLuint texture,
+		const float *positions,
+		const float *texCoords,
+		const unsigned short *indices,
+		const float *colors,
+		GLsizei stride
+	);
+
+	bool initialized = false;
+	bool core = false;
+
+	GLuint program = 0;
+	GLuint vertexArray = 0;
+	GLuint vertexBuffer = 0;
+	GLuint frameBuffer = 0;
+
+	// Stands in for "no texture", so everything can share one shader
+	GLuint whiteTexture = 0;
+
+	// Where the next frame's vertices go in vertexBuffer
+	GLsizeiptr capacity = 0;
+	GLsizeiptr offset = 0;
+
+	Frame frame = { { 0.0f } };
+	bool frameChanged = false;
+
+	std::array<float, 4> color = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	// Column-major, like GL's
+	std::array<float, 16> modelView = {
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	};
+
+	std::vector<Vertex> vertices;
+	std::vector<Batch> batches;
+};
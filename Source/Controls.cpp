@@ -1,8 +1,12 @@
 #include "Controls.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 
+#include "Canvas.hpp"
 #include "CConsole.h"
+#include "GlyphAtlas.hpp"
 
 // FIXME: KurintoSans covers a good span of Unicode characters, but not all.
 //        For example: it has all the kana, but no kanji
@@ -128,9 +132,17 @@ void Controls::LoadFromID3v1(const TAG_ID3 *id3) {
 		albumText.SetText(std::string(id3->album, id3->album + 30));
 }
 
-double Controls::OnLoop(const Delta &time, HSTREAM streamHandle, std::function<void(float)> setColor) {
+double Controls::OnLoop(const Delta &time, HSTREAM streamHandle, double latency, std::function<void(float)> setColor) {
 	AutoFader::OnLoop(time);
 
+	// Pick up a newly published waveform, if there is one
+	if (auto fresh = publishedWaveform.exchange(nullptr)) {
+		waveform = std::move(*fresh);
+		delete fresh;
+
+		builtWaveform = nullptr;
+	}
+
 	if (streamHandle) {
 		auto &cue = playlist.GetCue();
 
@@ -139,6 +151,11 @@ double Controls::OnLoop(const Delta &time, HSTREAM streamHandle, std::function<v
 			BASS_ChannelGetPosition(streamHandle, BASS_POS_BYTE)
 		);
 
+		// Just after a song's changed over, what's
+		// being heard is still the end of the last one
+		if (currentPos >= 0)
+			currentPos = std::max(currentPos - latency, 0.0);
+
 		if (cue)
 			currentPos -= cue->GetCurrentTrack()->startTime;
 
@@ -157,18 +174,19 @@ double Controls::OnLoop(const Delta &time, HSTREAM streamHandle, std::function<v
 			posRect[7] = 0;
 		}
 
-		glTranslatef(0, windowHeight - SeekbarSize * scale, 0.0f);
-
-		glVertexPointer(2, GL_FLOAT, 0, posRect);
+		auto &canvas = Canvas::Get();
 
-		glEnableClientState(GL_VERTEX_ARRAY);
+		canvas.Translate(0, windowHeight - SeekbarSize * scale);
 
-		setColor(alpha);
+		if (waveform && !waveform->GetLevel(0).empty()) {
+			DrawWaveform(pixels, setColor);
+		} else {
+			setColor(alpha);
 
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, Buffer::SquareBuffer.data());
-		glDisableClientState(GL_VERTEX_ARRAY);
+			canvas.Draw(GL_TRIANGLES, 6, posRect, Buffer::SquareBuffer.data());
+		}
 
-		glLoadIdentity();
+		canvas.LoadIdentity();
 
 		auto elapsed = static_cast<int>(currentPos);
 
@@ -186,7 +204,7 @@ double Controls::OnLoop(const Delta &time, HSTREAM streamHandle, std::function<v
 
 			auto yOffset = static_cast<int>(SeekbarSize * scale);
 
-			glColor4f(1.0f, 1.0f, 1.0f, alpha);
+			Canvas::Get().SetColor(1.0f, 1.0f, 1.0f, alpha);
 
 			elapsedText.OnLoop(
 				std::min(
@@ -272,6 +290,93 @@ double Controls::OnLoop(const Delta &time, HSTREAM streamHandle, std::function<v
 	return 0.0;
 }
 
+void Controls::PublishWaveform(std::shared_ptr<const PeakPyramid> waveform) {
+	// If the render thread never picked up
+	// the previous waveform, it's stale anyway
+	delete publishedWaveform.exchange(
+		new std::shared_ptr<const PeakPyramid>(std::move(waveform))
+	);
+}
+
+void Controls::UpdateWaveform(float height) {
+	auto length = GetCurrentSongLength();
+
+	if (builtWaveform == waveform.get() && builtWidth == windowWidth && builtHeight == height && builtLength == length)
+		return;
+
+	builtWaveform = waveform.get();
+	builtWidth = windowWidth;
+	builtHeight = height;
+	builtLength = length;
+
+	peakVertices.clear();
+	rmsVertices.clear();
+
+	if (windowWidth <= 0 || length <= 0.0)
+		return;
+
+	const auto columns = static_cast<std::size_t>(windowWidth);
+	const auto level = waveform->GetLevelFor(columns);
+	const auto &peaks = waveform->GetLevel(level);
+	const auto blockTime = waveform->GetBlockTime(level);
+
+	peakVertices.reserve(columns * 4);
+	rmsVertices.reserve(columns * 4);
+
+	const auto middle = height / 2.0f;
+
+	for (std::size_t x = 0; x < columns; ++x) {
+		// Whichever peaks fall under this column. Since the level
+		// has about as many peaks as we have columns, that's one
+		// or two of them.
+		auto first = static_cast<std::size_t>(x * length / columns / blockTime);
+		auto last = static_cast<std::size_t>(std::ceil((x + 1) * length / columns / blockTime));
+
+		first = std::min(first, peaks.size() - 1);
+		last = std::clamp(last, first + 1, peaks.size());
+
+		float min = 1.0f, max = -1.0f, sumOfSquares = 0.0f;
+		for (auto i = first; i < last; ++i) {
+			min = std::min(min, PeakPyramid::GetMin(peaks[i]));
+			max = std::max(max, PeakPyramid::GetMax(peaks[i]));
+			sumOfSquares += PeakPyramid::GetRms(peaks[i]) * PeakPyramid::GetRms(peaks[i]);
+		}
+
+		auto rms = std::min(std::sqrt(sumOfSquares / (last - first)), std::max(max, -min));
+
+		auto column = static_cast<float>(x);
+
+		peakVertices.insert(peakVertices.end(), { column, middle - max * middle, column, middle - min * middle });
+		rmsVertices.insert(rmsVertices.end(), { column, middle - rms * middle, column, middle + rms * middle });
+	}
+}
+
+void Controls::DrawWaveform(float pixels, const std::function<void(float)> &setColor) {
+	UpdateWaveform(SeekbarSize * scale);
+
+	const auto columns = static_cast<GLint>(peakVertices.size() / 4);
+	if (columns == 0)
+		return;
+
+	// Everything up to (and including) this column has been played
+	const auto played = std::clamp(static_cast<GLint>(pixels), 0, columns - 1);
+
+	auto draw = [](const std::vector<float> &vertices, GLint first, GLint count) {
+		Canvas::Get().Draw(GL_TRIANGLE_STRIP, count * 2, vertices.data() + first * 4);
+	};
+
+	setColor(alpha * 0.5f);
+	draw(peakVertices, 0, played + 1);
+	setColor(alpha);
+	draw(rmsVertices, 0, played + 1);
+
+	// What's still to come gets dimmed
+	setColor(alpha * 0.15f);
+	draw(peakVertices, played, columns - played);
+	setColor(alpha * 0.3f);
+	draw(rmsVertices, played, columns - played);
+}
+
 void Controls::SetElapsedSeconds(int elapsedSeconds) {
 	this->elapsedSeconds = elapsedSeconds;
 }
@@ -303,6 +408,9 @@ std::optional<double> Controls::GetNextSongLength() const {
 }
 
 void Controls::OnDestroy() {
+	delete publishedWaveform.exchange(nullptr);
+	waveform.reset();
+
 	albumArt->RemoveColorChangeListener(&volume);
 
 	elapsedText.OnDestroy();
@@ -314,6 +422,7 @@ void Controls::OnDestroy() {
 	volume.OnDestroy();
 	exclusiveIndicator.OnDestroy();
 
+	GlyphAtlas::Release(font);
 	TTF_CloseFont(font);
 	TTF_Quit();
 }
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <bass.h>
 #include <glad/glad.h>
@@ -18,6 +22,7 @@
 #include "Buffer.hpp"
 #include "ExclusiveIndicator.hpp"
 #include "FPSCounter.hpp"
+#include "PeakPyramid.hpp"
 #include "Playlist.hpp"
 #include "TagLoader.hpp"
 #include "Text.hpp"
@@ -37,9 +42,12 @@ public:
 	QWORD OnLoad(HSTREAM streamHandle);
 	void LoadFromCue();
 	void LoadFromTags(const std::map<std::string, std::string> &tags) override;
+	std::vector<std::string_view> GetWantedTags() const override { return { "title", "artist", "albumartist", "album" }; }
 	void LoadFromID3v1(const TAG_ID3 *id3) override;
 
-	double OnLoop(const Delta &time, HSTREAM streamHandle, std::function<void(float)> setColor);
+	// latency is how far (in seconds) what's being heard is
+	// behind streamHandle, which gets decoded ahead of it
+	double OnLoop(const Delta &time, HSTREAM streamHandle, double latency, std::function<void(float)> setColor);
 
 	void OnDestroy();
 
@@ -56,6 +64,11 @@ public:
 
 	double GetCurrentPosition() const { return currentPos; }
 
+	// Hands the current song's waveform (or null, if it doesn't
+	// have one) over to the render thread for the seekbar. Safe
+	// to call from any thread.
+	void PublishWaveform(std::shared_ptr<const PeakPyramid> waveform);
+
 	FPSCounter &GetFpsCounter() { return fpsCounter; }
 	Playlist &GetPlaylist() { return playlist; }
 	Volume &GetVolume() { return volume; }
@@ -65,6 +78,12 @@ private:
 	inline void OpenFont();
 	std::string FormatSeconds(int seconds) const;
 
+	// Only redoes the vertices when the waveform, our width
+	// or the song's length changed. Drawing is then just
+	// picking how much of them we've played.
+	void UpdateWaveform(float height);
+	void DrawWaveform(float pixels, const std::function<void(float)> &setColor);
+
 	AlbumArt * const albumArt = nullptr;
 
 	int windowWidth = 0, windowHeight = 0;
@@ -81,6 +100,19 @@ private:
 	double currentFileLength = 0.0;
 	float posRect[8] = { 0 };
 
+	// Owned by the render thread
+	std::shared_ptr<const PeakPyramid> waveform;
+	std::atomic<std::shared_ptr<const PeakPyramid> *> publishedWaveform = nullptr;
+
+	// A triangle strip each, two vertices per column
+	std::vector<float> peakVertices;
+	std::vector<float> rmsVertices;
+
+	const PeakPyramid *builtWaveform = nullptr;
+	int builtWidth = 0;
+	float builtHeight = 0.0f;
+	double builtLength = 0.0;
+
 	double currentPos = 0.0;
 	int elapsedSeconds = -1;
 
@@ -1,6 +1,6 @@
 #include "Cue.hpp"
 
-#include "Playlist.hpp"
+#include "Track.hpp"
 
 std::optional<std::filesystem::path> Cue::OnLoad(const std::filesystem::path &path) {
 	tracks.clear();
@@ -44,7 +44,7 @@ std::optional<std::filesystem::path> Cue::OnLoad(const std::filesystem::path &pa
 
 			// Some .cue files still point to the original .wav
 			// and not the compressed version.
-			const auto &supportedExtensions = Playlist::GetSupportedExtensions();
+			const auto &supportedExtensions = ::Track::GetSupportedExtensions();
 			auto iter = supportedExtensions.begin();
 			while (!std::filesystem::exists(filePath) && iter != supportedExtensions.end())
 				filePath.replace_extension(*(iter++));
@@ -76,7 +76,7 @@ std::optional<std::filesystem::path> Cue::OnLoad(const std::filesystem::path &pa
 					track.startTime = std::stoi(*split.rbegin()) / 75.0;
 
 					for (auto iter = split.rbegin() + 1; iter != split.rend(); ++iter)
-						track.startTime += (std::stoi(*iter) * std::max(1LL, (60 * (iter - split.rbegin() - 1))));
+						track.startTime += (std::stoi(*iter) * std::max<std::ptrdiff_t>(1, (60 * (iter - split.rbegin() - 1))));
 				}
 			} else if (line[0] == "TRACK") {
 				inTrackSection = true;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Canvas.hpp"
 #include "Settings.hpp"
 #include "Text.hpp"
 
@@ -17,9 +18,9 @@ public:
 		pos.y = y - text.GetSize().y / 2;
 
 		if (IsExclusive())
-			glColor4f(1.0f, 1.0f, 1.0f, alpha);
+			Canvas::Get().SetColor(1.0f, 1.0f, 1.0f, alpha);
 		else
-			glColor4f(0.5f, 0.5f, 0.5f, alpha);
+			Canvas::Get().SetColor(0.5f, 0.5f, 0.5f, alpha);
 
 		text.OnLoop(x, y - text.GetSize().y / 2);
 	}
@@ -59,17 +59,17 @@ public:
 			points[i].y = ((points[i].y - minPoint) / (maxPoint - minPoint)) * (albumArt->GetRadius() * 2) + albumArt->GetRadius() * -1;
 
 		SetColor(color, 1.0f);
-		glTranslatef(0, windowHeight / 3.0f * 2.0f, 0);
+		Canvas::Get().Translate(0, windowHeight / 3.0f * 2.0f);
 		// TODO: allow the oscilloscope / fft line to rotate
 		/*
-		glRotatef(
+		Canvas::Get().Rotate(
 			360.0f - frameCount,
 			0.0f,
 			0.0f,
 			1.0f
 		);
 		*/
-		line.SetPoints<Polyline::Join::None>(points, bufferLength);
+		line.SetPoints(points, bufferLength);
 		line.Draw();
 	}
 
@@ -156,18 +156,16 @@ void FFTRenderer::Draw(const Delta &time, float frameCount, const Colour<float>
 	//brightColor.s = 1.0;
 	auto brightRgb = Colour<float>::FromHsv(brightColor.h, brightColor.s, brightColor.v);
 
-	for (int i = 0; i < bufferLength; i++) {
-		glVertexPointer(2, GL_FLOAT, 0, &rects[i * 8]);
+	auto &canvas = Canvas::Get();
 
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glTranslatef(windowWidth / 2.0f, windowHeight / 2.0f, 0.0f);
+	for (int i = 0; i < bufferLength; i++) {
+		canvas.Translate(windowWidth / 2.0f, windowHeight / 2.0f);
 		auto angle = ((((static_cast<float>(i) / bufferLength * 360.0f) - frameCount) / distribution) * 360.0f);
-		glTranslatef(
+		canvas.Translate(
 			albumArt->GetRadius() * sin(angle * Maths::DEG2RAD<float>),
-			albumArt->GetRadius() * cos(angle * Maths::DEG2RAD<float>),
-			0.0f
+			albumArt->GetRadius() * cos(angle * Maths::DEG2RAD<float>)
 		);
-		glRotatef(
+		canvas.Rotate(
 			360.0f - angle,
 			xRot ? 1.0f : 0.0f,
 			yRot ? 1.0f : 0.0f,
@@ -177,7 +175,7 @@ void FFTRenderer::Draw(const Delta &time, float frameCount, const Colour<float>
 		fadeDecays[i].Update(time);
 
 		SetColor(color, fadeDecays[i].Get());
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indexBuffer->data());
+		canvas.Draw(GL_TRIANGLES, 6, &rects[i * 8], indexBuffer->data());
 
 		// FIXME: Rendering a _copy_ of the rectangle is not efficient
 		if (pulse && fadeDecays[i].WasReset()) {
@@ -191,12 +189,10 @@ void FFTRenderer::Draw(const Delta &time, float frameCount, const Colour<float>
 			if (fadeDecays[i].SinceLastReset() >= pulseTime)
 				fadeDecays[i].HasBeenReset();
 
-			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indexBuffer->data());
+			canvas.Draw(GL_TRIANGLES, 6, &rects[i * 8], indexBuffer->data());
 		}
 
-		glDisableClientState(GL_VERTEX_ARRAY);
-
-		glLoadIdentity();
+		canvas.LoadIdentity();
 	}
 }
 
@@ -210,6 +206,13 @@ void FFTRenderer::Reset() {
 	}
 }
 
+void FFTRenderer::ScaleGain(float factor) {
+	for (auto i = 0; i < fullBufferLength; ++i) {
+		min[i] *= factor;
+		max[i] *= factor;
+	}
+}
+
 void FFTRenderer::PrintMax() const {
 	std::stringstream stream;
 
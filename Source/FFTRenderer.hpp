@@ -47,6 +47,8 @@ public:
 
 	void Reset() override;
 
+	void ScaleGain(float factor) override;
+
 	void PrintMax() const;
 
 	void SetDistribution(float dist) { distribution = dist; }
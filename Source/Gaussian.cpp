@@ -2,6 +2,10 @@
 
 #define MULTITHREADED 1
 
+namespace {
+constexpr int TileRows = 16;
+}
+
 Gaussian::Gaussian(int kernelSize, double sigma) :
 	kernelSize(kernelSize),
 	sigma(sigma) {
@@ -21,7 +25,7 @@ Gaussian::~Gaussian() {
 	}
 }
 
-SDL_Surface *Gaussian::Blur(SDL_Surface *surface) {
+SDL_Surface *Gaussian::Blur(SDL_Surface *surface, const std::atomic<bool> &canceled) {
 	SDL_Surface *ret = SDL_CreateRGBSurfaceWithFormat(
 		surface->flags,
 		surface->w,
@@ -32,37 +36,46 @@ SDL_Surface *Gaussian::Blur(SDL_Surface *surface) {
 
 	const auto pixels = reinterpret_cast<uint8_t *>(ret->pixels);
 
-#if MULTITHREADED
-	const auto numThreads = std::max(1u, std::thread::hardware_concurrency() - 1);
-	std::vector<std::thread> threads(numThreads);
+	// Rows are handed out a tile at a time, so
+	// we can stop part way through if we have to
+	const auto tiles = (surface->h + TileRows - 1) / TileRows;
+	std::atomic<int> nextTile = 0;
 
-	for (unsigned int t = 0; t < numThreads; ++t) {
-		threads[t] = std::thread([this, t, numThreads, surface, ret, pixels] {
-			for (int row = static_cast<int>(t * std::ceil(static_cast<float>(surface->h) / numThreads));
-				row < (t + 1) * std::ceil(static_cast<float>(surface->h) / numThreads) && row < surface->h;
-				++row) {
-#else
-				for (int row = 0; row < surface->h; ++row) {
-#endif
+	auto work = [&] {
+		for (auto tile = nextTile++; tile < tiles && !canceled; tile = nextTile++) {
+			for (int row = tile * TileRows; row < std::min((tile + 1) * TileRows, surface->h); ++row) {
 				for (int col = 0; col < surface->w; ++col) {
 					for (int k = 0; k < 3; k++) {
 						pixels[row * ret->pitch + 3 * col + k] = GetPixel(surface, col, row, k);
 					}
 				}
 			}
+		}
+	};
+
 #if MULTITHREADED
-		});
-	}
+	const auto numThreads = std::max(1u, std::thread::hardware_concurrency() - 1);
+	std::vector<std::thread> threads(numThreads);
+
+	for (unsigned int t = 0; t < numThreads; ++t)
+		threads[t] = std::thread(work);
 
 	for (unsigned int t = 0; t < numThreads; ++t) {
 		if (threads[t].joinable()) {
 			threads[t].join();
 		}
 	}
+#else
+	work();
 #endif
 
 	SDL_FreeSurface(surface);
 
+	if (canceled) {
+		SDL_FreeSurface(ret);
+		return nullptr;
+	}
+
 	return ret;
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cmath>
 #include <sstream>
 
@@ -19,7 +20,11 @@ public:
 	Gaussian(int kernelSize = 3, double sigma = 1.0);
 	~Gaussian();
 
-	SDL_Surface *Blur(SDL_Surface *surface);
+	// This frees the surface once it's done.
+	//
+	// Returns nullptr if we were canceled part way through
+	// (which we check for between every few rows).
+	SDL_Surface *Blur(SDL_Surface *surface, const std::atomic<bool> &canceled);
 
 private:
 	void GenerateKernel(double **kernel);
@@ -0,0 +1,165 @@
+#include "GlyphAtlas.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "Canvas.hpp"
+
+GlyphAtlas::GlyphAtlas(TTF_Font *font) : font(font) {
+	Reset();
+}
+
+GlyphAtlas::~GlyphAtlas() {
+	glDeleteTextures(1, &texture);
+}
+
+GlyphAtlas &GlyphAtlas::Get(TTF_Font *font) {
+	auto &atlas = atlases[font];
+	if (!atlas)
+		atlas.reset(new GlyphAtlas(font));
+
+	atlas->Validate();
+
+	return *atlas;
+}
+
+void GlyphAtlas::Release(TTF_Font *font) {
+	atlases.erase(font);
+}
+
+const GlyphAtlas::Glyph &GlyphAtlas::GetGlyph(std::uint32_t codepoint) {
+	if (auto glyph = glyphs.find(codepoint); glyph != glyphs.end())
+		return glyph->second;
+
+	Glyph glyph;
+
+	int minX = 0, maxX = 0, minY = 0, maxY = 0, advance = 0;
+	if (TTF_GlyphMetrics32(font, codepoint, &minX, &maxX, &minY, &maxY, &advance) == 0) {
+		glyph.advance = advance;
+
+		if (maxX > minX && maxY > minY)
+			Rasterise(codepoint, minX, glyph);
+	}
+
+	return glyphs.emplace(codepoint, glyph).first->second;
+}
+
+int GlyphAtlas::GetKerning(std::uint32_t previous, std::uint32_t codepoint) const {
+	return TTF_GetFontKerningSizeGlyphs32(font, previous, codepoint);
+}
+
+void GlyphAtlas::Validate() {
+	if (TTF_FontHeight(font) != fontHeight || TTF_GetFontOutline(font) != outline)
+		Reset();
+}
+
+void GlyphAtlas::Reset() {
+	fontHeight = TTF_FontHeight(font);
+	outline = TTF_GetFontOutline(font);
+
+	// Anything already drawn this frame needs to
+	// get drawn before we pull its glyphs out
+	// from under it
+	if (texture)
+		Canvas::Get().Flush();
+
+	glyphs.clear();
+	shelfX = shelfY = shelfHeight = 0;
+
+	generation = nextGeneration++;
+
+	if (texture)
+		return;
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// Start out fully transparent, so the padding
+	// between glyphs really is empty
+	std::vector<std::uint8_t> empty(Size * Size * 4, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Size, Size, 0, GL_RGBA, GL_UNSIGNED_BYTE, empty.data());
+}
+
+bool GlyphAtlas::Pack(int width, int height, int &x, int &y) {
+	width += Padding;
+	height += Padding;
+
+	if (width > Size || height > Size)
+		return false;
+
+	// Start a new shelf
+	if (shelfX + width > Size) {
+		shelfX = 0;
+		shelfY += shelfHeight;
+		shelfHeight = 0;
+	}
+
+	if (shelfY + height > Size)
+		return false;
+
+	x = shelfX;
+	y = shelfY;
+
+	shelfX += width;
+	shelfHeight = std::max(shelfHeight, height);
+
+	return true;
+}
+
+void GlyphAtlas::Rasterise(std::uint32_t codepoint, int minX, Glyph &glyph) {
+	auto surface = TTF_RenderGlyph32_Blended(font, codepoint, SDL_Color{ 255, 255, 255, 255 });
+	if (!surface)
+		return;
+
+	// Blended glyphs are always 32-bit
+	if (surface->format->BytesPerPixel != 4) {
+		SDL_FreeSurface(surface);
+		return;
+	}
+
+	int x = 0, y = 0;
+	if (!Pack(surface->w, surface->h, x, y)) {
+		// Full, so start again. Everything that was
+		// using us will lay itself out again.
+		Reset();
+
+		if (!Pack(surface->w, surface->h, x, y)) {
+			SDL_FreeSurface(surface);
+			return;
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	// Rows can be padded, so tell GL how long they
+	// really are instead of flattening them first
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, surface->pitch / 4);
+	glTexSubImage2D(
+		GL_TEXTURE_2D,
+		0,
+		x, y,
+		surface->w, surface->h,
+		surface->format->Rmask == 0x000000ff ? GL_RGBA : GL_BGRA,
+		GL_UNSIGNED_BYTE,
+		surface->pixels
+	);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	// SDL_ttf shifts a glyph that hangs off to the
+	// left (e.g. italic "j") so it starts at 0
+	glyph.x = std::min(0, minX);
+	glyph.width = surface->w;
+	glyph.height = surface->h;
+
+	glyph.u0 = static_cast<float>(x) / Size;
+	glyph.v0 = static_cast<float>(y) / Size;
+	glyph.u1 = static_cast<float>(x + surface->w) / Size;
+	glyph.v1 = static_cast<float>(y + surface->h) / Size;
+
+	SDL_FreeSurface(surface);
+}
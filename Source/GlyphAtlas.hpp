@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include <SDL_ttf.h>
+#include <glad/glad.h>
+
+// Every glyph we've drawn with a font, rasterised once (in
+// white, so Text can tint it) into a texture shared by every
+// Text using that font. Laying out a string is then just
+// looking up its glyphs.
+//
+// Glyphs are packed onto shelves. When the texture fills up
+// (or the font's size or outline changes), everything gets
+// thrown out and we start again with a new generation, so
+// Texts know to lay themselves out again.
+//
+// Only ever use this from the render thread.
+class GlyphAtlas {
+public:
+	struct Glyph {
+		// Where its cell goes relative to the pen, and how big it is.
+		// Empty for glyphs with nothing to draw (e.g. spaces).
+		int x = 0;
+		int width = 0;
+		int height = 0;
+
+		float u0 = 0.0f, v0 = 0.0f;
+		float u1 = 0.0f, v1 = 0.0f;
+
+		int advance = 0;
+	};
+
+	~GlyphAtlas();
+
+	GlyphAtlas(const GlyphAtlas &) = delete;
+	GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+
+	static GlyphAtlas &Get(TTF_Font *font);
+
+	// Call this before closing a font
+	static void Release(TTF_Font *font);
+
+	// Might start a new generation, if it doesn't fit
+	const Glyph &GetGlyph(std::uint32_t codepoint);
+	int GetKerning(std::uint32_t previous, std::uint32_t codepoint) const;
+
+	GLuint GetTexture() const { return texture; }
+	std::uint64_t GetGeneration() const { return generation; }
+
+private:
+	static constexpr int Size = 1024;
+
+	// Keeps linear filtering from bleeding
+	// one glyph into the next
+	static constexpr int Padding = 1;
+
+	explicit GlyphAtlas(TTF_Font *font);
+
+	// Starts again if the font's changed since we last looked
+	void Validate();
+	void Reset();
+
+	bool Pack(int width, int height, int &x, int &y);
+	void Rasterise(std::uint32_t codepoint, int minX, Glyph &glyph);
+
+	TTF_Font *font = nullptr;
+	int fontHeight = 0;
+	int outline = 0;
+
+	GLuint texture = 0;
+
+	std::unordered_map<std::uint32_t, Glyph> glyphs;
+
+	int shelfX = 0;
+	int shelfY = 0;
+	int shelfHeight = 0;
+
+	std::uint64_t generation = 0;
+	static inline std::uint64_t nextGeneration = 1;
+
+	static inline std::unordered_map<TTF_Font *, std::unique_ptr<GlyphAtlas>> atlases;
+};
@@ -1,241 +1,53 @@
 #include "ID3V2.hpp"
 
-#include "CConsole.h"
-#include "Utils.hpp"
-
-// ===============================================
-// ================ ID3V2::Header ================
-// ===============================================
-ID3V2::Header::Header(ID3V2 &parent) : parent(parent) {
-
-}
-
-ID3V2::ExtendedHeader *ID3V2::Header::Read(const char **tag) {
-	auto *start = *tag;
-
-	memcpy(id, *tag, sizeof(id));
-	*tag += sizeof(id);
-
-	majorVersion = **tag;
-	*tag += sizeof(majorVersion);
-
-	parent.frameIdBytes = parent.frameSizeBytes = (majorVersion == 2 ? 3 : 4);
-
-	revisionNumber = **tag;
-	*tag += sizeof(revisionNumber);
-
-	flags = **tag;
-	*tag += sizeof(flags);
-
-	size = *reinterpret_cast<const uint32_t *>(*tag);
-	Fix32Bit(&size);
-	*tag += sizeof(size);
-
-	parent.currentOffset += (*tag - start);
-
-	return HasExtendedHeader() ? new ExtendedHeader() : nullptr;
-}
-
-bool ID3V2::Header::HasExtendedHeader() const {
-	auto ret = flags & 0x40;
-	if (ret) throw std::runtime_error("extended headers not yet supported");
-	return ret;
-}
-
-// ===============================================
-// ================= ID3V2::Art ==================
-// ===============================================
-ID3V2::Art::Art(ID3V2::Frame &parent) : parent(parent) {
-
-}
-
-ID3V2::Art::~Art() {
-	delete[] data;
-}
-
-bool ID3V2::Art::Read(const char **tag) {
-	auto *start = *tag;
-
-	parent.ReadEncoding(tag, &textEncoding);
-
-	// MIME types were added in v3
-	if (parent.parent.header.majorVersion > 2) {
-		// This one's null terminated, so it can
-		// implicitly be converted to a std::string
-		mimeType = *tag;
-		*tag += mimeType.size() + 1;
-	} else {
-		// We'll convert the 3-letter v2 format
-		// to a MIME type
-		mimeType = "image/";
-
-		if ((*tag)[0] == 'P' && (*tag)[1] == 'N' && (*tag)[2] == 'G')
-			mimeType += "png";
-		else if ((*tag)[0] == 'J' && (*tag)[1] == 'P' && (*tag)[2] == 'G')
-			mimeType += "jpeg";
-
-		*tag += 3;
-	}
-
-	type = static_cast<Type>(**tag);
-	*tag += sizeof(type);
-
-	// This one's also null terminated
-	description = *tag;
-
-	// Even when the encoding is Latin, there's
-	// sometimes a double terminator
-	while ((*tag)[0] == '\0')
-		*tag += 1;
-
-	auto offset = static_cast<uint32_t>(*tag - start);
-	dataLength = parent.size - offset;
-
-	data = new uint8_t[dataLength];
-	memcpy(data, *tag, dataLength);
-	
-	parent.size -= offset;
-	parent.parent.currentOffset += offset;
-
-	return true;
-}
-
-// ===============================================
-// ================ ID3V2::Frame =================
-// ===============================================
-ID3V2::Frame::Frame(ID3V2 &parent) : parent(parent) {
-
-}
-
-ID3V2::Frame::Frame(Frame &&other) noexcept : parent(std::move(other.parent)) {
-	id = std::move(other.id);
-	size = std::move(other.size);
-	flags = std::move(other.flags);
-	data = std::move(other.data);
-	other.data = nullptr;
-	textData = std::move(other.textData);
-	artData = std::move(other.artData);
-	other.artData = nullptr; // null out to prevent deletion on destruction
-	encoding = std::move(other.encoding);
-}
-
-ID3V2::Frame::~Frame() {
-	delete[] data;
-	delete artData;
-}
+#include <algorithm>
+#include <cmath>
+#include <codecvt>
+#include <locale>
+#include <sstream>
 
-bool ID3V2::Frame::Read(const char **tag, bool textOnly) {
-	bool ret = false;
-
-	auto *start = *tag;
-
-	uint8_t idChars[4];
-	memcpy(idChars, *tag, parent.frameIdBytes);
-	*tag += parent.frameIdBytes;
-
-	id = std::string(idChars, idChars + parent.frameIdBytes);
-
-	size = *reinterpret_cast<const uint32_t *>(*tag);
-
-	// Fix BEFORE possible shift
-	Fix32Bit(&size, parent.header.majorVersion >= 4); // no synch bits in versions below 4
-
-	// Versions lower than 3 only have a 3-byte size
-	if (parent.header.majorVersion < 3)
-		size >>= 8;
-	
-	*tag += parent.frameSizeBytes;
-
-	// Flags were introduced in version 3
-	if (parent.header.majorVersion > 2) {
-		flags = *reinterpret_cast<const uint16_t *>(*tag);
-		*tag += sizeof(flags);
-	}
-
-	// Only allocate data if it's a frame we care about
-	if (RelevantFrames.find(id) != RelevantFrames.end()) {
-		// Text has an encoding byte
-		if (id[0] == 'T') {
-			ReadEncoding(tag);
-
-			textData = ToUTF8(*tag, size, encoding);
-		} else if (!textOnly && id == "APIC" || id == "PIC") {
-			artData = new Art(*this);
-			if (!artData->Read(tag)) {
-				delete artData;
-				artData = nullptr;
-			}
-		}
-
-		ret = true;
-	}
-
-	*tag += size;
+#include "Utils.hpp"
 
-	parent.currentOffset += (*tag - start);
+namespace {
+// Big Endian, and (if synchsafe) only the low 7 bits of each byte
+uint32_t ReadSize(const uint8_t *bytes, std::size_t count, bool synchsafe) {
+	uint32_t ret = 0;
+	for (std::size_t i = 0; i < count; ++i)
+		ret = synchsafe ? (ret << 7) | (bytes[i] & 0x7F) : (ret << 8) | bytes[i];
 
 	return ret;
 }
 
-void ID3V2::Frame::ReadEncoding(const char **tag, Encoding *encoding) {
-	if (encoding) {
-		*encoding = static_cast<Encoding>(**tag);
-	} else {
-		this->encoding = static_cast<Encoding>(**tag);
-		size -= 1;
-	}
-
-	*tag += 1;
+// Frame IDs to the friendly names we use for them
+const std::map<std::string_view, std::string_view> RelevantFrames = {
+	// v2
+	{ "TP1", "artist" },		// Lead artist(s)/Lead performer(s)/Soloist(s)/Performing group
+	{ "TAL", "album" },			// Album/Movie/Show title
+	{ "TT2", "title" },			// Title/Songname/Content description
+	{ "PIC", "art" },			// Attached picture
+	{ "TPA", "discnumber" },	// Part of a set
+	{ "TRK", "tracknumber" },	// Track number/Position in set
+	// v3
+	{ "TALB", "album" },		// [#TALB Album/Movie/Show title]
+	{ "TIT2", "title" },		// [#TIT2 Title/songname/content description]
+	{ "TPE1", "artist" },		// [#TPE1 Lead performer(s)/Soloist(s)]
+	{ "APIC", "art" },			// [#sec4.15 Attached picture]
+	{ "TPOS", "discnumber" },	// [#TPOS Part of a set]
+	{ "TRCK", "tracknumber" }	// [#TRCK Track number/Position in set]
+};
 }
 
 // ===============================================
 // ==================== ID3V2 ====================
 // ===============================================
-ID3V2::ID3V2() : header(*this) {
-
-}
-
-ID3V2::~ID3V2() {
-	delete extendedHeader;
-}
-
-std::map<std::string, std::string> ID3V2::Read(const char **tag, bool textOnly) {
-	std::map<std::string, std::string> ret;
-
-	extendedHeader = header.Read(tag);
-	while (currentOffset < header.size) {
-		Frame frame(*this);
-		if (frame.Read(tag, textOnly)) {
-			auto &[friendlyName, mutator] = Frame::RelevantFrames.at(frame.id);
-			ret.emplace(std::make_pair(friendlyName, mutator(frame.textData)));
-			frames.emplace(std::make_pair(friendlyName, std::move(frame)));
-		} else {
-			if (frame.id.empty() || frame.id[0] == '\0') // we hit padding
-				break;
-
-			CConsole::Console.Print("Skipping frame " + frame.id, MSG_DIAG);
-		}
-	}
+std::size_t ID3V2::GetTagSize(const char *header) {
+	if (std::string_view(header, 3) != "ID3")
+		return 0;
 
-	return ret;
-}
+	auto bytes = reinterpret_cast<const uint8_t *>(header);
 
-void ID3V2::Fix32Bit(uint32_t *num, bool unsynch) {
-	// Big Endian to Little Endian
-	*num =
-		((*num & 0xFF000000) >> 24) |
-		((*num & 0x00FF0000) >> 8) |
-		((*num & 0x0000FF00) << 8) |
-		((*num & 0x000000FF) << 24);
-
-	if (unsynch) {
-		// Mask and shift out the synch bits
-		*num =
-			((*num & 0x7F000000) >> 3) |
-			((*num & 0x007F0000) >> 2) |
-			((*num & 0x00007F00) >> 1) |
-			((*num & 0x0000007F));
-	}
+	// A footer is just a copy of the header, at the end
+	return HeaderSize + ReadSize(bytes + 6, 4, true) + ((bytes[5] & 0x10) ? HeaderSize : 0);
 }
 
 std::string ID3V2::ToUTF8(const char *tag, uint32_t size, Encoding encoding) {
@@ -336,4 +148,196 @@ std::string ID3V2::ToUTF8(const char *tag, uint32_t size, Encoding encoding) {
 
 		return ret;
 	}
-}
\ No newline at end of file
+}
+
+// ===============================================
+// ================= ID3V2::View =================
+// ===============================================
+ID3V2::View::View(std::string_view tag) {
+	if (tag.size() < HeaderSize || !GetTagSize(tag.data()))
+		return;
+
+	auto bytes = reinterpret_cast<const uint8_t *>(tag.data());
+
+	majorVersion = bytes[3];
+	if (majorVersion < 2 || majorVersion > 4)
+		return;
+
+	auto flags = bytes[5];
+
+	std::size_t offset = HeaderSize;
+	auto end = std::min<std::size_t>(HeaderSize + ReadSize(bytes + 6, 4, true), tag.size());
+
+	// We don't need anything from these, so skip them
+	if (majorVersion > 2 && (flags & 0x40)) {
+		if (end - offset < 4)
+			return;
+
+		// v3's size doesn't count itself, v4's does
+		std::size_t extendedSize = majorVersion == 4 ?
+			ReadSize(bytes + offset, 4, true) :
+			ReadSize(bytes + offset, 4, false) + 4;
+
+		if (extendedSize > end - offset)
+			return;
+
+		offset += extendedSize;
+	}
+
+	// v2 has a 3-byte ID and size, and no flags
+	std::size_t idBytes = majorVersion == 2 ? 3 : 4;
+	std::size_t headerBytes = majorVersion == 2 ? 6 : 10;
+
+	while (end - offset >= headerBytes) {
+		auto id = tag.substr(offset, idBytes);
+
+		// We hit padding
+		if (id[0] == '\0')
+			break;
+
+		// No synch bits in versions below 4
+		std::size_t size = ReadSize(bytes + offset + idBytes, idBytes, majorVersion >= 4);
+
+		offset += headerBytes;
+		if (size > end - offset)
+			break;
+
+		auto body = tag.substr(offset, size);
+		offset += size;
+
+		auto relevant = RelevantFrames.find(id);
+		if (relevant == RelevantFrames.end() || body.empty())
+			continue;
+
+		auto name = relevant->second;
+		if (GetFrame(name))
+			continue;
+
+		frames.emplace_back(View::Frame{ id, name, static_cast<Encoding>(body[0]), body.substr(1) });
+	}
+
+	valid = true;
+}
+
+const ID3V2::View::Frame *ID3V2::View::GetFrame(std::string_view name) const {
+	for (const auto &frame : frames) {
+		if (frame.name == name)
+			return &frame;
+	}
+
+	return nullptr;
+}
+
+std::optional<std::string> ID3V2::View::GetText(std::string_view name) const {
+	auto frame = GetFrame(name);
+	if (!frame || frame->id[0] != 'T')
+		return std::nullopt;
+
+	auto ret = Decode(*frame);
+
+	// TRK / TRCK can be fractional (e.g. 01/08)
+	// but we only care about the numerator
+	if (name == "tracknumber") {
+		if (auto slash = ret.find('/'); slash != std::string::npos)
+			ret.erase(slash);
+	}
+
+	return ret;
+}
+
+std::map<std::string, std::string> ID3V2::View::GetTags() const {
+	std::map<std::string, std::string> ret;
+
+	for (const auto &frame : frames) {
+		if (auto text = GetText(frame.name))
+			ret.emplace(std::string(frame.name), std::move(*text));
+	}
+
+	return ret;
+}
+
+std::map<std::string, std::string> ID3V2::View::GetTags(const std::vector<std::string_view> &names) const {
+	if (names.empty())
+		return GetTags();
+
+	std::map<std::string, std::string> ret;
+
+	for (const auto &name : names) {
+		if (auto text = GetText(name))
+			ret.emplace(std::string(name), std::move(*text));
+	}
+
+	return ret;
+}
+
+std::optional<ID3V2::View::Picture> ID3V2::View::GetPicture() const {
+	auto frame = GetFrame("art");
+	if (!frame)
+		return std::nullopt;
+
+	Picture ret;
+	auto body = frame->body;
+
+	// MIME types were added in v3. Before that,
+	// it's a 3-letter format.
+	if (majorVersion > 2) {
+		auto terminator = body.find('\0');
+		if (terminator == std::string_view::npos)
+			return std::nullopt;
+
+		ret.mimeType = body.substr(0, terminator);
+		body.remove_prefix(terminator + 1);
+	} else {
+		if (body.size() < 3)
+			return std::nullopt;
+
+		if (body.substr(0, 3) == "PNG")
+			ret.mimeType = "image/png";
+		else if (body.substr(0, 3) == "JPG")
+			ret.mimeType = "image/jpeg";
+		else
+			ret.mimeType = "image/";
+
+		body.remove_prefix(3);
+	}
+
+	if (body.empty())
+		return std::nullopt;
+
+	ret.type = static_cast<Picture::Type>(body[0]);
+	body.remove_prefix(1);
+
+	// The description's terminator is as wide as its characters
+	if (frame->encoding == Encoding::UTF_16 || frame->encoding == Encoding::UTF_16_BE) {
+		std::size_t i = 0;
+		while (i + 1 < body.size() && (body[i] != '\0' || body[i + 1] != '\0'))
+			i += 2;
+
+		if (i + 1 >= body.size())
+			return std::nullopt;
+
+		body.remove_prefix(i + 2);
+	} else {
+		auto terminator = body.find('\0');
+		if (terminator == std::string_view::npos)
+			return std::nullopt;
+
+		body.remove_prefix(terminator + 1);
+	}
+
+	if (body.empty())
+		return std::nullopt;
+
+	ret.data = body;
+
+	return ret;
+}
+
+std::string ID3V2::View::Decode(const Frame &frame) {
+	// Latin and UTF-8 need nothing more than a copy,
+	// up to the terminator (if there is one)
+	if (frame.encoding == Encoding::Latin || frame.encoding == Encoding::UTF_8)
+		return std::string(frame.body.substr(0, frame.body.find('\0')));
+
+	return ToUTF8(frame.body.data(), static_cast<uint32_t>(frame.body.size()), frame.encoding);
+}
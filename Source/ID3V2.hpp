@@ -1,9 +1,11 @@
 #pragma once
 
-#include <codecvt>
-#include <functional>
-#include <locale>
+#include <cstdint>
 #include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "Utils.hpp"
 
@@ -17,158 +19,90 @@ public:
 		UTF_8		// no BOM
 	};
 
-	class ExtendedHeader {
-		// TODO: Does BASS already exclude this by default?
-		//       Given there's a BASS_TAG_ID3V2_2	tag, that's
-		//       my assumption.
-	};
-
-	class Header {
+	// Reads the frames we care about in place. Nothing gets copied
+	// out of the tag, text only gets decoded when it's asked for,
+	// and a picture is just a span of the tag that can go straight
+	// to the image decoder.
+	//
+	// The tag has to outlive the view.
+	class View {
 	public:
-		char id[3] = { 0 };
-		uint8_t majorVersion = 0;
-		uint8_t revisionNumber = 0;
-		uint8_t flags = 0;
-		uint32_t size = 0;
-
-		Header(ID3V2 &parent);
-
-		// Can't memcpy into the struct
-		// due to alignment
-		ExtendedHeader *Read(const char **tag);
-
-		bool HasExtendedHeader() const;
-
-	private:
-		ID3V2 &parent;
-	};
-
-	// Forward declare Frame to avoid circular dependency
-	class Frame;
-
-	class Art {
-	public:
-		enum class Type : uint8_t {
-			Other				=	0x00,
-			FileIcon			=	0x01,
-			OtherFileIcon		=	0x02,
-			CoverFront			=	0x03,
-			CoverBack			=	0x04,
-			Leaflet				=	0x05,
-			Media				=	0x06,
-			LeadArtist			=	0x07,
-			Artist				=	0x08,
-			Conductor			=	0x09,
-			Band				=	0x0A,
-			Composer			=	0x0B,
-			Lyricist			=	0x0C,
-			RecordingLocation	=	0x0D,
-			DuringRecording		=	0x0E,
-			DuringPerformance	=	0x0F,
-			ScreenCapture		=	0x10,
-			ABrightColoredFish	=	0x11,
-			Illustration		=	0x12,
-			BandLogo			=	0x13,
-			StudioLogo			=	0x14
+		struct Frame {
+			std::string_view id;
+			std::string_view name; // e.g. "title" for TIT2 (or TT2)
+			Encoding encoding = Encoding::Latin;
+			std::string_view body; // everything after the encoding byte
 		};
 
-		Art(Frame &parent);
-		~Art();
-
-		Encoding textEncoding = Encoding::Latin;
-		std::string mimeType; // does NOT use textEncoding
-		Type type = Type::Other;
-		std::string description; // DOES use textEncoding
-		uint8_t *data = nullptr;
-		std::size_t dataLength = 0;
-
-		bool Read(const char **tag);
-
-	private:
-		Frame &parent;
-	};
-
-	class Frame {
-	friend class Art;
-	private:
-		static inline const auto Dummy = [](const std::string &str) { 
-			return str; 
+		struct Picture {
+			enum class Type : uint8_t {
+				Other				=	0x00,
+				FileIcon			=	0x01,
+				OtherFileIcon		=	0x02,
+				CoverFront			=	0x03,
+				CoverBack			=	0x04,
+				Leaflet				=	0x05,
+				Media				=	0x06,
+				LeadArtist			=	0x07,
+				Artist				=	0x08,
+				Conductor			=	0x09,
+				Band				=	0x0A,
+				Composer			=	0x0B,
+				Lyricist			=	0x0C,
+				RecordingLocation	=	0x0D,
+				DuringRecording		=	0x0E,
+				DuringPerformance	=	0x0F,
+				ScreenCapture		=	0x10,
+				ABrightColoredFish	=	0x11,
+				Illustration		=	0x12,
+				BandLogo			=	0x13,
+				StudioLogo			=	0x14
+			};
+
+			std::string_view mimeType;
+			Type type = Type::Other;
+			std::string_view data;
 		};
 
-		// TRK / TRCK can be fractional (e.g. 01/08)
-		// but we only care about the numerator
-		// for now
-		static inline const auto TrackNumber = [](const std::string &str) {
-			return Fetcko::Utils::Split(str, '/')[0];
-		};
-
-	public:
-		Frame(Frame &&) noexcept;
-		static inline const std::map<
-			std::string,
-			std::pair<
-				std::string,
-				std::function<
-					std::string(const std::string &)
-				>
-			>
-		> RelevantFrames = {
-			// v2
-			{ "TP1", { "artist", Dummy }},				// Lead artist(s)/Lead performer(s)/Soloist(s)/Performing group
-			{ "TAL", { "album", Dummy }},				// Album/Movie/Show title
-			{ "TT2", { "title", Dummy }},				// Title/Songname/Content description
-			{ "PIC", { "art", Dummy }},					// Attached picture
-			{ "TPA", { "discnumber", Dummy }},			// Part of a set
-			{ "TRK", { "tracknumber", TrackNumber }},	// Track number/Position in set
-			// v3
-			{ "TALB", { "album", Dummy }},				// [#TALB Album/Movie/Show title]
-			{ "TIT2", { "title", Dummy }},				// [#TIT2 Title/songname/content description]
-			{ "TPE1", { "artist", Dummy }},			// [#TPE1 Lead performer(s)/Soloist(s)]
-			{ "APIC", { "art", Dummy }},				// [#sec4.15 Attached picture]
-			{ "TPOS", { "discnumber", Dummy }},		// [#TPOS Part of a set]
-			{ "TRCK", { "tracknumber", TrackNumber }} // [#TRCK Track number/Position in set]
-		};
+		// tag is the whole thing, header and all. Anything past
+		// its end (e.g. a frame that claims to be bigger than
+		// the tag) is ignored.
+		explicit View(std::string_view tag);
 
-		std::string id;
-		uint32_t size = 0;
-		uint16_t flags = 0;
-		uint8_t *data = nullptr;
+		// False if tag isn't an ID3v2 tag
+		bool IsValid() const { return valid; }
 
-		std::string textData;
-		Art *artData = nullptr;
+		// Only the frames we care about. When a frame
+		// shows up more than once, the first one wins.
+		const std::vector<Frame> &GetFrames() const { return frames; }
+		const Frame *GetFrame(std::string_view name) const;
 
-		Encoding encoding = Encoding::Latin;
+		// Decodes (and tidies up, e.g. "01/08" to "01")
+		// the frame with the friendly name name
+		std::optional<std::string> GetText(std::string_view name) const;
 
-		Frame(ID3V2 &parent);
+		// Every text frame, decoded
+		std::map<std::string, std::string> GetTags() const;
 
-		~Frame();
+		// Only the text frames with these friendly names, so
+		// nothing else gets decoded. No names means all of them.
+		std::map<std::string, std::string> GetTags(const std::vector<std::string_view> &names) const;
 
-		bool Read(const char **tag, bool textOnly = false);
+		std::optional<Picture> GetPicture() const;
 
 	private:
-		void ReadEncoding(const char **tag, Encoding *encoding = nullptr);
+		static std::string Decode(const Frame &frame);
 
-		ID3V2 &parent;
+		std::vector<Frame> frames;
+		uint8_t majorVersion = 0;
+		bool valid = false;
 	};
 
-	Header header;
-	std::size_t frameIdBytes = 4;
-	std::size_t frameSizeBytes = 4;
-	ExtendedHeader *extendedHeader = nullptr;
-	std::map<std::string, Frame> frames;
-	uint8_t *padding = nullptr;
-	uint8_t *footer = nullptr;
-
-	std::size_t currentOffset = 0;
-
-	ID3V2();
-	~ID3V2();
-
-	std::map<std::string, std::string> Read(const char **tag, bool textOnly = false);
-
-	const std::map<std::string, Frame> &GetFrames() const { return frames; }
-
-	static void Fix32Bit(uint32_t *num, bool unsynch = true);
+	// Including the header (and footer, if there is one).
+	// header needs to be at least HeaderSize bytes, and
+	// we return 0 if it isn't an ID3v2 header.
+	static constexpr std::size_t HeaderSize = 10;
+	static std::size_t GetTagSize(const char *header);
 private:
 	static std::string ToUTF8(const char *tag, uint32_t size, Encoding encoding);
 };
\ No newline at end of file
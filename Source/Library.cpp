@@ -0,0 +1,258 @@
+#include "Library.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "MathCPP/Duration.hpp"
+
+#include "CConsole.h"
+#include "Utils.hpp"
+
+using namespace MathsCPP;
+
+namespace {
+constexpr char Magic[4] = { 'P', 'R', 'L', 'B' };
+
+// Anything longer than this is a corrupt file, not a real tag
+constexpr std::uint32_t MaxStringLength = 1 << 16;
+
+template<typename T>
+void Write(std::ofstream &file, const T &value) {
+	file.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void Write(std::ofstream &file, const std::string &value) {
+	Write(file, static_cast<std::uint32_t>(value.size()));
+	file.write(value.data(), value.size());
+}
+
+// Whether the tags said, then what they said (so a
+// track or disc 0 doesn't get mistaken for nothing)
+void Write(std::ofstream &file, const std::optional<std::size_t> &value) {
+	Write(file, static_cast<std::uint8_t>(value.has_value()));
+	Write(file, static_cast<std::uint32_t>(value.value_or(0)));
+}
+
+template<typename T>
+bool Read(std::ifstream &file, T &value) {
+	file.read(reinterpret_cast<char *>(&value), sizeof(T));
+	return static_cast<bool>(file);
+}
+
+bool Read(std::ifstream &file, std::string &value) {
+	std::uint32_t size = 0;
+	if (!Read(file, size) || size > MaxStringLength)
+		return false;
+
+	value.resize(size);
+	file.read(value.data(), size);
+
+	return static_cast<bool>(file);
+}
+
+bool Read(std::ifstream &file, std::optional<std::size_t> &value) {
+	std::uint8_t present = 0;
+	std::uint32_t number = 0;
+	if (!Read(file, present) || !Read(file, number))
+		return false;
+
+	if (present)
+		value = number;
+
+	return true;
+}
+}
+
+Library::Library() {
+	Load();
+}
+
+Library &Library::Get() {
+	static Library library;
+	return library;
+}
+
+std::optional<Library::Stamp> Library::GetStamp(const std::filesystem::path &path) {
+	std::error_code error;
+
+	Stamp ret;
+	ret.size = std::filesystem::file_size(path, error);
+	if (error)
+		return std::nullopt;
+
+	ret.modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+	if (error)
+		return std::nullopt;
+
+	return ret;
+}
+
+std::optional<Library::Entry> Library::Find(const std::filesystem::path &path, const Stamp &stamp) const {
+	auto key = GetKey(path);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto entry = entries.find(key);
+	if (entry == entries.end() || entry->second.stamp != stamp)
+		return std::nullopt;
+
+	return entry->second;
+}
+
+void Library::Store(const std::filesystem::path &path, Entry entry) {
+	auto key = GetKey(path);
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	entries.insert_or_assign(std::move(key), std::move(entry));
+	dirty = true;
+}
+
+void Library::Save() {
+	auto path = GetPath();
+	if (path.empty())
+		return;
+
+	auto start = std::chrono::system_clock::now();
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!dirty)
+		return;
+
+	// Write somewhere nobody else will be, then move it into
+	// place, so nobody ever reads half a file
+	std::ostringstream suffix;
+	suffix << ".tmp" << std::hash<std::thread::id>{}(std::this_thread::get_id())
+		<< '-' << std::chrono::steady_clock::now().time_since_epoch().count();
+
+	auto temporary = path;
+	temporary += suffix.str();
+
+	{
+		std::ofstream file(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+
+		file.write(Magic, sizeof(Magic));
+		Write(file, Version);
+		Write(file, static_cast<std::uint64_t>(entries.size()));
+
+		for (const auto &[key, entry] : entries) {
+			Write(file, key);
+			Write(file, entry.stamp.size);
+			Write(file, entry.stamp.modified);
+			Write(file, entry.title);
+			Write(file, entry.disc);
+			Write(file, entry.index);
+		}
+
+		if (!file) {
+			CConsole::Console.Print("Could not write the library to " + temporary.u8string(), MSG_ERROR);
+
+			file.close();
+
+			std::error_code error;
+			std::filesystem::remove(temporary, error);
+
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+
+	if (error) {
+		CConsole::Console.Print("Could not save the library: " + error.message(), MSG_ERROR);
+		std::filesystem::remove(temporary, error);
+		return;
+	}
+
+	dirty = false;
+
+	auto end = std::chrono::system_clock::now();
+
+	CConsole::Console.Print(
+		"Saved " + std::to_string(entries.size()) + " songs to the library in " +
+			std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds",
+		MSG_DIAG
+	);
+}
+
+std::string Library::GetKey(const std::filesystem::path &path) {
+	std::error_code error;
+	auto absolute = std::filesystem::absolute(path, error);
+
+	return (error ? path : absolute).lexically_normal().u8string();
+}
+
+std::filesystem::path Library::GetPath() {
+	auto ret = Fetcko::Utils::GetUserFolder();
+
+	if (!ret.empty())
+		ret /= "Library.index";
+
+	return ret;
+}
+
+void Library::Load() {
+	auto path = GetPath();
+	if (path.empty())
+		return;
+
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file)
+		return;
+
+	char magic[sizeof(Magic)] = { 0 };
+	file.read(magic, sizeof(magic));
+
+	std::uint32_t version = 0;
+	std::uint64_t count = 0;
+
+	if (!file ||
+		!std::equal(std::begin(magic), std::end(magic), std::begin(Magic)) ||
+		!Read(file, version) ||
+		version != Version ||
+		!Read(file, count)) {
+		CConsole::Console.Print("Ignoring out of date (or corrupt) library", MSG_ALERT);
+		return;
+	}
+
+	std::size_t gone = 0;
+
+	for (std::uint64_t i = 0; i < count; ++i) {
+		std::string key;
+		Entry entry;
+
+		if (!Read(file, key) ||
+			!Read(file, entry.stamp.size) ||
+			!Read(file, entry.stamp.modified) ||
+			!Read(file, entry.title) ||
+			!Read(file, entry.disc) ||
+			!Read(file, entry.index)) {
+			// Whatever we did get is still good
+			CConsole::Console.Print("Library is cut short after " + std::to_string(i) + " songs", MSG_ALERT);
+			break;
+		}
+
+		// Forget about songs that aren't there anymore (which
+		// also gets them out of the file the next time we save).
+		// If we can't even tell, we hang onto them.
+		std::error_code error;
+		if (!std::filesystem::exists(std::filesystem::u8path(key), error) && !error) {
+			++gone;
+			continue;
+		}
+
+		entries.insert_or_assign(std::move(key), std::move(entry));
+	}
+
+	if (gone) {
+		CConsole::Console.Print("Dropped " + std::to_string(gone) + " songs that are gone from the library", MSG_DIAG);
+		dirty = true;
+	}
+
+	CConsole::Console.Print("Loaded " + std::to_string(entries.size()) + " songs from the library", MSG_DIAG);
+}
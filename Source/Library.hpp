@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Every song we've read the tags of, kept on disk (next to
+// our settings) between runs. Dropping a folder we've seen
+// before only needs to stat its files, and only the ones
+// that have changed since get their tags read again.
+//
+// An entry only counts for as long as its file's size and
+// modification time (its Stamp) stay the same, and entries
+// whose files have gone get dropped the next time we load.
+//
+// Everything here is safe to call from any thread.
+class Library {
+public:
+	struct Stamp {
+		std::uint64_t size = 0;
+		std::int64_t modified = 0;
+
+		bool operator==(const Stamp &other) const { return size == other.size && modified == other.modified; }
+		bool operator!=(const Stamp &other) const { return !(*this == other); }
+	};
+
+	struct Entry {
+		Stamp stamp;
+
+		// Only what the PlaylistScanner sorts by
+		std::string title;
+
+		std::optional<std::size_t> disc = std::nullopt;
+		std::optional<std::size_t> index = std::nullopt;
+	};
+
+	static Library &Get();
+
+	// Nothing if the file's gone
+	static std::optional<Stamp> GetStamp(const std::filesystem::path &path);
+
+	// Nothing if we've never seen the file, or
+	// it's changed since we last did
+	std::optional<Entry> Find(const std::filesystem::path &path, const Stamp &stamp) const;
+	void Store(const std::filesystem::path &path, Entry entry);
+
+	// Writes everything out, but only if
+	// something's been stored since we last did
+	void Save();
+
+private:
+	// Bump this whenever the file layout changes
+	static constexpr std::uint32_t Version = 2;
+
+	Library();
+
+	// Paths are kept absolute, so the same file
+	// gets found no matter how we got to it
+	static std::string GetKey(const std::filesystem::path &path);
+	static std::filesystem::path GetPath();
+
+	void Load();
+
+	mutable std::mutex mutex;
+	std::unordered_map<std::string, Entry> entries;
+	bool dirty = false;
+};
@@ -0,0 +1,296 @@
+#include "LiveBeatDetect.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include "MathCPP/Maths.hpp"
+
+#include "BeatDetect.hpp"
+#include "CConsole.h"
+
+using namespace MathsCPP;
+
+namespace {
+// Squashes loud passages so quiet
+// onsets still register in the flux
+constexpr double Compression = 100.0;
+
+// How far above the running mean (in running
+// deviations) the flux has to peak for an onset
+constexpr double Sensitivity = 1.5;
+
+// Seconds the threshold takes to adapt
+constexpr double ThresholdTime = 1.0;
+
+// Seconds between onsets, at the very least
+constexpr double MinimumOnsetInterval = 0.1;
+
+// Seconds the autocorrelation remembers
+constexpr double TempoMemory = 4.0;
+
+// Tempos we'll consider, and the one we lean towards
+constexpr double MinimumBpm = 60.0;
+constexpr double MaximumBpm = 200.0;
+constexpr double PreferredBpm = 120.0;
+
+// Seconds a new tempo has to win before we switch to it
+constexpr double TempoSwitchTime = 1.0;
+
+// How much of an onset's timing error we correct per beat
+constexpr double PhaseGain = 0.25;
+
+// Seconds without an onset before we stop predicting beats
+constexpr double SilenceTime = 2.0;
+}
+
+LiveBeatDetect::~LiveBeatDetect() {
+	if (plan) {
+		std::scoped_lock lock(BeatDetect::planMutex);
+		fftw_destroy_plan(plan);
+	}
+
+	if (in) fftw_free(in);
+	if (out) fftw_free(out);
+}
+
+void LiveBeatDetect::OnInit(unsigned int sampleRate, unsigned int channels) {
+	this->channels = std::max(channels, 1u);
+	hopTime = static_cast<double>(HopSize) / std::max(sampleRate, 1u);
+
+	if (!plan) {
+		in = fftw_alloc_real(FrameSize);
+		out = fftw_alloc_complex(FrameSize / 2 + 1);
+
+		std::scoped_lock lock(BeatDetect::planMutex);
+		plan = fftw_plan_dft_r2c_1d(static_cast<int>(FrameSize), in, out, FFTW_ESTIMATE);
+	}
+
+	window.resize(FrameSize);
+	for (std::size_t i = 0; i < FrameSize; ++i)
+		window[i] = 0.5 - 0.5 * std::cos(2.0 * Maths::PI<double> * i / (FrameSize - 1));
+
+	previous.assign(FrameSize / 2 + 1, 0.0);
+	samples.assign(FrameSize, 0.0f);
+	samplePos = sinceHop = 0;
+	hop = lastOnset = 0;
+
+	mean = deviation = 0.0;
+	fluxes[0] = fluxes[1] = 0.0;
+
+	minLag = static_cast<std::size_t>(std::floor(60.0 / MaximumBpm / hopTime));
+	maxLag = static_cast<std::size_t>(std::ceil(60.0 / MinimumBpm / hopTime));
+
+	envelope.assign(maxLag + 1, 0.0);
+	envelopePos = 0;
+
+	autocorrelation.assign(maxLag + 1, 0.0);
+
+	// Log-Gaussian around our preferred tempo, an octave wide.
+	// Without this, the autocorrelation happily picks half
+	// or double time just as often as the actual tempo.
+	prior.assign(maxLag + 1, 0.0);
+	for (auto lag = minLag; lag <= maxLag; ++lag) {
+		auto octaves = std::log2(lag * hopTime / (60.0 / PreferredBpm));
+		prior[lag] = std::exp(-0.5 * octaves * octaves);
+	}
+
+	period = nextBeat = candidate = 0.0;
+	candidateHops = 0;
+	tempo = 0.0f;
+
+	CConsole::Console.Print(
+		"Live beat detection running at " + std::to_string(sampleRate) + " Hz with " +
+		std::to_string(static_cast<int>(hopTime * 1000.0 + 0.5)) + "ms hops",
+		MSG_DIAG
+	);
+}
+
+void LiveBeatDetect::OnData(const float *data, std::size_t frames) {
+	if (!plan)
+		return;
+
+	for (std::size_t i = 0; i < frames; ++i) {
+		float sum = 0.0f;
+		if (data) {
+			for (unsigned int c = 0; c < channels; ++c)
+				sum += data[i * channels + c];
+		}
+
+		samples[samplePos] = sum / channels;
+		if (++samplePos == FrameSize)
+			samplePos = 0;
+
+		if (++sinceHop == HopSize) {
+			sinceHop = 0;
+			OnHop();
+		}
+	}
+}
+
+bool LiveBeatDetect::OnLoop() {
+	auto current = beats.load();
+	if (current == seenBeats)
+		return false;
+
+	// If the renderer fell behind, there's no point
+	// flashing through every beat we missed
+	seenBeats = current;
+	return true;
+}
+
+void LiveBeatDetect::OnHop() {
+	++hop;
+
+	for (std::size_t i = 0, j = samplePos; i < FrameSize; ++i) {
+		in[i] = samples[j] * window[i];
+		if (++j == FrameSize)
+			j = 0;
+	}
+
+	fftw_execute(plan);
+
+	// Half-wave rectified, so only energy
+	// coming in counts, not energy going away
+	double flux = 0.0;
+	for (std::size_t i = 1; i <= FrameSize / 2; ++i) {
+		auto magnitude = std::log1p(Compression * std::sqrt(out[i][0] * out[i][0] + out[i][1] * out[i][1]));
+		if (magnitude > previous[i])
+			flux += magnitude - previous[i];
+
+		previous[i] = magnitude;
+	}
+
+	auto onset = IsOnset(flux);
+
+	UpdateTempo(std::max(flux - mean, 0.0));
+
+	if (onset) {
+		// The peak was the previous hop
+		auto onsetHop = static_cast<double>(hop - 1);
+
+		if (period > 0.0) {
+			// Pull the upcoming beat towards wherever
+			// the nearest predicted beat should have been
+			auto elapsed = std::round((onsetHop - (nextBeat - period)) / period);
+			auto error = onsetHop - (nextBeat - period + elapsed * period);
+			if (std::abs(error) < period * 0.2)
+				nextBeat += error * PhaseGain;
+		} else if (onsetHop - lastOnset >= 60.0 / MaximumBpm / hopTime || lastOnset == 0) {
+			// Until we have a tempo, strong
+			// onsets are the best we can do
+			Beat();
+		}
+
+		lastOnset = hop - 1;
+	}
+
+	if (period > 0.0) {
+		if (hop >= nextBeat) {
+			// Don't keep flashing away
+			// through a quiet passage
+			if ((hop - lastOnset) * hopTime < SilenceTime)
+				Beat();
+
+			nextBeat += period;
+
+			// We've drifted way off (or come back from
+			// silence), so start counting from here
+			if (nextBeat < hop)
+				nextBeat = hop + period;
+		}
+	}
+}
+
+bool LiveBeatDetect::IsOnset(double flux) {
+	// Peak picking has to be causal, so we only know the
+	// previous hop was a peak once we see this one fall
+	auto peak = fluxes[1];
+	auto isPeak =
+		peak > fluxes[0] &&
+		peak >= flux &&
+		peak > mean + Sensitivity * deviation &&
+		(hop - 1 - lastOnset) * hopTime >= MinimumOnsetInterval;
+
+	// Exponential moving averages keep this
+	// the same cost every hop
+	auto alpha = hopTime / ThresholdTime;
+	mean += alpha * (flux - mean);
+	deviation += alpha * (std::abs(flux - mean) - deviation);
+
+	fluxes[0] = fluxes[1];
+	fluxes[1] = flux;
+
+	return isPeak;
+}
+
+void LiveBeatDetect::UpdateTempo(double strength) {
+	envelopePos = envelopePos == 0 ? envelope.size() - 1 : envelopePos - 1;
+	envelope[envelopePos] = strength;
+
+	// Rather than correlating the last few seconds every hop,
+	// each lag keeps a decaying sum of its products
+	auto decay = std::exp(-hopTime / TempoMemory);
+
+	auto best = minLag;
+	auto bestScore = 0.0;
+	auto total = 0.0;
+	for (auto lag = minLag; lag <= maxLag; ++lag) {
+		auto &value = autocorrelation[lag];
+		value = value * decay + strength * envelope[(envelopePos + lag) % envelope.size()];
+
+		auto score = value * prior[lag];
+		total += score;
+		if (score > bestScore) {
+			bestScore = score;
+			best = lag;
+		}
+	}
+
+	// A flat autocorrelation means noise (or silence),
+	// and any tempo we picked out of it would be a guess
+	auto average = total / (maxLag - minLag + 1);
+	if (bestScore <= 0.0 || bestScore < average * 1.5)
+		return;
+
+	// Parabolic interpolation gets us
+	// below the resolution of a hop
+	auto lag = static_cast<double>(best);
+	if (best > minLag && best < maxLag) {
+		auto a = autocorrelation[best - 1] * prior[best - 1];
+		auto b = bestScore;
+		auto c = autocorrelation[best + 1] * prior[best + 1];
+		auto denominator = a - 2.0 * b + c;
+		if (denominator < 0.0)
+			lag += 0.5 * (a - c) / denominator;
+	}
+
+	if (period <= 0.0) {
+		period = lag;
+		nextBeat = hop + period;
+	} else if (std::abs(lag - period) < period * 0.1) {
+		period += (lag - period) * 0.1;
+		candidateHops = 0;
+	} else {
+		// Only switch once the new tempo's
+		// held for a while, so one odd bar
+		// doesn't throw us off
+		if (std::abs(lag - candidate) < candidate * 0.1)
+			++candidateHops;
+		else {
+			candidate = lag;
+			candidateHops = 0;
+		}
+
+		if (candidateHops * hopTime >= TempoSwitchTime) {
+			period = candidate;
+			candidateHops = 0;
+		}
+	}
+
+	tempo = static_cast<float>(60.0 / (period * hopTime));
+}
+
+void LiveBeatDetect::Beat() {
+	++beats;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <fftw3.h>
+
+// BeatDetect needs a stream it can prescan, which we
+// don't have in listen mode. This follows the beat
+// as it happens instead, on the capture thread.
+//
+// Onsets come from spectral flux against an adaptive
+// threshold, the tempo from a decaying autocorrelation
+// of that flux, and beats are predicted from the tempo
+// then pulled into phase by the onsets.
+//
+// Every hop does the same amount of work (one small FFT
+// plus a pass over our lags), so it keeps up no matter
+// what's coming in.
+class LiveBeatDetect {
+public:
+	// ~21ms frames every ~5ms at 48kHz
+	static constexpr std::size_t FrameSize = 1024;
+	static constexpr std::size_t HopSize = 256;
+
+	~LiveBeatDetect();
+
+	// Only ever call these from the capture thread.
+	//
+	// data is interleaved, and can be nullptr for
+	// silence so the beat clock keeps running.
+	void OnInit(unsigned int sampleRate, unsigned int channels);
+	void OnData(const float *data, std::size_t frames);
+
+	// Only ever call this from the render thread.
+	//
+	// Returns true if we passed a beat
+	// since the last call.
+	bool OnLoop();
+
+	// 0 until we've settled on a tempo
+	float GetTempo() const { return tempo; }
+
+private:
+	void OnHop();
+	bool IsOnset(double flux);
+	void UpdateTempo(double strength);
+	void Beat();
+
+	unsigned int channels = 0;
+	double hopTime = 0.0;
+
+	double *in = nullptr;
+	fftw_complex *out = nullptr;
+	fftw_plan plan = nullptr;
+
+	std::vector<double> window;
+	std::vector<double> previous;
+
+	// Mono, FrameSize long, oldest sample at samplePos
+	std::vector<float> samples;
+	std::size_t samplePos = 0;
+	std::size_t sinceHop = 0;
+
+	std::uint64_t hop = 0;
+
+	// Adaptive threshold
+	double mean = 0.0;
+	double deviation = 0.0;
+	double fluxes[2] = { 0.0, 0.0 };
+	std::uint64_t lastOnset = 0;
+
+	// Onset strength, newest at envelopePos
+	std::vector<double> envelope;
+	std::size_t envelopePos = 0;
+
+	// Indexed by lag in hops
+	std::vector<double> autocorrelation;
+	std::vector<double> prior;
+	std::size_t minLag = 0;
+	std::size_t maxLag = 0;
+
+	// Both in hops, 0 while we've no tempo
+	double period = 0.0;
+	double nextBeat = 0.0;
+	double candidate = 0.0;
+	std::size_t candidateHops = 0;
+
+	std::atomic<float> tempo = 0.0f;
+	std::atomic<std::uint32_t> beats = 0;
+
+	// Owned by the render thread
+	std::uint32_t seenBeats = 0;
+};
@@ -0,0 +1,238 @@
+#include "Loudness.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "MathCPP/Maths.hpp"
+
+using namespace MathsCPP;
+
+namespace {
+// Gating, per BS.1770-4 and EBU Tech 3342
+constexpr double AbsoluteGate = -70.0;
+constexpr double RelativeGate = -10.0;
+constexpr double RangeRelativeGate = -20.0;
+
+// In 100ms sub-blocks
+constexpr std::size_t MomentaryBlocks = 4;
+constexpr std::size_t ShortTermBlocks = 30;
+
+// BS.1770-4 Annex 2's interpolating filter, as its four
+// phases. Phase 0 lands (almost) right on the sample.
+constexpr std::size_t TruePeakPhases = 4;
+constexpr std::size_t TruePeakTaps = 12;
+constexpr float TruePeakFilter[TruePeakPhases][TruePeakTaps] = {
+	{ 0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f, -0.0594482421875f,  0.1373291015625f,
+	  0.9721679687500f, -0.1022949218750f,  0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+	{ -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f, -0.1665039062500f,  0.4650878906250f,
+	   0.7797851562500f, -0.2003173828125f,  0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+	{ -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f, -0.2003173828125f,  0.7797851562500f,
+	   0.4650878906250f, -0.1665039062500f,  0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+	{ -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f, -0.1022949218750f,  0.9721679687500f,
+	   0.1373291015625f, -0.0594482421875f,  0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+};
+
+constexpr double OversampleBelow = 96000.0;
+}
+
+double Loudness::Result::GetGain(double targetLoudness) const {
+	if (integrated <= AbsoluteGate)
+		return 1.0;
+
+	auto gain = std::pow(10.0, (targetLoudness - integrated) / 20.0);
+
+	if (truePeak > 0.0)
+		gain = std::min(gain, 1.0 / truePeak);
+
+	return gain;
+}
+
+Loudness::Loudness(double sampleRate, unsigned int channels) :
+	channels(std::max(channels, 1u)),
+	subBlockFrames(static_cast<std::size_t>(std::lround(sampleRate / 10.0))),
+	state(this->channels),
+	oversample(sampleRate < OversampleBelow) {
+	// The K-weighting filters are only given for 48kHz,
+	// so work them out again for whatever rate we have
+	// (these are the same as libebur128's).
+	{
+		constexpr double f0 = 1681.974450955533;
+		constexpr double G = 3.999843853973347;
+		constexpr double Q = 0.7071752369554196;
+
+		auto K = std::tan(Maths::PI<double> * f0 / sampleRate);
+		auto Vh = std::pow(10.0, G / 20.0);
+		auto Vb = std::pow(Vh, 0.4996667741545416);
+		auto a0 = 1.0 + K / Q + K * K;
+
+		shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+		shelf.b1 = 2.0 * (K * K - Vh) / a0;
+		shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+		shelf.a1 = 2.0 * (K * K - 1.0) / a0;
+		shelf.a2 = (1.0 - K / Q + K * K) / a0;
+	}
+
+	{
+		constexpr double f0 = 38.13547087602444;
+		constexpr double Q = 0.5003270373238773;
+
+		auto K = std::tan(Maths::PI<double> * f0 / sampleRate);
+		auto a0 = 1.0 + K / Q + K * K;
+
+		highPass.b0 = 1.0;
+		highPass.b1 = -2.0;
+		highPass.b2 = 1.0;
+		highPass.a1 = 2.0 * (K * K - 1.0) / a0;
+		highPass.a2 = (1.0 - K / Q + K * K) / a0;
+	}
+
+	// Surrounds count for a bit more, and the LFE
+	// not at all. Anything that isn't 5.1 gets
+	// treated as front channels.
+	weights.assign(this->channels, 1.0);
+	if (this->channels == 6) {
+		weights[3] = 0.0;
+		weights[4] = weights[5] = 1.41;
+	}
+}
+
+void Loudness::Process(const float *samples, std::size_t frames) {
+	for (std::size_t i = 0; i < frames; ++i) {
+		for (unsigned int c = 0; c < channels; ++c) {
+			double x = samples[i * channels + c];
+
+			samplePeak = std::max(samplePeak, std::abs(x));
+
+			auto &s = state[c];
+
+			if (oversample)
+				UpdateTruePeak(s, samples[i * channels + c]);
+
+			// Transposed direct form II, both stages
+			auto y = shelf.b0 * x + s.z1;
+			s.z1 = shelf.b1 * x - shelf.a1 * y + s.z2;
+			s.z2 = shelf.b2 * x - shelf.a2 * y;
+
+			auto z = highPass.b0 * y + s.z3;
+			s.z3 = highPass.b1 * y - highPass.a1 * z + s.z4;
+			s.z4 = highPass.b2 * y - highPass.a2 * z;
+
+			s.sum += z * z;
+		}
+
+		historyPosition = (historyPosition + 1) % TruePeakTaps;
+
+		if (++framesInSubBlock == subBlockFrames) {
+			double energy = 0.0;
+			for (unsigned int c = 0; c < channels; ++c) {
+				energy += weights[c] * state[c].sum / subBlockFrames;
+				state[c].sum = 0.0;
+			}
+
+			subBlocks.emplace_back(energy);
+			framesInSubBlock = 0;
+		}
+	}
+}
+
+Loudness::Result Loudness::GetResult() const {
+	Result ret;
+	ret.samplePeak = samplePeak;
+	ret.truePeak = oversample ? std::max(truePeak, samplePeak) : samplePeak;
+
+	// Integrated loudness comes from 400ms blocks
+	// overlapping by 75% (so one every sub-block)
+	if (subBlocks.size() >= MomentaryBlocks) {
+		std::vector<double> blocks;
+		blocks.reserve(subBlocks.size() - MomentaryBlocks + 1);
+		for (std::size_t i = 0; i + MomentaryBlocks <= subBlocks.size(); ++i) {
+			auto energy = Energy(i, MomentaryBlocks);
+			if (ToLufs(energy) > AbsoluteGate)
+				blocks.emplace_back(energy);
+		}
+
+		if (!blocks.empty()) {
+			double total = 0.0;
+			for (auto energy : blocks)
+				total += energy;
+
+			auto threshold = ToLufs(total / blocks.size()) + RelativeGate;
+
+			total = 0.0;
+			std::size_t count = 0;
+			for (auto energy : blocks) {
+				if (ToLufs(energy) > threshold) {
+					total += energy;
+					++count;
+				}
+			}
+
+			if (count > 0)
+				ret.integrated = ToLufs(total / count);
+		}
+	}
+
+	// Loudness range comes from 3s blocks, between the 10th
+	// and 95th percentile of what makes it through the gates
+	if (subBlocks.size() >= ShortTermBlocks) {
+		std::vector<double> blocks;
+		blocks.reserve(subBlocks.size() - ShortTermBlocks + 1);
+		for (std::size_t i = 0; i + ShortTermBlocks <= subBlocks.size(); ++i) {
+			auto energy = Energy(i, ShortTermBlocks);
+			if (ToLufs(energy) > AbsoluteGate)
+				blocks.emplace_back(energy);
+		}
+
+		if (!blocks.empty()) {
+			double total = 0.0;
+			for (auto energy : blocks)
+				total += energy;
+
+			auto threshold = ToLufs(total / blocks.size()) + RangeRelativeGate;
+
+			std::vector<double> loudness;
+			loudness.reserve(blocks.size());
+			for (auto energy : blocks) {
+				if (auto lufs = ToLufs(energy); lufs > threshold)
+					loudness.emplace_back(lufs);
+			}
+
+			if (!loudness.empty()) {
+				std::sort(loudness.begin(), loudness.end());
+
+				auto percentile = [&loudness](double p) {
+					return loudness[static_cast<std::size_t>(std::lround(p * (loudness.size() - 1)))];
+				};
+
+				ret.range = percentile(0.95) - percentile(0.10);
+			}
+		}
+	}
+
+	return ret;
+}
+
+void Loudness::UpdateTruePeak(ChannelState &state, float sample) {
+	state.history[historyPosition] = sample;
+
+	for (std::size_t phase = 0; phase < TruePeakPhases; ++phase) {
+		float y = 0.0f;
+		for (std::size_t tap = 0; tap < TruePeakTaps; ++tap)
+			y += TruePeakFilter[phase][tap] * state.history[(historyPosition + TruePeakTaps - tap) % TruePeakTaps];
+
+		truePeak = std::max(truePeak, static_cast<double>(std::abs(y)));
+	}
+}
+
+double Loudness::ToLufs(double energy) {
+	return energy > 0.0 ? -0.691 + 10.0 * std::log10(energy) : -std::numeric_limits<double>::infinity();
+}
+
+double Loudness::Energy(std::size_t first, std::size_t count) const {
+	double total = 0.0;
+	for (std::size_t i = first; i < first + count; ++i)
+		total += subBlocks[i];
+
+	return total / count;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "AnalysisGraph.hpp"
+
+// Measures loudness the way ITU-R BS.1770 / EBU R128
+// describe it: K-weighted, gated, in 400ms blocks.
+// True peak comes from 4x oversampling, per BS.1770-4.
+class Loudness : public AnalysisGraph::Consumer {
+public:
+	struct Result {
+		// Gated integrated loudness, in LUFS
+		double integrated = -70.0;
+
+		// Loudness range, in LU
+		double range = 0.0;
+
+		// Largest absolute sample, where 1.0 is full scale
+		double samplePeak = 0.0;
+
+		// Largest absolute value in between samples too,
+		// where 1.0 is full scale
+		double truePeak = 0.0;
+
+		// How much to scale by to hit targetLoudness (in LUFS),
+		// ReplayGain style, without the true peak going over
+		// full scale. 1.0 if we've got nothing to go on.
+		double GetGain(double targetLoudness) const;
+	};
+
+	Loudness(double sampleRate, unsigned int channels);
+
+	// Interleaved samples, any number at a time
+	void Process(const float *samples, std::size_t frames);
+
+	void OnSamples(const float *samples, std::size_t frames) override { Process(samples, frames); }
+
+	Result GetResult() const;
+
+private:
+	struct Biquad {
+		double b0 = 1.0, b1 = 0.0, b2 = 0.0;
+		double a1 = 0.0, a2 = 0.0;
+	};
+
+	struct ChannelState {
+		double z1 = 0.0, z2 = 0.0;
+		double z3 = 0.0, z4 = 0.0;
+		double sum = 0.0;
+
+		// The last 12 samples, for the oversampling filter
+		std::array<float, 12> history = { 0.0f };
+	};
+
+	// Mean square energy (already channel weighted)
+	// of a run of 100ms sub-blocks, as loudness
+	static double ToLufs(double energy);
+
+	double Energy(std::size_t first, std::size_t count) const;
+
+	void UpdateTruePeak(ChannelState &state, float sample);
+
+	unsigned int channels = 0;
+	std::size_t subBlockFrames = 0;
+	std::size_t framesInSubBlock = 0;
+
+	// High shelf then high pass
+	Biquad shelf;
+	Biquad highPass;
+
+	std::vector<double> weights;
+	std::vector<ChannelState> state;
+
+	// Every 100ms of the track
+	std::vector<double> subBlocks;
+
+	double samplePeak = 0.0;
+	double truePeak = 0.0;
+
+	// Past 96kHz there's hardly anything in between samples
+	// to miss, so we don't bother oversampling
+	bool oversample = true;
+	std::size_t historyPosition = 0;
+};
@@ -1,153 +1,127 @@
 #include "MP4.hpp"
 
-#include "ID3V2.hpp"
+namespace {
+// Box headers are a 32-bit size then a 4 character type,
+// with a 64-bit size after that when the first is 1
+constexpr std::size_t HeaderSize = 8;
+constexpr std::size_t LargeHeaderSize = 16;
 
-#include "CConsole.h"
-
-MP4::Atom::Atom(std::ifstream &file) : file(file) {
+std::uint64_t ReadBigEndian(std::string_view bytes) {
+	std::uint64_t ret = 0;
+	for (auto byte : bytes)
+		ret = (ret << 8) | static_cast<std::uint8_t>(byte);
 
+	return ret;
 }
 
-MP4::Atom::Atom(Atom &&other) noexcept : file(std::move(other.file)) {
-	size = std::move(other.size);
-	name = std::move(other.name);
-	version = std::move(other.version);
-	memcpy(&flags, &other.flags, sizeof(flags));
-	memset(&other.flags, 0, sizeof(flags));
-	dataSize = std::move(other.dataSize);
-	data = std::move(other.data);
-	other.data = nullptr; // null out to prevent deletion on destruction
-	mimeType = std::move(other.mimeType);
+std::string_view AsString(const MappedFile &file) {
+	if (!file.IsOpen())
+		return std::string_view();
+
+	return std::string_view(reinterpret_cast<const char *>(file.GetData()), file.GetSize());
+}
 }
 
-MP4::Atom::~Atom() {
-	delete[] data;
+std::string_view MP4::Data::GetMimeType() const {
+	switch (type) {
+	case 13:
+		return "image/jpeg";
+	case 14:
+		return "image/png";
+	case 27:
+		return "image/bmp";
+	default:
+		return "image/";
+	}
 }
 
-void MP4::Atom::Read() {
-	char name[4];
-	file.read(reinterpret_cast<char *>(&size), sizeof(size));
-	// Convert from Big Endian to Little Endian
-	ID3V2::Fix32Bit(&size, false);
-	file.read(name, sizeof(name));
-	this->name = std::string(name, name + sizeof(name));
+MP4::Box::Box(std::string_view type, std::string_view contents) : type(type), contents(contents) {
 
-	bytes = sizeof(size) + sizeof(name);
 }
 
-constexpr int32_t MP4::Atom::GetExtrasSize() {
-	return sizeof(uint8_t) + sizeof(flags);
-}
+const std::vector<MP4::Box> &MP4::Box::GetChildren() const {
+	if (children)
+		return *children;
 
-void MP4::Atom::ReadExtras() {
-	file.read(reinterpret_cast<char *>(&version), sizeof(uint8_t));
-	file.read(reinterpret_cast<char *>(flags), sizeof(flags));
+	children.emplace();
 
-	bytes += GetExtrasSize();
-}
+	auto remaining = contents;
 
-void MP4::Atom::ReadData() {
-	// FIXME: Make this test more robust
-	if (name != "data") return;
+	// ISO's "meta" is a full box, with a version and flags
+	// before its children. QuickTime's goes straight into
+	// its "hdlr".
+	if (type == "meta" && remaining.size() >= HeaderSize && remaining.substr(4, 4) != "hdlr")
+		remaining.remove_prefix(4);
 
-	ReadExtras();
+	while (remaining.size() >= HeaderSize) {
+		auto size = ReadBigEndian(remaining.substr(0, 4));
+		auto header = HeaderSize;
 
-	// There are currently 4 reserved
-	// bytes in "data" atoms
-	file.seekg(4, std::ios::cur);
+		if (size == 1) {
+			if (remaining.size() < LargeHeaderSize)
+				break;
 
-	mimeType = "image/";
-	switch (flags[2]) {
-	case 13:
-		mimeType += "jpeg";
-		break;
-	case 14:
-		mimeType += "png";
-		break;
-	default:
-		break;
-	}
+			size = ReadBigEndian(remaining.substr(8, 8));
+			header = LargeHeaderSize;
+		} else if (size == 0) {
+			// Runs to the end of its parent
+			size = remaining.size();
+		}
 
-	// 16 bytes in total before the data proper:
-	//		4 bytes for atom size
-	//		4 bytes for atom name
-	//		1 byte for version
-	//		3 bytes for flag
-	//		4 bytes reserved
-	dataSize = size - 16;
+		if (size < header || size > remaining.size())
+			break;
 
-	data = new uint8_t[dataSize];
-	file.read(reinterpret_cast<char *>(data), dataSize);
-}
+		children->emplace_back(
+			remaining.substr(4, 4),
+			remaining.substr(header, static_cast<std::size_t>(size) - header)
+		);
 
-bool MP4::Atom::IsValid() const {
-	constexpr auto isValid = [](unsigned char c /* implicit cast to unsigned */) {
-		// iTunes tags can also sometimes
-		// just be 4 dashes
-		// ...or contain spaces (e.g. "xid ")
-		return !std::isalpha(c) && c != '-' && c != ' ';
-	};
-
-	if (std::find_if(
-		// iTunes tags can begin with ''
-		*name.begin() == '' ? name.begin() + 1 : name.begin(),
-		name.end(),
-		isValid
-	) != name.end())
-		return false;
-
-	if (!size)
-		return false;
-
-	return true;
-}
+		remaining.remove_prefix(static_cast<std::size_t>(size));
+	}
 
-int32_t MP4::Atom::GetBytes() const {
-	return bytes;
+	return *children;
 }
 
-MP4::MP4(const std::filesystem::path &path) {
-	file.open(path, std::ios::in | std::ios::binary);
+const MP4::Box *MP4::Box::GetChild(std::string_view type) const {
+	for (const auto &child : GetChildren()) {
+		if (child.type == type)
+			return &child;
+	}
+
+	return nullptr;
 }
 
-std::optional<MP4::Atom> MP4::GetAtomAtPath(const std::vector<std::string> &path) {
-	std::optional<Atom> ret = std::nullopt;
+std::optional<MP4::Data> MP4::Box::GetData() const {
+	// 1 byte of version and 3 bytes of type, then
+	// 4 bytes of locale before the value proper
+	if (type != "data" || contents.size() < 8)
+		return std::nullopt;
 
-	for (const auto &name : path) {
-		auto atom = SeekToAtom(name, ret);
-		if (atom) ret.emplace(std::move(*atom));
-		else return std::nullopt;
-	}
+	Data ret;
+	ret.type = static_cast<std::uint32_t>(ReadBigEndian(contents.substr(1, 3)));
+	ret.value = contents.substr(8);
 
 	return ret;
 }
 
-std::optional<MP4::Atom> MP4::SeekToAtom(const std::string &name, const std::optional<Atom> &parent) {
-	Atom ret(file);
+MP4::MP4(const std::filesystem::path &path) :
+	file(std::make_unique<MappedFile>(path)),
+	root("", AsString(*file)) {
 
-	while (file) {
-		ret.Read();
+}
 
-		if (!ret.IsValid()) {
-			file.seekg(-(ret.GetBytes() * 2), std::ios::cur);
+MP4::MP4(std::string_view file) : root("", file) {
 
-			ret.Read();
-			ret.ReadExtras();
+}
 
-			// It's possible that, after this,
-			// we're back to our parent atom.
-			//
-			// When that happens, we won't
-			// seek at all this iteration
-			// so that we get our first child
-			// on the next.
-		}
+const MP4::Box *MP4::GetBoxAtPath(const std::vector<std::string_view> &path) const {
+	const Box *ret = &root;
 
-		if (ret.name == name)
-			return ret;
-		else if (file && (!parent || (parent && parent->name != ret.name)))
-			file.seekg(ret.size - ret.GetBytes(), std::ios::cur);
+	for (const auto &type : path) {
+		ret = ret->GetChild(type);
+		if (!ret)
+			return nullptr;
 	}
 
-	return std::nullopt;
-}
\ No newline at end of file
+	return ret;
+}
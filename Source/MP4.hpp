@@ -1,62 +1,84 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
-#include <fstream>
+#include <memory>
 #include <optional>
-#include <string>
+#include <string_view>
 #include <vector>
 
+#include "MappedFile.hpp"
+
 // BASS_TAG_MP4 does not get iTunes-style metadata
 // Embedded album art (the "moov.udta.meta.ilst.covr" atom)
 // needs to be fetched manually
 //
+// Boxes (atoms) are read in place from a MappedFile, and a
+// box's children are only indexed the first time we go
+// looking in it, so the only pages we ever touch are the
+// headers on the way down to what we asked for. Boxes
+// with 64-bit sizes (e.g. a multi-GB "mdat") get skipped
+// like any other.
+//
 // Resources used:
 // https://dev.to/alfg/a-quick-dive-into-mp4-57fo
 // https://developer.apple.com/documentation/quicktime-file-format/user_data_atom
 // https://atomicparsley.sourceforge.net/mpeg-4files.html
 // https://github.com/google/ExoPlayer/issues/5694
 // https://xhelmboyx.tripod.com/formats/mp4-layout.txt
-// 
+//
 class MP4 {
 public:
-	class Atom {
-	public:
-		Atom(std::ifstream &file);
-		Atom(Atom &&) noexcept;
-		~Atom();
+	// What's inside a "data" box, under an ilst item
+	struct Data {
+		// "Well-known" type (e.g. 1 for UTF-8, 13 for JPEG)
+		std::uint32_t type = 0;
+		std::string_view value;
 
-		uint32_t size = 0;
-		std::string name;
+		// Only for images, and just "image/" if we don't know it
+		std::string_view GetMimeType() const;
+	};
 
-		uint8_t version = 0;
-		uint8_t flags[3] = { 0 };
+	class Box {
+	public:
+		Box(std::string_view type, std::string_view contents);
+
+		std::string_view GetType() const { return type; }
 
-		uint32_t dataSize = 0;
-		uint8_t *data = nullptr;
-		std::string mimeType;
+		// Everything after the header. Points
+		// straight into the file.
+		std::string_view GetContents() const { return contents; }
 
-		void Read();
-		constexpr static int32_t GetExtrasSize();
-		void ReadExtras();
-		void ReadData();
+		// Indexed the first time they're asked for. Stops at
+		// the first child that doesn't fit inside us.
+		const std::vector<Box> &GetChildren() const;
+		const Box *GetChild(std::string_view type) const;
 
-		bool IsValid() const;
-		int32_t GetBytes() const;
+		// Empty unless we're a "data" box
+		std::optional<Data> GetData() const;
 
 	private:
-		// Signed so we can easily have
-		// negative relative positions
-		int32_t bytes = 8;
+		std::string_view type;
+		std::string_view contents;
 
-		std::ifstream &file;
+		mutable std::optional<std::vector<Box>> children;
 	};
 
-	MP4(const std::filesystem::path &path);
+	explicit MP4(const std::filesystem::path &path);
+
+	// For a file that's already in memory (or mapped),
+	// which has to outlive us
+	explicit MP4(std::string_view file);
+
+	MP4(const MP4 &) = delete;
+	MP4 &operator=(const MP4 &) = delete;
 
-	std::optional<Atom> GetAtomAtPath(const std::vector<std::string> &path);
+	// e.g. { "moov", "udta", "meta", "ilst", "covr", "data" }
+	const Box *GetBoxAtPath(const std::vector<std::string_view> &path) const;
 
 private:
-	std::optional<Atom> SeekToAtom(const std::string &name, const std::optional<Atom> &parent = std::nullopt);
+	std::unique_ptr<MappedFile> file;
 
-	std::ifstream file;
-};
\ No newline at end of file
+	// The whole file, with the top-level boxes as its children
+	Box root;
+};
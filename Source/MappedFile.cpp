@@ -0,0 +1,86 @@
+#include "MappedFile.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "CConsole.h"
+
+MappedFile::MappedFile(const std::filesystem::path &path) {
+#ifdef _WIN32
+	// We only ever jump around a file's headers, so
+	// don't bother reading ahead
+	auto handle = CreateFileW(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_FLAG_RANDOM_ACCESS,
+		nullptr
+	);
+
+	if (handle == INVALID_HANDLE_VALUE) {
+		CConsole::Console.Print("Could not open " + path.u8string(), MSG_ALERT);
+		return;
+	}
+
+	file = handle;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		CConsole::Console.Print("Could not map " + path.u8string(), MSG_ALERT);
+		return;
+	}
+
+	data = static_cast<const std::uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (data)
+		size = static_cast<std::size_t>(fileSize.QuadPart);
+	else
+		CConsole::Console.Print("Could not map " + path.u8string(), MSG_ALERT);
+#else
+	auto descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor == -1) {
+		CConsole::Console.Print("Could not open " + path.u8string(), MSG_ALERT);
+		return;
+	}
+
+	struct stat info;
+	if (fstat(descriptor, &info) == 0 && info.st_size > 0) {
+		auto *view = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+		if (view != MAP_FAILED) {
+			madvise(view, static_cast<std::size_t>(info.st_size), MADV_RANDOM);
+
+			data = static_cast<const std::uint8_t *>(view);
+			size = static_cast<std::size_t>(info.st_size);
+		} else CConsole::Console.Print("Could not map " + path.u8string(), MSG_ALERT);
+	}
+
+	// The mapping holds on to the file by itself
+	close(descriptor);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+#else
+	if (data)
+		munmap(const_cast<std::uint8_t *>(data), size);
+#endif
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// A read-only view of a whole file. Nothing actually gets read
+// until we touch it (a page at a time), so peeking at a header,
+// or the last 128 bytes, only costs us the pages they live in.
+class MappedFile {
+public:
+	explicit MappedFile(const std::filesystem::path &path);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	// Empty files never get mapped
+	bool IsOpen() const { return data != nullptr; }
+
+	const std::uint8_t *GetData() const { return data; }
+	std::size_t GetSize() const { return size; }
+
+private:
+	const std::uint8_t *data = nullptr;
+	std::size_t size = 0;
+
+#ifdef _WIN32
+	void *file = nullptr;
+	void *mapping = nullptr;
+#endif
+};
@@ -1,27 +1,46 @@
 #include "Metadata.hpp"
 
+#include <algorithm>
+
 void Metadata::OnLoad(
 	const std::filesystem::path &path,
 	const std::string &extension,
 	HSTREAM streamHandle,
 	TagLoader *tagLoader,
-	AlbumArt *albumArt
+	ArtLoader *artLoader
+) {
+	// We can read the common formats ourselves, straight out of
+	// the file, for a few KB of I/O. Anything else (or anything
+	// that isn't what its extension says) is up to BASS.
+	if (!TagReader::CanRead(extension) || !TagReader(path).Read(extension, tagLoader, artLoader))
+		ReadFromStream(path, extension, streamHandle, tagLoader, artLoader);
+
+	// If title is STILL empty, use the filename
+	if (!tagLoader->HasTitle()) {
+		CConsole::Console.Print("Using filename in lieu of title", MSG_ALERT);
+		tagLoader->SetTitle(path.stem().u8string());
+	}
+}
+
+void Metadata::ReadFromStream(
+	const std::filesystem::path &path,
+	const std::string &extension,
+	HSTREAM streamHandle,
+	TagLoader *tagLoader,
+	ArtLoader *artLoader
 ) {
 	// Prefer ID3v2, since it doesn't have a character limit
 	auto id3v2 = BASS_ChannelGetTags(streamHandle, BASS_TAG_ID3V2);
 	if (id3v2) {
-		ID3V2 id3;
-
-		auto tags = id3.Read(&id3v2, albumArt == nullptr);
-		tagLoader->LoadFromTags(tags);
-
-		auto &frames = id3.GetFrames();
-		if (auto art = frames.find("art"); art != frames.end() && art->second.artData) {
-			albumArt->Load(
-				art->second.artData->mimeType,
-				art->second.artData->data,
-				art->second.artData->dataLength
-			);
+		// BASS hands us the whole tag, so its
+		// header tells us how big it is
+		ID3V2::View id3(std::string_view(id3v2, ID3V2::GetTagSize(id3v2)));
+
+		tagLoader->LoadFromTags(id3.GetTags(tagLoader->GetWantedTags()));
+
+		if (artLoader) {
+			if (auto art = id3.GetPicture())
+				artLoader->Load(std::string(art->mimeType), art->data.data(), art->data.size());
 		}
 	}
 
@@ -49,18 +68,12 @@ void Metadata::OnLoad(
 		}
 	}
 
-	// If title is STILL empty, use the filename
-	if (!tagLoader->HasTitle()) {
-		CConsole::Console.Print("Using filename in lieu of title", MSG_ALERT);
-		tagLoader->SetTitle(path.stem().u8string());
-	}
-
 	// Load embedded album art
-	if (albumArt) {
+	if (artLoader) {
 		if (extension == ".flac") {
 			auto art = reinterpret_cast<const TAG_FLAC_PICTURE *>(BASS_ChannelGetTags(streamHandle, BASS_TAG_FLAC_PICTURE));
 			if (art) {
-				albumArt->Load(
+				artLoader->Load(
 					art->mime,
 					const_cast<void *>(art->data),
 					art->length
@@ -70,11 +83,10 @@ void Metadata::OnLoad(
 			MP4 mp4(path);
 
 			// For now, we just want to grab "iTunes style" album art
-			auto atom = mp4.GetAtomAtPath({ "moov", "udta", "meta", "ilst", "covr", "data" });
+			auto box = mp4.GetBoxAtPath({ "moov", "udta", "meta", "ilst", "covr", "data" });
 
-			if (atom) {
-				atom->ReadData();
-				if (albumArt->Load(atom->mimeType, atom->data, atom->dataSize))
+			if (auto art = box ? box->GetData() : std::nullopt) {
+				if (artLoader->Load(std::string(art->GetMimeType()), art->value.data(), art->value.size()))
 					CConsole::Console.Print("Found iTunes-style embedded album art", MSG_DIAG);
 			}
 		}
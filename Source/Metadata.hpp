@@ -3,11 +3,12 @@
 #include <bass.h>
 #include <bassflac.h>
 
-#include "AlbumArt.hpp"
+#include "ArtLoader.hpp"
 #include "CConsole.h"
 #include "ID3V2.hpp"
 #include "MP4.hpp"
 #include "TagLoader.hpp"
+#include "TagReader.hpp"
 
 class Metadata {
 public:
@@ -16,9 +17,19 @@ public:
 		const std::string &extension,
 		HSTREAM streamHandle,
 		TagLoader *tagLoader,
-		AlbumArt *albumArt = nullptr
+		ArtLoader *artLoader = nullptr
 	);
 
 private:
+	// What we did before TagReader, and still
+	// do for everything it can't read
+	void ReadFromStream(
+		const std::filesystem::path &path,
+		const std::string &extension,
+		HSTREAM streamHandle,
+		TagLoader *tagLoader,
+		ArtLoader *artLoader
+	);
+
 	std::map<std::string, std::string> GetTags(const char *tags) const;
 };
\ No newline at end of file
@@ -0,0 +1,251 @@
+#include "MotionBlur.hpp"
+
+#include <algorithm>
+#include <string>
+
+#include "Buffer.hpp"
+#include "Canvas.hpp"
+#include "CConsole.h"
+
+namespace {
+// One triangle that covers the whole screen, so
+// there's no need for any vertices
+constexpr const char *VertexShader = R"(#version 150
+
+out vec2 texCoord;
+
+void main() {
+	texCoord = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(texCoord * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// Same as glAccum(GL_MULT) then glAccum(GL_ACCUM)
+constexpr const char *FragmentShader = R"(#version 150
+
+uniform sampler2D frame;
+uniform sampler2D history;
+uniform float intensity;
+
+in vec2 texCoord;
+
+out vec4 outputColor;
+
+void main() {
+	outputColor = vec4(mix(texture(frame, texCoord).rgb, texture(history, texCoord).rgb, intensity), 1.0);
+}
+)";
+}
+
+bool MotionBlur::Target::Create(int width, int height, GLint format, GLenum type) {
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, type, nullptr);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+	auto status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		CConsole::Console.Print("Motion blur framebuffer is incomplete (status " + std::to_string(status) + ")", MSG_ERROR);
+		return false;
+	}
+
+	Clear();
+
+	return true;
+}
+
+void MotionBlur::Target::Clear() {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void MotionBlur::Target::Destroy() {
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &texture);
+
+	framebuffer = texture = 0;
+}
+
+void MotionBlur::OnResize(int width, int height) {
+	if (width == this->width && height == this->height)
+		return;
+
+	this->width = width;
+	this->height = height;
+
+	// Worth another try at a new size
+	created = failed = false;
+}
+
+void MotionBlur::OnDestroy() {
+	frame.Destroy();
+	for (auto &target : history)
+		target.Destroy();
+
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteProgram(program);
+
+	vertexArray = program = 0;
+
+	created = false;
+}
+
+void MotionBlur::SetHalfResolution(bool halfResolution) {
+	if (halfResolution == this->halfResolution)
+		return;
+
+	this->halfResolution = halfResolution;
+	created = failed = false;
+}
+
+void MotionBlur::Reset() {
+	if (!created)
+		return;
+
+	for (auto &target : history)
+		target.Clear();
+}
+
+bool MotionBlur::Begin() {
+	if (failed || width <= 0 || height <= 0)
+		return false;
+
+	if (!created && !Create()) {
+		failed = true;
+		return false;
+	}
+
+	// Anything already drawn stays out of the blur
+	Canvas::Get().Flush();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, frame.framebuffer);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	began = true;
+
+	return true;
+}
+
+void MotionBlur::End(float intensity) {
+	if (!began)
+		return;
+
+	began = false;
+
+	auto &canvas = Canvas::Get();
+	canvas.Flush();
+
+	const auto previous = current;
+	current = 1 - current;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, history[current].framebuffer);
+	glViewport(0, 0, historyWidth, historyHeight);
+
+	// Every pixel gets replaced, so
+	// there's nothing to blend with
+	glDisable(GL_BLEND);
+
+	glUseProgram(program);
+	glUniform1f(intensityLocation, std::clamp(intensity, 0.0f, 1.0f));
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, history[previous].texture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, frame.texture);
+
+	glBindVertexArray(vertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glUseProgram(0);
+
+	glEnable(GL_BLEND);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, width, height);
+
+	// Our history's alpha is always 1,
+	// so this replaces what's there
+	const float positions[8] = {
+		0.0f, 0.0f,
+		0.0f, static_cast<float>(height),
+		static_cast<float>(width), static_cast<float>(height),
+		static_cast<float>(width), 0.0f
+	};
+
+	// Textures start at the bottom, we start at the top
+	const float texCoords[8] = {
+		0.0f, 1.0f,
+		0.0f, 0.0f,
+		1.0f, 0.0f,
+		1.0f, 1.0f
+	};
+
+	auto color = canvas.GetColor();
+
+	canvas.SetColor(1.0f, 1.0f, 1.0f, 1.0f);
+	canvas.DrawTextured(GL_TRIANGLES, 6, history[current].texture, positions, texCoords, Buffer::SquareBuffer.data());
+	canvas.SetColor(color[0], color[1], color[2], color[3]);
+}
+
+bool MotionBlur::Create() {
+	if (!program) {
+		program = Canvas::CreateProgram(VertexShader, FragmentShader);
+		if (!program)
+			return false;
+
+		glUseProgram(program);
+		glUniform1i(glGetUniformLocation(program, "frame"), 0);
+		glUniform1i(glGetUniformLocation(program, "history"), 1);
+		intensityLocation = glGetUniformLocation(program, "intensity");
+		glUseProgram(0);
+
+		glGenVertexArrays(1, &vertexArray);
+	}
+
+	frame.Destroy();
+	for (auto &target : history)
+		target.Destroy();
+
+	historyWidth = halfResolution ? std::max(width / 2, 1) : width;
+	historyHeight = halfResolution ? std::max(height / 2, 1) : height;
+
+	// The frame itself is only ever 8-bit anyway
+	if (!frame.Create(width, height, GL_RGBA8, GL_UNSIGNED_BYTE))
+		return false;
+
+	for (auto &target : history)
+		if (!target.Create(historyWidth, historyHeight, GL_RGBA16F, GL_HALF_FLOAT))
+			return false;
+
+	created = true;
+
+	CConsole::Console.Print(
+		"Blurring at " + std::to_string(historyWidth) + "x" + std::to_string(historyHeight),
+		MSG_DIAG
+	);
+
+	return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include <glad/glad.h>
+
+// Motion blur without an accumulation buffer. Everything drawn
+// between Begin() and End() goes into a texture of its own, and
+// then gets mixed into what we've been showing so far:
+//
+//		history = frame * (1 - intensity) + history * intensity
+//
+// which is exactly what glAccum(GL_MULT / GL_ACCUM / GL_RETURN)
+// gave us. History is kept in two half-float textures we swap
+// between (reading one while writing the other), so trails fade
+// all the way out instead of getting stuck on 8-bit rounding.
+//
+// History can be kept at half resolution, since it's a blur
+// anyway. That's a quarter of the pixels for the feedback pass.
+//
+// Only ever use this from the render thread.
+class MotionBlur {
+public:
+	void OnResize(int width, int height);
+	void OnDestroy();
+
+	bool GetHalfResolution() const { return halfResolution; }
+	void SetHalfResolution(bool halfResolution);
+
+	// Forgets everything we've shown so far
+	void Reset();
+
+	// False (and End() does nothing) if
+	// we couldn't set ourselves up
+	bool Begin();
+	void End(float intensity);
+
+private:
+	bool Create();
+
+	// One texture, and the framebuffer that draws into it
+	struct Target {
+		GLuint texture = 0;
+		GLuint framebuffer = 0;
+
+		bool Create(int width, int height, GLint format, GLenum type);
+		void Clear();
+		void Destroy();
+	};
+
+	int width = 0, height = 0;
+	int historyWidth = 0, historyHeight = 0;
+	bool halfResolution = false;
+
+	// Whether our targets match our size
+	bool created = false;
+
+	// So we only complain once
+	bool failed = false;
+
+	// Only true between Begin() and End()
+	bool began = false;
+
+	GLuint program = 0;
+	GLint intensityLocation = -1;
+
+	// The full screen triangle doesn't need any
+	// vertices, but core profiles still need this
+	GLuint vertexArray = 0;
+
+	Target frame;
+	std::array<Target, 2> history;
+
+	// The one that's been written to most recently
+	std::size_t current = 0;
+};
@@ -0,0 +1,328 @@
+#include "Palette.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <map>
+
+#include <bassflac.h>
+
+#include "MathCPP/Colour.hpp"
+
+#include "Hash.hpp"
+#include "ID3V2.hpp"
+#include "MP4.hpp"
+
+using namespace MathsCPP;
+
+Palette::Histogram Palette::Extract(const SDL_Surface *surface, const ColorSelection &selection, int samples) {
+	Histogram ret;
+
+	auto pixels = reinterpret_cast<const uint8_t *>(surface->pixels);
+
+	std::map<float, Bin> histogram;
+
+	Colour<float> color;
+
+	// Still using nearest neighbor for this...
+	// should we wait until Scale() is done before
+	// loading the colors?
+	//
+	// n = 1, but "VA-11 HALL-A - Second Round"'s
+	// album art sets a precedent for still
+	// using nearest neighbor. Bicubic ultimately
+	// makes the dominant color darker.
+	//
+	// Until proven otherwise, color selection is
+	// wrapped in "if (!scaled)"
+	auto hstep = std::max(1, surface->w / std::max(samples, 1));
+	auto vstep = std::max(1, surface->h / std::max(samples, 1));
+
+	double minSaturation = selection.minSaturation;
+	double minValue = selection.minValue;
+
+	while (histogram.empty()) {
+		for (auto x = 0; x < surface->w; x += hstep) {
+			for (auto y = 0; y < surface->h; y += vstep) {
+				auto index = y * surface->pitch + x * surface->format->BytesPerPixel;
+
+				color.r = pixels[index] / 255.0f;
+				color.g = pixels[index + 1] / 255.0f;
+				color.b = pixels[index + 2] / 255.0f;
+
+				auto hsv = color.ToHsv();
+
+				// Round to the nearest 0.5
+				// That gives us 720 possible hues
+				//hsv.h = (std::round(hsv.h * 2)) / 2;
+
+				// Round to the nearest _even_ number
+				// This only gives us 180 possible hues,
+				// but allows for fewer low-count bins
+				hsv.h = std::round(std::round(hsv.h) / 2) * 2;
+
+				// Exclude dark / low contrast colors
+				if (hsv.s >= minSaturation && hsv.v >= minValue) {
+					if (auto iter = histogram.find(hsv.h); iter != histogram.end()) {
+						++iter->second.count;
+						iter->second.s += hsv.s;
+						
+						/*
+						if (hsv.s > iter->second.s)
+							iter->second.s = hsv.s;
+						*/
+
+						iter->second.v += hsv.v;
+					} else
+						histogram.emplace(std::make_pair(hsv.h, Bin(1, hsv.h, hsv.s, hsv.v)));
+				}
+			}
+		}
+
+		// If we found nothing above the minimums,
+		// disable them
+		if (histogram.empty() && minSaturation > DBL_EPSILON) {
+			minSaturation = 0.0;
+			minValue = 0.0;
+		} else
+			break;
+	}
+
+	ret.clear();
+
+	std::size_t maxCount = std::numeric_limits<std::size_t>::min();
+	for (const auto &[hue, bin] : histogram) {
+		if (bin.count > maxCount)
+			maxCount = bin.count;
+	}
+
+	const auto minPercentage = static_cast<std::size_t>(
+		maxCount * selection.minPercentage
+	);
+
+	for (auto &[hue, bin] : histogram) {
+		// Filter out anything < a percentage of our max
+		if (bin.count >= minPercentage) {
+			ret.emplace(
+				Bin(
+					bin.count,
+					bin.h,
+					bin.s / bin.count,
+					bin.v / bin.count
+				)
+			);
+		}
+	}
+
+	// This compares each bin to _every_ other bin in the histogram
+	/*
+	for (auto iter = ret.begin(); iter != ret.end();) {
+		bool erased = false;
+		for (auto compare = ret.begin(); compare != ret.end(); ++compare) {
+			// When hues are separated by less than a
+			// certain number of degrees, choose the
+			// one with the highest count and discard
+			// the other.
+			if (compare != iter &&
+				std::abs(iter->second.h - compare->second.h) < minSeparation &&
+				iter->first < compare->first
+			) {
+				iter = ret.erase(iter);
+				erased = true;
+				break;
+			}
+		}
+		if (!erased)
+			++iter;
+	}
+	*/
+
+	// This compares each bin to the last bin inserted into the histogram
+	/*
+	auto tempHistogram = ret;
+	ret.clear();
+	for (auto iter = tempHistogram.rbegin(); iter != tempHistogram.rend(); ++iter) {
+		if (ret.empty()) {
+			ret.emplace(*iter);
+		} else if (std::abs(ret.begin()->h - iter->h) > 25.0) {
+			CConsole::Console.Print(
+				"Placing in histogram because hue is " +
+					std::to_string(iter->h) +
+					" vs last bin's hue of " +
+					std::to_string(ret.begin()->h),
+				MSG_DIAG
+			);
+			ret.emplace(*iter);
+		}
+	}
+	*/
+
+	// This compares each bin to the other, already-selected bins
+	//
+	// This also doesn't just take hue into account.
+	// If we had to remove the minimum saturation / value filters,
+	// we also check for value separation.
+	auto tempHistogram = ret;
+	ret.clear();
+	for (auto iter = tempHistogram.rbegin(); iter != tempHistogram.rend(); ++iter) {
+		if (ret.empty()) {
+			ret.emplace(*iter);
+		} else {
+			bool found = true;
+			for (auto compare = ret.begin(); compare != ret.end(); ++compare) {
+				auto rgb = Colour<float>::FromHsv(iter->h, iter->s, iter->v);
+				auto rgbComp = Colour<float>::FromHsv(compare->h, compare->s, compare->v);
+
+				auto distance =
+					std::sqrt(
+						std::pow(rgbComp.r - rgb.r, 2) +
+						std::pow(rgbComp.g - rgb.g, 2) +
+						std::pow(rgbComp.b - rgb.b, 2)
+					);
+
+				// https://gamedev.stackexchange.com/a/4472
+				// 360 - 0 (in degrees) needs to be 0, not 360
+				if ((180 - abs(abs(iter->h - compare->h) - 180) < selection.minHueSeparation &&
+					distance < selection.minRgbSeparation) ||
+					(minSaturation <= DBL_EPSILON && std::abs(compare->v - iter->v) < selection.minValueSeparation))
+					found = false;
+
+				/*
+				if (180 - abs(abs(iter->h - compare->h) - 180) < selection.minHueSeparation ||
+					(minSaturation <= DBL_EPSILON && std::abs(compare->v - iter->v) < selection.minValueSeparation))
+					found = false;
+				*/
+			}
+			if (found)
+				ret.emplace(*iter);
+		}
+	}
+
+	// FIXME: In This Moment's "Blood"'s red
+	//        is more pink right now, but
+	//        selecting the max saturation
+	//        instead of the average blows out
+	//        colors on other albums like 
+	//        "talking / Nana Hitsuji"
+
+	// If our histogram contains only a single color,
+	// add a darker / lighter variant of that color 
+	// for beat detection to toggle through
+	if (ret.size() == 1) {
+		auto deeperColor = *ret.begin();
+
+		if (deeperColor.v >= 0.5)
+			deeperColor.v = std::clamp(deeperColor.v / 1.75f, 0.0f, 1.0f);
+		else
+			deeperColor.v = std::clamp(deeperColor.v * 1.75f, 0.0f, 1.0f);
+
+		deeperColor.count -= 1;
+
+		ret.emplace(std::move(deeperColor));
+	}
+
+	return ret;
+}
+
+std::filesystem::path Palette::FindArt(const std::filesystem::path &folder, bool searchSubfolders) {
+	std::filesystem::path found;
+	bool foundPreferred = false;
+
+	auto find = [&](const std::filesystem::directory_entry &entry, bool breakOnFind = false) {
+		auto extension = entry.path().extension().u8string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
+		if (IsSupported(extension)) {
+			if (found.empty())
+				found = entry.path();
+
+			auto filename = entry.path().filename().u8string();
+			std::transform(filename.begin(), filename.end(), filename.begin(), tolower);
+
+			if ((filename.find("cover") == 0 ||
+				filename.find("front") == 0 ||
+				filename.find("folder") == 0) &&
+				!foundPreferred) {
+				found = entry.path();
+				foundPreferred = true;
+
+				// Optionally break when we find a preferred file
+				//
+				// This can be used with recursive_directory_iterator
+				// to avoid scanning _every_ subfolder.
+				//
+				// My music folder has a number of unsorted tracks
+				// in the root, and I don't want it scannning through
+				// 1TB of data when trying to load album art for those
+				//
+				// In those cases, this will just pick the first (preferred)
+				// album art file found in any of the subfolders. It should
+				// really just pick _nothing_, but I'm not sure what a good
+				// litmus test for this specific case would look like.
+				if (breakOnFind)
+					return true;
+			}
+		}
+
+		return false;
+	};
+
+	// A folder we can't read just doesn't have any art,
+	// rather than taking the whole library scan down with it
+	std::error_code error;
+
+	// Try to find in our current folder first
+	for (auto iter = std::filesystem::directory_iterator(folder, std::filesystem::directory_options::skip_permission_denied, error);
+		!error && iter != std::filesystem::directory_iterator();
+		iter.increment(error))
+		find(*iter);
+
+	// Then try any subfolders
+	// FIXME: we don't need to re-check files in the current folder
+	if (found.empty() && searchSubfolders) {
+		for (auto iter = std::filesystem::recursive_directory_iterator(folder, std::filesystem::directory_options::skip_permission_denied, error);
+			!error && iter != std::filesystem::recursive_directory_iterator();
+			iter.increment(error))
+			if (find(*iter, true)) break;
+	}
+
+	return found;
+}
+
+bool Palette::ReadEmbeddedArt(
+	const std::filesystem::path &path,
+	const std::string &extension,
+	HSTREAM streamHandle,
+	const ArtCallback &onArt
+) {
+	if (auto id3v2 = BASS_ChannelGetTags(streamHandle, BASS_TAG_ID3V2)) {
+		// BASS hands us the whole tag, so its
+		// header tells us how big it is
+		ID3V2::View id3(std::string_view(id3v2, ID3V2::GetTagSize(id3v2)));
+
+		if (auto art = id3.GetPicture()) {
+			onArt(std::string(art->mimeType), art->data.data(), art->data.size());
+			return true;
+		}
+	}
+
+	if (extension == ".flac") {
+		if (auto art = reinterpret_cast<const TAG_FLAC_PICTURE *>(BASS_ChannelGetTags(streamHandle, BASS_TAG_FLAC_PICTURE))) {
+			onArt(art->mime, art->data, art->length);
+			return true;
+		}
+	} else if (extension == ".mp4" || extension == ".m4a") {
+		MP4 mp4(path);
+
+		auto box = mp4.GetBoxAtPath({ "moov", "udta", "meta", "ilst", "covr", "data" });
+
+		if (auto art = box ? box->GetData() : std::nullopt) {
+			onArt(std::string(art->GetMimeType()), art->value.data(), art->value.size());
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::uint32_t Palette::Hash(const void *data, std::size_t length) {
+	return hash_32_fnv1a_const(reinterpret_cast<const char *>(data), length);
+}
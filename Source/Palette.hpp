@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <set>
+#include <string>
+#include <string_view>
+
+#include <bass.h>
+#include <SDL.h>
+
+// Picks visualizer colors out of album art. None of this
+// needs a window or GL, so popRocksAnalyse can work out
+// palettes ahead of time for AlbumArt to pick up.
+class Palette {
+public:
+	// What counts as a color worth picking. Kept
+	// in the Settings, but popRocksAnalyse has to
+	// get by without them.
+	struct ColorSelection {
+		double minPercentage = 0.02;
+		double minSaturation = 0.1;
+		double minValue = 0.25;
+		double minHueSeparation = 25.0;
+		double minValueSeparation = 0.1;
+		double minRgbSeparation = 0.70;
+	};
+
+	struct Bin {
+		Bin(std::size_t count, float h, float s, float v) : count(count), h(h), s(s), v(v) {}
+
+		std::size_t count;
+		float h = 0.0f;
+		float s = 0.0;
+		float v = 0.0f;
+	};
+
+	struct CompareBins {
+		bool operator()(const Bin &lhs, const Bin &rhs) const {
+			return 
+				lhs.count < rhs.count ||
+				(lhs.count == rhs.count && lhs.h < rhs.h);
+
+			// The original container is sorted by hue,
+			// so we'll never have two bins with the same
+			// hue.
+		}
+	};
+
+	using Histogram = std::multiset<Bin, CompareBins>;
+
+	// Roughly how many pixels we sample across each axis.
+	//
+	// This used to follow the album art's on-screen radius,
+	// but then the same album could end up with different
+	// colors depending on DPI (and we couldn't cache them).
+	static constexpr int DefaultSamples = 400;
+
+	static constexpr bool IsSupported(const std::string_view &lowercaseExtension) {
+		for (const auto &extension : SupportedExtensions)
+			if (lowercaseExtension == extension)
+				return true;
+
+		return false;
+	}
+
+	static Histogram Extract(
+		const SDL_Surface *surface,
+		const ColorSelection &selection,
+		int samples = DefaultSamples
+	);
+
+	// Finds cover art in a song's folder, preferring cover / front / folder
+	// images, then (if searchSubfolders) the first preferred image in any
+	// subfolder.
+	static std::filesystem::path FindArt(const std::filesystem::path &folder, bool searchSubfolders = true);
+
+	using ArtCallback = std::function<void(const std::string &mimeType, const void *data, std::size_t length)>;
+
+	// Calls onArt with a song's embedded art (ID3v2, FLAC or iTunes style),
+	// if it has any. Returns whether it did.
+	static bool ReadEmbeddedArt(
+		const std::filesystem::path &path,
+		const std::string &extension,
+		HSTREAM streamHandle,
+		const ArtCallback &onArt
+	);
+
+	// What AlbumArt and the cache both know art by
+	static std::uint32_t Hash(const void *data, std::size_t length);
+
+private:
+	constexpr inline static std::array<std::string_view, 3> SupportedExtensions = { ".jpg", ".png", ".webp" };
+};
@@ -0,0 +1,59 @@
+#include "PeakPyramid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+PeakPyramid::PeakPyramid(std::vector<Peak> base, double blockTime) : blockTime(blockTime) {
+	levels.emplace_back(std::move(base));
+
+	// Each level up merges pairs from the one below it. An odd
+	// peak out at the end just gets carried up on its own.
+	while (levels.back().size() > 1) {
+		const auto &below = levels.back();
+
+		std::vector<Peak> level;
+		level.reserve((below.size() + 1) / 2);
+
+		for (std::size_t i = 0; i < below.size(); i += 2) {
+			if (i + 1 == below.size()) {
+				level.emplace_back(below[i]);
+				break;
+			}
+
+			const auto &a = below[i];
+			const auto &b = below[i + 1];
+
+			auto rmsA = GetRms(a), rmsB = GetRms(b);
+
+			Peak peak;
+			peak.min = std::min(a.min, b.min);
+			peak.max = std::max(a.max, b.max);
+			peak.rms = static_cast<std::uint8_t>(std::lround(std::sqrt((rmsA * rmsA + rmsB * rmsB) / 2.0f) * 255.0f));
+
+			level.emplace_back(peak);
+		}
+
+		levels.emplace_back(std::move(level));
+	}
+}
+
+PeakPyramid::Peak PeakPyramid::Quantise(float min, float max, float rms) {
+	auto toSigned = [](float value) {
+		return static_cast<std::int8_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 127.0f));
+	};
+
+	Peak ret;
+	ret.min = toSigned(min);
+	ret.max = toSigned(max);
+	ret.rms = static_cast<std::uint8_t>(std::lround(std::clamp(rms, 0.0f, 1.0f) * 255.0f));
+
+	return ret;
+}
+
+std::size_t PeakPyramid::GetLevelFor(std::size_t columns) const {
+	std::size_t level = 0;
+	while (level + 1 < levels.size() && levels[level + 1].size() >= columns)
+		++level;
+
+	return level;
+}
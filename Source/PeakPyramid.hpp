@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A waveform overview of a track at every power-of-two
+// resolution, for drawing its shape at whatever width
+// we've got. Level 0 is the finest, and every level after
+// it has half as many peaks as the one before.
+//
+// Peaks are quantised down to a byte apiece, so even an
+// hour long track fits in a couple of megabytes.
+//
+// Never changes once it's built, so any thread can read it.
+class PeakPyramid {
+public:
+	struct Peak {
+		std::int8_t min = 0;
+		std::int8_t max = 0;
+		std::uint8_t rms = 0;
+	};
+
+	static_assert(sizeof(Peak) == 3, "Peaks get written to disk as is");
+
+	// base is level 0, where every peak covers blockTime seconds
+	PeakPyramid(std::vector<Peak> base, double blockTime);
+
+	static Peak Quantise(float min, float max, float rms);
+
+	static float GetMin(const Peak &peak) { return peak.min / 127.0f; }
+	static float GetMax(const Peak &peak) { return peak.max / 127.0f; }
+	static float GetRms(const Peak &peak) { return peak.rms / 255.0f; }
+
+	// The coarsest level that still has at least one peak per
+	// column, so drawing any one column only looks at a peak
+	// or two. Falls back to level 0 for really short tracks.
+	std::size_t GetLevelFor(std::size_t columns) const;
+
+	const std::vector<Peak> &GetLevel(std::size_t level) const { return levels[level]; }
+	std::size_t GetLevelCount() const { return levels.size(); }
+
+	// How much of the track a peak on level covers, in seconds
+	double GetBlockTime(std::size_t level = 0) const { return blockTime * (std::size_t(1) << level); }
+
+	double GetLength() const { return levels.front().size() * blockTime; }
+
+private:
+	std::vector<std::vector<Peak>> levels;
+	double blockTime = 0.0;
+};
@@ -1,30 +1,5 @@
 #include "Playlist.hpp"
 
-Playlist::Sorter::iterator Playlist::GuessDisc(Sorter &sorter, std::size_t index) {
-	std::size_t discGuess = 1;
-
-	// If we already have a track with
-	// the same index on another disc,
-	// make a new one.
-	for (const auto &disc : sorter) {
-		if (auto track = disc.second.find(index); track != disc.second.end())
-			++discGuess;
-	}
-
-	auto discSorter = sorter.find(discGuess);
-
-	if (discSorter == sorter.end()) {
-		discSorter = sorter.emplace(
-			std::make_pair(
-				discGuess,
-				std::map<std::size_t, std::pair<std::string, std::filesystem::path>>()
-			)
-		).first;
-	}
-
-	return discSorter;
-}
-
 std::optional<Playlist::Track> Playlist::OnLoad(
 	const std::filesystem::path &path,
 	const std::string_view &extension,
@@ -45,145 +20,96 @@ std::optional<Playlist::Track> Playlist::OnLoad(
 		}
 	}
 
-	Metadata metadata;
-
-	class Loader : public TagLoader {
-	public:
-		void LoadFromTags(const std::map<std::string, std::string> &tags) override {
-			if (auto title = tags.find("title"); title != tags.end())
-				SetTitle(title->second);
-			auto track = tags.find("tracknumber");
-			// MP4 tags can use "track" instead of "tracknumber"
-			if (track == tags.end()) track = tags.find("track");
-			if (track != tags.end()) {
-				try {
-					index = std::stoll(Fetcko::Utils::Split(track->second, '/')[0]);
-				}
-				catch (std::exception &e) {
-					CConsole::Console.Print("Track number '" + track->second + "' is not a number: " + e.what(), MSG_ALERT);
-				}
-			}
-			auto disc = tags.find("discnumber");
-			// MP4 tags can use "disc" instead of "discnumber"
-			if (disc == tags.end()) disc = tags.find("disc");
-			if (disc != tags.end()) {
-				try {
-					this->disc = std::stoll(Fetcko::Utils::Split(disc->second, '/')[0]);
-				}
-				catch (std::exception &e) {
-					CConsole::Console.Print("Disc number '" + disc->second + "' is not a number: " + e.what(), MSG_ALERT);
-				}
-			}
-		}
-		bool AreThereEmptyTags() const override {
-			return title.empty();
-		}
-		bool HasTitle() const override {
-			return !title.empty();
-		}
-
-		void LoadFromID3v1(const TAG_ID3 *id3) override {
-			if (!HasTitle() && id3->title[0] != '\0')
-				title = std::string(id3->title, id3->title + 30);
-		}
-
-		void SetTitle(const std::string &title) override {
-			this->title = title;
-		}
-
-		const std::string &GetTitle() const {
-			return title;
-		}
-
-		const std::optional<std::size_t> &GetIndex() const {
-			return index;
-		}
-
-		const std::optional<std::size_t> &GetDisc() const {
-			return disc;
-		}
-
-	private:
-		std::string title;
-		std::optional<std::size_t> disc = std::nullopt;
-		std::optional<std::size_t> index = std::nullopt;
-	};
-
-	std::vector<Title> titles;
-
-	Sorter sorter;
+	std::vector<std::filesystem::path> files;
 	for (const auto &iter : std::filesystem::recursive_directory_iterator(path)) {
 		auto extension = iter.path().extension().u8string();
 		std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
 
 		if (auto filename = iter.path().filename().u8string();
-			IsSupported(extension) &&
+			Track::IsSupported(extension) &&
 			// Ignore HFS attribute files (filenames that start with "._")
 			(filename.size() <= 1 || filename[0] != '.' || filename[1] != '_')
 		) {
-			auto streamHandle = openWithFlags(iter.path(), extension, BASS_STREAM_PRESCAN);
-
-			Loader loader;
-			metadata.OnLoad(iter.path(), extension, streamHandle, &loader);
-
-			Sorter::iterator discSorter = sorter.end();
-
-			// We _do_ want to make a copy here,
-			// since we may need to modify it
-			auto index = loader.GetIndex();
-			if (index) {
-				if (auto &disc = loader.GetDisc()) {
-					discSorter = sorter.find(*disc);
-
-					if (discSorter == sorter.end()) {
-						discSorter = sorter.emplace(
-							std::make_pair(
-								*disc,
-								std::map<std::size_t, std::pair<std::string, std::filesystem::path>>()
-							)
-						).first;
-					}
-				} else discSorter = GuessDisc(sorter, *index);
-			} else {
-				index = titles.size() + 1;
-				discSorter = GuessDisc(sorter, *index);
-			}
-
-			discSorter->second.emplace(
-				std::make_pair(
-					*index,
-					std::make_pair(
-						loader.GetTitle(),
-						iter.path()
-					)
-				)
-			);
-
-			BASS_StreamFree(streamHandle);
+			files.emplace_back(iter.path());
 		}
 	}
 
-	for (auto &&[number, disc] : sorter) {
-		for (auto &&track : disc) {
-			titles.emplace_back(Title{ number, track.first, std::move(track.second.first) });
-			files.emplace_back(std::move(track.second.second));
-		}
-	}
+	// Most albums' filenames start with their track numbers,
+	// so this is usually the right order already
+	std::sort(files.begin(), files.end());
 
-	LoadTitles(titles);
+	this->files = files;
+	currentFile = this->files.end();
 
-	currentFile = files.end();
+	scanner = std::make_unique<PlaylistScanner>(std::move(files), std::move(openWithFlags));
 
 	if (auto next = Next()) {
 		this->path = path;
+		onFirstFile = true;
 		return next;
 	}
 
 	return std::nullopt;
 }
 
-inline void Playlist::UpdateSize() {
-	em = this->titles.begin()->MeasureText("M");
+bool Playlist::Update(bool started) {
+	if (!scanner)
+		return false;
+
+	auto entries = scanner->Take();
+	if (!entries)
+		return false;
+
+	scanner.reset();
+
+	std::optional<std::filesystem::path> current;
+	if (currentFile != files.end())
+		current = *currentFile;
+
+	files.clear();
+	files.reserve(entries->size());
+
+	std::vector<Title> titles;
+	titles.reserve(entries->size());
+
+	for (auto &entry : *entries) {
+		titles.emplace_back(Title{ entry.disc, entry.index, std::move(entry.title) });
+		files.emplace_back(std::move(entry.path));
+	}
+
+	LoadTitles(titles);
+
+	// Nobody's heard any of the song we guessed at, so
+	// start from the top of the album instead
+	if (!started && onFirstFile && !files.empty())
+		currentFile = files.begin();
+	else
+		currentFile = current ? std::find(files.begin(), files.end(), *current) : files.end();
+
+	return true;
+}
+
+void Playlist::Measure() {
+	size = { 0, 0 };
+	rowHeight = 0;
+
+	if (rows.empty() || !font)
+		return;
+
+	int emWidth = 0, emHeight = 0;
+	TTF_SizeUTF8(font, "M", &emWidth, &emHeight);
+	em = { static_cast<float>(emWidth), static_cast<float>(emHeight) };
+
+	// The same height every Text gives itself
+	rowHeight = static_cast<int>(emHeight + TTF_FontDescent(font) / 2.0f);
+
+	// Shaping every title would take a while on a big
+	// playlist, so rows only get a width once they've been
+	// on screen (see OnLoop())
+	for (auto &row : rows)
+		row.width = 0;
+
+	size.y = rowHeight * static_cast<int>(rows.size());
 
 	rect[0] = -em.x / 2;
 	rect[1] = -em.y / 2;
@@ -195,6 +121,17 @@ inline void Playlist::UpdateSize() {
 	rect[7] = -em.x / 2;
 }
 
+std::string Playlist::GetTitle(std::size_t row) const {
+	return titleArena.substr(rows[row].offset, rows[row].length);
+}
+
+void Playlist::ClearVisibleTitles() {
+	for (auto &[row, title] : visibleTitles)
+		title.OnDestroy();
+
+	visibleTitles.clear();
+}
+
 void Playlist::OnInit(int windowWidth, int windowHeight, TTF_Font *font, float scale) {
 	this->windowWidth = windowWidth;
 	this->windowHeight = windowHeight;
@@ -205,29 +142,28 @@ void Playlist::OnInit(int windowWidth, int windowHeight, TTF_Font *font, float s
 void Playlist::OnResize(int windowWidth, int windowHeight, float scale) {
 	this->windowWidth = windowWidth;
 	this->windowHeight = windowHeight;
-	if (this->scale != scale && !titles.empty()) {
-		size = { 0, 0 };
-		for (auto &title : titles) {
-			title.OnInit(font);
-
-			size.y += title.GetSize().y;
-			if (title.GetSize().x > size.x)
-				size.x = title.GetSize().x;
-		}
-
-		UpdateSize();
+	if (this->scale != scale && !rows.empty()) {
+		// They'll get laid out again at the new
+		// size as soon as they're back on screen
+		ClearVisibleTitles();
+		Measure();
 	}
 	this->scale = scale;
 }
 
 void Playlist::Clear() {
+	scanner.reset();
+
 	path.clear();
 	files.clear();
+	currentFile = files.end();
+	onFirstFile = false;
 
-	for (auto &title : titles)
-		title.OnDestroy();
+	ClearVisibleTitles();
 
-	titles.clear();
+	titleArena.clear();
+	rows.clear();
+	rowHeight = 0;
 
 	cue.reset();
 }
@@ -240,6 +176,8 @@ std::optional<Playlist::Track> Playlist::Current() {
 }
 
 std::optional<Playlist::Track> Playlist::Previous() {
+	onFirstFile = false;
+
 	if (files.empty()) {
 		if (cue)
 			return Track{ cue->GetFilePath(), cue->Previous().startTime };
@@ -254,6 +192,8 @@ std::optional<Playlist::Track> Playlist::Previous() {
 }
 
 std::optional<Playlist::Track> Playlist::Next() {
+	onFirstFile = false;
+
 	if (files.empty()) {
 		if (cue)
 			return Track{ cue->GetFilePath(), cue->Next().startTime };
@@ -281,18 +221,95 @@ const std::optional<Playlist::Track> Playlist::Next() const {
 	return Track{ *(currentFile + 1) };
 }
 
+std::optional<Playlist::Track> Playlist::Upcoming() const {
+	if (files.empty()) {
+		if (cue)
+			return Track{ cue->GetFilePath(), const_cast<const Cue *>(cue.get())->Next().startTime };
+
+		return std::nullopt;
+	}
+
+	// Same as Next(), we go back around to the start
+	if (currentFile == files.end() || currentFile + 1 == files.end())
+		return Track{ files.front() };
+
+	return Track{ *(currentFile + 1) };
+}
+
+std::vector<Playlist::Track> Playlist::Surrounding(std::size_t behind, std::size_t ahead) const {
+	std::vector<Track> ret;
+
+	std::size_t current = 0, count = 0;
+	std::function<Track(std::size_t)> trackAt;
+
+	if (!files.empty()) {
+		if (currentFile == files.end())
+			return ret;
+
+		current = static_cast<std::size_t>(currentFile - files.begin());
+		count = files.size();
+		trackAt = [this](std::size_t index) { return Track{ files[index] }; };
+	} else if (cue && cue->GetCurrentTrack() != cue->GetTracks().end()) {
+		const auto &tracks = cue->GetTracks();
+
+		current = static_cast<std::size_t>(cue->GetCurrentTrack() - tracks.begin());
+		count = tracks.size();
+		trackAt = [this, &tracks](std::size_t index) {
+			return Track{
+				cue->GetFilePath(),
+				tracks[index].startTime,
+				index + 1 < tracks.size() ?
+					std::optional<double>(tracks[index + 1].startTime - tracks[index].startTime) :
+					std::nullopt
+			};
+		};
+	} else return ret;
+
+	for (std::size_t distance = 1; distance <= std::max(behind, ahead); ++distance) {
+		if (distance <= ahead && current + distance < count)
+			ret.emplace_back(trackAt(current + distance));
+		if (distance <= behind && distance <= current)
+			ret.emplace_back(trackAt(current - distance));
+	}
+
+	return ret;
+}
+
+std::vector<Playlist::Track> Playlist::Album() const {
+	std::vector<Track> ret;
+
+	if (!files.empty() || !cue)
+		return ret;
+
+	const auto &tracks = cue->GetTracks();
+	ret.reserve(tracks.size());
+
+	for (std::size_t i = 0; i < tracks.size(); ++i) {
+		ret.emplace_back(Track{
+			cue->GetFilePath(),
+			tracks[i].startTime,
+			i + 1 < tracks.size() ?
+				std::optional<double>(tracks[i + 1].startTime - tracks[i].startTime) :
+				std::nullopt
+		});
+	}
+
+	return ret;
+}
+
 void Playlist::OnLoop(Vector2i pos, float maxHeight, float alpha) {
 	// We want to store its _origin_
 	this->pos = pos;
 
-	if (!files.empty())
+	// Nothing to show until we've read everyone's tags
+	if (!files.empty() && rows.size() == files.size())
 		OnLoop(files, currentFile, pos, maxHeight, alpha);
 	else if (cue)
 		OnLoop(cue->GetTracks(), cue->GetCurrentTrack(), pos, maxHeight, alpha);
 }
 
 std::optional<Playlist::Track> Playlist::OnMouseClicked(const Vector2i &mousePos) {
-	if (!titles.empty() && mousePos.y >= pos.y) {
+	if (!rows.empty() && rowHeight > 0 && (cue || rows.size() == files.size()) && mousePos.y >= pos.y) {
 		const auto offset = 
 			cue ?
 				std::distance(cue->GetTracks().begin(), cue->GetCurrentTrack()) :
@@ -303,9 +320,10 @@ std::optional<Playlist::Track> Playlist::OnMouseClicked(const Vector2i &mousePos
 				std::distance(cue->GetCurrentTrack(), cue->GetTracks().end()) :
 				std::distance(currentFile, files.end());
 
-		if (auto index = (mousePos.y - pos.y) / titles.begin()->GetSize().y; index < distance) {
-			if (mousePos.x >= pos.x && mousePos.x <= pos.x + titles[offset + index].GetSize().x) {
+		if (auto index = (mousePos.y - pos.y) / rowHeight; index < distance) {
+			if (mousePos.x >= pos.x && mousePos.x <= pos.x + rows[offset + index].width) {
 				if (!files.empty()) {
+					onFirstFile = false;
 					currentFile += index;
 					return currentFile == files.end() ? Track{ *(--currentFile) } : Track{ *currentFile };
 				} else if (cue) {
@@ -2,31 +2,48 @@
 
 #include <array>
 #include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string_view>
 #include <vector>
 
 #include "Buffer.hpp"
+#include "Canvas.hpp"
 #include "Cue.hpp"
 #include "Metadata.hpp"
+#include "PlaylistScanner.hpp"
 #include "TagLoader.hpp"
 #include "Text.hpp"
+#include "Track.hpp"
 #include "Utils.hpp"
 
 class Playlist {
 public:
-	struct Track {
-		std::filesystem::path path;
-		double startTime = 0.0;
-	};
+	using Track = ::Track;
 
+	// For a folder, this returns right away with the first
+	// song (by filename) so it can start playing. The proper
+	// order comes from the songs' tags, which get read in the
+	// background and picked up by Update().
 	std::optional<Track> OnLoad(
 		const std::filesystem::path &path,
 		const std::string_view &extension,
 		std::function<HSTREAM(const std::filesystem::path &, const std::string &, DWORD)> openWithFlags
 	);
 
+	// Picks up a finished tag scan, if there is one. The
+	// current song stays current, unless nothing's been
+	// played yet (started is false) and we're still on the
+	// song OnLoad() picked. Then the first song in tag order
+	// takes over, so check Current() afterwards. Returns true
+	// if the playlist changed.
+	//
+	// Only ever call this from the render thread.
+	bool Update(bool started = true);
+
 	void OnInit(int windowWidth, int windowHeight, TTF_Font *font, float scale = 1.0f);
 	void OnResize(int windowWidth, int windowHeight, float scale = 1.0f);
 
@@ -41,6 +58,21 @@ public:
 	//        that intuitive
 	const std::optional<Track> Next() const;
 
+	// Whichever track Next() would move on to,
+	// without moving on to it
+	std::optional<Track> Upcoming() const;
+
+	// Up to the given number of tracks either side of the
+	// current one, nearest first. At the same distance,
+	// the upcoming track comes before the previous one.
+	//
+	// The current track itself isn't included.
+	std::vector<Track> Surrounding(std::size_t behind, std::size_t ahead) const;
+
+	// Every track of the loaded cue sheet in order,
+	// or nothing if we're not playing a cue sheet
+	std::vector<Track> Album() const;
+
 	void OnLoop(Vector2i pos, float maxHeight, float alpha);
 
 	std::optional<Track> OnMouseClicked(const Vector2i &mousePos);
@@ -52,20 +84,7 @@ public:
 		return lowercaseExtension == ".cue";
 	}
 
-	static constexpr auto &GetSupportedExtensions() {
-		return SupportedExtensions;
-	}
-
 private:
-	constexpr inline static std::array<std::string_view, 9> SupportedExtensions = { ".flac", ".mp3", ".m4a", ".mp4", ".ape", ".wv", ".ogg", ".aac", ".wav"};
-
-	static constexpr bool IsSupported(const std::string_view &lowercaseExtension) {
-		for (const auto &extension : SupportedExtensions)
-			if (lowercaseExtension == extension)
-				return true;
-
-		return false;
-	}
 
 	struct Title {
 		std::size_t disc;
@@ -80,19 +99,10 @@ private:
 
 	std::optional<std::filesystem::path> FindCue(const std::filesystem::path &path);
 
-	inline void UpdateSize();
-
-	// First key is disc #
-	// Second key is track #
-	using Sorter = std::map<std::size_t, std::map<std::size_t, std::pair<std::string, std::filesystem::path>>>;
-	Sorter::iterator GuessDisc(Sorter &sorter, std::size_t index);
-
 	template <typename T>
 	void LoadTitles(const std::vector<T> &titles) {
 		if (titles.empty()) return;
 
-		size = { 0, 0 };
-
 		std::size_t numberOfDiscs = 1;
 		std::size_t maxTracksPerDisc = 1;
 		for (const auto &title : titles) {
@@ -102,9 +112,12 @@ private:
 				maxTracksPerDisc = title.index;
 		}
 
+		rows.reserve(titles.size());
+
 		auto digits = Fetcko::Utils::GetNumberOfDigits(maxTracksPerDisc);
+		std::stringstream stream;
 		for (const auto &title : titles) {
-			std::stringstream stream;
+			stream.str("");
 
 			// If we have multiple discs,
 			// also display disc number
@@ -124,18 +137,16 @@ private:
 				<< " - " 
 				<< title;
 
-			Text text;
-			text.OnInit(font);
-			text.SetText(stream.str());
+			auto text = stream.str();
 
-			size.y += text.GetSize().y;
-			if (text.GetSize().x > size.x)
-				size.x = text.GetSize().x;
+			rows.emplace_back(Row{ titleArena.size(), text.size(), 0 });
 
-			this->titles.emplace_back(std::move(text));
+			// Keep the terminator, so TTF can measure it in place
+			titleArena.append(text);
+			titleArena.push_back('\0');
 		}
 
-		UpdateSize();
+		Measure();
 	}
 
 	template<typename T>
@@ -151,63 +162,115 @@ private:
 		if (rect[3] > maxHeight + em.y / 2 - pos.y)
 			rect[3] = rect[5] = maxHeight + em.y / 2 - pos.y;
 
-		glTranslatef(static_cast<GLfloat>(pos.x), static_cast<GLfloat>(pos.y), 0.0f);
+		auto &canvas = Canvas::Get();
 
-		glVertexPointer(2, GL_FLOAT, 0, rect);
-
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glEnableClientState(GL_COLOR_ARRAY);
+		canvas.Translate(static_cast<float>(pos.x), static_cast<float>(pos.y));
 
 		rectColors[3] = rectColors[15] = alpha;
 
-		glColorPointer(4, GL_FLOAT, 0, rectColors);
-
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, Buffer::SquareBuffer.data());
-		glDisableClientState(GL_VERTEX_ARRAY);
-		glDisableClientState(GL_COLOR_ARRAY);
+		canvas.Draw(GL_TRIANGLES, 6, rect, Buffer::SquareBuffer.data(), rectColors);
+		canvas.LoadIdentity();
 
-		glLoadIdentity();
+		if (rows.empty() || rowHeight <= 0)
+			return;
 
-		std::size_t maxIndex = static_cast<std::size_t>(
-			titles.empty() ?
-				0 :
-				(maxHeight - pos.y) / titles.begin()->GetSize().y
-		);
+		std::size_t maxIndex = static_cast<std::size_t>((maxHeight - pos.y) / rowHeight);
 
-		auto distance = static_cast<int32_t>(
+		auto distance = static_cast<std::size_t>(
 			std::distance(tracks.begin(), current)
 		);
-		pos.y -= titles.begin()->GetSize().y * distance;
-
-		auto iter = tracks.begin();
-		for (const auto &[i, title] : Fetcko::Utils::Enumerate(titles)) {
-			if (pos.y + title.GetSize().y > maxHeight)
-				return;
 
-			if (iter == current)
-				glColor4f(1.0f, 1.0f, 1.0f, alpha);
-			else
-				glColor4f(0.6f, 0.6f, 0.6f, alpha - (static_cast<float>(i - distance) / maxIndex));
+		// Everything before the current track is faded out
+		// completely, so the current track is the first row
+		// we draw, and it always sits at pos.y
+		const auto rowTop = [top = static_cast<float>(pos.y), this, distance](std::size_t i) {
+			return top + static_cast<float>(rowHeight) * (static_cast<float>(i) - static_cast<float>(distance));
+		};
+		const auto fits = [&rowTop, maxHeight, this](std::size_t i) {
+			return rowTop(i) + rowHeight <= maxHeight;
+		};
+
+		// Reduce the height as we near the end of the playlist
+		if (rows.size() >= 2 && fits(rows.size() - 2))
+			rect[3] = rect[5] = rowTop(rows.size() - 2) + em.y / 2.0f;
+
+		std::size_t last = distance;
+		while (last < rows.size() && fits(last))
+			++last;
+
+		// Drop whatever's scrolled out of view...
+		for (auto iter = visibleTitles.begin(); iter != visibleTitles.end();) {
+			if (iter->first < distance || iter->first >= last) {
+				iter->second.OnDestroy();
+				iter = visibleTitles.erase(iter);
+			} else ++iter;
+		}
 
-			title.OnLoop(pos.x, pos.y);
+		// ...and only lay out what's scrolled into it
+		for (auto i = distance; i < last; ++i) {
+			auto [title, inserted] = visibleTitles.try_emplace(i);
+			if (inserted) {
+				title->second.OnInit(font);
+				title->second.SetText(GetTitle(i));
+
+				// Now that it's been laid out, we know how wide it
+				// is. The background only ever grows to fit.
+				rows[i].width = title->second.GetSize().x;
+				if (rows[i].width > size.x) {
+					size.x = rows[i].width;
+					rect[4] = rect[6] = size.x + em.x / 2;
+				}
+			}
 
-			// Reduce the height as we near the end of the playlist
-			if (i == titles.size() - 2 && pos.y < maxHeight)
-				rect[3] = rect[5] = pos.y + em.y / 2.0f;
+			if (i == distance)
+				canvas.SetColor(1.0f, 1.0f, 1.0f, alpha);
+			else
+				canvas.SetColor(0.6f, 0.6f, 0.6f, alpha - (static_cast<float>(i - distance) / maxIndex));
 
-			pos.y += title.GetSize().y;
+			title->second.OnLoop(pos.x, pos.y);
 
-			++iter;
+			pos.y += rowHeight;
 		}
 	}
 
+	// (Re)measures the rows' height and fits our background
+	// rectangle around them. Widths get filled in by OnLoop(),
+	// as rows come on screen.
+	void Measure();
+
+	std::string GetTitle(std::size_t row) const;
+
+	// Forgets every title's text, but not the titles themselves
+	void ClearVisibleTitles();
+
 	std::filesystem::path path;
 	std::vector<std::filesystem::path> files;
 	std::vector<std::filesystem::path>::iterator currentFile = files.end();
 
+	// Whether we're still on the song OnLoad() started
+	// with, i.e. the first one by filename
+	bool onFirstFile = false;
+
 	int windowWidth = 0, windowHeight = 0;
 	TTF_Font *font = nullptr;
-	std::vector<Text> titles;
+
+	// Every title lives in one string, one after the other. Rows
+	// are all the same height, so where each one goes is just
+	// arithmetic. Only the rows on screen get a Text (keyed by
+	// their row), and only for as long as they stay there.
+	struct Row {
+		std::size_t offset = 0;
+		std::size_t length = 0;
+
+		// 0 until the row's been on screen
+		int width = 0;
+	};
+
+	std::string titleArena;
+	std::vector<Row> rows;
+	int rowHeight = 0;
+
+	std::map<std::size_t, Text> visibleTitles;
 
 	Vector2i pos{ 0, 0 };
 	Vector2i size{ 0, 0 };
@@ -215,6 +278,10 @@ private:
 
 	std::unique_ptr<Cue> cue;
 
+	// Until this finishes, files is in filename
+	// order and we don't have any titles
+	std::unique_ptr<PlaylistScanner> scanner;
+
 	float rect[8] = { 0.0f };
 	float rectColors[16] = {
 		0.0f, 0.0f, 0.0f, 0.75f,
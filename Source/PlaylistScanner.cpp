@@ -0,0 +1,255 @@
+#include "PlaylistScanner.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "MathCPP/Duration.hpp"
+
+#include "CConsole.h"
+#include "Library.hpp"
+#include "Metadata.hpp"
+#include "TagLoader.hpp"
+#include "TagReader.hpp"
+#include "Utils.hpp"
+#include "WorkStealingPool.hpp"
+
+using namespace MathsCPP;
+
+namespace {
+class Loader : public TagLoader {
+public:
+	void LoadFromTags(const std::map<std::string, std::string> &tags) override {
+		if (auto title = tags.find("title"); title != tags.end())
+			SetTitle(title->second);
+		auto track = tags.find("tracknumber");
+		// MP4 tags can use "track" instead of "tracknumber"
+		if (track == tags.end()) track = tags.find("track");
+		if (track != tags.end()) {
+			try {
+				index = std::stoll(Fetcko::Utils::Split(track->second, '/')[0]);
+			}
+			catch (std::exception &e) {
+				CConsole::Console.Print("Track number '" + track->second + "' is not a number: " + e.what(), MSG_ALERT);
+			}
+		}
+		auto disc = tags.find("discnumber");
+		// MP4 tags can use "disc" instead of "discnumber"
+		if (disc == tags.end()) disc = tags.find("disc");
+		if (disc != tags.end()) {
+			try {
+				this->disc = std::stoll(Fetcko::Utils::Split(disc->second, '/')[0]);
+			}
+			catch (std::exception &e) {
+				CConsole::Console.Print("Disc number '" + disc->second + "' is not a number: " + e.what(), MSG_ALERT);
+			}
+		}
+	}
+	std::vector<std::string_view> GetWantedTags() const override {
+		return { "title", "tracknumber", "track", "discnumber", "disc" };
+	}
+	bool AreThereEmptyTags() const override {
+		return title.empty();
+	}
+	bool HasTitle() const override {
+		return !title.empty();
+	}
+
+	void LoadFromID3v1(const TAG_ID3 *id3) override {
+		if (!HasTitle() && id3->title[0] != '\0')
+			title = std::string(id3->title, id3->title + 30);
+	}
+
+	void SetTitle(const std::string &title) override {
+		this->title = title;
+	}
+
+	Library::Entry ToEntry() && {
+		Library::Entry ret;
+		ret.title = std::move(title);
+		ret.disc = disc;
+		ret.index = index;
+
+		return ret;
+	}
+
+private:
+	std::string title;
+	std::optional<std::size_t> disc = std::nullopt;
+	std::optional<std::size_t> index = std::nullopt;
+};
+}
+
+PlaylistScanner::PlaylistScanner(std::vector<std::filesystem::path> files, OpenFunction openWithFlags) :
+	files(std::move(files)),
+	openWithFlags(std::move(openWithFlags)) {
+	thread = std::thread(&PlaylistScanner::Scan, this);
+}
+
+PlaylistScanner::~PlaylistScanner() {
+	canceled = true;
+
+	if (thread.joinable())
+		thread.join();
+
+	delete published.exchange(nullptr);
+}
+
+std::optional<std::vector<PlaylistScanner::Entry>> PlaylistScanner::Take() {
+	auto entries = published.exchange(nullptr);
+	if (!entries)
+		return std::nullopt;
+
+	std::optional<std::vector<Entry>> ret = std::move(*entries);
+	delete entries;
+
+	return ret;
+}
+
+PlaylistScanner::Sorter::iterator PlaylistScanner::GuessDisc(Sorter &sorter, std::size_t index) {
+	std::size_t discGuess = 1;
+
+	// If we already have a track with
+	// the same index on another disc,
+	// make a new one.
+	for (const auto &disc : sorter) {
+		if (auto track = disc.second.find(index); track != disc.second.end())
+			++discGuess;
+	}
+
+	auto discSorter = sorter.find(discGuess);
+
+	if (discSorter == sorter.end()) {
+		discSorter = sorter.emplace(
+			std::make_pair(
+				discGuess,
+				std::map<std::size_t, std::pair<std::string, std::filesystem::path>>()
+			)
+		).first;
+	}
+
+	return discSorter;
+}
+
+void PlaylistScanner::Scan() {
+	auto start = std::chrono::system_clock::now();
+
+	// Tags are read all at once, but sorted one at a time (in
+	// the order we were given) so guessed discs come out the
+	// same every time
+	std::vector<Library::Entry> tags(files.size());
+
+	auto &library = Library::Get();
+	std::atomic<std::size_t> read = 0;
+
+	{
+		WorkStealingPool pool;
+
+		for (std::size_t i = 0; i < files.size(); ++i) {
+			pool.Submit([this, &tags, &library, &read, i] {
+				if (canceled)
+					return;
+
+				// Only songs we haven't seen before (or
+				// that have changed since) get read
+				auto stamp = Library::GetStamp(files[i]);
+				if (stamp) {
+					if (auto entry = library.Find(files[i], *stamp)) {
+						tags[i] = std::move(*entry);
+						return;
+					}
+				}
+
+				tags[i] = Read(files[i]);
+				++read;
+
+				if (stamp) {
+					tags[i].stamp = *stamp;
+					library.Store(files[i], tags[i]);
+				}
+			});
+		}
+
+		pool.Wait();
+	}
+
+	// Even if we were canceled, whatever
+	// we did read is worth keeping
+	library.Save();
+
+	if (canceled)
+		return;
+
+	Sorter sorter;
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		Sorter::iterator discSorter = sorter.end();
+
+		// We _do_ want to make a copy here,
+		// since we may need to modify it
+		auto index = tags[i].index;
+		if (index) {
+			if (auto &disc = tags[i].disc) {
+				discSorter = sorter.find(*disc);
+
+				if (discSorter == sorter.end()) {
+					discSorter = sorter.emplace(
+						std::make_pair(
+							*disc,
+							std::map<std::size_t, std::pair<std::string, std::filesystem::path>>()
+						)
+					).first;
+				}
+			} else discSorter = GuessDisc(sorter, *index);
+		} else {
+			index = i + 1;
+			discSorter = GuessDisc(sorter, *index);
+		}
+
+		discSorter->second.emplace(
+			std::make_pair(
+				*index,
+				std::make_pair(
+					std::move(tags[i].title),
+					files[i]
+				)
+			)
+		);
+	}
+
+	auto entries = new std::vector<Entry>();
+	entries->reserve(files.size());
+
+	for (auto &&[number, disc] : sorter) {
+		for (auto &&track : disc)
+			entries->emplace_back(Entry{ number, track.first, std::move(track.second.first), std::move(track.second.second) });
+	}
+
+	auto end = std::chrono::system_clock::now();
+
+	CConsole::Console.Print(
+		"Read tags for " + std::to_string(read) + " songs (and " + std::to_string(files.size() - read) +
+			" more from the library) in " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds",
+		MSG_DIAG
+	);
+
+	delete published.exchange(entries);
+}
+
+Library::Entry PlaylistScanner::Read(const std::filesystem::path &path) const {
+	auto extension = path.extension().u8string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
+
+	// TagReader doesn't need a stream at all. For everything
+	// else, no BASS_STREAM_PRESCAN, which would have BASS read
+	// through the whole file (for MP3s) just so we could get a title.
+	HSTREAM streamHandle = 0;
+	if (!TagReader::CanRead(extension))
+		streamHandle = openWithFlags(path, extension, BASS_STREAM_DECODE);
+
+	Loader loader;
+	Metadata().OnLoad(path, extension, streamHandle, &loader);
+
+	if (streamHandle)
+		BASS_StreamFree(streamHandle);
+
+	return std::move(loader).ToEntry();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <bass.h>
+
+#include "Library.hpp"
+
+// Works out the order of a folder's tracks from their tags,
+// off the render thread. Every file's tags get read on a
+// WorkStealingPool, by TagReader where it can (a few KB
+// each), otherwise from a stream that's opened without
+// BASS_STREAM_PRESCAN, so only the headers (and an ID3v1
+// tag at the end) get read instead of the whole file.
+//
+// Songs that are already in the Library, and haven't
+// changed since, don't get read at all.
+//
+// Dropping (or destroying) a scanner cancels it.
+class PlaylistScanner {
+public:
+	using OpenFunction = std::function<HSTREAM(const std::filesystem::path &, const std::string &, DWORD)>;
+
+	struct Entry {
+		std::size_t disc = 1;
+		std::size_t index = 0;
+		std::string title;
+		std::filesystem::path path;
+	};
+
+	// files should already be in a sensible order (we fall back
+	// to it for anything without a track number)
+	PlaylistScanner(std::vector<std::filesystem::path> files, OpenFunction openWithFlags);
+	~PlaylistScanner();
+
+	PlaylistScanner(const PlaylistScanner &) = delete;
+	PlaylistScanner &operator=(const PlaylistScanner &) = delete;
+
+	// Every track in playlist order, but only once we're done
+	// (and only the once). Only ever call this from the render
+	// thread.
+	std::optional<std::vector<Entry>> Take();
+
+private:
+	// First key is disc #
+	// Second key is track #
+	using Sorter = std::map<std::size_t, std::map<std::size_t, std::pair<std::string, std::filesystem::path>>>;
+	static Sorter::iterator GuessDisc(Sorter &sorter, std::size_t index);
+
+	void Scan();
+	Library::Entry Read(const std::filesystem::path &path) const;
+
+	std::vector<std::filesystem::path> files;
+	OpenFunction openWithFlags;
+
+	std::atomic<bool> canceled = false;
+
+	// Written by the scanning thread and exchanged
+	// out by the render thread
+	std::atomic<std::vector<Entry> *> published = nullptr;
+
+	std::thread thread;
+};
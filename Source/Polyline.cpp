@@ -0,0 +1,611 @@
+#include "Polyline.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+#include "Canvas.hpp"
+#include "CConsole.h"
+
+namespace {
+// Anything shorter than this doesn't have a direction
+constexpr float Epsilon = 1e-6f;
+
+constexpr float Pi = 3.14159265358979323846f;
+
+// Same miters (and end caps) as the CPU, but for
+// one corner of one segment at a time, straight
+// from the points. Corners are in the same order
+// as Buffer::SquareBuffer.
+constexpr const char *VertexShader = R"(#version 150
+
+layout(std140) uniform Frame {
+	mat4 projection;
+};
+
+uniform mat4 modelView;
+uniform vec4 color;
+
+uniform samplerBuffer points;
+uniform int count;
+uniform bool closed;
+uniform bool miter;
+uniform float miterLimit;
+uniform float halfWidth;
+uniform float extend;
+
+out vec4 fragmentColor;
+
+const int Corners[6] = int[6](0, 1, 2, 0, 2, 3);
+
+vec2 Point(int i) {
+	return texelFetch(points, closed ? (i + count) % count : clamp(i, 0, count - 1)).xy;
+}
+
+vec2 Direction(vec2 from, vec2 to) {
+	vec2 vector = to - from;
+	float magnitude = length(vector);
+
+	return magnitude > 1e-6 ? vector / magnitude : vec2(0.0);
+}
+
+vec2 Normal(vec2 direction) {
+	return vec2(-direction.y, direction.x);
+}
+
+void main() {
+	int segment = gl_VertexID / 6;
+	int corner = Corners[gl_VertexID % 6];
+
+	bool start = corner < 2;
+	float side = (corner == 0 || corner == 3) ? 1.0 : -1.0;
+
+	vec2 from = Point(segment);
+	vec2 to = Point(segment + 1);
+	vec2 direction = Direction(from, to);
+	vec2 normal = Normal(direction);
+
+	vec2 point = start ? from : to;
+	vec2 offset = normal * halfWidth;
+
+	int index = start ? segment : segment + 1;
+
+	if (!closed && (index == 0 || index == count - 1)) {
+		point += direction * (start ? -extend : extend);
+	} else if (miter) {
+		vec2 other = start ? Direction(Point(segment - 1), from) : Direction(to, Point(segment + 2));
+		vec2 sum = normal + Normal(other);
+		float lengthSquared = dot(sum, sum);
+
+		// Too sharp just gets cut off at the limit
+		if (lengthSquared > 1e-6)
+			offset = sum * min(2.0 * halfWidth / lengthSquared, miterLimit * halfWidth * inversesqrt(lengthSquared));
+	}
+
+	fragmentColor = color;
+
+	gl_Position = projection * modelView * vec4(point + side * offset, 0.0, 1.0);
+}
+)";
+
+constexpr const char *FragmentShader = R"(#version 150
+
+in vec4 fragmentColor;
+
+out vec4 outputColor;
+
+void main() {
+	outputColor = fragmentColor;
+}
+)";
+
+// Shared by every line
+struct Extruder {
+	bool Create();
+	void Destroy();
+
+	bool created = false;
+	bool failed = false;
+
+	GLuint program = 0;
+	GLuint vertexArray = 0;
+	GLuint buffer = 0;
+	GLuint texture = 0;
+
+	GLint modelView = -1;
+	GLint color = -1;
+	GLint count = -1;
+	GLint closed = -1;
+	GLint miter = -1;
+	GLint halfWidth = -1;
+	GLint extend = -1;
+} extruder;
+
+bool Extruder::Create() {
+	program = Canvas::CreateProgram(VertexShader, FragmentShader);
+	if (!program)
+		return false;
+
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "points"), 0);
+	glUniform1f(glGetUniformLocation(program, "miterLimit"), Polyline::MiterLimit);
+	glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Frame"), Canvas::FrameBinding);
+	glUseProgram(0);
+
+	modelView = glGetUniformLocation(program, "modelView");
+	color = glGetUniformLocation(program, "color");
+	count = glGetUniformLocation(program, "count");
+	closed = glGetUniformLocation(program, "closed");
+	miter = glGetUniformLocation(program, "miter");
+	halfWidth = glGetUniformLocation(program, "halfWidth");
+	extend = glGetUniformLocation(program, "extend");
+
+	// No vertices, but core profiles still need this
+	glGenVertexArrays(1, &vertexArray);
+
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, 2 * sizeof(float), nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	created = true;
+
+	return true;
+}
+
+void Extruder::Destroy() {
+	glDeleteTextures(1, &texture);
+	glDeleteBuffers(1, &buffer);
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteProgram(program);
+
+	texture = buffer = vertexArray = program = 0;
+
+	created = failed = false;
+}
+
+// Most fans we'll draw in one go. Lines with more get drawn in
+// batches, which keeps the index buffers below a fixed size
+constexpr std::size_t FanBatch = 1024;
+
+// And never more than we can index with a GLushort
+std::size_t FansPerBatch(std::size_t triangles) {
+	return std::min(FanBatch, (static_cast<std::size_t>(std::numeric_limits<GLushort>::max()) + 1) / (triangles + 2));
+}
+
+// Indices for a whole batch of fans of the given number of
+// triangles. Every fan's laid out the same way, so they're made
+// once and shared by every line with fans of that size (and there
+// are only a handful of sizes, see GetRoundSegments()).
+const GLushort *GetFanIndices(std::size_t triangles) {
+	static std::map<std::size_t, std::vector<GLushort>> cache;
+
+	auto &indices = cache[triangles];
+
+	if (indices.empty()) {
+		const auto vertices = triangles + 2;
+		const auto fans = FansPerBatch(triangles);
+
+		indices.reserve(fans * triangles * 3);
+
+		for (std::size_t fan = 0; fan < fans; ++fan) {
+			const auto first = fan * vertices;
+
+			for (std::size_t i = 0; i < triangles; ++i) {
+				indices.emplace_back(static_cast<GLushort>(first));
+				indices.emplace_back(static_cast<GLushort>(first + i + 1));
+				indices.emplace_back(static_cast<GLushort>(first + i + 2));
+			}
+		}
+	}
+
+	return indices.data();
+}
+}
+
+bool Polyline::gpuExtrusion = false;
+
+void Polyline::SetGpuExtrusion(bool gpuExtrusion) {
+	Polyline::gpuExtrusion = gpuExtrusion;
+
+	// Worth another go
+	extruder.failed = false;
+}
+
+void Polyline::OnDestroy() {
+	if (extruder.created)
+		extruder.Destroy();
+}
+
+void Polyline::SetWidth(float width) {
+	if (width == this->width)
+		return;
+
+	this->width = width;
+	dirty = true;
+}
+
+void Polyline::SetJoin(Join join) {
+	if (join == this->join)
+		return;
+
+	this->join = join;
+	dirty = true;
+}
+
+void Polyline::SetCap(Cap cap) {
+	if (cap == this->cap)
+		return;
+
+	this->cap = cap;
+	dirty = true;
+}
+
+void Polyline::Reserve(std::size_t size) {
+	points.reserve(size * 2);
+}
+
+void Polyline::Clear() {
+	points.clear();
+	closed = false;
+	dirty = true;
+}
+
+void Polyline::AddPoint(const Vector2f &point) {
+	points.emplace_back(point.x);
+	points.emplace_back(point.y);
+
+	closed = false;
+	dirty = true;
+}
+
+void Polyline::SetPoints(const Vector2f *points, std::size_t size) {
+	this->points.resize(size * 2);
+
+	for (std::size_t i = 0; i < size; ++i) {
+		this->points[i * 2] = points[i].x;
+		this->points[i * 2 + 1] = points[i].y;
+	}
+
+	closed = false;
+	dirty = true;
+}
+
+void Polyline::Loop() {
+	auto size = points.size() / 2;
+
+	// The closing segment takes care of this for us
+	if (size > 1 &&
+		std::abs(points[0] - points[size * 2 - 2]) < 1e-3f &&
+		std::abs(points[1] - points[size * 2 - 1]) < 1e-3f) {
+		points.resize(--size * 2);
+	}
+
+	if (size < 3) {
+		CConsole::Console.Print("Can't loop a line with fewer than 3 points", MSG_ALERT);
+		return;
+	}
+
+	closed = true;
+	dirty = true;
+}
+
+void Polyline::Draw() {
+	auto &canvas = Canvas::Get();
+
+	if (!gpuExtrusion || !DrawOnGpu()) {
+		if (dirty)
+			Extrude();
+
+		for (const auto &region : regions)
+			DrawRegion(region);
+	}
+
+	canvas.LoadIdentity();
+}
+
+std::size_t Polyline::GetRoundSegments() const {
+	// Enough that a wide line still looks round
+	return static_cast<std::size_t>(std::clamp(width / 3.0f, 4.0f, 16.0f));
+}
+
+void Polyline::Extrude() {
+	dirty = false;
+
+	for (auto &region : regions)
+		region = Region();
+
+	const auto size = points.size() / 2;
+
+	if (size < 2)
+		return;
+
+	const auto segments = closed ? size : size - 1;
+	const auto halfWidth = width / 2.0f;
+	const auto *p = points.data();
+
+	// 1) Every segment's direction
+
+	directionX.resize(segments);
+	directionY.resize(segments);
+
+	auto direction = [&](std::size_t segment, std::size_t from, std::size_t to) {
+		const auto x = p[to * 2] - p[from * 2];
+		const auto y = p[to * 2 + 1] - p[from * 2 + 1];
+		const auto length = std::sqrt(x * x + y * y);
+		const auto inverse = length > Epsilon ? 1.0f / length : 0.0f;
+
+		directionX[segment] = x * inverse;
+		directionY[segment] = y * inverse;
+	};
+
+	for (std::size_t i = 0; i < size - 1; ++i)
+		direction(i, i, i + 1);
+
+	if (closed)
+		direction(size - 1, size - 1, 0);
+
+	// 2) Every point's miter, if it has one. This is where
+	// the two segments' edges meet, so they can just share
+	// it and there's no need for anything in between.
+	//
+	//		length = thickness * ( 1 / |normal|.|miter| )
+	//
+	// works out as the sum of the two normals, times
+	// thickness * 2 / (the sum's length squared).
+
+	miterX.resize(size);
+	miterY.resize(size);
+	mitered.assign(size, 0);
+
+	if (join == Join::Miter) {
+		// Anything less than this is
+		// longer than our miter limit
+		const auto shortest = 4.0f / (MiterLimit * MiterLimit);
+
+		auto miter = [&](std::size_t i, std::size_t previous, std::size_t next) {
+			const auto x = -(directionY[previous] + directionY[next]);
+			const auto y = directionX[previous] + directionX[next];
+			const auto lengthSquared = x * x + y * y;
+			const auto fits = lengthSquared > shortest;
+			const auto scale = fits ? halfWidth * 2.0f / lengthSquared : 0.0f;
+
+			miterX[i] = x * scale;
+			miterY[i] = y * scale;
+			mitered[i] = fits;
+		};
+
+		for (std::size_t i = 1; i < segments; ++i)
+			miter(i, i - 1, i);
+
+		if (closed)
+			miter(0, segments - 1, 0);
+	}
+
+	// Every fan's vertices are stored one after another, so
+	// work out how many of each there are before writing any
+
+	const auto roundSegments = GetRoundSegments();
+
+	auto &quads = regions[0];
+	quads.fans = segments;
+	quads.triangles = 2;
+
+	auto &joins = regions[1];
+	if (join != Join::None) {
+		joins.fans = closed ? size : size - 2;
+		joins.triangles = join == Join::Round ? roundSegments : 1;
+	}
+
+	auto &caps = regions[2];
+	if (!closed && cap == Cap::Round) {
+		caps.fans = 2;
+		caps.triangles = roundSegments;
+	}
+
+	std::size_t first = 0;
+	for (auto &region : regions) {
+		region.first = first;
+		first += region.fans * (region.triangles + 2);
+	}
+
+	vertices.resize(first * 2);
+
+	auto *v = vertices.data();
+
+	// 3) Every segment's quad
+
+	auto quad = [&](std::size_t segment, std::size_t from, std::size_t to) {
+		const auto normalX = -directionY[segment] * halfWidth;
+		const auto normalY = directionX[segment] * halfWidth;
+
+		const auto startX = mitered[from] ? miterX[from] : normalX;
+		const auto startY = mitered[from] ? miterY[from] : normalY;
+		const auto endX = mitered[to] ? miterX[to] : normalX;
+		const auto endY = mitered[to] ? miterY[to] : normalY;
+
+		auto *out = v + segment * 8;
+
+		out[0] = p[from * 2] + startX;
+		out[1] = p[from * 2 + 1] + startY;
+		out[2] = p[from * 2] - startX;
+		out[3] = p[from * 2 + 1] - startY;
+		out[4] = p[to * 2] - endX;
+		out[5] = p[to * 2 + 1] - endY;
+		out[6] = p[to * 2] + endX;
+		out[7] = p[to * 2 + 1] + endY;
+	};
+
+	for (std::size_t i = 0; i < size - 1; ++i)
+		quad(i, i, i + 1);
+
+	if (closed)
+		quad(size - 1, size - 1, 0);
+
+	// Square caps are just the ends pushed out a bit
+	if (!closed && cap == Cap::Square) {
+		const auto last = (segments - 1) * 8;
+
+		for (std::size_t i = 0; i < 4; i += 2) {
+			v[i] -= directionX[0] * halfWidth;
+			v[i + 1] -= directionY[0] * halfWidth;
+			v[last + 4 + i] += directionX[segments - 1] * halfWidth;
+			v[last + 4 + i + 1] += directionY[segments - 1] * halfWidth;
+		}
+	}
+
+	// 4) Everything in between segments, on the outside of the turn.
+	// Mitered points don't need anything, so their fans get squashed
+	// down to nothing (which is cheaper than working around them).
+
+	auto fan = [&](float *out, std::size_t triangles, float x, float y, float fromX, float fromY, float angle) {
+		out[0] = x;
+		out[1] = y;
+
+		const auto c = std::cos(angle / triangles);
+		const auto s = std::sin(angle / triangles);
+
+		for (std::size_t i = 0; i <= triangles; ++i) {
+			out[(i + 1) * 2] = x + fromX;
+			out[(i + 1) * 2 + 1] = y + fromY;
+
+			const auto rotatedX = fromX * c - fromY * s;
+			fromY = fromX * s + fromY * c;
+			fromX = rotatedX;
+		}
+	};
+
+	if (joins.fans) {
+		const auto stride = (joins.triangles + 2) * 2;
+
+		for (std::size_t i = 0; i < joins.fans; ++i) {
+			const auto point = closed ? i : i + 1;
+			const auto previous = point == 0 ? segments - 1 : point - 1;
+			const auto next = point;
+
+			const auto x = p[point * 2];
+			const auto y = p[point * 2 + 1];
+
+			auto *out = v + (joins.first * 2) + i * stride;
+
+			if (mitered[point]) {
+				for (std::size_t j = 0; j < stride; j += 2) {
+					out[j] = x;
+					out[j + 1] = y;
+				}
+
+				continue;
+			}
+
+			// Which way we're turning decides which side's outside
+			const auto cross = directionX[previous] * directionY[next] - directionY[previous] * directionX[next];
+			const auto side = cross > 0.0f ? -halfWidth : halfWidth;
+
+			const auto fromX = -directionY[previous] * side;
+			const auto fromY = directionX[previous] * side;
+			const auto toX = -directionY[next] * side;
+			const auto toY = directionX[next] * side;
+
+			fan(out, joins.triangles, x, y, fromX, fromY, std::atan2(fromX * toY - fromY * toX, fromX * toX + fromY * toY));
+		}
+	}
+
+	// 5) Half a circle on each end
+	if (caps.fans) {
+		const auto last = size - 1;
+
+		auto *out = v + caps.first * 2;
+
+		fan(out, caps.triangles, p[0], p[1], -directionY[0] * halfWidth, directionX[0] * halfWidth, Pi);
+		fan(
+			out + (caps.triangles + 2) * 2,
+			caps.triangles,
+			p[last * 2],
+			p[last * 2 + 1],
+			directionY[segments - 1] * halfWidth,
+			-directionX[segments - 1] * halfWidth,
+			Pi
+		);
+	}
+}
+
+void Polyline::DrawRegion(const Region &region) const {
+	if (!region.fans)
+		return;
+
+	auto &canvas = Canvas::Get();
+
+	const auto fanVertices = region.triangles + 2;
+
+	const auto most = FansPerBatch(region.triangles);
+
+	for (std::size_t fan = 0; fan < region.fans; fan += most) {
+		const auto fans = std::min(most, region.fans - fan);
+
+		canvas.Draw(
+			GL_TRIANGLES,
+			static_cast<GLsizei>(fans * region.triangles * 3),
+			vertices.data() + (region.first + fan * fanVertices) * 2,
+			GetFanIndices(region.triangles)
+		);
+	}
+}
+
+bool Polyline::DrawOnGpu() {
+	// Anything else needs more than
+	// one quad per segment
+	if ((join != Join::None && join != Join::Miter) || cap == Cap::Round)
+		return false;
+
+	if (extruder.failed)
+		return false;
+
+	if (!extruder.created && !extruder.Create()) {
+		CConsole::Console.Print("Could not set up GPU line extrusion, extruding on the CPU instead", MSG_ALERT);
+		extruder.failed = true;
+		return false;
+	}
+
+	const auto size = points.size() / 2;
+
+	if (size < 2)
+		return true;
+
+	auto &canvas = Canvas::Get();
+
+	// Anything drawn before us needs to be underneath
+	canvas.Flush();
+
+	glBindBuffer(GL_TEXTURE_BUFFER, extruder.buffer);
+	glBufferData(GL_TEXTURE_BUFFER, points.size() * sizeof(float), points.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glUseProgram(extruder.program);
+	canvas.BindFrame();
+
+	glUniformMatrix4fv(extruder.modelView, 1, GL_FALSE, canvas.GetModelView().data());
+	glUniform4fv(extruder.color, 1, canvas.GetColor().data());
+	glUniform1i(extruder.count, static_cast<GLint>(size));
+	glUniform1i(extruder.closed, closed);
+	glUniform1i(extruder.miter, join == Join::Miter);
+	glUniform1f(extruder.halfWidth, width / 2.0f);
+	glUniform1f(extruder.extend, cap == Cap::Square ? width / 2.0f : 0.0f);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, extruder.texture);
+
+	glBindVertexArray(extruder.vertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>((closed ? size : size - 1) * 6));
+	glBindVertexArray(0);
+
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glUseProgram(0);
+
+	return true;
+}
@@ -9,6 +9,7 @@
 #include <mutex>
 
 #include "CApp.h"
+#include "LiveBeatDetect.hpp"
 
 class MyAudioSink {
 public:
@@ -27,10 +28,16 @@ public:
 
 	HRESULT SetFormat(WAVEFORMATEX *format) {
 		// Don't worry, everything is gonna happy <3
+		beats.OnInit(format->nSamplesPerSec, format->nChannels);
 		return S_OK;
 	}
 
 	HRESULT CopyData(BYTE *pData, UINT32 numFramesAvailable, BOOL *pDone) {
+		// Only the capture thread touches the beat
+		// tracker, so it doesn't need the lock. Silent
+		// packets still go in to keep its clock running.
+		beats.OnData(reinterpret_cast<const float *>(pData), numFramesAvailable);
+
 		if (!pData) return S_FALSE;
 
 		std::unique_lock lock(mutex);
@@ -58,6 +65,8 @@ public:
 
 	std::atomic<bool> done = false;
 
+	LiveBeatDetect beats;
+
 private:
 	std::size_t bufferLength = 0;
 };
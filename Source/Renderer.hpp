@@ -8,6 +8,7 @@
 #include "MathCPP/Duration.hpp"
 
 #include "AlbumArt.hpp"
+#include "Canvas.hpp"
 #include "DynamicGain.hpp"
 
 class Renderer {
@@ -72,6 +73,10 @@ public:
 	) = 0;
 	virtual void Reset() = 0;
 
+	// Scales whatever gain we've learned so far, for when we
+	// know the next song's this much louder than the last
+	virtual void ScaleGain(float factor) { }
+
 	void SetNumberOfChannels(uint8_t numberOfChannels) {
 		this->numberOfChannels = numberOfChannels;
 	}
@@ -84,7 +89,7 @@ public:
 
 protected:
 	void SetColor(const Colour<float> &color, float alpha) {
-		glColor4f(color.r, color.g, color.b, alpha);
+		Canvas::Get().SetColor(color.r, color.g, color.b, alpha);
 	}
 
 	bool initialized = false;
@@ -2,39 +2,16 @@
 
 #include <fstream>
 
-#ifdef _WIN32
-#include <Shlobj.h>
-#endif
-
 #include "CConsole.h"
+#include "Utils.hpp"
 
 Settings Settings::settings = Settings::Load();
 
 std::filesystem::path Settings::GetPath() {
-	std::filesystem::path ret;
-
-#ifdef _WIN32
-	PWSTR folder;
-	if (SHGetKnownFolderPath(FOLDERID_RoamingAppData, 0, NULL, &folder) == S_OK) {
-		ret = std::filesystem::path(folder);
-
-		CoTaskMemFree(folder);
-	}
-#elif defined(__linux__)
-	ret = "~/.config";
-#endif
-
-	if (!ret.empty()) {
-		ret /= "Fetcko";
-		if (!std::filesystem::exists(ret))
-			std::filesystem::create_directory(ret);
-
-		ret /= "popRocks";
-		if (!std::filesystem::exists(ret))
-			std::filesystem::create_directory(ret);
+	auto ret = Fetcko::Utils::GetUserFolder();
 
+	if (!ret.empty())
 		ret /= "Settings.json";
-	}
 
 	return ret;
 }
@@ -80,6 +57,16 @@ void Settings::SetColorSelection(ColorSelection colorSelection) {
 	Save();
 }
 
+void Settings::SetNormalize(bool normalize) {
+	this->normalize = normalize;
+	Save();
+}
+
+void Settings::SetTargetLoudness(double targetLoudness) {
+	this->targetLoudness = targetLoudness;
+	Save();
+}
+
 void Settings::Save() {
 	if (auto path = GetPath(); !path.empty()) {
 		std::ofstream outFile(path, std::ios::out);
@@ -134,6 +121,15 @@ const Node &operator>>(const Node &node, Settings &settings) {
 	if (node.has("colorSelection"))
 		node["colorSelection"]->get(settings.colorSelection);
 
+	if (node.has("normalize"))
+		node["normalize"]->get(settings.normalize);
+
+	if (node.has("targetLoudness"))
+		node["targetLoudness"]->get(settings.targetLoudness);
+
+	if (node.has("coreProfile"))
+		node["coreProfile"]->get(settings.coreProfile);
+
 	return node;
 }
 
@@ -141,6 +137,9 @@ Node &operator<<(Node &node, const Settings &settings) {
 	node["volume"]->set(settings.volume);
 	node["exclusive"]->set(settings.exclusive);
 	node["colorSelection"]->set(settings.colorSelection);
+	node["normalize"]->set(settings.normalize);
+	node["targetLoudness"]->set(settings.targetLoudness);
+	node["coreProfile"]->set(settings.coreProfile);
 
 	return node;
 }
\ No newline at end of file
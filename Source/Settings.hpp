@@ -4,18 +4,13 @@
 
 #include "Serial/Json.hpp"
 
+#include "Palette.hpp"
+
 using namespace serial;
 
 class Settings {
 public:
-	struct ColorSelection {
-		double minPercentage = 0.02;
-		double minSaturation = 0.1;
-		double minValue = 0.25;
-		double minHueSeparation = 25.0;
-		double minValueSeparation = 0.1;
-		double minRgbSeparation = 0.70;
-	};
+	using ColorSelection = Palette::ColorSelection;
 
 	static Settings settings;
 
@@ -28,11 +23,24 @@ public:
 	const ColorSelection &GetColorSelection() const { return colorSelection; }
 	void SetColorSelection(ColorSelection colorSelection);
 
+	// Whether to scale playback so every song hits
+	// targetLoudness (in LUFS), going by its analysed loudness
+	const bool &GetNormalize() const { return normalize; }
+	void SetNormalize(bool normalize);
+
+	const double &GetTargetLoudness() const { return targetLoudness; }
+	void SetTargetLoudness(double targetLoudness);
+
+	// Whether to ask for a core profile OpenGL context (instead
+	// of a compatibility one). Only read at startup.
+	const bool &GetCoreProfile() const { return coreProfile; }
+
 	friend const Node &operator>>(const Node &node, Settings &settings);
 	friend Node &operator<<(Node &node, const Settings &settings);
 
 	friend const Node &operator>>(const Node &node, ColorSelection &colorSelection);
 	friend Node &operator<<(Node &node, const ColorSelection &colorSelection);
+
 private:
 	static std::filesystem::path GetPath();
 
@@ -44,4 +52,10 @@ private:
 	float volume = 1.0f;
 	bool exclusive = true;
 	ColorSelection colorSelection;
+	bool normalize = false;
+
+	// Same reference level as ReplayGain 2.0
+	double targetLoudness = -18.0;
+
+	bool coreProfile = false;
 };
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <map>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <bass.h>
 
@@ -10,6 +12,12 @@ public:
 	virtual ~TagLoader() = default;
 
 	virtual void LoadFromTags(const std::map<std::string, std::string> &tags) = 0;
+
+	// The tags LoadFromTags actually looks at, so a reader that
+	// has to decode each one (i.e. ID3v2) can skip the rest.
+	// Empty means we want everything.
+	virtual std::vector<std::string_view> GetWantedTags() const { return {}; }
+
 	virtual bool AreThereEmptyTags() const = 0;
 	virtual bool HasTitle() const = 0;
 
@@ -0,0 +1,293 @@
+#include "TagReader.hpp"
+
+#include <algorithm>
+
+#include "CConsole.h"
+#include "ID3V2.hpp"
+#include "MP4.hpp"
+
+namespace {
+constexpr std::size_t ID3v1Size = 128;
+
+// FLAC metadata block types
+constexpr std::uint8_t VorbisCommentBlock = 4;
+constexpr std::uint8_t PictureBlock = 6;
+
+// Picture type (same as ID3v2's APIC) of a front cover
+constexpr std::uint32_t FrontCover = 3;
+
+// "Well-known" types of an ilst item's data
+constexpr std::uint32_t MP4Utf8 = 1;
+constexpr std::uint32_t MP4Jpeg = 13;
+constexpr std::uint32_t MP4Png = 14;
+
+// ilst items we have a use for, under the names BASS_TAG_MP4
+// would have given them. '©' is 0xA9 here, not UTF-8.
+const std::map<std::string_view, std::string> MP4Items = {
+	{ "\xA9" "nam", "title" },
+	{ "\xA9" "ART", "artist" },
+	{ "\xA9" "alb", "album" },
+	{ "aART", "albumartist" }
+};
+
+std::string_view AsString(const std::uint8_t *data, std::size_t size) {
+	return std::string_view(reinterpret_cast<const char *>(data), size);
+}
+
+std::uint64_t ReadBigEndian(const std::uint8_t *data, std::size_t bytes) {
+	std::uint64_t ret = 0;
+	for (std::size_t i = 0; i < bytes; ++i)
+		ret = (ret << 8) | data[i];
+
+	return ret;
+}
+
+// Walks through a block without ever going past the end
+// of it. Once a read doesn't fit, every read after it
+// comes back empty.
+class Cursor {
+public:
+	Cursor(const std::uint8_t *data, std::size_t size) : data(data), size(size) {}
+
+	const std::uint8_t *Take(std::size_t bytes) {
+		if (failed || size - position < bytes) {
+			failed = true;
+			return nullptr;
+		}
+
+		auto *ret = data + position;
+		position += bytes;
+
+		return ret;
+	}
+
+	std::string_view TakeString(std::size_t bytes) {
+		auto *ret = Take(bytes);
+		return ret ? AsString(ret, bytes) : std::string_view();
+	}
+
+	std::uint32_t ReadBigEndian32() {
+		auto *bytes = Take(4);
+		return bytes ? static_cast<std::uint32_t>(ReadBigEndian(bytes, 4)) : 0;
+	}
+
+	std::uint32_t ReadLittleEndian32() {
+		auto *bytes = Take(4);
+		if (!bytes) return 0;
+
+		return
+			static_cast<std::uint32_t>(bytes[0]) |
+			(static_cast<std::uint32_t>(bytes[1]) << 8) |
+			(static_cast<std::uint32_t>(bytes[2]) << 16) |
+			(static_cast<std::uint32_t>(bytes[3]) << 24);
+	}
+
+	bool Failed() const { return failed; }
+
+private:
+	const std::uint8_t *data = nullptr;
+	std::size_t size = 0;
+	std::size_t position = 0;
+
+	bool failed = false;
+};
+}
+
+TagReader::TagReader(const std::filesystem::path &path) : file(path) {
+
+}
+
+bool TagReader::CanRead(const std::string &extension) {
+	return
+		extension == ".mp3" ||
+		extension == ".flac" ||
+		extension == ".mp4" ||
+		extension == ".m4a";
+}
+
+bool TagReader::Read(const std::string &extension, TagLoader *tagLoader, ArtLoader *artLoader) const {
+	if (!file.IsOpen())
+		return false;
+
+	if (extension == ".mp3") {
+		// Prefer ID3v2, since it doesn't have a character limit
+		ReadID3v2(tagLoader, artLoader);
+
+		if (tagLoader->AreThereEmptyTags())
+			ReadID3v1(tagLoader);
+
+		return true;
+	} else if (extension == ".flac") {
+		return ReadFlac(tagLoader, artLoader);
+	} else if (extension == ".mp4" || extension == ".m4a") {
+		return ReadMP4(tagLoader, artLoader);
+	}
+
+	return false;
+}
+
+std::size_t TagReader::GetID3v2Size() const {
+	if (file.GetSize() < ID3V2::HeaderSize)
+		return 0;
+
+	return ID3V2::GetTagSize(reinterpret_cast<const char *>(file.GetData()));
+}
+
+void TagReader::ReadID3v2(TagLoader *tagLoader, ArtLoader *artLoader) const {
+	auto size = GetID3v2Size();
+	if (!size) return;
+
+	ID3V2::View id3(AsString(file.GetData(), std::min(size, file.GetSize())));
+	if (!id3.IsValid()) return;
+
+	tagLoader->LoadFromTags(id3.GetTags(tagLoader->GetWantedTags()));
+
+	if (artLoader) {
+		if (auto art = id3.GetPicture())
+			artLoader->Load(std::string(art->mimeType), art->data.data(), art->data.size());
+	}
+}
+
+void TagReader::ReadID3v1(TagLoader *tagLoader) const {
+	if (file.GetSize() < ID3v1Size + GetID3v2Size())
+		return;
+
+	const auto *tag = file.GetData() + file.GetSize() - ID3v1Size;
+	if (AsString(tag, 3) == "TAG")
+		tagLoader->LoadFromID3v1(reinterpret_cast<const TAG_ID3 *>(tag));
+}
+
+bool TagReader::ReadFlac(TagLoader *tagLoader, ArtLoader *artLoader) const {
+	// Some taggers stick an ID3v2 tag in front of
+	// the stream, so we skip straight past it
+	auto begin = std::min(GetID3v2Size(), file.GetSize());
+
+	Cursor cursor(file.GetData() + begin, file.GetSize() - begin);
+	if (cursor.TakeString(4) != "fLaC")
+		return false;
+
+	std::map<std::string, std::string> tags;
+
+	struct {
+		std::string_view mimeType;
+		const std::uint8_t *data = nullptr;
+		std::size_t length = 0;
+		bool frontCover = false;
+	} picture;
+
+	for (bool last = false; !last;) {
+		auto *header = cursor.Take(4);
+		if (!header) break;
+
+		last = header[0] & 0x80;
+		auto type = header[0] & 0x7F;
+
+		auto length = static_cast<std::size_t>(ReadBigEndian(header + 1, 3));
+		auto *data = cursor.Take(length);
+		if (!data) break;
+
+		if (type == VorbisCommentBlock) {
+			Cursor block(data, length);
+
+			// Skip the vendor string
+			block.Take(block.ReadLittleEndian32());
+
+			auto count = block.ReadLittleEndian32();
+			for (std::uint32_t i = 0; i < count && !block.Failed(); ++i) {
+				auto comment = block.TakeString(block.ReadLittleEndian32());
+
+				auto equals = comment.find('=');
+				if (equals == std::string_view::npos)
+					continue;
+
+				// Field names are case-insensitive
+				std::string name(comment.substr(0, equals));
+				std::transform(name.begin(), name.end(), name.begin(), tolower);
+
+				tags.emplace(std::move(name), std::string(comment.substr(equals + 1)));
+			}
+		} else if (type == PictureBlock && artLoader && !picture.frontCover) {
+			Cursor block(data, length);
+
+			auto pictureType = block.ReadBigEndian32();
+			auto mimeType = block.TakeString(block.ReadBigEndian32());
+
+			// Description, then width, height, colour depth
+			// and the number of colours (for indexed images)
+			block.Take(block.ReadBigEndian32());
+			block.Take(16);
+
+			auto dataLength = block.ReadBigEndian32();
+			auto *pictureData = block.Take(dataLength);
+
+			// Take the first picture, unless
+			// there's a front cover later on
+			if (pictureData && (!picture.data || pictureType == FrontCover)) {
+				picture.mimeType = mimeType;
+				picture.data = pictureData;
+				picture.length = dataLength;
+				picture.frontCover = pictureType == FrontCover;
+			}
+		}
+	}
+
+	tagLoader->LoadFromTags(tags);
+
+	if (picture.data)
+		artLoader->Load(std::string(picture.mimeType), picture.data, picture.length);
+
+	return true;
+}
+
+bool TagReader::ReadMP4(TagLoader *tagLoader, ArtLoader *artLoader) const {
+	MP4 mp4(AsString(file.GetData(), file.GetSize()));
+
+	if (!mp4.GetBoxAtPath({ "moov" }))
+		return false;
+
+	// No tags at all
+	auto ilst = mp4.GetBoxAtPath({ "moov", "udta", "meta", "ilst" });
+	if (!ilst)
+		return true;
+
+	std::map<std::string, std::string> tags;
+	bool foundArt = false;
+
+	for (const auto &item : ilst->GetChildren()) {
+		auto value = item.GetChild("data");
+		auto data = value ? value->GetData() : std::nullopt;
+		if (!data)
+			continue;
+
+		auto type = item.GetType();
+		auto *bytes = reinterpret_cast<const std::uint8_t *>(data->value.data());
+
+		if (type == "trkn" || type == "disk") {
+			// 2 bytes of padding, then the number,
+			// then how many there are altogether
+			if (data->value.size() >= 6) {
+				auto number = ReadBigEndian(bytes + 2, 2);
+				auto total = ReadBigEndian(bytes + 4, 2);
+
+				tags.emplace(
+					type == "trkn" ? "track" : "disc",
+					std::to_string(number) + (total ? "/" + std::to_string(total) : "")
+				);
+			}
+		} else if (type == "covr") {
+			// For now, we just want to grab "iTunes style" album art
+			if (artLoader && !foundArt && (data->type == MP4Jpeg || data->type == MP4Png)) {
+				foundArt = artLoader->Load(std::string(data->GetMimeType()), bytes, data->value.size());
+				if (foundArt)
+					CConsole::Console.Print("Found iTunes-style embedded album art", MSG_DIAG);
+			}
+		} else if (data->type == MP4Utf8) {
+			if (auto name = MP4Items.find(type); name != MP4Items.end())
+				tags.emplace(name->second, std::string(data->value));
+		}
+	}
+
+	tagLoader->LoadFromTags(tags);
+
+	return true;
+}
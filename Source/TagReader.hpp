@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <string>
+
+#include "ArtLoader.hpp"
+#include "MappedFile.hpp"
+#include "TagLoader.hpp"
+
+// Reads tags straight out of the file, without a BASS stream:
+//		ID3v2 (and ID3v1, at the very end) for MP3s
+//		VORBIS_COMMENT and PICTURE metadata blocks for FLAC
+//		The "moov.udta.meta.ilst" tree for MP4s
+//
+// Everything gets parsed in place from a MappedFile, so the
+// only I/O is the handful of pages the tags live in. Even an
+// MP4 whose moov comes after the audio only costs us the box
+// headers we skip on the way there.
+//
+// Resources used:
+// https://xiph.org/flac/format.html#metadata_block
+// https://www.xiph.org/vorbis/doc/v-comment.html
+// https://developer.apple.com/documentation/quicktime-file-format/metadata_item_list_atom
+class TagReader {
+public:
+	explicit TagReader(const std::filesystem::path &path);
+
+	// Whether we know how to read a (lowercase) extension's tags
+	static bool CanRead(const std::string &extension);
+
+	// Hands whatever tags we find over to tagLoader, and embedded
+	// art (if we're given an artLoader to load it into) to artLoader.
+	//
+	// False if the file isn't what its extension says it is (or
+	// couldn't be opened), in which case it's up to BASS.
+	bool Read(const std::string &extension, TagLoader *tagLoader, ArtLoader *artLoader = nullptr) const;
+
+private:
+	// 0 if the file doesn't start with an ID3v2 tag
+	std::size_t GetID3v2Size() const;
+
+	void ReadID3v2(TagLoader *tagLoader, ArtLoader *artLoader) const;
+	void ReadID3v1(TagLoader *tagLoader) const;
+	bool ReadFlac(TagLoader *tagLoader, ArtLoader *artLoader) const;
+	bool ReadMP4(TagLoader *tagLoader, ArtLoader *artLoader) const;
+
+	MappedFile file;
+};
@@ -1,6 +1,43 @@
 #include "Text.hpp"
 
-#include "Buffer.hpp"
+#include "Canvas.hpp"
+#include "GlyphAtlas.hpp"
+
+namespace {
+constexpr std::uint32_t ReplacementCharacter = 0xFFFD;
+
+// Decodes the codepoint at text[i], and moves i past it
+std::uint32_t NextCodepoint(const std::string &text, std::size_t &i) {
+	auto lead = static_cast<std::uint8_t>(text[i++]);
+
+	std::size_t continuations = 0;
+	std::uint32_t ret = 0;
+
+	if (lead < 0x80) {
+		return lead;
+	} else if ((lead & 0xE0) == 0xC0) {
+		continuations = 1;
+		ret = lead & 0x1F;
+	} else if ((lead & 0xF0) == 0xE0) {
+		continuations = 2;
+		ret = lead & 0x0F;
+	} else if ((lead & 0xF8) == 0xF0) {
+		continuations = 3;
+		ret = lead & 0x07;
+	} else {
+		return ReplacementCharacter;
+	}
+
+	for (std::size_t c = 0; c < continuations; ++c) {
+		if (i >= text.size() || (static_cast<std::uint8_t>(text[i]) & 0xC0) != 0x80)
+			return ReplacementCharacter;
+
+		ret = (ret << 6) | (static_cast<std::uint8_t>(text[i++]) & 0x3F);
+	}
+
+	return ret;
+}
+}
 
 void Text::OnInit(TTF_Font *font) {
 	this->font = font;
@@ -22,108 +59,101 @@ void Text::SetText(const std::string &text, bool force) {
 
 	// Size needs to be re-measured
 	size = { 0, 0 };
+	vertices.clear();
 
-	// Don't try to load an empty string
-	//
-	// We'll likely get a null surface anyway
-	if (Empty()) return;
-
-	auto surface = TTF_RenderUTF8_Blended(
-		font,
-		text.c_str(),
-		SDL_Color {
-			static_cast<uint8_t>(color.r * 255.0f),
-			static_cast<uint8_t>(color.g * 255.0f),
-			static_cast<uint8_t>(color.b * 255.0f),
-			static_cast<uint8_t>(color.a * 255.0f)
-		}
-	);
+	if (Empty() || !font) return;
 
-	if (!surface) {
-		this->text.clear();
-		return;
-	}
+	// The same size TTF_RenderUTF8_Blended would've given us
+	auto measured = MeasureText(text);
+	size = { measured.x, measured.y + TTF_FontDescent(font) / 2.0f };
 
-	glEnable(GL_TEXTURE_2D);
-	glDeleteTextures(1, &texture);
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	GLenum textureFormat = GL_RGBA;
-	if (surface->format->BytesPerPixel == 4) {		// alpha
-		if (surface->format->Rmask == 0x000000ff)
-			textureFormat = GL_RGBA;
-		else
-			textureFormat = GL_BGRA;
-	} else {										// no alpha
-		if (surface->format->Rmask == 0x000000ff)
-			textureFormat = GL_RGB;
-		else
-			textureFormat = GL_BGR;
-	}
+	Layout();
+}
 
-	// For some reason (on my machine, at least) each row has a ton of extra padding
-	// Use this to (slowly) flatten the data
-	uint8_t *flat = new uint8_t[surface->w * surface->h * surface->format->BytesPerPixel];
-	auto pixels = reinterpret_cast<uint8_t *>(surface->pixels);
-
-	for (auto y = 0; y < surface->h; ++y) {
-		for (auto x = 0; x < surface->w; ++x) {
-			flat[y * surface->w * 4 + (x * 4 + 0)] = pixels[y * surface->pitch + (x * 4 + 0)];
-			flat[y * surface->w * 4 + (x * 4 + 1)] = pixels[y * surface->pitch + (x * 4 + 1)];
-			flat[y * surface->w * 4 + (x * 4 + 2)] = pixels[y * surface->pitch + (x * 4 + 2)];
-			flat[y * surface->w * 4 + (x * 4 + 3)] = pixels[y * surface->pitch + (x * 4 + 3)];
-		}
-	}
+void Text::Layout() const {
+	auto &atlas = GlyphAtlas::Get(font);
+
+	// If the atlas fills up halfway through, it starts over
+	// and what we've already laid out is pointing at nothing.
+	// A fresh atlas always has room for one string.
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		vertices.clear();
+		vertices.reserve(text.size() * 6);
+
+		generation = atlas.GetGeneration();
+
+		int pen = 0;
+		std::uint32_t previous = 0;
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surface->w, surface->h, 0, textureFormat, GL_UNSIGNED_BYTE, flat);
+		for (std::size_t i = 0; i < text.size();) {
+			auto codepoint = NextCodepoint(text, i);
 
-	delete[] flat;
+			if (previous)
+				pen += atlas.GetKerning(previous, codepoint);
 
-	rect[0] = 0;
-	rect[1] = 0;
-	rect[2] = 0;
-	rect[3] = static_cast<float>(surface->h);
-	rect[4] = static_cast<float>(surface->w);
-	rect[5] = static_cast<float>(surface->h);
-	rect[6] = static_cast<float>(surface->w);
-	rect[7] = 0;
+			const auto &glyph = atlas.GetGlyph(codepoint);
 
-	size = { surface->w, surface->h + TTF_FontDescent(font) / 2.0f };
+			if (glyph.width > 0) {
+				auto left = static_cast<float>(pen + glyph.x);
+				auto right = left + glyph.width;
+				auto bottom = static_cast<float>(glyph.height);
 
-	SDL_FreeSurface(surface);
-	glDisable(GL_TEXTURE_2D);
+				vertices.insert(vertices.end(), {
+					{ left, 0.0f, glyph.u0, glyph.v0 },
+					{ left, bottom, glyph.u0, glyph.v1 },
+					{ right, bottom, glyph.u1, glyph.v1 },
+					{ left, 0.0f, glyph.u0, glyph.v0 },
+					{ right, bottom, glyph.u1, glyph.v1 },
+					{ right, 0.0f, glyph.u1, glyph.v0 }
+				});
+			}
+
+			pen += glyph.advance;
+			previous = codepoint;
+		}
+
+		if (generation == atlas.GetGeneration())
+			break;
+	}
 }
 
 void Text::OnDestroy() {
-	glDeleteTextures(1, &texture);
-	texture = 0;
+	vertices.clear();
+	vertices.shrink_to_fit();
+	generation = 0;
 }
 
 void Text::OnLoop(int x, int y) const {
 	if (!font || Empty()) return;
 
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	auto &atlas = GlyphAtlas::Get(font);
+	if (generation != atlas.GetGeneration())
+		Layout();
 
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	if (vertices.empty()) return;
 
-	glVertexPointer(2, GL_FLOAT, 0, rect);
-	glTexCoordPointer(2, GL_FLOAT, 0, Buffer::TexCoordBuffer.data());
+	auto &canvas = Canvas::Get();
 
-	glTranslatef(static_cast<GLfloat>(x), static_cast<GLfloat>(y), 0.0f);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, Buffer::SquareBuffer.data());
+	// Glyphs are white, so tint them with our color
+	// on top of whatever color we've been given
+	auto tinted = color.r != 1.0f || color.g != 1.0f || color.b != 1.0f || color.a != 1.0f;
 
-	glLoadIdentity();
+	auto current = canvas.GetColor();
+	if (tinted)
+		canvas.SetColor(current[0] * color.r, current[1] * color.g, current[2] * color.b, current[3] * color.a);
 
-	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-	glDisableClientState(GL_VERTEX_ARRAY);
+	canvas.Translate(static_cast<float>(x), static_cast<float>(y));
+	canvas.DrawTextured(
+		GL_TRIANGLES,
+		static_cast<GLsizei>(vertices.size()),
+		atlas.GetTexture(),
+		&vertices[0].x,
+		&vertices[0].u,
+		nullptr,
+		sizeof(Vertex)
+	);
+	canvas.LoadIdentity();
 
-	glDisable(GL_TEXTURE_2D);
-}
\ No newline at end of file
+	if (tinted)
+		canvas.SetColor(current[0], current[1], current[2], current[3]);
+}
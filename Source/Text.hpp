@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include <SDL_ttf.h>
 #include <glad/glad.h>
@@ -10,6 +12,9 @@
 
 using namespace MathsCPP;
 
+// A string drawn out of its font's GlyphAtlas: one textured
+// quad per glyph, all in one draw call. Changing the string
+// only rewrites vertices, it never touches a texture.
 class Text {
 public:
 	void OnInit(TTF_Font *font);
@@ -27,13 +32,22 @@ public:
 	void SetColor(const Colour<float> &color) { this->color = color; }
 
 private:
-	TTF_Font *font = nullptr;
+	struct Vertex {
+		float x, y;
+		float u, v;
+	};
+
+	// Also called (lazily) whenever the atlas
+	// starts a new generation under us
+	void Layout() const;
 
-	GLuint texture = 0;
-	float rect[8] = { 0 };
+	TTF_Font *font = nullptr;
 
 	std::string text;
 
+	mutable std::vector<Vertex> vertices;
+	mutable std::uint64_t generation = 0;
+
 	Vector2i size = { 0, 0 };
 	Colour<float> color = { 1.0f, 1.0f, 1.0f, 1.0f };
 };
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+// A song, or one song of a cue sheet's image. It lives apart
+// from Playlist (and all of its text and GL) so popRocksAnalyse
+// and Cue can use it too.
+struct Track {
+	std::filesystem::path path;
+	double startTime = 0.0;
+
+	// Only set for tracks that don't run
+	// to the end of their file (cue sheets)
+	std::optional<double> length = std::nullopt;
+
+	static constexpr bool IsSupported(const std::string_view &lowercaseExtension) {
+		for (const auto &extension : SupportedExtensions)
+			if (lowercaseExtension == extension)
+				return true;
+
+		return false;
+	}
+
+	static constexpr auto &GetSupportedExtensions() {
+		return SupportedExtensions;
+	}
+
+private:
+	constexpr inline static std::array<std::string_view, 9> SupportedExtensions = { ".flac", ".mp3", ".m4a", ".mp4", ".ape", ".wv", ".ogg", ".aac", ".wav"};
+};
@@ -0,0 +1,59 @@
+#include "TrackFeatures.hpp"
+
+#include "AnalysisCache.hpp"
+
+TrackFeatures::TrackFeatures(
+	const std::filesystem::path &path,
+	double startTime,
+	std::optional<double> length,
+	bool loudness,
+	bool waveform,
+	bool force
+) : path(path), startTime(startTime), length(length) {
+	// The player wants the loudness and waveform
+	// themselves, not just to know they're there
+	if (loudness && !force)
+		cachedLoudness = AnalysisCache::LoadLoudness(path, startTime);
+
+	if (waveform && !force)
+		cachedWaveform = AnalysisCache::LoadWaveform(path, startTime);
+
+	wantsLoudness = loudness && !cachedLoudness;
+	wantsWaveform = waveform && !cachedWaveform;
+}
+
+void TrackFeatures::AddTo(AnalysisGraph &graph) {
+	const auto &format = graph.GetFormat();
+
+	if (wantsLoudness) {
+		loudness.emplace(format.freq, format.chans);
+		graph.Add(*loudness, startTime, length);
+	}
+
+	if (wantsWaveform) {
+		waveform.emplace();
+		graph.Add(*waveform, startTime, length);
+	}
+}
+
+void TrackFeatures::Save() const {
+	if (loudness)
+		AnalysisCache::SaveLoudness(path, startTime, loudness->GetResult());
+
+	if (waveform && waveform->GetPyramid())
+		AnalysisCache::SaveWaveform(path, startTime, *waveform->GetPyramid());
+}
+
+std::optional<Loudness::Result> TrackFeatures::GetLoudness() const {
+	if (loudness)
+		return loudness->GetResult();
+
+	return cachedLoudness;
+}
+
+std::shared_ptr<const PeakPyramid> TrackFeatures::GetWaveform() const {
+	if (waveform && waveform->GetPyramid())
+		return waveform->GetPyramid();
+
+	return cachedWaveform;
+}
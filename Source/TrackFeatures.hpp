@@ -0,0 +1,57 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+#include "AnalysisGraph.hpp"
+#include "Loudness.hpp"
+#include "PeakPyramid.hpp"
+#include "Waveform.hpp"
+
+// Everything besides beats we keep in the AnalysisCache for a
+// track (or one track of a cue sheet's image). These ride
+// along on whatever decode is already happening, usually beat
+// detection's, so they cost next to nothing.
+//
+// Only what isn't cached yet gets worked out, unless forced.
+class TrackFeatures {
+public:
+	TrackFeatures(
+		const std::filesystem::path &path,
+		double startTime,
+		std::optional<double> length,
+		bool loudness = true,
+		bool waveform = true,
+		bool force = false
+	);
+
+	// Nothing left to work out
+	bool IsEmpty() const { return !wantsLoudness && !wantsWaveform; }
+
+	// Our consumers need to outlive the graph's Run()
+	void AddTo(AnalysisGraph &graph);
+
+	// Only call this once the graph's finished (not canceled)
+	void Save() const;
+
+	// Whichever we've got: what was already cached, or what
+	// we just worked out (so, again, only once the graph's
+	// finished). Empty if neither.
+	std::shared_ptr<const PeakPyramid> GetWaveform() const;
+	std::optional<Loudness::Result> GetLoudness() const;
+
+private:
+	std::filesystem::path path;
+	double startTime = 0.0;
+	std::optional<double> length;
+
+	bool wantsLoudness = false;
+	bool wantsWaveform = false;
+
+	std::optional<Loudness> loudness;
+	std::optional<Waveform> waveform;
+
+	std::optional<Loudness::Result> cachedLoudness;
+	std::shared_ptr<const PeakPyramid> cachedWaveform;
+};
@@ -0,0 +1,154 @@
+#include "TrackLoader.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "MathCPP/Duration.hpp"
+
+#include "CConsole.h"
+#include "Metadata.hpp"
+
+using namespace MathsCPP;
+
+namespace {
+// How much of a stream gets warmed up, in bytes
+constexpr std::size_t WarmLength = 64 * 1024;
+}
+
+bool TrackLoader::Tags::HasTitle() const {
+	for (const auto &found : tags) {
+		if (found.count("title"))
+			return true;
+	}
+
+	return id3v1 && id3v1->title[0] != '\0';
+}
+
+bool TrackLoader::Tags::Load(const std::string &mimeType, const void *data, std::size_t length) {
+	if (art || !data || length == 0)
+		return false;
+
+	art = Art{ mimeType, std::string(reinterpret_cast<const char *>(data), length) };
+
+	return true;
+}
+
+void TrackLoader::Tags::LoadInto(TagLoader &tagLoader) const {
+	if (!tags.empty())
+		tagLoader.LoadFromTags(tags.front());
+
+	if (tagLoader.AreThereEmptyTags()) {
+		if (id3v1)
+			tagLoader.LoadFromID3v1(&*id3v1);
+
+		for (std::size_t i = 1; i < tags.size(); ++i)
+			tagLoader.LoadFromTags(tags[i]);
+	}
+
+	if (title && !tagLoader.HasTitle())
+		tagLoader.SetTitle(*title);
+}
+
+TrackLoader::TrackLoader(std::filesystem::path path, std::string extension, DWORD flags, OpenFunction openWithFlags, bool warm) :
+	path(std::move(path)),
+	extension(std::move(extension)),
+	flags(flags),
+	openWithFlags(std::move(openWithFlags)),
+	warm(warm) {
+	thread = std::thread(&TrackLoader::Load, this);
+}
+
+TrackLoader::~TrackLoader() {
+	canceled = true;
+
+	if (thread.joinable())
+		thread.join();
+
+	// Nobody wanted it
+	if (auto stream = publishedStream.exchange(nullptr)) {
+		if (stream->handle)
+			BASS_StreamFree(stream->handle);
+
+		delete stream;
+	}
+
+	delete publishedTags.exchange(nullptr);
+}
+
+std::optional<TrackLoader::Stream> TrackLoader::TakeStream() {
+	auto stream = publishedStream.exchange(nullptr);
+	if (!stream)
+		return std::nullopt;
+
+	std::optional<Stream> ret = *stream;
+	delete stream;
+
+	return ret;
+}
+
+std::optional<TrackLoader::Tags> TrackLoader::TakeTags() {
+	auto tags = publishedTags.exchange(nullptr);
+	if (!tags)
+		return std::nullopt;
+
+	std::optional<Tags> ret = std::move(*tags);
+	delete tags;
+
+	return ret;
+}
+
+void TrackLoader::Load() {
+	auto start = std::chrono::system_clock::now();
+
+	auto opened = new Stream();
+	opened->handle = openWithFlags(path, extension, flags);
+
+	if (opened->handle) {
+		BASS_ChannelGetInfo(opened->handle, &opened->info);
+
+		// Before anyone else can get at it
+		if (warm && !canceled)
+			Warm(opened->handle);
+
+		auto end = std::chrono::system_clock::now();
+
+		CConsole::Console.Print("Opened " + path.filename().u8string() + " in " + std::to_string(Duration<Microseconds>(end - start).AsSeconds()) + " seconds", MSG_DIAG);
+	} else {
+		CConsole::Console.Print(L"Could not open " + path.wstring() + L"! Error code " + std::to_wstring(BASS_ErrorGetCode()), MSG_ERROR);
+	}
+
+	stream = opened->handle;
+
+	delete publishedStream.exchange(opened);
+
+	if (!stream) {
+		done = true;
+		return;
+	}
+
+	if (canceled) {
+		done = true;
+		return;
+	}
+
+	// The stream's only needed for anything TagReader
+	// can't read. It's fine if it's been freed out from
+	// under us by now, as BASS just won't find it.
+	auto tags = new Tags();
+	Metadata().OnLoad(path, extension, stream, tags, tags);
+
+	delete publishedTags.exchange(tags);
+
+	done = true;
+}
+
+void TrackLoader::Warm(HSTREAM stream) const {
+	// Nothing's going to buffer a decoding stream for us,
+	// but decoding a little of it pulls the start of the
+	// file in and gets the decoder going. Going back to
+	// the start after is cheap (and exact, as we prescan).
+	std::vector<std::uint8_t> scratch(WarmLength);
+	BASS_ChannelGetData(stream, scratch.data(), static_cast<DWORD>(scratch.size()));
+	BASS_ChannelSetPosition(stream, 0, BASS_POS_BYTE);
+}
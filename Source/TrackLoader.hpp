@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <bass.h>
+
+#include "ArtLoader.hpp"
+#include "TagLoader.hpp"
+
+// Gets a song ready to play off the render thread, one stage
+// at a time, each handed over as soon as it's done:
+//
+//		Opening its stream (with BASS_STREAM_PRESCAN, which
+//		reads through the whole of a VBR MP3), so it can
+//		start playing
+//		Warming it up (decoding the start of it), if it's
+//		being got ready ahead of time
+//		Reading its tags and embedded art
+//
+// Finding and decoding its album art is then up to AlbumArt's
+// own worker, and analysing it is up to the BeatScheduler.
+//
+// Dropping (or destroying) a loader cancels it, and frees
+// a stream nobody took. That waits on whatever stage we're
+// in, so anything that can't wait should Cancel() it and
+// hang onto it until it's Done().
+class TrackLoader {
+public:
+	using OpenFunction = std::function<HSTREAM(const std::filesystem::path &, const std::string &, DWORD)>;
+
+	struct Stream {
+		// 0 if the song couldn't be opened
+		HSTREAM handle = 0;
+		BASS_CHANNELINFO info = { 0 };
+	};
+
+	// Everything Metadata found, just as it found it, for the
+	// render thread to hand over to Controls and AlbumArt. It's
+	// up to whoever we replay it into what to make of it.
+	class Tags : public TagLoader, public ArtLoader {
+	public:
+		struct Art {
+			std::string mimeType;
+			std::string data;
+		};
+
+		// The first tags are the file's own. Anything after that
+		// (and ID3v1) is what Metadata falls back on when they
+		// leave something out.
+		void LoadFromTags(const std::map<std::string, std::string> &tags) override { this->tags.push_back(tags); }
+
+		// We can't know what's missing until we're replayed,
+		// so we take every fallback there is
+		bool AreThereEmptyTags() const override { return true; }
+		bool HasTitle() const override;
+
+		void LoadFromID3v1(const TAG_ID3 *id3) override { id3v1 = *id3; }
+
+		void SetTitle(const std::string &title) override { this->title = title; }
+
+		// Only the first art we're given
+		bool Load(const std::string &mimeType, const void *data, std::size_t length) override;
+
+		// Makes the same calls Metadata would have,
+		// had it been reading into tagLoader
+		void LoadInto(TagLoader &tagLoader) const;
+
+		std::optional<Art> art;
+
+	private:
+		std::vector<std::map<std::string, std::string>> tags;
+		std::optional<TAG_ID3> id3v1;
+
+		// The filename, if there wasn't a title anywhere
+		std::optional<std::string> title;
+	};
+
+	// Opens path with flags (which have to include
+	// BASS_STREAM_DECODE, since we always play through
+	// our own output), then reads its tags. Warming it up
+	// decodes the start of it before it's handed over, so
+	// it can start without waiting on the disk.
+	TrackLoader(std::filesystem::path path, std::string extension, DWORD flags, OpenFunction openWithFlags, bool warm = false);
+
+	~TrackLoader();
+
+	TrackLoader(const TrackLoader &) = delete;
+	TrackLoader &operator=(const TrackLoader &) = delete;
+
+	const std::filesystem::path &GetPath() const { return path; }
+	const std::string &GetExtension() const { return extension; }
+
+	// Each stage, once it's done (and only the once). Only ever
+	// call these from the render thread.
+	std::optional<Stream> TakeStream();
+	std::optional<Tags> TakeTags();
+
+	// Stops after whatever stage we're in,
+	// without waiting for it
+	void Cancel() { canceled = true; }
+
+	// Whether our thread has nothing left to do
+	bool Done() const { return done; }
+
+private:
+	void Load();
+	void Warm(HSTREAM stream) const;
+
+	const std::filesystem::path path;
+	const std::string extension;
+
+	const DWORD flags = 0;
+	OpenFunction openWithFlags;
+	const bool warm = false;
+
+	HSTREAM stream = 0;
+
+	std::atomic<bool> canceled = false;
+	std::atomic<bool> done = false;
+
+	// Written by our thread and exchanged
+	// out by the render thread
+	std::atomic<Stream *> publishedStream = nullptr;
+	std::atomic<Tags *> publishedTags = nullptr;
+
+	std::thread thread;
+};
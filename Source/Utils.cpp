@@ -1,9 +1,14 @@
 #include "Utils.hpp"
 
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <sstream>
 
+#ifdef _WIN32
+#include <Shlobj.h>
+#endif
+
 namespace Fetcko {
 std::string Utils::GetStringFromFile(const std::filesystem::path & path) {
 	std::ifstream inFile(path, std::ios_base::in | std::ios_base::binary);
@@ -32,4 +37,37 @@ std::filesystem::path Utils::GetResource(const std::filesystem::path &path) {
 	return std::filesystem::path(".") / "Data" / path;
 #endif
 }
+
+std::filesystem::path Utils::GetUserFolder() {
+	std::filesystem::path ret;
+
+#ifdef _WIN32
+	PWSTR folder;
+	if (SHGetKnownFolderPath(FOLDERID_RoamingAppData, 0, NULL, &folder) == S_OK) {
+		ret = std::filesystem::path(folder);
+
+		CoTaskMemFree(folder);
+	}
+#elif defined(__APPLE__)
+	if (auto home = std::getenv("HOME"))
+		ret = std::filesystem::path(home) / "Library" / "Application Support";
+#else
+	// It's the shell that expands "~", not the filesystem
+	if (auto config = std::getenv("XDG_CONFIG_HOME"); config && *config)
+		ret = config;
+	else if (auto home = std::getenv("HOME"))
+		ret = std::filesystem::path(home) / ".config";
+#endif
+
+	if (!ret.empty()) {
+		ret = ret / "Fetcko" / "popRocks";
+
+		std::error_code error;
+		std::filesystem::create_directories(ret, error);
+		if (error)
+			ret.clear();
+	}
+
+	return ret;
+}
 }
\ No newline at end of file
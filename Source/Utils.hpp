@@ -1,9 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <optional>
+#include <sstream>
+#include <string>
 #include <typeindex>
+#include <vector>
 
 namespace Fetcko {
 class Utils {
@@ -11,6 +15,10 @@ public:
 	static std::string GetStringFromFile(const std::filesystem::path &path);
 	static std::filesystem::path GetResource(const std::filesystem::path &path);
 
+	// Where everything of ours (settings, caches, ...) lives.
+	// Empty if we couldn't find anywhere to put it.
+	static std::filesystem::path GetUserFolder();
+
 	enum class BOM {UTF_8, UTF_16_BE, UTF_16_LE};
 
 	template<typename C>
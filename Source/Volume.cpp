@@ -1,10 +1,18 @@
 #include "Volume.hpp"
 
+#include "Canvas.hpp"
+#include "GlyphAtlas.hpp"
+
 void Volume::OnInit(const std::filesystem::path &fontFile) {
 	auto string = fontFile.u8string();
 
 	ring.SetWidth(radius / 10);
 	outlineRing.SetWidth(radius / 10 + (radius / 25) * 2);
+
+	// One point per percent, plus the one we started at
+	ring.Reserve(101);
+	outlineRing.Reserve(101);
+
 	font = TTF_OpenFont(string.c_str(), static_cast<int>(radius / 2));
 	outlineFont = TTF_OpenFont(string.c_str(), static_cast<int>(radius / 2));
 
@@ -18,8 +26,10 @@ void Volume::OnInit(const std::filesystem::path &fontFile) {
 void Volume::OnLoop(int x, int y, const Delta &time) {
 	AutoFader::OnLoop(time);
 
-	glColor4f(color.r, color.g, color.b, alpha);
-	//glTranslatef(x, y, 0);
+	auto &canvas = Canvas::Get();
+
+	canvas.SetColor(color.r, color.g, color.b, alpha);
+	//canvas.Translate(x, y);
 
 	outlineText.OnLoop(x - outlineText.GetSize().x / 2, y - outlineText.GetSize().y / 2);
 	text.OnLoop(x - text.GetSize().x / 2, y - text.GetSize().y / 2);
@@ -41,19 +51,17 @@ void Volume::OnLoop(int x, int y, const Delta &time) {
 	glLoadIdentity();
 	*/
 
-	glColor4f(0.0f, 0.0f, 0.0f, alpha);
-	glTranslatef(
-		static_cast<GLfloat>(x),
-		static_cast<GLfloat>(y),
-		0
+	canvas.SetColor(0.0f, 0.0f, 0.0f, alpha);
+	canvas.Translate(
+		static_cast<float>(x),
+		static_cast<float>(y)
 	);
 	outlineRing.Draw();
 
-	glColor4f(color.r, color.g, color.b, alpha);
-	glTranslatef(
-		static_cast<GLfloat>(x),
-		static_cast<GLfloat>(y),
-		0
+	canvas.SetColor(color.r, color.g, color.b, alpha);
+	canvas.Translate(
+		static_cast<float>(x),
+		static_cast<float>(y)
 	);
 	ring.Draw();
 }
@@ -97,6 +105,10 @@ const float Volume::GetInverseVolume() const {
 
 void Volume::OnDestroy() {
 	text.OnDestroy();
+	outlineText.OnDestroy();
+
+	GlyphAtlas::Release(font);
+	GlyphAtlas::Release(outlineFont);
 	TTF_CloseFont(font);
 }
 
@@ -125,31 +137,31 @@ inline void Volume::UpdateVolume(bool force) {
 
 	std::size_t size = static_cast<std::size_t>((GetVolume() * 100) + 1);
 
-	auto *points = new Vector2f[size];
-	auto *outlinePoints = new Vector2f[size];
+	ring.Clear();
+	outlineRing.Clear();
+
 	float degInRad = 0.0f;
 	const auto outlineOffset = (outlineRing.GetWidth() - ring.GetWidth()) / 2.0f;
 	for (auto i = 0; i < size; ++i) {
 		degInRad = (((i / 100.0f) * 360.0f) + 180.0f /* start at 12 o'clock */) * Maths::DEG2RAD<float>;
 
 		// Negative X for clockwise movement
-		points[i].x = -(sin(degInRad) * ((radius - ring.GetWidth() / 2.0f) - outlineOffset));
-		points[i].y = cos(degInRad) * (radius - ring.GetWidth() / 2.0f - outlineOffset);
-
-		outlinePoints[i].x = -(sin(degInRad) * (radius - outlineRing.GetWidth() / 2.0f));
-		outlinePoints[i].y = cos(degInRad) * (radius - outlineRing.GetWidth() / 2.0f);
+		ring.AddPoint(Vector2f(
+			-(sin(degInRad) * ((radius - ring.GetWidth() / 2.0f) - outlineOffset)),
+			cos(degInRad) * (radius - ring.GetWidth() / 2.0f - outlineOffset)
+		));
+
+		outlineRing.AddPoint(Vector2f(
+			-(sin(degInRad) * (radius - outlineRing.GetWidth() / 2.0f)),
+			cos(degInRad) * (radius - outlineRing.GetWidth() / 2.0f)
+		));
 	}
-	ring.SetPoints<Polyline::Join::Miter>(points, size);
-	outlineRing.SetPoints<Polyline::Join::Miter>(outlinePoints, size);
 
 	if (size == 101) {
-		ring.Loop<Polyline::Join::Miter>();
-		outlineRing.Loop<Polyline::Join::Miter>();
+		ring.Loop();
+		outlineRing.Loop();
 	}
 
-	delete[] points;
-	delete[] outlinePoints;
-
 	// Update setting here
 
 	Fade(true);
@@ -0,0 +1,57 @@
+#include "Waveform.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void Waveform::OnStart(const AnalysisGraph::Format &format) {
+	freq = format.freq;
+	chans = std::max<DWORD>(format.chans, 1);
+
+	peaks.clear();
+	min = max = 0.0f;
+	sumOfSquares = 0.0;
+	framesInBlock = 0;
+
+	pyramid.reset();
+}
+
+void Waveform::OnSamples(const float *samples, std::size_t frames) {
+	for (std::size_t i = 0; i < frames; ++i) {
+		float sum = 0.0f;
+		for (DWORD c = 0; c < chans; ++c)
+			sum += samples[i * chans + c];
+
+		auto sample = sum / chans;
+
+		if (framesInBlock == 0) {
+			min = max = sample;
+		} else {
+			min = std::min(min, sample);
+			max = std::max(max, sample);
+		}
+
+		sumOfSquares += static_cast<double>(sample) * sample;
+
+		if (++framesInBlock == BlockFrames)
+			FinishBlock();
+	}
+}
+
+void Waveform::OnFinish() {
+	// Whatever's left of the last block
+	if (framesInBlock > 0)
+		FinishBlock();
+
+	if (freq > 0)
+		pyramid = std::make_shared<const PeakPyramid>(std::move(peaks), static_cast<double>(BlockFrames) / freq);
+
+	peaks.clear();
+}
+
+void Waveform::FinishBlock() {
+	auto rms = static_cast<float>(std::sqrt(sumOfSquares / framesInBlock));
+	peaks.emplace_back(PeakPyramid::Quantise(min, max, rms));
+
+	sumOfSquares = 0.0;
+	framesInBlock = 0;
+}
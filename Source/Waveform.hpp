@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "AnalysisGraph.hpp"
+#include "PeakPyramid.hpp"
+
+// The shape of a track, mixed down to mono: the lowest and
+// highest sample, and the RMS, of every block of BlockFrames.
+// Once the graph finishes, that gets built up into a PeakPyramid.
+class Waveform : public AnalysisGraph::Consumer {
+public:
+	static constexpr std::size_t BlockFrames = 256;
+
+	void OnStart(const AnalysisGraph::Format &format) override;
+	void OnSamples(const float *samples, std::size_t frames) override;
+	void OnFinish() override;
+
+	// Null until we've finished
+	const std::shared_ptr<const PeakPyramid> &GetPyramid() const { return pyramid; }
+
+private:
+	void FinishBlock();
+
+	DWORD freq = 0;
+	DWORD chans = 0;
+
+	std::vector<PeakPyramid::Peak> peaks;
+
+	float min = 0.0f;
+	float max = 0.0f;
+	double sumOfSquares = 0.0;
+	std::size_t framesInBlock = 0;
+
+	std::shared_ptr<const PeakPyramid> pyramid;
+};
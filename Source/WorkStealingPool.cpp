@@ -0,0 +1,115 @@
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+
+thread_local WorkStealingPool *WorkStealingPool::currentPool = nullptr;
+thread_local std::size_t WorkStealingPool::currentIndex = 0;
+
+WorkStealingPool::WorkStealingPool(std::size_t workers) {
+	if (workers == 0)
+		workers = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (std::size_t i = 0; i < workers; ++i)
+		queues.emplace_back(std::make_unique<Queue>());
+
+	for (std::size_t i = 0; i < workers; ++i)
+		this->workers.emplace_back(&WorkStealingPool::Work, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	{
+		std::unique_lock lock(mutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+
+	for (auto &worker : workers) {
+		if (worker.joinable())
+			worker.join();
+	}
+}
+
+void WorkStealingPool::Submit(Task task) {
+	auto index = currentPool == this ?
+		currentIndex :
+		nextQueue++ % queues.size();
+
+	++pending;
+
+	{
+		std::unique_lock lock(queues[index]->mutex);
+		queues[index]->tasks.emplace_back(std::move(task));
+		++queued;
+	}
+
+	// Taking the lock here means a worker can't check for
+	// work, miss this task and then go to sleep on us
+	{
+		std::unique_lock lock(mutex);
+	}
+
+	wake.notify_one();
+}
+
+void WorkStealingPool::Wait() {
+	std::unique_lock lock(mutex);
+	done.wait(lock, [this] { return pending == 0; });
+}
+
+void WorkStealingPool::Work(std::size_t index) {
+	currentPool = this;
+	currentIndex = index;
+
+	while (true) {
+		Task task;
+		if (Pop(index, task) || Steal(index, task)) {
+			task();
+
+			if (--pending == 0) {
+				std::unique_lock lock(mutex);
+				done.notify_all();
+			}
+
+			continue;
+		}
+
+		std::unique_lock lock(mutex);
+		wake.wait(lock, [this] { return stopping || queued > 0; });
+
+		if (stopping)
+			return;
+	}
+}
+
+bool WorkStealingPool::Pop(std::size_t index, Task &task) {
+	auto &queue = *queues[index];
+
+	std::unique_lock lock(queue.mutex);
+	if (queue.tasks.empty())
+		return false;
+
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	--queued;
+
+	return true;
+}
+
+bool WorkStealingPool::Steal(std::size_t index, Task &task) {
+	for (std::size_t i = 1; i < queues.size(); ++i) {
+		auto &queue = *queues[(index + i) % queues.size()];
+
+		std::unique_lock lock(queue.mutex);
+		if (queue.tasks.empty())
+			continue;
+
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		--queued;
+
+		return true;
+	}
+
+	return false;
+}
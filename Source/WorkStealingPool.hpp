@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads, each with its own queue.
+//
+// Workers take from the back of their own queue (so work
+// they queued themselves stays hot in cache) and, once
+// that runs dry, steal from the front of everyone else's.
+// Tracks vary wildly in length, so this keeps every core
+// busy until the very last one is done.
+class WorkStealingPool {
+public:
+	using Task = std::function<void()>;
+
+	// 0 means one worker per core
+	explicit WorkStealingPool(std::size_t workers = 0);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool &) = delete;
+	WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+	// Safe to call from any thread, including from inside
+	// a task (which queues onto that worker's own queue)
+	void Submit(Task task);
+
+	// Blocks until every submitted task has finished
+	void Wait();
+
+	std::size_t GetWorkerCount() const { return queues.size(); }
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void Work(std::size_t index);
+	bool Pop(std::size_t index, Task &task);
+	bool Steal(std::size_t index, Task &task);
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	// Round robin for tasks submitted from outside the pool
+	std::atomic<std::size_t> nextQueue = 0;
+
+	// Submitted but not yet finished
+	std::atomic<std::size_t> pending = 0;
+
+	// Sitting in a queue, waiting for a worker
+	std::atomic<std::size_t> queued = 0;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool stopping = false;
+
+	static thread_local WorkStealingPool *currentPool;
+	static thread_local std::size_t currentIndex;
+};
@@ -0,0 +1,61 @@
+// How long BeatRoot takes to track a long song, and how long
+// induction takes on a lot of onsets. Best of a few runs, since we
+// care about the tracker and not whatever else is running:
+//
+//	BeatRootBenchmark [SECONDS] [RUNS]
+//
+// Not part of ctest, it only prints timings.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+
+#include "BeatRootProcessor.h"
+#include "Induction.h"
+
+#include "SyntheticOnsets.hpp"
+
+namespace {
+template <typename F>
+double Best(int runs, F &&f) {
+	auto ret = std::numeric_limits<double>::max();
+
+	for (int run = 0; run < runs; ++run) {
+		const auto start = std::chrono::steady_clock::now();
+		f();
+		ret = std::min(ret, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	return ret;
+}
+}
+
+int main(int argc, char **argv) {
+	const double seconds = argc > 1 ? std::atof(argv[1]) : 600.0;
+	const int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+
+	// Onset detection isn't what we're timing, so
+	// only feed the spectra in once
+	BeatRootProcessor processor(44100, AgentParameters());
+	SyntheticOnsets::Feed(processor, 1, seconds, 0.05);
+
+	std::size_t beats = 0;
+	const auto tracking = Best(runs, [&] {
+		beats = processor.beatTrack().size();
+	});
+
+	std::printf("beatTrack: %.0f seconds of audio, %zu beats in %.3f ms\n", seconds, beats, tracking * 1000.0);
+
+	const auto onsets = SyntheticOnsets::Onsets(2, 4000);
+
+	std::size_t agents = 0;
+	const auto induction = Best(runs, [&] {
+		agents = Induction::beatInduction(AgentParameters(), onsets).size();
+	});
+
+	std::printf("beatInduction: %zu onsets, %zu agents in %.3f ms\n", onsets.size(), agents, induction * 1000.0);
+
+	return 0;
+}
@@ -0,0 +1,163 @@
+// Runs BeatRoot over synthetic songs and checks that every beat
+// (and every tempo induction comes up with) is bit for bit what
+// the unmodified tracker gave us. Anything we do to speed it up
+// has to keep these the same:
+//
+//	BeatRootTest [--print]
+//
+// --print writes out a new table of hashes instead, for when the
+// results are *meant* to change.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "BeatRootProcessor.h"
+#include "BeatTracker.h"
+#include "Induction.h"
+
+#include "SyntheticOnsets.hpp"
+
+namespace {
+// FNV-1a over the exact bits, so even the last ulp counts
+class Hash {
+public:
+	void Add(const void *data, std::size_t size) {
+		auto bytes = static_cast<const unsigned char *>(data);
+		for (std::size_t i = 0; i < size; ++i) {
+			value ^= bytes[i];
+			value *= 1099511628211ull;
+		}
+	}
+
+	void Add(double value) {
+		std::uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		Add(&bits, sizeof(bits));
+	}
+
+	void Add(int value) {
+		std::int64_t wide = value;
+		Add(&wide, sizeof(wide));
+	}
+
+	void Add(const EventList &events) {
+		Add(static_cast<int>(events.size()));
+		for (const auto &event : events) {
+			Add(event.time);
+			Add(event.beat);
+			Add(event.salience);
+		}
+	}
+
+	std::uint64_t Get() const { return value; }
+
+private:
+	std::uint64_t value = 14695981039346656037ull;
+};
+
+struct Song {
+	std::uint64_t seed;
+	double seconds;
+	double noise;
+};
+
+// Short and long, clean and noisy
+constexpr Song Songs[] = {
+	{ 1, 30.0, 0.03 },
+	{ 2, 60.0, 0.03 },
+	{ 3, 60.0, 0.20 },
+	{ 4, 120.0, 0.05 },
+	{ 5, 180.0, 0.10 },
+};
+
+constexpr std::uint64_t InductionSeeds = 60;
+
+// From the original BeatRoot, before any of our changes
+constexpr std::uint64_t Expected[] = {
+	0x9546ef725684aaf6ull,
+	0x54d89af91c764607ull,
+	0x42a7a9ba714ef890ull,
+	0x9b37b3bcf2ebd626ull,
+	0xe00f27c546506be7ull,
+	0x866f50a8299c613eull,
+	0x20a27e72fd43aab3ull,
+	0xcc109e9034e15e58ull,
+	0x8e1ead0d42976407ull,
+	0xddd780e93467d4c8ull,
+	0xa5ca0bbbee3243bbull,
+};
+
+std::vector<std::uint64_t> Run() {
+	std::vector<std::uint64_t> ret;
+
+	for (const auto &song : Songs) {
+		BeatRootProcessor processor(44100, AgentParameters());
+		const double beat = 60.0 / SyntheticOnsets::Feed(processor, song.seed, song.seconds, song.noise);
+
+		Hash tracked;
+		tracked.Add(processor.beatTrack());
+		ret.push_back(tracked.Get());
+
+		// Tracking from a few beats we already know about
+		SyntheticOnsets::Random random(song.seed);
+
+		EventList onsets, initial;
+		for (int i = 0; i < 400; ++i)
+			onsets.push_back(Event(i * beat * 0.5 + random.Next() * 0.02, 0, random.Next()));
+		for (int i = 0; i < 4; ++i)
+			initial.push_back(Event(i * beat, 0, 1));
+
+		Hash seeded;
+		seeded.Add(BeatTracker::beatTrack(AgentParameters(), onsets, initial));
+		ret.push_back(seeded.Get());
+	}
+
+	Hash induced;
+	for (std::uint64_t seed = 0; seed < InductionSeeds; ++seed) {
+		auto agents = Induction::beatInduction(AgentParameters(), SyntheticOnsets::Onsets(seed, 50 + seed * 20));
+
+		// Not the ID numbers though, the original handed
+		// those out from a global counter
+		induced.Add(static_cast<int>(agents.size()));
+		for (auto it = agents.begin(); it != agents.end(); ++it)
+			induced.Add((*it)->beatInterval);
+	}
+	ret.push_back(induced.Get());
+
+	return ret;
+}
+}
+
+int main(int argc, char **argv) {
+	const auto hashes = Run();
+
+	if (argc > 1 && std::strcmp(argv[1], "--print") == 0) {
+		for (auto hash : hashes)
+			std::printf("\t0x%016llxull,\n", static_cast<unsigned long long>(hash));
+		return 0;
+	}
+
+	constexpr auto expectedCount = sizeof(Expected) / sizeof(Expected[0]);
+	if (hashes.size() != expectedCount) {
+		std::printf("FAILED: %zu results, expected %zu\n", hashes.size(), expectedCount);
+		return 1;
+	}
+
+	int failures = 0;
+	for (std::size_t i = 0; i < hashes.size(); ++i) {
+		if (hashes[i] != Expected[i]) {
+			std::printf("FAILED: result %zu is %016llx, expected %016llx\n",
+				i,
+				static_cast<unsigned long long>(hashes[i]),
+				static_cast<unsigned long long>(Expected[i])
+			);
+			++failures;
+		}
+	}
+
+	std::printf("%d failures\n", failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+// Draws one batch of everything Canvas knows how to draw into an
+// offscreen EGL surface, then reads it back. No window and no GPU
+// needed, so Mesa's llvmpipe is enough:
+//
+//	EGL_PLATFORM=surfaceless CanvasTest [--compatibility]
+//
+// Uses a 3.3 core profile context unless told otherwise.
+
+#include <cstdio>
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "Canvas.hpp"
+
+namespace {
+constexpr int Size = 64;
+
+int failures = 0;
+
+void Check(bool condition, const char *what) {
+	if (!condition) {
+		std::printf("FAILED: %s\n", what);
+		++failures;
+	}
+}
+
+struct Pixel {
+	unsigned char r, g, b, a;
+};
+
+// (0, 0) in the top left, same as Canvas
+Pixel At(int x, int y) {
+	Pixel ret;
+	glReadPixels(x, Size - 1 - y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &ret);
+	return ret;
+}
+
+bool MakeContext(bool core) {
+	auto display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major = 0, minor = 0;
+	if (!eglInitialize(display, &major, &minor)) {
+		std::printf("Could not initialize EGL\n");
+		return false;
+	}
+
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+
+	EGLConfig config;
+	EGLint count = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &count) || count == 0) {
+		std::printf("No EGL config we can draw into\n");
+		return false;
+	}
+
+	const EGLint surfaceAttributes[] = { EGL_WIDTH, Size, EGL_HEIGHT, Size, EGL_NONE };
+	auto surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+
+	eglBindAPI(EGL_OPENGL_API);
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, core ? 3 : 2,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, core ? EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+		EGL_NONE
+	};
+
+	auto context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (!surface || !context || !eglMakeCurrent(display, surface, surface, context)) {
+		std::printf("Could not create a %s context\n", core ? "core" : "compatibility");
+		return false;
+	}
+
+	return gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+}
+}
+
+int main(int argc, char **argv) {
+	const bool core = !(argc > 1 && std::strcmp(argv[1], "--compatibility") == 0);
+
+	if (!MakeContext(core))
+		return 1;
+
+	std::printf("%s on %s\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+
+	auto &canvas = Canvas::Get();
+	Check(canvas.OnInit(), "OnInit");
+	Check(canvas.IsCore() == core, "IsCore");
+
+	canvas.OnResize(Size, Size);
+	glViewport(0, 0, Size, Size);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	const float square[] = { 0, 0, 0, 16, 16, 16, 16, 0 };
+	const unsigned short indices[] = { 0, 1, 2, 0, 2, 3 };
+
+	// Indexed, in the current color
+	canvas.SetColor(1.0f, 0.0f, 0.0f, 1.0f);
+	canvas.Translate(4, 4);
+	canvas.Draw(GL_TRIANGLES, 6, square, indices);
+	canvas.LoadIdentity();
+
+	// A strip, blended
+	const float strip[] = { 30, 4, 30, 14, 40, 4, 40, 14 };
+	canvas.SetColor(0.0f, 1.0f, 0.0f, 0.5f);
+	canvas.Draw(GL_TRIANGLE_STRIP, 4, strip);
+
+	// Per-vertex colors
+	const float colors[] = { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1 };
+	canvas.Translate(4, 40);
+	canvas.Draw(GL_TRIANGLES, 6, square, indices, colors);
+	canvas.LoadIdentity();
+
+	// A white | yellow texture, as an interleaved fan turned 90 degrees
+	const unsigned char pixels[] = { 255, 255, 255, 255, 255, 255, 0, 255 };
+
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+	struct Vertex {
+		float x, y, u, v;
+	} fan[] = { { 0, 0, 0, 0 }, { 0, 16, 0, 1 }, { 16, 16, 1, 1 }, { 16, 0, 1, 0 } };
+
+	canvas.SetColor(1.0f, 1.0f, 1.0f, 1.0f);
+	canvas.Translate(56, 40);
+	canvas.Rotate(90, 0, 0, 1);
+	canvas.DrawTextured(GL_TRIANGLE_FAN, 4, texture, &fan[0].x, &fan[0].u, nullptr, sizeof(Vertex));
+	canvas.LoadIdentity();
+
+	canvas.Flush();
+
+	auto pixel = At(10, 10);
+	Check(pixel.r == 255 && pixel.g == 0 && pixel.b == 0, "indexed triangles");
+
+	pixel = At(2, 2);
+	Check(pixel.r == 0 && pixel.g == 0 && pixel.b == 0, "nothing drawn outside them");
+
+	pixel = At(35, 8);
+	Check(pixel.r == 0 && pixel.g > 120 && pixel.g < 135, "blended strip");
+
+	pixel = At(10, 45);
+	Check(pixel.r == 0 && pixel.b == 255, "per-vertex colors");
+
+	pixel = At(50, 44);
+	Check(pixel.r == 255 && pixel.g == 255 && pixel.b == 255, "textured fan (white half)");
+
+	pixel = At(50, 52);
+	Check(pixel.r == 255 && pixel.g == 255 && pixel.b == 0, "textured fan (yellow half)");
+
+	Check(glGetError() == GL_NO_ERROR, "no GL errors");
+
+	glDeleteTextures(1, &texture);
+	canvas.OnDestroy();
+
+	std::printf("%s: %d failures\n", core ? "core" : "compatibility", failures);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "BeatRootProcessor.h"
+
+// Made up (but beat-like) input for BeatRoot, the same on every
+// platform and standard library. <random>'s distributions aren't,
+// so we roll our own.
+namespace SyntheticOnsets {
+// xorshift64*
+class Random {
+public:
+	explicit Random(std::uint64_t seed) : state(seed * 2654435761u + 1) {}
+
+	// [0, 1)
+	double Next() {
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+
+		return static_cast<double>((state * 2685821657736338717ull) >> 11) / 9007199254740992.0;
+	}
+
+private:
+	std::uint64_t state;
+};
+
+// A song's worth of spectra: a kick on every beat, something
+// quieter on every half beat, and random bursts (spurious onsets)
+// over the top. Returns the tempo.
+inline double Feed(BeatRootProcessor &processor, std::uint64_t seed, double seconds, double noise) {
+	Random random(seed);
+
+	const auto fftSize = processor.getFFTSize();
+	const auto hopTime = processor.getHopTime();
+
+	const double bpm = 80.0 + 100.0 * random.Next();
+	const double beat = 60.0 / bpm;
+
+	std::vector<float> spectrum((fftSize + 2) * 2);
+
+	const auto frames = static_cast<long>(seconds / hopTime);
+	for (long frame = 0; frame < frames; ++frame) {
+		const double time = frame * hopTime;
+
+		double level = 0.0;
+		if (std::fmod(time, beat) / beat < 0.08)
+			level += 5.0;
+		if (std::fmod(time, beat / 2.0) / (beat / 2.0) < 0.05)
+			level += 2.0;
+		if (random.Next() < noise)
+			level += 3.0 * random.Next();
+
+		for (int bin = 0; bin <= fftSize / 2; ++bin) {
+			const double falloff = 1.0 + bin * 0.01;
+
+			spectrum[bin * 2] = static_cast<float>(random.Next() * (0.5 + level) / falloff);
+			spectrum[bin * 2 + 1] = static_cast<float>(random.Next() * (0.5 + level) / falloff);
+		}
+
+		const float *frameData = spectrum.data();
+		processor.processFrame(&frameData);
+	}
+
+	return bpm;
+}
+
+// Onsets on their own, for induction. Every third seed is
+// just noise, the rest are beats (and subdivisions of them),
+// with times rounded to 10ms so some of them coincide.
+inline EventList Onsets(std::uint64_t seed, std::size_t count) {
+	Random random(seed);
+
+	const double beat = 0.3 + random.Next();
+
+	EventList ret;
+	double time = 0.0;
+
+	for (std::size_t i = 0; i < count; ++i) {
+		const double pick = random.Next();
+
+		if (seed % 3 == 0)
+			time += 0.01 + random.Next() * 0.3;
+		else if (seed % 3 == 1)
+			time += (pick < 0.5 ? beat : beat / 2.0) + (random.Next() - 0.5) * 0.03;
+		else
+			time += (pick < 0.3 ? beat / 3.0 : pick < 0.6 ? beat / 4.0 : beat) + (random.Next() - 0.5) * 0.05;
+
+		ret.push_back(Event(std::round(time * 100.0) / 100.0, 0, random.Next()));
+
+		if (random.Next() < 0.02)
+			ret.push_back(ret.back());
+	}
+
+	return ret;
+}
+}
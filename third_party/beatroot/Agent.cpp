@@ -25,11 +25,9 @@ const double Agent::INNER_MARGIN = 0.040;
 const double Agent::CONF_FACTOR = 0.5;
 const double Agent::DEFAULT_CORRECTION_FACTOR = 50.0;
 
-int Agent::idCounter = 0;
-
-void Agent::accept(Event e, double err, int beats) {
+void Agent::accept(const Event &e, double err, int beats, AgentList &a) {
     beatTime = e.time;
-    events.push_back(e);
+    lastEvent = a.addEvent(e, lastEvent);
     if (fabs(initialBeatInterval - beatInterval -
              err / correctionFactor) < maxChange * initialBeatInterval)
         beatInterval += err / correctionFactor;// Adjust tempo
@@ -51,17 +49,16 @@ void Agent::accept(Event e, double err, int beats) {
 #endif
 } // accept()
 
-bool Agent::considerAsBeat(Event e, AgentList &a) {
+bool Agent::considerAsBeat(const Event &e, AgentList &a) {
     double err;
     if (beatTime < 0) {	// first event
 #ifdef DEBUG_BEATROOT
         std::cerr << "Ag#" << idNumber << ": accepting first event trivially at " << e.time << std::endl;
 #endif
-	accept(e, 0, 1);
+	accept(e, 0, 1, a);
 	return true;
     } else {			// subsequent events
-        EventList::iterator last = events.end();
-        --last;
+        const Event *last = &a.getEvent(lastEvent);
 	if (e.time - last->time > expiryTime) {
 #ifdef DEBUG_BEATROOT
             std::cerr << "Ag#" << idNumber << ": time " << e.time 
@@ -83,9 +80,9 @@ bool Agent::considerAsBeat(Event e, AgentList &a) {
 #endif
                 // Create new agent that skips this event (avoids
                 // large phase jump)
-		a.add(clone());
+		a.add(a.clone(*this), false);
             }
-	    accept(e, err, (int)beats);
+	    accept(e, err, (int)beats, a);
 	    return true;
 	}
     }
@@ -93,29 +90,34 @@ bool Agent::considerAsBeat(Event e, AgentList &a) {
 } // considerAsBeat()
 
 
-void Agent::fillBeats(double start) {
+EventList Agent::fillBeats(const AgentList &a, double start) const {
+    // Modified 18Oct2026:
+    //    Builds a new EventList front to back instead of
+    //    inserting into the middle of a std::list.
+    //
+    //    The original quirk of seeding prevBeat with the
+    //    *second* event's time (so the gap between the
+    //    first two beats is never filled) is preserved
+    //    on purpose, so results are unchanged.
+    EventList events = a.getEvents(*this);
+    EventList filled;
     double prevBeat = 0, nextBeat, currentInterval, beats;
-    EventList::iterator ei = events.begin();
-    if (ei != events.end()) {
-        EventList::iterator ni = ei;
-        if (++ni != events.end()) {
-            prevBeat = ni->time;
-        }
+    if (events.size() > 1)
+        prevBeat = events[1].time;
+    if (!events.empty()) {
+        filled.reserve(events.size() * 2);
+        filled.push_back(events.front());
     }
-    while (ei != events.end()) {
-        EventList::iterator ni = ei;
-        if (ni == events.end() ||
-            ++ni == events.end()) {
-            break;
-        }
-	nextBeat = ni->time;
+    for (std::size_t i = 1; i < events.size(); ++i) {
+	nextBeat = events[i].time;
 	beats = nearbyint((nextBeat - prevBeat) / beatInterval - 0.01); //prefer slow
 	currentInterval = (nextBeat - prevBeat) / beats;
 	for ( ; (nextBeat > start) && (beats > 1.5); beats--) {
 	    prevBeat += currentInterval;
-            events.insert(ni, BeatTracker::newBeat(prevBeat, 0));
+            filled.push_back(BeatTracker::newBeat(prevBeat, 0));
 	}
 	prevBeat = nextBeat;
-        ei = ni;
+        filled.push_back(events[i]);
     }
+    return filled;
 } // fillBeats()
@@ -86,9 +86,6 @@ public:
     static const double DEFAULT_CORRECTION_FACTOR;
 	
 protected:
-    /** The identity number of the next created Agent */
-    static int idCounter;
-	
     /** The maximum time (in seconds) that a beat can deviate from the
      *  predicted beat time without a fork occurring (i.e. a 2nd Agent
      *  being created). */
@@ -150,21 +147,29 @@ public:
      * expressed as a fraction of the initial beat period. */
     double maxChange;
 	
-    /** The list of Events (onsets) accepted by this Agent as beats,
-     * plus interpolated beats. */
-    EventList events;
+    /** The most recent Event (onset) accepted by this Agent as a
+     *  beat, as an index into the history shared by every Agent in
+     *  the owning AgentList, or -1 if no beats have been accepted.
+     *
+     *  Modified 18Oct2026: this used to be a full EventList per
+     *  Agent, which meant every clone() copied the entire beat
+     *  history. The history is now a tree of Events owned by the
+     *  AgentList, where each Agent only holds its leaf, so cloning
+     *  is O(1). See AgentList::getEvents(). */
+    int lastEvent;
 
     /** Constructor: the work is performed by init()
      *  @param ibi The beat period (inter-beat interval) of the Agent's tempo hypothesis.
+     *  @param id The Agent's unique identity number (see AgentList::create())
      */
-    Agent(AgentParameters params, double ibi) :
+    Agent(AgentParameters params, double ibi, int id) :
 	innerMargin(INNER_MARGIN),
 	correctionFactor(DEFAULT_CORRECTION_FACTOR),
 	expiryTime(params.expiryTime),
 	decayFactor(0),
 	preMargin(ibi * params.preMarginFactor),
 	postMargin(ibi * params.postMarginFactor),
-	idNumber(idCounter++),
+	idNumber(id),
 	tempoScore(0.0),
 	phaseScore(0.0),
 	topScoreTime(0.0),
@@ -172,15 +177,10 @@ public:
 	beatInterval(ibi),
 	initialBeatInterval(ibi),
 	beatTime(-1.0),
-        maxChange(params.maxChange) {
+        maxChange(params.maxChange),
+        lastEvent(-1) {
     } // constructor
 
-    Agent *clone() const {
-        Agent *a = new Agent(*this);
-        a->idNumber = idCounter++;
-        return a;
-    }
-
 protected:
     double threshold(double value, double min, double max) {
 	if (value < min)
@@ -195,8 +195,9 @@ public:
      *  @param e The Event which is accepted as being on the beat.
      *  @param err The difference between the predicted and actual beat times.
      *  @param beats The number of beats since the last beat that matched an Event.
+     *  @param a The list of all agents, which owns the shared beat history.
      */
-    void accept(Event e, double err, int beats);
+    void accept(const Event &e, double err, int beats, AgentList &a);
 
     /** The given Event is tested for a possible beat time. The following situations can occur:
      *  1) The Agent has no beats yet; the Event is accepted as the first beat.
@@ -209,17 +210,22 @@ public:
      * @param a The list of all agents, which is updated if a new agent is created.
      * @return Indicate whether the given Event was accepted as a beat by this Agent.
      */
-    bool considerAsBeat(Event e, AgentList &a);
+    bool considerAsBeat(const Event &e, AgentList &a);
 
-    /** Interpolates missing beats in the Agent's beat track, starting from the beginning of the piece. */
-    void fillBeats() {
-	fillBeats(-1.0);
-    } // fillBeats()/0
+    /** Interpolates missing beats in the Agent's beat track, starting from the beginning of the piece.
+     *  @param a The list of all agents, which owns the shared beat history.
+     *  @return The Events accepted by this Agent as beats, plus interpolated beats.
+     */
+    EventList fillBeats(const AgentList &a) const {
+	return fillBeats(a, -1.0);
+    } // fillBeats()/1
 
     /** Interpolates missing beats in the Agent's beat track.
+     *  @param a The list of all agents, which owns the shared beat history.
      *  @param start Ignore beats earlier than this start time 
+     *  @return The Events accepted by this Agent as beats, plus interpolated beats.
      */
-    void fillBeats(double start);
+    EventList fillBeats(const AgentList &a, double start) const;
 
 }; // class Agent
 
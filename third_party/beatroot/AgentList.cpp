@@ -52,23 +52,21 @@ void AgentList::removeDuplicates()
             }
         }
     }
+    // Modified 18Oct2026:
+    //    Compact in a single pass instead of erasing one
+    //    agent at a time, and hand removed agents back to
+    //    the pool rather than deleting them.
     int removed = 0;
-    for (iterator itr = begin(); itr != end(); ) {
+    iterator out = begin();
+    for (iterator itr = begin(); itr != end(); ++itr) {
         if ((*itr)->phaseScore < 0.0) {
             ++removed;
-            delete *itr;
-			
-			// 11Jun2025: Return value of erase was ignored,
-			//            resulting in an invalidated iterator.
-			//            
-			//            Fix: set itr to erase's return value.
-			//
-			// - Nick Fetcko
-            itr = list.erase(itr);
+            spare.push_back(*itr);
         } else {
-            ++itr;
+            *out++ = *itr;
         }
     }
+    list.erase(out, end());
 #ifdef DEBUG_BEATROOT
     if (removed > 0) {
         std::cerr << "removeDuplicates: removed " << removed << ", have "
@@ -82,13 +80,12 @@ void AgentList::removeDuplicates()
 } // removeDuplicates()
 
 
-void AgentList::beatTrack(EventList el, AgentParameters params, double stop)
+void AgentList::beatTrack(const EventList &el, AgentParameters params, double stop)
 {
-    EventList::iterator ei = el.begin();
     bool phaseGiven = !empty() && ((*begin())->beatTime >= 0); // if given for one, assume given for others
-    while (ei != el.end()) {
-        Event ev = *ei;
-        ++ei;
+    history.reserve(history.size() + el.size() * 4);
+    for (EventList::const_iterator ei = el.begin(); ei != el.end(); ++ei) {
+        const Event &ev = *ei;
         if ((stop > 0) && (ev.time > stop))
             break;
         bool created = phaseGiven;
@@ -98,7 +95,14 @@ void AgentList::beatTrack(EventList el, AgentParameters params, double stop)
         // list while scanning without disrupting our scan.  Each
         // agent needs to be re-added to our own list explicitly
         // (since it is modified by e.g. considerAsBeat)
-        Container currentAgents = list;
+        //
+        // Modified 18Oct2026:
+        //    Swap into a reused container rather than copying,
+        //    and append without sorting. removeDuplicates() sorts
+        //    once at the end, and since (beatInterval, idNumber) is
+        //    a strict ordering, the result is identical to sorting
+        //    after every add.
+        currentAgents.swap(list);
         list.clear();
         for (Container::iterator ai = currentAgents.begin();
              ai != currentAgents.end(); ++ai) {
@@ -109,17 +113,17 @@ void AgentList::beatTrack(EventList el, AgentParameters params, double stop)
                     std::cerr << "Creating a new agent" << std::endl;
 #endif
                     // Create new agent with different phase
-                    Agent *newAgent = new Agent(params, prevBeatInterval);
+                    Agent *newAgent = create(params, prevBeatInterval);
                     // This may add another agent to our list as well
                     newAgent->considerAsBeat(ev, *this);
-                    add(newAgent);
+                    add(newAgent, false);
                 }
                 prevBeatInterval = currentAgent->beatInterval;
                 created = phaseGiven;
             }
             if (currentAgent->considerAsBeat(ev, *this))
                 created = true;
-            add(currentAgent);
+            add(currentAgent, false);
         } // loop for each agent
         removeDuplicates();
     } // loop for each event
@@ -130,7 +134,7 @@ Agent *AgentList::bestAgent()
     double best = -1.0;
     Agent *bestAg = 0;
     for (iterator itr = begin(); itr != end(); ++itr) {
-        if ((*itr)->events.empty()) continue;
+        if ((*itr)->lastEvent < 0) continue;
         double conf = ((*itr)->phaseScore + (*itr)->tempoScore) /
             (useAverageSalience? (double)(*itr)->beatCount: 1.0);
         if (conf > best) {
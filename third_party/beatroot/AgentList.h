@@ -20,6 +20,7 @@
 #include "Event.h"
 
 #include <vector>
+#include <deque>
 #include <algorithm>
 
 #ifdef DEBUG_BEATROOT
@@ -37,6 +38,28 @@ public:
 protected:
     Container list;
 
+    /** Scratch copy of list, reused for every onset by beatTrack() */
+    Container currentAgents;
+
+    /** Storage for every Agent owned by this list. A deque never
+     *  moves its elements, so pointers into it stay valid. */
+    std::deque<Agent> pool;
+
+    /** Agents in the pool which have been removed and can be reused */
+    Container spare;
+
+    /** A node in the beat history shared by every Agent in the list.
+     *  Each node points to the previously accepted Event, so an
+     *  Agent's history is the path from its lastEvent to the root. */
+    struct HistoryNode {
+        Event event;
+        int previous;
+    };
+    std::vector<HistoryNode> history;
+
+    /** The identity number of the next created Agent */
+    int idCounter;
+
     static bool agentComparator(const Agent *a, const Agent *b) {
         if (a->beatInterval == b->beatInterval) {
             return a->idNumber < b->idNumber; // ensure stable ordering
@@ -46,6 +69,69 @@ protected:
     }
 
 public:
+    AgentList() : idCounter(0) { }
+
+    // Agents point into our pool, so we can be moved but not copied
+    AgentList(const AgentList &) = delete;
+    AgentList &operator=(const AgentList &) = delete;
+    AgentList(AgentList &&) = default;
+    AgentList &operator=(AgentList &&) = default;
+
+    /** Creates a new Agent owned by this list (but does not add it).
+     *  @param ibi The beat period (inter-beat interval) of the Agent's tempo hypothesis.
+     */
+    Agent *create(AgentParameters params, double ibi) {
+        if (spare.empty()) {
+            pool.emplace_back(params, ibi, idCounter++);
+            return &pool.back();
+        }
+        Agent *a = spare.back();
+        spare.pop_back();
+        *a = Agent(params, ibi, idCounter++);
+        return a;
+    } // create()
+
+    /** Creates a copy of the given Agent with a new identity number.
+     *  The beat history is shared rather than copied.
+     */
+    Agent *clone(const Agent &agent) {
+        Agent *a;
+        if (spare.empty()) {
+            pool.push_back(agent);
+            a = &pool.back();
+        } else {
+            a = spare.back();
+            spare.pop_back();
+            *a = agent;
+        }
+        a->idNumber = idCounter++;
+        return a;
+    } // clone()
+
+    /** Appends an Event to the shared beat history.
+     *  @param e The Event which has been accepted as a beat
+     *  @param previous The previously accepted Event, or -1
+     *  @return The index of the new Event
+     */
+    int addEvent(const Event &e, int previous) {
+        history.push_back({ e, previous });
+        return (int)history.size() - 1;
+    } // addEvent()
+
+    /** @return The Event at the given index in the shared beat history */
+    const Event &getEvent(int index) const {
+        return history[index].event;
+    } // getEvent()
+
+    /** @return The Events accepted as beats by the given Agent, in order */
+    EventList getEvents(const Agent &a) const {
+        EventList events;
+        for (int i = a.lastEvent; i >= 0; i = history[i].previous)
+            events.push_back(history[i].event);
+        std::reverse(events.begin(), events.end());
+        return events;
+    } // getEvents()
+
     // expose some vector methods
     //!!! can we remove these again once the rest of AgentList is implemented?
     bool empty() const { return list.empty(); }
@@ -121,7 +207,7 @@ public:
     /** Perform beat tracking on a list of events (onsets).
      *  @param el The list of onsets (or events or peaks) to beat track
      */
-    void beatTrack(EventList el, AgentParameters params) {
+    void beatTrack(const EventList &el, AgentParameters params) {
 	beatTrack(el, params, -1.0);
     } // beatTrack()/1
 	
@@ -129,7 +215,7 @@ public:
      *  @param el The list of onsets (or events or peaks) to beat track.
      *  @param stop Do not find beats after <code>stop</code> seconds.
      */
-    void beatTrack(EventList el, AgentParameters params, double stop);
+    void beatTrack(const EventList &el, AgentParameters params, double stop);
 
     /** Finds the Agent with the highest score in the list, or NULL if beat tracking has failed.
      *  @return The Agent with the highest score
@@ -15,6 +15,8 @@
 
 #include "BeatRootProcessor.h"
 
+#include <algorithm>
+
 bool
 BeatRootProcessor::silent = true;
 
@@ -71,3 +73,44 @@ EventList BeatRootProcessor::beatTrack() {
 
 } // processFile()
 
+
+EventList BeatRootProcessor::beatTrack(double startTime, double endTime) {
+
+    double hop = hopTime;
+    std::size_t frames = spectralFlux.size();
+    std::size_t first = std::min(frames, (std::size_t)std::max(0L, lrint(startTime / hop)));
+    std::size_t last = endTime < 0 ? frames :
+        std::min(frames, (std::size_t)std::max(0L, lrint(endTime / hop)));
+    if (last <= first)
+        return EventList();
+
+    // A second either side is plenty for the peak picker's
+    // running average to settle before the section starts
+    std::size_t context = (std::size_t)lrint(1.0 / hop);
+    std::size_t from = first > context ? first - context : 0;
+    std::size_t to = std::min(frames, last + context);
+
+    vector<double> flux(spectralFlux.begin() + from, spectralFlux.begin() + to);
+    Peaks::normalise(flux);
+    auto peaks = Peaks::findPeaks(flux, (int)lrint(0.06 / hop), 0.35, 0.84, true);
+
+    EventList sectionOnsets;
+    sectionOnsets.reserve(peaks.size());
+    double minSalience = Peaks::min(flux);
+    for (auto peak : peaks) {
+        std::size_t index = peak + from;
+        if (index < first || index >= last)
+            continue;
+        Event e = BeatTracker::newBeat((index - first) * hop, 0);
+        // Note that salience must be non-negative or the beat tracking system fails!
+        e.salience = flux[peak] - minSalience;
+        sectionOnsets.push_back(e);
+    }
+
+#ifdef DEBUG_BEATROOT
+    std::cerr << "Section onsets: " << sectionOnsets.size() << std::endl;
+#endif
+
+    return BeatTracker::beatTrack(agentParameters, sectionOnsets);
+
+} // beatTrack()/2
@@ -126,6 +126,17 @@ public:
      */
     EventList beatTrack();
 
+    /** Tracks beats in one section of the frames processed so far (e.g.
+     *  one song of a whole album image), leaving the spectral flux
+     *  untouched so other sections can be tracked afterwards. Frames
+     *  either side of the section are used as context for peak picking.
+     *  Added 18Oct2026.
+     *  @param startTime The start of the section in seconds
+     *  @param endTime The end of the section in seconds, or < 0 for the end
+     *  @return The beats, relative to startTime
+     */
+    EventList beatTrack(double startTime, double endTime);
+
 protected:
     /** Allocates or re-allocates memory for arrays, based on parameter settings */
     void init() {
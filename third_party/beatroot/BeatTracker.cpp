@@ -16,7 +16,7 @@
 #include "BeatTracker.h"
 
 EventList BeatTracker::beatTrack(AgentParameters params,
-                                 EventList events, EventList beats)
+                                 const EventList &events, const EventList &beats)
 {
     AgentList agents;
 	// Modified 18Jul2025 by Nick Fetcko:
@@ -26,33 +26,30 @@ EventList BeatTracker::beatTrack(AgentParameters params,
     double beatTime = -1;
     if (!beats.empty()) {
 	count = beats.size() - 1;
-	EventList::iterator itr = beats.end();
-	--itr;
-	beatTime = itr->time;
+	beatTime = beats.back().time;
     }
     if (count > 0) { // tempo given by mean of initial beats
-	double ioi = (beatTime - beats.begin()->time) / count;
-	agents.push_back(new Agent(params, ioi));
+	double ioi = (beatTime - beats.front().time) / count;
+	agents.push_back(agents.create(params, ioi));
     } else // tempo not given; use tempo induction
 	agents = Induction::beatInduction(params, events);
-    if (!beats.empty())
+    if (!beats.empty()) {
+	// The initial beats are shared by every agent
+	int lastEvent = -1;
+	for (EventList::const_iterator itr = beats.begin(); itr != beats.end(); ++itr)
+	    lastEvent = agents.addEvent(*itr, lastEvent);
 	for (AgentList::iterator itr = agents.begin(); itr != agents.end();
 	     ++itr) {
 	    (*itr)->beatTime = beatTime;
 	    (*itr)->beatCount = count;
-	    (*itr)->events = beats;
+	    (*itr)->lastEvent = lastEvent;
 	}
+    }
     agents.beatTrack(events, params, -1);
     Agent *best = agents.bestAgent();
     EventList results;
-    if (best) {
-	best->fillBeats(beatTime);
-	results = best->events;
-    }
-    for (AgentList::iterator ai = agents.begin(); ai != agents.end(); ++ai) {
-	delete *ai;
-    }
+    if (best)
+	results = best->fillBeats(agents, beatTime);
+    // Agents are owned by (and freed with) the AgentList
     return results;
 } // beatTrack()/1
-	
-
@@ -56,7 +56,7 @@ public:
      *  @param events The onsets or peaks in a feature list
      *  @return The list of beats, or an empty list if beat tracking fails
      */
-    static EventList beatTrack(AgentParameters params, EventList events) {
+    static EventList beatTrack(AgentParameters params, const EventList &events) {
 	return beatTrack(params, events, EventList());
     }
 	
@@ -66,7 +66,7 @@ public:
      *  @return The list of beats, or an empty list if beat tracking fails
      */
     static EventList beatTrack(AgentParameters params,
-                               EventList events, EventList beats);
+                               const EventList &events, const EventList &beats);
 	
 	
     // Various get and set methods
@@ -16,7 +16,7 @@
 #ifndef _EVENT_H_
 #define _EVENT_H_
 
-#include <list>
+#include <vector>
 
 struct Event {
     double time;
@@ -26,15 +26,20 @@ struct Event {
     Event() : time(0), beat(0), salience(0) { }
     Event(double t, double b, double s) : time(t), beat(b), salience(s) { }
 
-    bool operator==(const Event &e) {
+    bool operator==(const Event &e) const {
 	return (time == e.time && beat == e.beat && salience == e.salience);
     }
-    bool operator!=(const Event &e) {
+    bool operator!=(const Event &e) const {
 	return !operator==(e);
     }
 };
 
-typedef std::list<Event> EventList;
+// Modified 18Oct2026:
+//    Changed from std::list to std::vector.
+//    Nothing ever inserts into the middle of
+//    an EventList anymore (see Agent::fillBeats()),
+//    so contiguous storage is strictly a win.
+typedef std::vector<Event> EventList;
 
 #endif
 
@@ -15,6 +15,8 @@
 
 #include "Induction.h"
 
+#include <algorithm>
+
 double Induction::clusterWidth = 0.025;
 double Induction::minIOI = 0.070;
 double Induction::maxIOI = 2.500;
@@ -23,7 +25,7 @@ double Induction::maxIBI = 1.0;
 int Induction::topN = 10;
 
 
-AgentList Induction::beatInduction(AgentParameters params, EventList events) {
+AgentList Induction::beatInduction(AgentParameters params, const EventList &events) {
     int i, j, b, bestCount;
     bool submult;
     int intervals = 0;			// number of interval clusters
@@ -40,39 +42,52 @@ AgentList Induction::beatInduction(AgentParameters params, EventList events) {
     vector<int> clusterScore;
     clusterScore.resize(maxClusterCount);
 		
-    EventList::iterator ptr1, ptr2;
-    Event e1, e2;
-    ptr1 = events.begin();
-    while (ptr1 != events.end()) {
-        e1 = *ptr1;
-        ++ptr1;
-        ptr2 = events.begin();
-        e2 = *ptr2;
-        ++ptr2;
-        while (e2 != e1 && ptr2 != events.end()) {
-            e2 = *ptr2;
-            ++ptr2;
-        }
-        while (ptr2 != events.end()) {
-            e2 = *ptr2;
-            ++ptr2;
-            double ioi = e2.time - e1.time;
+    // Modified 18Oct2026:
+    //    Index the events directly instead of rescanning from
+    //    the start of the list to find e1 for every onset.
+    //
+    //    Events are sorted by time, so the first event at least
+    //    minIOI after e1 only ever moves forward (window), and the
+    //    scan for each e1 stops at maxIOI. The cluster means are
+    //    kept in ascending order, so the nearest cluster can be
+    //    found with a binary search (see findCluster()).
+    //
+    //    All of this gives identical clusters to the original
+    //    quadratic scan.
+    std::size_t first = 0;		// first event equal to e1
+    std::size_t window = 0;		// first event at least minIOI after e1
+    bool sorted = true;			// clusterMean is in ascending order
+    for (std::size_t index = 0; index < events.size(); ++index) {
+        const Event &e1 = events[index];
+        // The original matched e2 against e1 by value, so
+        // duplicate events start from the first duplicate
+        if (events[first] != e1)
+            first = index;
+        if (window < first + 1)
+            window = first + 1;
+        while (window < events.size() && events[window].time - e1.time < minIOI)
+            ++window;
+        for (std::size_t next = window; next < events.size(); ++next) {
+            double ioi = events[next].time - e1.time;
             if (ioi < minIOI)		// skip short intervals
                 continue;
             if (ioi > maxIOI)		// ioi too long
                 break;
-            for (b = 0; b < intervals; b++)		// assign to nearest cluster
-                if (fabs(clusterMean[b] - ioi) < clusterWidth) {
-                    if ((b < intervals - 1) && (
-                            fabs(clusterMean[b+1] - ioi) <
-                            fabs(clusterMean[b] - ioi)))
-                        b++;		// next cluster is closer
-                    clusterMean[b] = (clusterMean[b] * clusterSize[b] +ioi)/
-                        (clusterSize[b] + 1);
-                    clusterSize[b]++;
-                    break;
-                }
-            if (b == intervals) {	// no suitable cluster; create new one
+            b = findCluster(clusterMean, intervals, ioi, sorted);
+            if (b < intervals) {	// assign to nearest cluster
+                if ((b < intervals - 1) && (
+                        fabs(clusterMean[b+1] - ioi) <
+                        fabs(clusterMean[b] - ioi)))
+                    b++;		// next cluster is closer
+                clusterMean[b] = (clusterMean[b] * clusterSize[b] +ioi)/
+                    (clusterSize[b] + 1);
+                clusterSize[b]++;
+                // Means can (rarely) drift past their neighbours,
+                // at which point we fall back to a linear search
+                if (((b > 0) && (clusterMean[b-1] > clusterMean[b])) ||
+                    ((b < intervals - 1) && (clusterMean[b] > clusterMean[b+1])))
+                    sorted = false;
+            } else {		// no suitable cluster; create new one
                 if (intervals == maxClusterCount) {
 //			System.err.println("Warning: Too many clusters");
                     continue; // ignore this IOI
@@ -87,10 +102,20 @@ AgentList Induction::beatInduction(AgentParameters params, EventList events) {
             }
         }
     }
-    for (b = 0; b < intervals; b++)	// merge similar intervals
-        // TODO: they are now in order, so don't need the 2nd loop
-        // TODO: check BOTH sides before averaging or upper gps don't work
-        for (i = b+1; i < intervals; i++)
+    // Merge similar intervals
+    //
+    // Modified 18Oct2026:
+    //    When the means are in order, nothing after the first
+    //    larger cluster that's too far away can be merged, so
+    //    stop looking there instead of checking every later cluster.
+    //
+    //    Note that after a merge the next cluster gets skipped
+    //    (i is incremented after shifting everything down). This
+    //    (and merging without checking both sides) is how BeatRoot
+    //    has always behaved, so it's left alone.
+    sorted = std::is_sorted(clusterMean.begin(), clusterMean.begin() + intervals);
+    for (b = 0; b < intervals; b++)
+        for (i = b+1; i < intervals; i++) {
             if (fabs(clusterMean[b] - clusterMean[i]) < clusterWidth) {
                 clusterMean[b] = (clusterMean[b] * clusterSize[b] +
                                   clusterMean[i] * clusterSize[i]) /
@@ -101,7 +126,9 @@ AgentList Induction::beatInduction(AgentParameters params, EventList events) {
                     clusterMean[j-1] = clusterMean[j];
                     clusterSize[j-1] = clusterSize[j];
                 }
-            }
+            } else if (sorted && (clusterMean[i] > clusterMean[b]))
+                break;
+        }
     if (intervals == 0)
         return AgentList();
     for (b = 0; b < intervals; b++)
@@ -183,7 +210,7 @@ AgentList Induction::beatInduction(AgentParameters params, EventList events) {
         while (beat > maxIBI)		// Minimum speed
             beat /= 2.0;
         if (beat >= minIBI) {
-            a.push_back(new Agent(params, beat));
+            a.push_back(a.create(params, beat));
         }
     }
 #ifdef DEBUG_BEATROOT
@@ -192,3 +219,22 @@ AgentList Induction::beatInduction(AgentParameters params, EventList events) {
     return a;
 } // beatInduction()
 
+int Induction::findCluster(const vector<double> &clusterMean, int intervals,
+                           double ioi, bool sorted) {
+    int b = 0;
+    if (sorted) {
+        // Everything before this is more than clusterWidth away.
+        // The extra slack keeps us clear of any rounding in fabs().
+        b = (int)(std::lower_bound(clusterMean.begin(),
+                                   clusterMean.begin() + intervals,
+                                   ioi - 2 * clusterWidth) - clusterMean.begin());
+    }
+    for ( ; b < intervals; b++) {
+        if (fabs(clusterMean[b] - ioi) < clusterWidth)
+            return b;
+        if (sorted && (clusterMean[b] > ioi + 2 * clusterWidth))
+            break;
+    }
+    return intervals;
+} // findCluster()
+
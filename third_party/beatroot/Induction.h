@@ -68,9 +68,19 @@ public:
      *  @return A list of beat tracking agents, where each is initialised with one
      *          of the top tempo hypotheses but no beats
      */
-    static AgentList beatInduction(AgentParameters params, EventList events);
+    static AgentList beatInduction(AgentParameters params, const EventList &events);
 
 protected:
+    /** Finds the first cluster whose mean is within clusterWidth of ioi.
+     *  @param clusterMean The means of the clusters found so far
+     *  @param intervals The number of clusters found so far
+     *  @param ioi The inter-onset interval to look for
+     *  @param sorted Whether clusterMean is in ascending order
+     *  @return The index of the cluster, or intervals if there is none
+     */
+    static int findCluster(const vector<double> &clusterMean, int intervals,
+                           double ioi, bool sorted);
+
     /** For variable cluster widths in newInduction().
      * @param low The lowest IOI allowed in the cluster
      * @return The highest IOI allowed in the cluster